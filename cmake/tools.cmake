@@ -37,6 +37,20 @@ endif()
 set(Python3_FIND_VIRTUALENV ONLY)
 find_package(Python3 3.10 REQUIRED COMPONENTS Interpreter)
 
+# Executables can optionally be compressed and bundled with a small stub that
+# decompresses them at startup, by passing -DCOMPRESS_EXECUTABLES=ON to CMake.
+option(
+	COMPRESS_EXECUTABLES
+	"Compress executables and decompress them at startup"
+	OFF
+)
+
+if(COMPRESS_EXECUTABLES)
+	set(_convertExecutableOptions -c)
+else()
+	set(_convertExecutableOptions)
+endif()
+
 # Define some helper functions that rely on the Python scripts in the tools
 # folder.
 function(addPS1Executable name)
@@ -52,6 +66,7 @@ function(addPS1Executable name)
 		COMMAND
 			"${Python3_EXECUTABLE}"
 			"${PROJECT_SOURCE_DIR}/tools/convertExecutable.py"
+			${_convertExecutableOptions}
 			"$<TARGET_FILE:${name}>"
 			${name}.psexe
 		VERBATIM
@@ -70,6 +85,7 @@ function(addPS1ExecutableAdv name loadAddress stackTop region)
 			"${PROJECT_SOURCE_DIR}/tools/convertExecutable.py"
 			-r "${region}"
 			-s "${stackTop}"
+			${_convertExecutableOptions}
 			"$<TARGET_FILE:${name}>"
 			${name}.psexe
 		VERBATIM
@@ -90,28 +106,117 @@ function(convertImage input bpp)
 	)
 endfunction()
 
-# Let CMake locate psxavenc automatically (or rely on the user overriding it by
-# passing -DPSXAVENC_PATH=...) and define a helper function to encode audio
-# samples if available.
-find_program(
-	PSXAVENC_PATH psxavenc
-	DOC "Path to psxavenc executable (if not present in PATH)"
-)
+# Photographic images can be compressed into an MDEC bitstream, which takes
+# significantly less space than raw 16bpp data and can be decoded directly into
+# VRAM at load time. Higher quantization scales result in smaller files at the
+# expense of image quality.
+function(convertMDECImage input quantScale output)
+	add_custom_command(
+		OUTPUT  "${output}"
+		DEPENDS "${PROJECT_SOURCE_DIR}/${input}"
+		COMMAND
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/convertImage.py"
+			-m
+			-q ${quantScale}
+			"${PROJECT_SOURCE_DIR}/${input}"
+			"${output}"
+		VERBATIM
+	)
+endfunction()
 
-function(convertAudioSample input sampleRate output)
-	if("${PSXAVENC_PATH}" STREQUAL "PSXAVENC_PATH-NOTFOUND")
-		message(FATAL_ERROR "Unable to find psxavenc. Ensure your PATH \
-environment variable includes the full path to the directory containing it, or \
-pass -DPSXAVENC_PATH=... to CMake to specify its location manually.")
-	endif()
+# Video streams are generated from one or more animated images (or a sequence
+# of still images) by encoding each frame so that it fits in the sectors read by
+# the drive in one frame's time at the given frame rate. Any additional
+# arguments are passed to the encoder as options (e.g. -a to interleave an audio
+# track).
+function(convertVideo input frameRate output)
+	add_custom_command(
+		OUTPUT  "${output}"
+		DEPENDS "${PROJECT_SOURCE_DIR}/${input}"
+		COMMAND
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/convertVideo.py"
+			-r ${frameRate}
+			${ARGN}
+			"${PROJECT_SOURCE_DIR}/${input}"
+			"${output}"
+		VERBATIM
+	)
+endfunction()
+
+# Sequences for the sequence player are converted from standard MIDI files at
+# the given tick rate (in ticks per second). Any additional arguments are passed
+# to the converter as options (e.g. -l to loop the entire song).
+function(convertMIDI input tickRate output)
+	add_custom_command(
+		OUTPUT  "${output}"
+		DEPENDS "${PROJECT_SOURCE_DIR}/${input}"
+		COMMAND
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/convertMIDI.py"
+			-r ${tickRate}
+			${ARGN}
+			"${PROJECT_SOURCE_DIR}/${input}"
+			"${output}"
+		VERBATIM
+	)
+endfunction()
+
+# Instrument banks are built from a JSON manifest listing samples, which are
+# usually generated by the build using convertAudioSample() and should be passed
+# as additional arguments. As with disc images, a depfile is generated so that
+# the bank is rebuilt whenever any of the samples it uses changes.
+function(buildSoundBank manifest output)
+	add_custom_command(
+		OUTPUT  "${output}"
+		DEPENDS "${PROJECT_SOURCE_DIR}/${manifest}" ${ARGN}
+		DEPFILE "${output}.d"
+		COMMAND
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/buildSoundBank.py"
+			-I "${PROJECT_BINARY_DIR}"
+			-d "${output}.d"
+			"${PROJECT_SOURCE_DIR}/${manifest}"
+			"${output}"
+		VERBATIM
+	)
+endfunction()
 
+# The disc image builder takes a JSON manifest listing the files to place on the
+# disc, which may be either in the source tree or generated by the build (such
+# as executables). Any targets the image depends on should be passed as
+# additional arguments. The script generates a depfile listing all source files
+# it read, so that the image is rebuilt whenever any of them changes.
+function(addPS1DiscImage name manifest)
+	add_custom_command(
+		OUTPUT  ${name}.bin ${name}.cue
+		DEPENDS "${PROJECT_SOURCE_DIR}/${manifest}" ${ARGN}
+		DEPFILE ${name}.d
+		COMMAND
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/buildDiscImage.py"
+			-I "${PROJECT_BINARY_DIR}"
+			-d ${name}.d
+			"${PROJECT_SOURCE_DIR}/${manifest}"
+			${name}.bin
+		VERBATIM
+	)
+	add_custom_target(${name} ALL DEPENDS ${name}.bin)
+endfunction()
+
+# Audio samples are converted from WAV files into SPU-ADPCM data at the given
+# sample rate. Any additional arguments are passed to the encoder as options
+# (e.g. -l to loop the sample).
+function(convertAudioSample input sampleRate output)
 	add_custom_command(
 		OUTPUT  "${output}"
 		DEPENDS "${PROJECT_SOURCE_DIR}/${input}"
 		COMMAND
-			"${PSXAVENC_PATH}"
-			-t spu
-			-f ${sampleRate}
+			"${Python3_EXECUTABLE}"
+			"${PROJECT_SOURCE_DIR}/tools/convertAudio.py"
+			-r ${sampleRate}
+			${ARGN}
 			"${PROJECT_SOURCE_DIR}/${input}"
 			"${output}"
 		VERBATIM
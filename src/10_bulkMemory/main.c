@@ -0,0 +1,186 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example is a small benchmark comparing the CPU-based memset() and
+ * memcpy() implementations in the libc folder against the DMA-based bulkFill()
+ * and bulkCopy() functions provided by ps1/bulkmem.c, which use the GPU's DMA
+ * channel and a scratch area of VRAM to move data around without involving the
+ * CPU.
+ *
+ * The PS1's CPU has no data cache, so every load and store it performs goes
+ * straight to main RAM and pays the full access latency (stores are somewhat
+ * faster thanks to a small write buffer). DMA transfers on the other hand are
+ * able to move roughly one word per clock cycle once started, but have a fixed
+ * setup cost of several hundred cycles due to the need to issue GPU commands
+ * and wait for the GPU to become ready. As a result there is a "crossover"
+ * buffer size above which DMA becomes faster; this program measures it and
+ * prints the results over the serial port, so that the thresholds defined in
+ * bulkmem.h can be adjusted accordingly.
+ *
+ * Timing is done using one of the PS1's three hardware timers (also known as
+ * root counters), configured to count at 1/8 of the CPU clock rate. As the
+ * counter is only 16 bits wide, the maximum interval that can be measured is
+ * about 15 milliseconds.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ps1/bulkmem.h"
+#include "ps1/gpucmd.h"
+#include "ps1/registers.h"
+
+static void startTimer(void) {
+	// Setting the prescaler bit on timer 2 makes it count once every 8 CPU
+	// cycles. Writing to the control register also resets the counter to zero
+	// and clears the overflow flag.
+	TIMER_CTRL(2) = TIMER_CTRL_PRESCALE;
+}
+
+static int stopTimer(void) {
+	int value = TIMER_VALUE(2);
+
+	// Return -1 to signal that the timer overflowed, making the measurement
+	// invalid.
+	if (TIMER_CTRL(2) & TIMER_CTRL_OVERFLOWED)
+		return -1;
+
+	return value * 8;
+}
+
+typedef void *(*FillFunction)(void *dest, int ch, size_t count);
+typedef void *(*CopyFunction)(void *dest, const void *src, size_t count);
+
+#define MIN_BUFFER_SIZE   64
+#define MAX_BUFFER_SIZE   (128 * 1024)
+#define NUM_BUFFER_SIZES  12
+
+static uint8_t sourceBuffer[MAX_BUFFER_SIZE], destBuffer[MAX_BUFFER_SIZE];
+
+static int measureFill(FillFunction func, size_t length, int value) {
+	// Run each test twice and only keep the second measurement, so that the
+	// first run can warm up the instruction cache.
+	int time = 0;
+
+	for (int i = 0; i < 2; i++) {
+		startTimer();
+		func(destBuffer, value, length);
+		time = stopTimer();
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		if (destBuffer[i] != value) {
+			printf("Fill verification failed at offset %d\n", i);
+			break;
+		}
+	}
+
+	return time;
+}
+
+static int measureCopy(CopyFunction func, size_t length) {
+	int time = 0;
+
+	for (int i = 0; i < 2; i++) {
+		memset(destBuffer, 0, length);
+
+		startTimer();
+		func(destBuffer, sourceBuffer, length);
+		time = stopTimer();
+	}
+
+	if (memcmp(destBuffer, sourceBuffer, length))
+		puts("Copy verification failed");
+
+	return time;
+}
+
+// Returns the smallest buffer size above which the second set of measurements
+// is consistently faster than the first one, or 0 if it never is.
+static size_t findCrossover(const int *cpuTimes, const int *dmaTimes) {
+	size_t crossover = 0;
+	size_t length    = MAX_BUFFER_SIZE;
+
+	for (int i = NUM_BUFFER_SIZES - 1; i >= 0; i--, length /= 2) {
+		if ((cpuTimes[i] < 0) || (dmaTimes[i] < 0))
+			continue;
+		if (dmaTimes[i] >= cpuTimes[i])
+			break;
+
+		crossover = length;
+	}
+
+	return crossover;
+}
+
+int main(int argc, const char **argv) {
+	initSerialIO(115200);
+
+	// Reset the GPU to make sure it isn't busy doing anything, then reserve the
+	// bottom half of VRAM as a scratch area. Nothing is displayed by this
+	// example so the rest of VRAM is left unused.
+	GPU_GP1 = gp1_resetGPU();
+	initBulkMemory(0, 256, 1024, 256);
+
+	// Force all fills and copies to go through DMA regardless of their size.
+	setBulkThresholds(0, 0);
+
+	for (size_t i = 0; i < MAX_BUFFER_SIZE; i++)
+		sourceBuffer[i] = (uint8_t) (i * 7);
+
+	int fillTimes[2][NUM_BUFFER_SIZES];
+	int copyTimes[2][NUM_BUFFER_SIZES];
+
+	puts("  Size | memset()  bulkFill() | memcpy()  bulkCopy()");
+
+	size_t length = MIN_BUFFER_SIZE;
+
+	for (int i = 0; i < NUM_BUFFER_SIZES; i++, length *= 2) {
+		fillTimes[0][i] = measureFill(&memset,   length, 0);
+		fillTimes[1][i] = measureFill(&bulkFill, length, 0);
+		copyTimes[0][i] = measureCopy(&memcpy,   length);
+		copyTimes[1][i] = measureCopy(&bulkCopy, length);
+
+		printf(
+			"%6d | %8d  %10d | %8d  %10d\n",
+			length,
+			fillTimes[0][i],
+			fillTimes[1][i],
+			copyTimes[0][i],
+			copyTimes[1][i]
+		);
+	}
+
+	// All times are in CPU cycles (-1 means the timer overflowed). Finally,
+	// print the buffer sizes at which switching to DMA starts to pay off.
+	size_t fillThreshold = findCrossover(fillTimes[0], fillTimes[1]);
+	size_t copyThreshold = findCrossover(copyTimes[0], copyTimes[1]);
+
+	printf(
+		"Measured crossover points: fill = %d bytes, copy = %d bytes\n"
+		"(0 = DMA was never faster at the sizes tested)\n",
+		fillThreshold,
+		copyThreshold
+	);
+
+	for (;;)
+		__asm__ volatile("");
+
+	return 0;
+}
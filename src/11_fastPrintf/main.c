@@ -0,0 +1,259 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Debug overlays are a common sight during development: printing a handful of
+ * coordinates, counters and timings on screen every frame is an easy way to
+ * keep an eye on what the game is doing. On the PS1 however formatting numbers
+ * is surprisingly expensive, as converting an integer to decimal requires one
+ * division per digit and the CPU's hardware divider takes 36 cycles to produce
+ * each result. A line of text with several numbers in it can easily end up
+ * taking tens of thousands of cycles.
+ *
+ * The printf() implementation in the vendor folder has thus been extended with
+ * a few faster paths:
+ *
+ * - 32-bit decimal conversion divides by 10 by multiplying by a precomputed
+ *   reciprocal (0xcccccccd / 2^35) rather than issuing a division, while
+ *   hexadecimal, octal and binary conversion only use shifts and masks;
+ * - the %k specifier prints fixed-point values in the same 20.12 format used by
+ *   the GTE (where 4096 = 1.0), with rounding, without having to manually split
+ *   the value into an integer and a fractional part first;
+ * - sprintf_tokens() takes an array of pre-parsed format tokens built at
+ *   compile time in place of a format string, skipping format parsing entirely
+ *   for strings that are printed every frame.
+ *
+ * This example measures each of these against the approach they replace and
+ * prints the results over the serial port. The original division-based
+ * conversion loop is reproduced below as a reference; printf() can also be
+ * reverted to it by defining PRINTF_DISABLE_FAST_NTOA when building the common
+ * library, in order to compare entire sprintf() calls before and after.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "ps1/registers.h"
+
+static void startTimer(void) {
+	// Setting the prescaler bit on timer 2 makes it count once every 8 CPU
+	// cycles. Writing to the control register also resets the counter to zero
+	// and clears the overflow flag.
+	TIMER_CTRL(2) = TIMER_CTRL_PRESCALE;
+}
+
+static int stopTimer(void) {
+	int value = TIMER_VALUE(2);
+
+	// Return -1 to signal that the timer overflowed, making the measurement
+	// invalid.
+	if (TIMER_CTRL(2) & TIMER_CTRL_OVERFLOWED)
+		return -1;
+
+	return value * 8;
+}
+
+#define NUM_ITERATIONS 32
+
+static char buffer[64];
+
+// These two functions only differ in the way they obtain each digit. The base
+// is passed as an argument to prevent the compiler from optimizing the first
+// one's division into a multiplication, just like in the original generic
+// printf() code.
+static __attribute__((noinline)) int divisionItoa(
+	char         *output,
+	unsigned int value,
+	unsigned int base
+) {
+	char digits[12];
+	int  length = 0;
+
+	do {
+		digits[length++] = '0' + (value % base);
+		value           /= base;
+	} while (value);
+
+	for (int i = 0; i < length; i++)
+		output[i] = digits[length - i - 1];
+
+	output[length] = 0;
+	return length;
+}
+
+static __attribute__((noinline)) int reciprocalItoa(
+	char         *output,
+	unsigned int value
+) {
+	char digits[12];
+	int  length = 0;
+
+	do {
+		unsigned int quotient = ((uint64_t) value * 0xcccccccd) >> 35;
+
+		digits[length++] = '0' + (value - quotient * 10);
+		value            = quotient;
+	} while (value);
+
+	for (int i = 0; i < length; i++)
+		output[i] = digits[length - i - 1];
+
+	output[length] = 0;
+	return length;
+}
+
+// A fake "HUD" line containing a few typical values. The token array below is
+// equivalent to the format string and is built entirely at compile time.
+#define HUD_FORMAT "X:%6d Y:%6d Z:%6d ANG:%.2k FPS:%2d"
+
+static const printf_token_t hudTokens[] = {
+	PRINTF_TOKEN("X:",   'd', 0, 6, 0),
+	PRINTF_TOKEN(" Y:",  'd', 0, 6, 0),
+	PRINTF_TOKEN(" Z:",  'd', 0, 6, 0),
+	PRINTF_TOKEN(" ANG:", 'k', 0, 0, 2),
+	PRINTF_TOKEN(" FPS:", 'd', 0, 2, 0),
+	PRINTF_TOKEN("",     0,   0, 0, 0)
+};
+
+static const int testValues[] = {
+	0, 7, 42, 1337, -4096, 65535, 1000000, -123456789
+};
+
+#define NUM_TEST_VALUES (sizeof(testValues) / sizeof(int))
+
+static void printResult(const char *name, int time) {
+	if (time < 0)
+		printf("%-32s: timer overflowed\n", name);
+	else
+		printf("%-32s: %6d cycles/call\n", name, time / NUM_ITERATIONS);
+}
+
+int main(int argc, const char **argv) {
+	initSerialIO(115200);
+
+	// Each test is run twice and only the second measurement is kept, so that
+	// the first run can warm up the instruction cache.
+	int time = 0;
+
+	puts("Integer conversion (8 values):");
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			for (int j = 0; j < NUM_TEST_VALUES; j++)
+				divisionItoa(buffer, (unsigned int) testValues[j], 10);
+		}
+
+		time = stopTimer();
+	}
+
+	printResult("  division (original)", time);
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			for (int j = 0; j < NUM_TEST_VALUES; j++)
+				reciprocalItoa(buffer, (unsigned int) testValues[j]);
+		}
+
+		time = stopTimer();
+	}
+
+	printResult("  reciprocal multiplication", time);
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			for (int j = 0; j < NUM_TEST_VALUES; j++)
+				sprintf(buffer, "%d", testValues[j]);
+		}
+
+		time = stopTimer();
+	}
+
+	printResult("  sprintf(\"%d\")", time);
+
+	// Fixed-point values have traditionally been printed by splitting them
+	// manually, which requires an extra multiplication and two conversions.
+	puts("Fixed-point conversion (8 values):");
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			for (int j = 0; j < NUM_TEST_VALUES; j++) {
+				int value = testValues[j];
+				int whole = value / 4096;
+				int frac  = ((value % 4096) * 1000) / 4096;
+
+				if (frac < 0)
+					frac = -frac;
+
+				sprintf(buffer, "%d.%03d", whole, frac);
+			}
+		}
+
+		time = stopTimer();
+	}
+
+	printResult("  sprintf(\"%d.%03d\")", time);
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			for (int j = 0; j < NUM_TEST_VALUES; j++)
+				sprintf(buffer, "%.3k", testValues[j]);
+		}
+
+		time = stopTimer();
+	}
+
+	printResult("  sprintf(\"%.3k\")", time);
+
+	puts("HUD line:");
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++)
+			sprintf(buffer, HUD_FORMAT, -1234, 567, 89012, 6144, 60);
+
+		time = stopTimer();
+	}
+
+	printResult("  sprintf()", time);
+	printf("  -> %s\n", buffer);
+
+	for (int pass = 0; pass < 2; pass++) {
+		startTimer();
+
+		for (int i = 0; i < NUM_ITERATIONS; i++)
+			sprintf_tokens(buffer, hudTokens, -1234, 567, 89012, 6144, 60);
+
+		time = stopTimer();
+	}
+
+	printResult("  sprintf_tokens()", time);
+	printf("  -> %s\n", buffer);
+
+	for (;;)
+		__asm__ volatile("");
+
+	return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example is a rewrite of the controller tester from example 9 which
+ * polls controllers in the background using interrupts, rather than stalling
+ * the CPU for the entire duration of each transfer.
+ *
+ * The busy-waiting approach used previously is simple but wasteful: each byte
+ * takes 32 microseconds to be sent at 250000bps, plus some additional time for
+ * the controller to acknowledge it, and the delays required before and after
+ * each packet add up quickly. Polling two ports ends up taking over a
+ * millisecond, during which the CPU does nothing but spin in a loop. By having
+ * the hardware notify the CPU through interrupts whenever something happens on
+ * the bus, the CPU only has to spend a few microseconds on each byte and is
+ * free to build the next frame in the meantime.
+ *
+ * Interrupts on the PS1 are handled by the CPU's exception mechanism: whenever
+ * the interrupt controller raises its IRQ line, the CPU stops whatever it is
+ * doing and jumps to a fixed address (0x80000080) where an exception handler
+ * is expected to be. We'll replace the BIOS handler with a much simpler one
+ * (see ps1/system.c and ps1/exception.s) and register a function to be called
+ * for each interrupt, which will in turn forward it to the relevant drivers:
+ *
+ * - the vertical blank IRQ is used to kick off a new poll every frame (and to
+ *   let the main loop know when to flip the framebuffers);
+ * - the SIO0 IRQ, triggered whenever a controller acknowledges a byte, and the
+ *   timer 0 IRQ, used for delays and timeouts, are handled by the driver in
+ *   ps1/sio0.c, which advances a state machine to send the next byte.
+ *
+ * The results are double buffered by the driver in ps1/pad.c, so the main loop
+ * can retrieve the most recent state of each controller at any time without
+ * having to wait. The time taken by each poll is also displayed on screen.
+ *
+ * The driver can also configure analog controllers as soon as they are
+ * connected. In this example, DualShock controllers are switched to analog
+ * mode (with the analog button disabled) and their vibration motors are mapped
+ * onto the poll request, so that holding L2 or R2 will turn on the small or
+ * large motor respectively without requiring any additional transfers.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	// Check which interrupts are pending and dispatch them. Note that multiple
+	// IRQs may be pending at the same time, so all of them must be checked.
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+static const char *const controllerTypes[] = {
+	"Unknown",            // ID 0x0
+	"Mouse",              // ID 0x1
+	"neGcon",             // ID 0x2
+	"Konami Justifier",   // ID 0x3
+	"Digital controller", // ID 0x4
+	"Analog stick",       // ID 0x5
+	"Guncon",             // ID 0x6
+	"Analog controller",  // ID 0x7
+	"Multitap",           // ID 0x8
+	"Keyboard",           // ID 0x9
+	"Unknown",            // ID 0xa
+	"Unknown",            // ID 0xb
+	"Unknown",            // ID 0xc
+	"Unknown",            // ID 0xd
+	"Jogcon",             // ID 0xe
+	"Configuration mode"  // ID 0xf
+};
+
+static const char *const buttonNames[] = {
+	"Select",   // Bit  0
+	"L3",       // Bit  1
+	"R3",       // Bit  2
+	"Start",    // Bit  3
+	"Up",       // Bit  4
+	"Right",    // Bit  5
+	"Down",     // Bit  6
+	"Left",     // Bit  7
+	"L2",       // Bit  8
+	"R2",       // Bit  9
+	"L1",       // Bit 10
+	"R1",       // Bit 11
+	"Triangle", // Bit 12
+	"Circle",   // Bit 13
+	"X",        // Bit 14
+	"Square"    // Bit 15
+};
+
+static const char *const configStates[] = {
+	"None",
+	"In progress",
+	"Done",
+	"Not supported"
+};
+
+static void printControllerInfo(int port, char *output) {
+	// Unlike in the previous example, no communication happens here; the state
+	// returned by getPadState() was fetched in the background at the beginning
+	// of the frame.
+	const PadState *state = getPadState(port, 0);
+	char           *ptr   = output;
+
+	ptr += sprintf(ptr, "Port %d:\n", port + 1);
+
+	if (!state->connected) {
+		ptr += sprintf(ptr, "  No controller connected");
+		return;
+	}
+
+	ptr += sprintf(
+		ptr,
+		"  Controller type:\t%s\n"
+		"  Configuration:\t%s\n"
+		"  Buttons pressed:\t",
+		controllerTypes[state->type],
+		configStates[getPadConfigState(port)]
+	);
+
+	for (int i = 0; i < 16; i++) {
+		if ((state->buttons >> i) & 1)
+			ptr += sprintf(ptr, "%s ", buttonNames[i]);
+	}
+
+	ptr += sprintf(ptr, "\n  Response data:\t");
+
+	for (int i = 0; i < state->length; i++)
+		ptr += sprintf(ptr, "%02X ", state->data[i]);
+}
+
+static int cyclesToMicroseconds(uint32_t cycles) {
+	return (cycles * 1000) / (F_CPU / 1000);
+}
+
+static void printPollStats(char *output) {
+	const PadPollStats *stats = getPadPollStats();
+
+	if (!stats->completedPolls) {
+		sprintf(output, "Waiting for first poll...");
+		return;
+	}
+
+	sprintf(
+		output,
+		"Poll latency:\t%d us (min %d, max %d)\n"
+		"Polls completed:\t%d (%d skipped)",
+		cyclesToMicroseconds(stats->lastLatency),
+		cyclesToMicroseconds(stats->minLatency),
+		cyclesToMicroseconds(stats->maxLatency),
+		stats->completedPolls,
+		stats->skippedPolls
+	);
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	// Install the exception handler and initialize the drivers before enabling
+	// any interrupts.
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+
+	for (int i = 0; i < PAD_NUM_PORTS; i++)
+		setPadConfig(
+			i,
+			PAD_CONFIG_ANALOG | PAD_CONFIG_LOCK | PAD_CONFIG_MOTORS
+		);
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Register the interrupt handler, unmask the vertical blank IRQ (the SIO0
+	// and timer 0 IRQs have already been unmasked by initSIO0()) and finally
+	// enable interrupts.
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		char buffer[512];
+
+		for (int i = 0; i < PAD_NUM_PORTS; i++) {
+			const PadState *state = getPadState(i, 0);
+			int            offset = i * 72;
+
+			// The new motor speeds will be sent along with the next poll.
+			setPadVibration(
+				i,
+				state->buttons & PAD_L2,
+				(state->buttons & PAD_R2) ? 0xc0 : 0x00
+			);
+
+			printControllerInfo(i, buffer);
+			printString(chain, &font, 16, 32 + offset, buffer);
+		}
+
+		printPollStats(buffer);
+		printString(chain, &font, 16, 192, buffer);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+	}
+
+	return 0;
+}
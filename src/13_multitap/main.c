@@ -0,0 +1,234 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example extends the previous one with support for the multitap, an
+ * adapter that allows up to four controllers (and memory cards) to be connected
+ * to a single port, for a total of eight controllers across both ports.
+ *
+ * A naive approach to supporting multitaps would be to poll each slot
+ * separately, which would require up to eight transfers per frame, each one
+ * paying the full cost of asserting DTR, addressing the device and waiting for
+ * the final timeout. Instead, the multitap supports an extended poll command
+ * which returns the state of all four controllers in a single 34-byte response
+ * (2 header bytes plus 8 bytes for each slot). The driver in ps1/pad.c always
+ * sends this command, so each port still takes exactly one transfer per frame
+ * whether or not a multitap is connected, and decodes the response into a
+ * uniform 2x4 array of controller states.
+ *
+ * The worst case cost of polling is thus bounded to two 34-byte transfers, or
+ * roughly 3 milliseconds of bus time with two multitaps connected. As the
+ * transfers are driven by interrupts, only a small fraction of this time is
+ * actually spent by the CPU. The actual number of bytes transferred and time
+ * taken by each poll are displayed on screen.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+static const char *const controllerTypes[] = {
+	"Unknown",            // ID 0x0
+	"Mouse",              // ID 0x1
+	"neGcon",             // ID 0x2
+	"Konami Justifier",   // ID 0x3
+	"Digital controller", // ID 0x4
+	"Analog stick",       // ID 0x5
+	"Guncon",             // ID 0x6
+	"Analog controller",  // ID 0x7
+	"Multitap",           // ID 0x8
+	"Keyboard",           // ID 0x9
+	"Unknown",            // ID 0xa
+	"Unknown",            // ID 0xb
+	"Unknown",            // ID 0xc
+	"Unknown",            // ID 0xd
+	"Jogcon",             // ID 0xe
+	"Configuration mode"  // ID 0xf
+};
+
+static void printPortInfo(int port, char *output) {
+	char *ptr = output;
+
+	ptr += sprintf(
+		ptr,
+		"Port %d (%s):\n",
+		port + 1,
+		isMultitapConnected(port) ? "multitap" : "direct"
+	);
+
+	// Each slot is identified using the same naming convention as the labels
+	// on the multitap itself (1A-1D for port 1, 2A-2D for port 2). Only slot A
+	// is used when no multitap is connected.
+	int numSlots = isMultitapConnected(port) ? PAD_NUM_SLOTS : 1;
+
+	for (int i = 0; i < numSlots; i++) {
+		const PadState *state = getPadState(port, i);
+
+		ptr += sprintf(ptr, "  %d%c: ", port + 1, 'A' + i);
+
+		if (state->connected)
+			ptr += sprintf(
+				ptr,
+				"%-20s %04X\n",
+				controllerTypes[state->type],
+				state->buttons
+			);
+		else
+			ptr += sprintf(ptr, "-\n");
+	}
+}
+
+static int cyclesToMicroseconds(uint32_t cycles) {
+	return (cycles * 1000) / (F_CPU / 1000);
+}
+
+static void printPollStats(char *output) {
+	const PadPollStats *stats = getPadPollStats();
+
+	if (!stats->completedPolls) {
+		sprintf(output, "Waiting for first poll...");
+		return;
+	}
+
+	sprintf(
+		output,
+		"Poll length:\t%d bytes\n"
+		"Poll latency:\t%d us (min %d, max %d)\n"
+		"Polls completed:\t%d (%d skipped)",
+		stats->lastLength,
+		cyclesToMicroseconds(stats->lastLatency),
+		cyclesToMicroseconds(stats->minLatency),
+		cyclesToMicroseconds(stats->maxLatency),
+		stats->completedPolls,
+		stats->skippedPolls
+	);
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		char buffer[256];
+
+		for (int i = 0; i < PAD_NUM_PORTS; i++) {
+			int offset = i * 64;
+
+			printPortInfo(i, buffer);
+			printString(chain, &font, 16, 32 + offset, buffer);
+		}
+
+		printPollStats(buffer);
+		printString(chain, &font, 16, 176, buffer);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example shows how to save and load data to and from memory cards using
+ * the driver in ps1/memcard.c and the filesystem layer in ps1/memcardfs.c, both
+ * of which run entirely in the background. Memory cards share the bus with
+ * controllers and are accessed one 128-byte sector at a time, each sector
+ * taking several milliseconds to transfer; a save file spanning a single 8 KB
+ * block thus takes hundreds of milliseconds to write. Instead of stopping the
+ * game for this long, each sector is transferred as a separate packet driven
+ * by interrupts, and controller polls are interleaved with it.
+ *
+ * Memory cards use a simple filesystem made up of a header, a directory with
+ * one entry per 8 KB block and a linked list of blocks for each file. The first
+ * block of each file is expected to start with a "title frame" containing the
+ * name and icon shown by the BIOS memory card manager, followed by the actual
+ * data. The directory is read from the card once when it is "mounted" and kept
+ * in memory from then on, so looking up files and querying the amount of free
+ * space does not require accessing the card at all.
+ *
+ * Press X to save, O to load and triangle to delete the save file, and select
+ * to switch between ports 1 and 2 (the card is mounted again each time). If the
+ * card is removed or swapped, the next button press mounts it again. The
+ * counter at the top of the screen keeps running while the card is being
+ * accessed. The tools/editMemoryCard.py script can be used to create or inspect
+ * memory card images for use with an emulator.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/memcard.h"
+#include "ps1/memcardfs.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+// File names are made up of a region prefix ("BE" for Europe, "BA" for the US,
+// "BI" for Japan), the game's product code and an arbitrary suffix of up to 8
+// characters.
+#define SAVE_NAME  "BESLUS-00000BAREMTL"
+#define SAVE_MAGIC 0x45564153 // "SAVE"
+
+typedef struct {
+	// Title frame (sector 0)
+	char     magic[2];
+	uint8_t  iconFlags, numBlocks;
+	uint8_t  title[64];
+	uint8_t  _reserved[28];
+	uint16_t iconPalette[16];
+
+	// Icon frame (sector 1)
+	uint8_t  icon[MEMCARD_SECTOR_SIZE];
+
+	// Actual save data (sectors 2+)
+	uint32_t saveMagic, saveCount, frameCounter;
+} SaveFile;
+
+// The save buffer must cover the entire block, as whole blocks are always
+// written to the card.
+static union {
+	SaveFile data;
+	uint8_t  raw[MEMCARD_BLOCK_SIZE];
+} saveBuffer;
+
+static void encodeTitle(uint8_t *output, const char *title) {
+	// The title is displayed by the BIOS using Shift-JIS encoding. Convert
+	// ASCII letters, digits and spaces to their full width equivalents.
+	for (; *title; title++) {
+		char     ch = *title;
+		uint16_t code;
+
+		if ((ch >= '0') && (ch <= '9'))
+			code = 0x824f + (ch - '0');
+		else if ((ch >= 'A') && (ch <= 'Z'))
+			code = 0x8260 + (ch - 'A');
+		else if ((ch >= 'a') && (ch <= 'z'))
+			code = 0x8281 + (ch - 'a');
+		else
+			code = 0x8140;
+
+		*(output++) = code >> 8;
+		*(output++) = code & 0xff;
+	}
+}
+
+static void prepareSave(uint32_t saveCount, uint32_t frameCounter) {
+	SaveFile *save = &saveBuffer.data;
+
+	memset(&saveBuffer, 0, sizeof(saveBuffer));
+
+	save->magic[0]  = 'S';
+	save->magic[1]  = 'C';
+	save->iconFlags = 0x11; // Static icon
+	save->numBlocks = 1;
+	encodeTitle(save->title, "ps1 bare metal");
+
+	// Draw a simple icon (a filled square with a border) using colors 1 and 2
+	// of the icon's 16-color palette.
+	save->iconPalette[1] = 0x7c00;
+	save->iconPalette[2] = 0x7fff;
+
+	for (int y = 0; y < 16; y++) {
+		for (int x = 0; x < 16; x += 2) {
+			bool border = !y || (y == 15);
+			int  left   = (border || !x)        ? 2 : 1;
+			int  right  = (border || (x == 14)) ? 2 : 1;
+
+			save->icon[y * 8 + x / 2] = left | (right << 4);
+		}
+	}
+
+	save->saveMagic    = SAVE_MAGIC;
+	save->saveCount    = saveCount;
+	save->frameCounter = frameCounter;
+}
+
+static const char *const statusNames[] = {
+	"In progress",
+	"OK",
+	"No card",
+	"Checksum error",
+	"Bad sector",
+	"Protocol error",
+	"Not formatted",
+	"File not found",
+	"Not enough space",
+	"Directory corrupted",
+	"Card changed"
+};
+
+static void printCardInfo(const MemCardFS *fs, char *output) {
+	char *ptr = output;
+
+	ptr += sprintf(ptr, "Memory card in port %d:\n", fs->port + 1);
+
+	if (!fs->mounted) {
+		ptr += sprintf(ptr, "  Not mounted");
+		return;
+	}
+
+	ptr += sprintf(ptr, "  Free blocks:\t%d\n", getMemCardFreeBlocks(fs));
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		const MemCardDirEntry *entry = &fs->entries[i];
+
+		if (entry->state != MEMCARD_BLOCK_FIRST)
+			continue;
+
+		ptr += sprintf(
+			ptr,
+			"  %-20s %d KB\n",
+			entry->name,
+			entry->length / 1024
+		);
+	}
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initMemCards();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	// Mount the card in port 1. The filesystem functions return immediately;
+	// the status field is updated once the operation is complete.
+	static MemCardFS fs;
+
+	mountMemCardFS(&fs, 0, 0, 0);
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	uint32_t   frameCounter = 0, opStartFrame = 0, opFrames = 0;
+	uint32_t   saveCount    = 0;
+	uint16_t   lastButtons  = 0;
+	const char *lastAction  = "Mount";
+	bool       opPending    = true;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		// Handle newly pressed buttons, ignoring them while the previous
+		// operation is still in progress.
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if (opPending && !isMemCardFSBusy(&fs)) {
+			opPending = false;
+			opFrames  = frameCounter - opStartFrame;
+
+			if (
+				(fs.status == MEMCARD_OK) &&
+				(saveBuffer.data.saveMagic == SAVE_MAGIC)
+			)
+				saveCount = saveBuffer.data.saveCount;
+		}
+
+		if (!opPending && pressed) {
+			opPending    = true;
+			opStartFrame = frameCounter;
+
+			if (pressed & PAD_SELECT) {
+				lastAction = "Mount";
+				mountMemCardFS(&fs, fs.port ^ 1, 0, 0);
+			} else if (!fs.mounted) {
+				// If the card was removed or swapped, mount it again before
+				// attempting any other operation.
+				lastAction = "Mount";
+				mountMemCardFS(&fs, fs.port, 0, 0);
+			} else if (pressed & PAD_CROSS) {
+				lastAction = "Save";
+				prepareSave(++saveCount, frameCounter);
+				writeMemCardFile(
+					&fs,
+					SAVE_NAME,
+					&saveBuffer,
+					sizeof(saveBuffer),
+					0,
+					0
+				);
+			} else if (pressed & PAD_CIRCLE) {
+				lastAction = "Load";
+				memset(&saveBuffer, 0, sizeof(saveBuffer));
+				readMemCardFile(&fs, SAVE_NAME, &saveBuffer, 0, 0);
+			} else if (pressed & PAD_TRIANGLE) {
+				lastAction = "Delete";
+				deleteMemCardFile(&fs, SAVE_NAME, 0, 0);
+			} else {
+				opPending = false;
+			}
+		}
+
+		char buffer[512];
+
+		sprintf(
+			buffer,
+			"Frame counter:\t%d\n"
+			"Save counter:\t%d\n"
+			"%s:\t%s (%d frames)",
+			frameCounter,
+			saveCount,
+			lastAction,
+			statusNames[fs.status],
+			opPending ? (frameCounter - opStartFrame) : opFrames
+		);
+		printString(chain, &font, 16, 16, buffer);
+
+		printCardInfo(&fs, buffer);
+		printString(chain, &font, 16, 64, buffer);
+
+		printString(
+			chain,
+			&font,
+			16,
+			208,
+			"[X] Save  [O] Load  [/\\] Delete  [Select] Port"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+		frameCounter++;
+	}
+
+	return 0;
+}
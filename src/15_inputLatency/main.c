@@ -0,0 +1,298 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example measures the latency between a controller being polled and the
+ * frame reflecting its state being shown on screen, i.e. the part of the
+ * "input lag" that is under the program's control. Knowing where the time goes
+ * is the first step towards reducing it: a game that polls controllers at the
+ * beginning of a frame, uses the results to build the next frame and only then
+ * sends it to the GPU will always show the effects of each button press at
+ * least one frame late, no matter how fast it is.
+ *
+ * To track the state of each poll through the pipeline, we'll use one of the
+ * PS1's timers (also known as root counters) as a clock. Timer 1 can be
+ * configured to count horizontal blanking periods rather than CPU cycles,
+ * giving us a timestamp in scanlines that naturally lines up with the display.
+ * The following events are timestamped:
+ *
+ * - the completion of each poll, through a callback registered with the
+ *   controller driver;
+ * - the point at which the main loop sends a DMA chain built using the state
+ *   from a given poll to the GPU (each chain is tagged with the index and
+ *   timestamp of the poll it used);
+ * - the first vertical blank after the chain has been sent, at which point the
+ *   frame it drew has been fully scanned out.
+ *
+ * The minimum, average and maximum latency over the last second are displayed
+ * on screen and printed to the serial port, along with a breakdown of the time
+ * spent before and after the chain is sent. Pressing the D-pad moves a square
+ * around, so the measured latency can be compared with how responsive the
+ * program actually feels.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+static volatile uint32_t pollSequence = 0;
+static volatile uint16_t pollTime     = 0;
+static volatile uint16_t vblankTime   = 0;
+
+static uint16_t getScanline(void) {
+	return TIMER_VALUE(1);
+}
+
+static void pollCallback(void *arg) {
+	pollTime = getScanline();
+	pollSequence++;
+}
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		vblankTime = getScanline();
+
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+typedef struct {
+	uint32_t count, total;
+	uint16_t min, max;
+} LatencyStats;
+
+static void resetStats(LatencyStats *stats) {
+	stats->count = 0;
+	stats->total = 0;
+	stats->min   = UINT16_MAX;
+	stats->max   = 0;
+}
+
+static void addSample(LatencyStats *stats, uint16_t value) {
+	stats->count++;
+	stats->total += value;
+
+	if (value < stats->min)
+		stats->min = value;
+	if (value > stats->max)
+		stats->max = value;
+}
+
+static int printStats(
+	char               *output,
+	const char         *name,
+	const LatencyStats *stats
+) {
+	if (!stats->count)
+		return sprintf(output, "%s:\t-\n", name);
+
+	return sprintf(
+		output,
+		"%s:\t%d / %d / %d\n",
+		name,
+		stats->min,
+		stats->total / stats->count,
+		stats->max
+	);
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define REPORT_INTERVAL 60
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Configure timer 1 to count horizontal blanking periods. With no reload
+	// value set, it will count up freely and wrap around every 65536
+	// scanlines; as long as all latencies are shorter than that, timestamps
+	// can be subtracted from each other using 16-bit unsigned arithmetic.
+	TIMER_CTRL(1) = TIMER_CTRL_EXT_CLOCK;
+
+	setPadPollCallback(&pollCallback, 0);
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	// The chain sent during the previous frame, which will have been scanned
+	// out by the time waitForVSync() returns in the current one.
+	DMAChain *lastChain   = 0;
+	uint32_t lastSequence = 0;
+
+	LatencyStats totalStats, beforeSendStats, afterSendStats;
+	int          frameCounter = 0;
+	char         report[256]  = "Measuring...";
+
+	resetStats(&totalStats);
+	resetStats(&beforeSendStats);
+	resetStats(&afterSendStats);
+
+	int squareX = SCREEN_WIDTH / 2, squareY = SCREEN_HEIGHT / 2;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		// Fetch the latest controller state and tag the chain with the poll it
+		// came from. The state, sequence number and timestamp are all updated
+		// by the interrupt handler, so interrupts must be disabled while
+		// reading them to make sure they match.
+		bool           enabled = disableInterrupts();
+		const PadState *pad    = getPadState(0, 0);
+
+		chain->pollSequence = pollSequence;
+		chain->pollTime     = pollTime;
+
+		if (enabled)
+			enableInterrupts();
+
+		if (pad->connected) {
+			if ((pad->buttons & PAD_LEFT) && (squareX > 0))
+				squareX -= 2;
+			if ((pad->buttons & PAD_RIGHT) && (squareX < (SCREEN_WIDTH - 32)))
+				squareX += 2;
+			if ((pad->buttons & PAD_UP) && (squareY > 0))
+				squareY -= 2;
+			if ((pad->buttons & PAD_DOWN) && (squareY < (SCREEN_HEIGHT - 32)))
+				squareY += 2;
+		}
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(255, 255, 0) | gp0_rectangle(false, false, false);
+		ptr[1] = gp0_xy(squareX, squareY);
+		ptr[2] = gp0_xy(32, 32);
+
+		printString(chain, &font, 16, 16, report);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+
+		// The previous chain has now been fully displayed. Only count it if it
+		// actually used the results of a new poll, as the latency would
+		// otherwise include the time the poll was skipped for.
+		if (lastChain && (lastChain->pollSequence != lastSequence)) {
+			uint16_t scanout = vblankTime;
+
+			addSample(&totalStats, scanout - lastChain->pollTime);
+			addSample(
+				&beforeSendStats,
+				lastChain->sendTime - lastChain->pollTime
+			);
+			addSample(&afterSendStats, scanout - lastChain->sendTime);
+
+			lastSequence = lastChain->pollSequence;
+		}
+
+		chain->sendTime = getScanline();
+		sendLinkedList(chain->data);
+		lastChain = chain;
+
+		if (++frameCounter < REPORT_INTERVAL)
+			continue;
+
+		char *output = report;
+
+		output += sprintf(output, "Latency in scanlines (min/avg/max)\n");
+		output += printStats(output, "Poll to scanout", &totalStats);
+		output += printStats(output, "Poll to send", &beforeSendStats);
+		output += printStats(output, "Send to scanout", &afterSendStats);
+		puts(report);
+
+		resetStats(&totalStats);
+		resetStats(&beforeSendStats);
+		resetStats(&afterSendStats);
+		frameCounter = 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example loads files from the CD it was booted from, using the driver in
+ * ps1/cdrom.c, the ISO9660 index in ps1/iso9660.c and the sector cache in
+ * ps1/cdcache.c. Unlike all previous examples, it is not meant to be run as a
+ * standalone executable: the build process generates a disc image
+ * (example16_disc.bin and .cue) containing the executable along with a few
+ * data files (this example's own source code), which can then be burned or
+ * loaded into an emulator.
+ *
+ * The disc is mounted in the background once at startup, building an index of
+ * all files on it; from then on, looking up a file by its path no longer
+ * requires reading any directory from the disc. Files are then loaded through
+ * the cache, which reads a few more sectors after each file and keeps recently
+ * used sectors around. As the files are laid out on the disc in the order
+ * listed in the trace.txt file next to this one, loading them in that order
+ * results in most of them being served from the cache without any seek. The
+ * number of cache hits, misses and seeks is shown on screen.
+ *
+ * When built in debug mode, the cache prints the location of each read to the
+ * serial port. To record a new trace, boot the disc image, load files in the
+ * desired order while capturing the serial output and pass the log along with
+ * the image to tools/convertTraceLog.py, then rebuild the image.
+ *
+ * Use left and right on the D-pad to select a file, X to load it and triangle
+ * to prefetch all files in the background. The frame counter keeps running
+ * while files are being loaded.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/cdcache.h"
+#include "ps1/cdrom.h"
+#include "ps1/gpucmd.h"
+#include "ps1/iso9660.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+	handleCDROMInterrupts();
+}
+
+// Paths of the files to load, which must match the names given to them in the
+// disc image manifest (disc.json).
+static const char *const fileNames[] = {
+	"SRC/MAIN.C",
+	"SRC/GPU.C",
+	"SRC/GPU.H",
+	"SRC/FONT.C",
+	"SRC/FONT.H"
+};
+
+#define NUM_FILES        ((int) (sizeof(fileNames) / sizeof(const char *)))
+#define MAX_FILE_SIZE    (16 * CDCACHE_SECTOR_SIZE)
+#define INDEX_SIZE       64
+#define CACHE_SLOTS      32
+#define READ_AHEAD       8
+#define MAX_KEPT_SECTORS 8
+
+static ISO9660FS    iso;
+static ISO9660Entry isoIndex[INDEX_SIZE];
+static CDCache      cache;
+static CDCacheSlot  cacheSlots[CACHE_SLOTS];
+
+static uint8_t cacheBuffer[CACHE_SLOTS * CDCACHE_SECTOR_SIZE]
+	__attribute__((aligned(4)));
+static uint8_t fileBuffer[MAX_FILE_SIZE] __attribute__((aligned(4)));
+
+static const char *const isoStatusNames[] = {
+	"Mounting...",
+	"OK",
+	"Drive error",
+	"Not an ISO9660 disc",
+	"Index full",
+	"Hash collision"
+};
+
+static const char *const readStatusNames[] = {
+	"Loading...",
+	"OK",
+	"Drive error",
+	"End of disc"
+};
+
+static int getSectorCount(const ISO9660Entry *entry) {
+	return (entry->length + CDCACHE_SECTOR_SIZE - 1) / CDCACHE_SECTOR_SIZE;
+}
+
+static void printPreview(char *output, const char *data, int length) {
+	// Copy the first few lines of the file, truncating long lines and
+	// replacing any character the font cannot display.
+	int line = 0, column = 0;
+
+	for (int i = 0; (i < length) && (line < 12); i++) {
+		char ch = data[i];
+
+		if (ch == '\n') {
+			*(output++) = '\n';
+			line++;
+			column = 0;
+			continue;
+		}
+		if (column++ >= 48)
+			continue;
+
+		if (ch == '\t')
+			ch = ' ';
+		else if ((ch < ' ') || (ch > '~'))
+			ch = '?';
+
+		*(output++) = ch;
+	}
+
+	*output = 0;
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initCDROM();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	// Start mounting the disc and set up the cache. As with the memory card
+	// example, all of these functions return immediately and the actual work
+	// is done by the interrupt handler.
+	mountISO9660(&iso, isoIndex, INDEX_SIZE, 0, 0);
+	initCDCache(
+		&cache,
+		cacheSlots,
+		cacheBuffer,
+		CACHE_SLOTS,
+		READ_AHEAD,
+		MAX_KEPT_SECTORS
+	);
+
+	// Log all reads issued through the cache, so that the order in which files
+	// are loaded can be turned into a new trace.txt (see below).
+	cache.trace = true;
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	CDCacheRead read;
+	bool        readStarted   = false, readPending = false;
+	int         selectedFile  = 0, readLength = 0;
+	uint32_t    frameCounter  = 0, readStartFrame = 0, readFrames = 0;
+	uint16_t    lastButtons   = 0;
+	char        preview[1024] = "";
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if (readPending && (read.status != CDROM_PENDING)) {
+			readPending = false;
+			readFrames  = frameCounter - readStartFrame;
+
+			if (read.status == CDROM_OK)
+				printPreview(preview, (const char *) fileBuffer, readLength);
+		}
+
+		if (!readPending) {
+			if (pressed & PAD_LEFT) {
+				selectedFile = (selectedFile + NUM_FILES - 1) % NUM_FILES;
+				preview[0]   = 0;
+			}
+			if (pressed & PAD_RIGHT) {
+				selectedFile = (selectedFile + 1) % NUM_FILES;
+				preview[0]   = 0;
+			}
+		}
+
+		// The index is only valid once the disc has been mounted, until then
+		// all lookups will fail.
+		const ISO9660Entry *entry = findISO9660File(
+			&iso,
+			fileNames[selectedFile]
+		);
+
+		if (!readPending) {
+			if ((pressed & PAD_CROSS) && entry) {
+				if (entry->length > MAX_FILE_SIZE) {
+					puts("File too large");
+				} else {
+					read.lba      = entry->lba;
+					read.count    = getSectorCount(entry);
+					read.data     = fileBuffer;
+					read.callback = 0;
+
+					readStarted    = true;
+					readPending    = true;
+					readStartFrame = frameCounter;
+					readLength     = entry->length;
+					queueCDCacheRead(&cache, &read);
+				}
+			}
+		}
+
+		// Hint the cache to load all files in the background. Reads will still
+		// be processed as soon as possible while prefetching is in progress.
+		if ((pressed & PAD_TRIANGLE) && (iso.status == ISO9660_OK)) {
+			for (int i = 0; i < NUM_FILES; i++) {
+				const ISO9660Entry *file = findISO9660File(&iso, fileNames[i]);
+
+				if (file)
+					prefetchCDCache(&cache, file->lba, getSectorCount(file));
+			}
+		}
+
+		char               buffer[512];
+		const CDCacheStats *stats = &cache.stats;
+
+		sprintf(
+			buffer,
+			"Frame counter:\t%d\n"
+			"Disc:\t\t%s (%d files)\n"
+			"File:\t\t< %s >\n"
+			"Location:\t%d (%d bytes)\n"
+			"Read:\t\t%s (%d frames)\n"
+			"Cache:\t\t%d hits, %d misses\n"
+			"Disc reads:\t%d seeks, %d sectors",
+			frameCounter,
+			isoStatusNames[iso.status],
+			iso.numEntries,
+			fileNames[selectedFile],
+			entry ? entry->lba : 0,
+			entry ? entry->length : 0,
+			readStarted ? readStatusNames[read.status] : "-",
+			readPending ? (frameCounter - readStartFrame) : readFrames,
+			stats->hits,
+			stats->misses,
+			stats->seeks,
+			stats->sectorsRead
+		);
+		printString(chain, &font, 16, 16, buffer);
+		printString(chain, &font, 16, 96, preview);
+
+		printString(
+			chain,
+			&font,
+			16,
+			216,
+			"[<][>] Select  [X] Load  [/\\] Prefetch all"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+		frameCounter++;
+	}
+
+	return 0;
+}
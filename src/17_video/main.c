@@ -0,0 +1,189 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example plays back a full screen video from the CD using the MDEC and
+ * the player in ps1/strplayer.c. The video is generated at build time from the
+ * animated image next to this file by tools/convertVideo.py, which compresses
+ * each frame so that it fits in the sectors the drive reads in one frame's
+ * time (10 sectors at 15 fps and double speed), and is placed on the disc image
+ * (example17_disc.bin and .cue) along with the executable.
+ *
+ * Once started, the player runs almost entirely in the background: the drive
+ * streams sectors into a ring buffer, the main loop decodes each frame's
+ * bitstream as soon as all of its sectors have arrived and the DMA interrupt
+ * handler moves the decoded image from the MDEC to VRAM one slice at a time.
+ * The main loop is free to do other work in the meantime; here it only prints
+ * how long each stage took for the last frame to the serial port once per
+ * second, which is useful to figure out how much headroom is left at a given
+ * resolution and frame rate.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gpu.h"
+#include "ps1/cdrom.h"
+#include "ps1/gpucmd.h"
+#include "ps1/iso9660.h"
+#include "ps1/mdec.h"
+#include "ps1/mdecbs.h"
+#include "ps1/registers.h"
+#include "ps1/spu.h"
+#include "ps1/strplayer.h"
+#include "ps1/system.h"
+
+#define SCREEN_WIDTH  320
+#define SCREEN_HEIGHT 240
+
+// The MDEC buffers must be at least as large as the limit passed to the
+// encoder (16384 words by default), while the frame buffer must be able to
+// hold all sectors of a frame.
+#define SECTOR_SLOTS     32
+#define MAX_FRAME_CHUNKS 16
+#define MDEC_BUFFER_SIZE 16384
+#define SLICE_SIZE       (MDEC_MACROBLOCK_SIZE_16BPP * SCREEN_HEIGHT / 16)
+
+static STRPlayer player;
+
+static uint8_t sectorBuffer[SECTOR_SLOTS * XASTREAM_SECTOR_SIZE]
+	__attribute__((aligned(4)));
+static uint8_t  frameBuffer[MAX_FRAME_CHUNKS * STR_CHUNK_SIZE]
+	__attribute__((aligned(4)));
+static uint32_t mdecBuffers[2][MDEC_BUFFER_SIZE];
+static uint32_t sliceBuffers[2][SLICE_SIZE];
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+
+		// Display the last frame the player has finished uploading.
+		int buffer = player.displayBuffer;
+
+		if (buffer >= 0) {
+			GPU_GP1 = gp1_fbOffset(
+				player.bufferX[buffer],
+				player.bufferY[buffer]
+			);
+			GPU_GP1 = gp1_dispBlank(false);
+		}
+	}
+
+	handleSTRPlayerInterrupt(&player);
+	handleCDROMInterrupts();
+}
+
+#define INDEX_SIZE 16
+
+static ISO9660FS    iso;
+static ISO9660Entry isoIndex[INDEX_SIZE];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initCDROM();
+	initMDEC();
+	initMDECBitstream(0);
+	initSPU();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+
+	// Frames are uploaded alternately to two buffers, one above the other,
+	// which are also used directly as framebuffers.
+	player.frameBuffer       = frameBuffer;
+	player.frameBufferLength = sizeof(frameBuffer);
+	player.mdecBuffers[0]    = mdecBuffers[0];
+	player.mdecBuffers[1]    = mdecBuffers[1];
+	player.mdecBufferLength  = MDEC_BUFFER_SIZE;
+	player.sliceBuffers[0]   = sliceBuffers[0];
+	player.sliceBuffers[1]   = sliceBuffers[1];
+	player.bufferX[0]        = 0;
+	player.bufferY[0]        = 0;
+	player.bufferX[1]        = 0;
+	player.bufferY[1]        = 256;
+	player.upload            = &sendVRAMData;
+
+	initSTRPlayer(&player, sectorBuffer, SECTOR_SLOTS);
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~((1 << IRQ_VSYNC) | (1 << IRQ_DMA));
+	IRQ_MASK |= (1 << IRQ_VSYNC) | (1 << IRQ_DMA);
+	enableInterrupts();
+
+	// Mount the disc and wait for the file to be found before starting
+	// playback.
+	mountISO9660(&iso, isoIndex, INDEX_SIZE, 0, 0);
+
+	while (isISO9660Busy(&iso))
+		__asm__ volatile("");
+
+	const ISO9660Entry *entry = findISO9660File(&iso, "VIDEO.STR");
+
+	if (!entry) {
+		puts("Unable to find VIDEO.STR on the disc");
+
+		for (;;)
+			__asm__ volatile("");
+	}
+
+	// The channel numbers must match the ones used by convertVideo.py.
+	player.stream.lba          = entry->lba;
+	player.stream.length       = entry->length / XASTREAM_SECTOR_SIZE;
+	player.stream.file         = 1;
+	player.stream.audioChannel = 0;
+	player.stream.dataChannel  = 1;
+	player.stream.loop         = true;
+
+	startSTRPlayer(&player);
+
+	for (int counter = 0;; counter++) {
+		updateSTRPlayer(&player);
+		waitForVSync();
+
+		if (counter % 60)
+			continue;
+
+		// All times are in horizontal blanking periods (about 64 us each).
+		const STRPlayerStats *stats = &player.stats;
+
+		printf(
+			"Frames: %d (%d dropped, %d errors), sectors lost: %d\n"
+			"Last frame: read %d, decode %d, MDEC %d, upload %d, "
+			"interval %d\n",
+			stats->frames,
+			stats->dropped,
+			stats->errors,
+			player.stream.stats.dropped,
+			stats->readTime,
+			stats->decodeTime,
+			stats->mdecTime,
+			stats->uploadTime,
+			stats->interval
+		);
+	}
+
+	return 0;
+}
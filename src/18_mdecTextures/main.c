@@ -0,0 +1,245 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example shows how the MDEC, normally used to play back videos, can also
+ * be used to decompress textures. Raw 16bpp textures take up a lot of space in
+ * the executable (128 KB for a single 256x256 image), which quickly adds up and
+ * slows down loading. Photographic images can instead be compressed at build
+ * time by tools/convertImage.py into the same bitstream format used by video
+ * frames, usually shrinking them by a factor of 5-15 with little visible loss
+ * in quality.
+ *
+ * At load time, the bitstream is first decoded into run-length codes by the
+ * CPU, then fed to the MDEC which turns them back into pixels. The MDEC outputs
+ * the image one vertical strip at a time, each of which is uploaded to VRAM
+ * while the next one is being decoded (see uploadCompressedTexture() in gpu.c).
+ * Compressed textures are not suitable for images with sharp edges or few
+ * colors, such as fonts or sprites, which are better stored as indexed color
+ * data instead.
+ *
+ * The same image is loaded here both as a raw texture and as a compressed one
+ * and displayed side by side, along with the size of each version and the time
+ * it took to upload or decode them. As decompression is entirely CPU-bound,
+ * the compressed texture takes longer to load from memory; however, it saves
+ * far more time than that when the data has to be read from a disc in the
+ * first place (a double speed drive reads roughly 300 KB per second).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/mdec.h"
+#include "ps1/mdecbs.h"
+#include "ps1/registers.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC))
+		handleVSyncInterrupt();
+}
+
+// The buffer holding the decoded run-length codes must be at least as large as
+// the mdecLength field of the compressed texture's header, which is usually
+// about 3-4 times the size of the compressed data.
+#define MDEC_BUFFER_SIZE 16384
+
+static uint32_t mdecBuffer[MDEC_BUFFER_SIZE];
+
+// Timer 1 is configured to count horizontal blanking periods, which last about
+// 64 microseconds each. This is not particularly accurate but allows measuring
+// times of up to a few seconds without the counter overflowing.
+static uint16_t getTime(void) {
+	return TIMER_VALUE(1);
+}
+
+static int getThroughput(int length, uint16_t time) {
+	// Convert the amount of data generated in the given time into kilobytes
+	// per second (there are about 15625 horizontal blanking periods per
+	// second).
+	if (!time)
+		time = 1;
+
+	return (length / 1024) * 15625 / time;
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+#define TEXTURE_WIDTH    256
+#define TEXTURE_HEIGHT   256
+#define PREVIEW_SIZE     144
+
+extern const uint8_t  fontTexture[], fontPalette[];
+extern const uint8_t  textureRaw[], textureMDEC[];
+extern const uint32_t textureMDECSize;
+
+static void drawTexture(
+	DMAChain          *chain,
+	const TextureInfo *texture,
+	int               x,
+	int               y
+) {
+	// Only draw the center of the texture, as it would not fit on screen
+	// otherwise.
+	int offset = (texture->width - PREVIEW_SIZE) / 2;
+
+	uint32_t *ptr = allocatePacket(chain, 5);
+	ptr[0] = gp0_texpage(texture->page, false, false);
+	ptr[1] = gp0_rectangle(true, true, false);
+	ptr[2] = gp0_xy(x, y);
+	ptr[3] = gp0_uv(texture->u + offset, texture->v + offset, texture->clut);
+	ptr[4] = gp0_xy(PREVIEW_SIZE, PREVIEW_SIZE);
+}
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initMDEC();
+	initMDECBitstream(0);
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TIMER_CTRL(1) = TIMER_CTRL_EXT_CLOCK;
+
+	TextureInfo font, raw, compressed;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Load both versions of the texture below the framebuffers, measuring how
+	// long each upload takes.
+	uint16_t start = getTime();
+
+	uploadTexture(&raw, textureRaw, 0, 256, TEXTURE_WIDTH, TEXTURE_HEIGHT);
+
+	uint16_t rawTime = getTime() - start;
+	start            = getTime();
+
+	bool decoded = uploadCompressedTexture(
+		&compressed,
+		textureMDEC,
+		textureMDECSize,
+		mdecBuffer,
+		MDEC_BUFFER_SIZE,
+		TEXTURE_WIDTH,
+		256,
+		TEXTURE_WIDTH,
+		TEXTURE_HEIGHT
+	);
+
+	uint16_t compressedTime = getTime() - start;
+
+	int rawLength = TEXTURE_WIDTH * TEXTURE_HEIGHT * 2;
+	int ratio     = rawLength * 10 / textureMDECSize;
+
+	char buffer[512];
+
+	sprintf(
+		buffer,
+		"Raw:\t\t%d bytes, %d us (%d KB/s)\n"
+		"Compressed:\t%d bytes, %d us (%d KB/s)\n"
+		"Ratio:\t\t%d.%d:1%s",
+		rawLength,
+		rawTime * 64,
+		getThroughput(rawLength, rawTime),
+		textureMDECSize,
+		compressedTime * 64,
+		getThroughput(rawLength, compressedTime),
+		ratio / 10,
+		ratio % 10,
+		decoded ? "" : " (failed to decode)"
+	);
+	puts(buffer);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		printString(chain, &font, 16, 16, buffer);
+		printString(chain, &font, 16, 64, "Raw");
+		printString(chain, &font, 168, 64, "Compressed");
+
+		drawTexture(chain, &raw, 12, 76);
+		drawTexture(chain, &compressed, 164, 76);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+	}
+
+	return 0;
+}
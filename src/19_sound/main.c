@@ -0,0 +1,358 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example plays sound effects using the SPU driver in ps1/spu.c. To keep
+ * it self-contained, the samples are not converted from audio files but
+ * generated at startup directly in the SPU's ADPCM format: each 16-byte block
+ * holds a header byte (the filter and shift, i.e. how much each sample is
+ * scaled down), a flags byte and 28 4-bit samples. With the filter set to
+ * zero, each sample is simply its 4-bit value shifted left by 12 bits and then
+ * right by the block's shift amount, which makes it easy to produce square
+ * waves and noise whose volume fades out over time.
+ *
+ * The samples are copied to SPU RAM through DMA after allocating space for
+ * them, then played back on whatever channel the voice allocator picks. Hold X
+ * to start a beep every other frame at a low priority: as each beep lasts about
+ * a second, all 24 channels are soon in use and new beeps take over the
+ * channels playing the oldest ones. Square plays a noise burst at a higher
+ * priority, which beeps can never interrupt, while holding triangle plays a
+ * looping tone at the highest priority until the button is released. The
+ * channels in use are shown on screen.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/spu.h"
+#include "ps1/system.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+/* Sample generation */
+
+#define SAMPLES_PER_BLOCK 28
+
+// ADPCM block flags. A sample whose last block has the loop end flag set but
+// not the repeat flag stops playing once it reaches the end.
+#define FLAG_LOOP_END   (1 << 0)
+#define FLAG_REPEAT     (1 << 1)
+#define FLAG_LOOP_START (1 << 2)
+
+#define BEEP_BLOCKS  1024
+#define NOISE_BLOCKS  400
+#define TONE_BLOCKS     8
+
+static uint8_t beepSample [BEEP_BLOCKS  * SPU_ADPCM_BLOCK_SIZE]
+	__attribute__((aligned(4)));
+static uint8_t noiseSample[NOISE_BLOCKS * SPU_ADPCM_BLOCK_SIZE]
+	__attribute__((aligned(4)));
+static uint8_t toneSample [TONE_BLOCKS  * SPU_ADPCM_BLOCK_SIZE]
+	__attribute__((aligned(4)));
+
+static void generateSquareWave(
+	uint8_t *output,
+	int     numBlocks,
+	int     period,
+	int     fadeInterval
+) {
+	for (int i = 0; i < numBlocks; i++) {
+		// Halve the volume every fadeInterval blocks (if not zero).
+		int shift = fadeInterval ? (2 + i / fadeInterval) : 2;
+
+		if (shift > 12)
+			shift = 12;
+
+		*(output++) = shift;
+		*(output++) = 0;
+
+		for (int j = 0; j < SAMPLES_PER_BLOCK; j += 2) {
+			int index = i * SAMPLES_PER_BLOCK + j;
+
+			// Each byte holds two samples, the first one in the lower nibble.
+			// 0x7 and 0x9 are the 4-bit representations of 7 and -7.
+			int low  = ((index       % period) < (period / 2)) ? 0x7 : 0x9;
+			int high = (((index + 1) % period) < (period / 2)) ? 0x7 : 0x9;
+
+			*(output++) = low | (high << 4);
+		}
+	}
+}
+
+static void generateNoise(uint8_t *output, int numBlocks) {
+	uint32_t lfsr = 1;
+
+	for (int i = 0; i < numBlocks; i++) {
+		int shift = 1 + (i * 11) / numBlocks;
+
+		*(output++) = shift;
+		*(output++) = 0;
+
+		for (int j = 0; j < SAMPLES_PER_BLOCK; j += 2) {
+			// Use a 16-bit Galois LFSR to generate pseudorandom samples.
+			lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xb400);
+
+			*(output++) = lfsr & 0xff;
+		}
+	}
+}
+
+static void setFlags(uint8_t *sample, int numBlocks, bool loop) {
+	uint8_t *lastBlock = &sample[(numBlocks - 1) * SPU_ADPCM_BLOCK_SIZE];
+
+	if (loop) {
+		sample[1]    |= FLAG_LOOP_START;
+		lastBlock[1] |= FLAG_LOOP_END | FLAG_REPEAT;
+	} else {
+		lastBlock[1] |= FLAG_LOOP_END;
+	}
+}
+
+/* Main */
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define HEAP_BLOCKS   16
+#define BEEP_INTERVAL  2
+
+// Sound priorities. Beeps are the least important sounds and can be replaced
+// by any other sound, including other beeps.
+#define PRIORITY_BEEP  1
+#define PRIORITY_NOISE 2
+#define PRIORITY_TONE  3
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+static SPUHeap  heap;
+static SPUBlock heapBlocks[HEAP_BLOCKS];
+
+static uint32_t soundsStarted = 0, soundsDropped = 0;
+
+static int playSound(
+	uint32_t offset,
+	uint16_t pitch,
+	uint16_t volumeLeft,
+	uint16_t volumeRight,
+	int      priority
+) {
+	int voice = playSPUSample(offset, pitch, volumeLeft, volumeRight, priority);
+
+	if (voice < 0)
+		soundsDropped++;
+	else
+		soundsStarted++;
+
+	return voice;
+}
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initSPU();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Generate the samples and upload them to SPU RAM. Each upload waits for
+	// the previous one to finish, so the buffers must not be modified until
+	// all transfers are done.
+	generateSquareWave(beepSample, BEEP_BLOCKS, 32, BEEP_BLOCKS / 8);
+	generateNoise(noiseSample, NOISE_BLOCKS);
+	generateSquareWave(toneSample, TONE_BLOCKS, 56, 0);
+
+	setFlags(beepSample,  BEEP_BLOCKS,  false);
+	setFlags(noiseSample, NOISE_BLOCKS, false);
+	setFlags(toneSample,  TONE_BLOCKS,  true);
+
+	initSPUHeap(&heap, SPU_HEAP_START, SPU_RAM_SIZE, heapBlocks, HEAP_BLOCKS);
+
+	uint32_t beepAddr  = loadSPUSample(&heap, beepSample,  sizeof(beepSample));
+	uint32_t noiseAddr = loadSPUSample(&heap, noiseSample, sizeof(noiseSample));
+	uint32_t toneAddr  = loadSPUSample(&heap, toneSample,  sizeof(toneSample));
+
+	waitForSPUTransfer();
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	int      toneVoice    = -1;
+	uint32_t frameCounter = 0;
+	uint16_t lastButtons  = 0;
+
+	for (;; frameCounter++) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		// Give each beep a slightly different pitch and panning, so that
+		// overlapping beeps can be told apart.
+		if ((buttons & PAD_CROSS) && !(frameCounter % BEEP_INTERVAL)) {
+			int step = (frameCounter / BEEP_INTERVAL) % 8;
+
+			playSound(
+				beepAddr,
+				spu_pitch(22050 + step * 2205),
+				SPU_MAX_VOLUME / 16 * (8 + step),
+				SPU_MAX_VOLUME / 16 * (15 - step),
+				PRIORITY_BEEP
+			);
+		}
+		if (pressed & PAD_SQUARE)
+			playSound(
+				noiseAddr,
+				spu_pitch(11025),
+				SPU_MAX_VOLUME,
+				SPU_MAX_VOLUME,
+				PRIORITY_NOISE
+			);
+
+		if ((pressed & PAD_TRIANGLE) && !isSPUVoicePlaying(toneVoice)) {
+			toneVoice = playSound(
+				toneAddr,
+				spu_pitch(44100),
+				SPU_MAX_VOLUME / 2,
+				SPU_MAX_VOLUME / 2,
+				PRIORITY_TONE
+			);
+		}
+		if (!(buttons & PAD_TRIANGLE))
+			stopSPUVoice(toneVoice);
+
+		// Show the state of each channel as a row of characters.
+		uint32_t active = getSPUActiveChannels();
+		char     channels[SPU_NUM_CHANNELS + 1];
+
+		for (int ch = 0; ch < SPU_NUM_CHANNELS; ch++)
+			channels[ch] = (active & (1 << ch)) ? '#' : '.';
+
+		channels[SPU_NUM_CHANNELS] = 0;
+
+		char buffer[512];
+
+		sprintf(
+			buffer,
+			"Channels:\t%s\n"
+			"Sounds:\t\t%d started, %d dropped\n"
+			"Samples:\t%05x, %05x, %05x\n"
+			"Free SPU RAM:\t%d bytes",
+			channels,
+			soundsStarted,
+			soundsDropped,
+			beepAddr,
+			noiseAddr,
+			toneAddr,
+			getSPUHeapLargestFree(&heap)
+		);
+		printString(chain, &font, 16, 16, buffer);
+
+		printString(
+			chain,
+			&font,
+			16,
+			216,
+			"[X] Beep  [] Noise  [/\\] Tone (hold)"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+
+		// Start all sounds requested during this frame at once.
+		updateSPU();
+	}
+
+	return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This example plays back a song using the sequence player in ps1/seqplayer.c.
+ * The song is a standard MIDI file, converted at build time by
+ * tools/convertMIDI.py into a sequence of events at a fixed rate of 120 ticks
+ * per second, while the instruments are short samples encoded into SPU ADPCM
+ * format by tools/convertAudio.py and packed into a bank by
+ * tools/buildSoundBank.py according to bank.json (which also specifies each
+ * instrument's envelope and the MIDI programs and drum notes it is mapped to).
+ *
+ * Once the bank's samples have been uploaded to SPU RAM, the player reserves a
+ * number of SPU channels for itself and is driven entirely by the timer 2
+ * interrupt, independently of the main loop: the song keeps playing at the
+ * same speed even if rendering slows down. To show that the player only takes
+ * a small and bounded amount of CPU time, the time spent processing the last
+ * tick and the longest tick so far are displayed on screen, along with the
+ * resulting CPU load and the state of each voice's envelope. Press start to
+ * stop or restart the song and use the up and down buttons to change its
+ * volume.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/seqplayer.h"
+#include "ps1/sio0.h"
+#include "ps1/spu.h"
+#include "ps1/system.h"
+
+static SeqPlayer player;
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSeqPlayerInterrupt(&player);
+	handleSIO0Interrupts();
+}
+
+/* Main */
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define HEAP_BLOCKS  4
+#define NUM_VOICES  12
+#define VOLUME_STEP  8
+
+extern const uint8_t fontTexture[], fontPalette[];
+extern const uint8_t musicBank[], musicSequence[];
+
+static SPUHeap  heap;
+static SPUBlock heapBlocks[HEAP_BLOCKS];
+static SeqBank  bank;
+
+static const char envelopeStates[] = {
+	'.', // SEQ_ENV_IDLE
+	'A', // SEQ_ENV_ATTACK
+	'D', // SEQ_ENV_DECAY
+	'S', // SEQ_ENV_SUSTAIN
+	'R'  // SEQ_ENV_RELEASE
+};
+
+static int cyclesToMicroseconds(uint32_t cycles) {
+	return (cycles * 1000) / (F_CPU / 1000);
+}
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initSPU();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Upload the bank's samples to SPU RAM and reserve the channels used by
+	// the player. Any channels left over remain available to playSPUSample()
+	// for sound effects.
+	initSPUHeap(&heap, SPU_HEAP_START, SPU_RAM_SIZE, heapBlocks, HEAP_BLOCKS);
+
+	if (
+		!loadSeqBank(&bank, &heap, musicBank) ||
+		!initSeqPlayer(&player, &bank, NUM_VOICES)
+	) {
+		puts("Unable to load instrument bank");
+
+		for (;;)
+			__asm__ volatile("");
+	}
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	startSeqPlayer(&player, musicSequence);
+
+	const SeqHeader *header = (const SeqHeader *) musicSequence;
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	int      volume      = 127;
+	uint16_t lastButtons = 0;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if (pressed & PAD_START) {
+			if (player.playing)
+				stopSeqPlayer(&player);
+			else
+				startSeqPlayer(&player, musicSequence);
+		}
+
+		if (pressed & PAD_UP)
+			volume += VOLUME_STEP;
+		if (pressed & PAD_DOWN)
+			volume -= VOLUME_STEP;
+
+		if (volume > 127)
+			volume = 127;
+		if (volume < 0)
+			volume = 0;
+
+		setSeqPlayerVolume(&player, volume);
+
+		// Copy the statistics with interrupts disabled, as the timer interrupt
+		// may otherwise update them halfway through.
+		disableInterrupts();
+
+		SeqPlayerStats stats = player.stats;
+		char           voices[NUM_VOICES + 1];
+
+		for (int i = 0; i < NUM_VOICES; i++)
+			voices[i] = envelopeStates[player.voices[i].state];
+
+		voices[NUM_VOICES] = 0;
+
+		enableInterrupts();
+
+		// Calculate the fraction of CPU time taken by the player (in units of
+		// 0.01%) based on the duration of the last tick.
+		int load = (stats.lastTickTime * header->tickRate) / (F_CPU / 10000);
+
+		char buffer[512];
+
+		sprintf(
+			buffer,
+			"State:\t\t%s\n"
+			"Volume:\t\t%d\n"
+			"Ticks:\t\t%d (%d per second)\n"
+			"Deferred:\t%d\n"
+			"Last tick:\t%d us\n"
+			"Longest tick:\t%d us\n"
+			"CPU load:\t%d.%02d%%\n"
+			"Voices:\t\t%s",
+			player.playing ? "playing" : "stopped",
+			volume,
+			stats.ticks,
+			header->tickRate,
+			stats.deferred,
+			cyclesToMicroseconds(stats.lastTickTime),
+			cyclesToMicroseconds(stats.maxTickTime),
+			load / 100,
+			load % 100,
+			voices
+		);
+		printString(chain, &font, 16, 16, buffer);
+
+		printString(
+			chain,
+			&font,
+			16,
+			216,
+			"[START] Stop/restart  [UP/DOWN] Volume"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,389 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * This example shows how to play back audio that does not fit in SPU RAM by
+ * streaming it through a small buffer, using the streaming driver in
+ * ps1/spustream.c. Only two chunks of 4 KB each are kept in SPU RAM at any
+ * time; each time the SPU finishes playing one, an interrupt is raised and the
+ * driver replaces it with the next chunk from a ring buffer in main RAM.
+ *
+ * The ring buffer can be filled from any source, such as a large file loaded
+ * into RAM or sectors read from the CD-ROM on demand. To keep the example self
+ * contained the audio is generated on the fly instead: the main loop encodes a
+ * never-ending random melody directly into SPU-ADPCM format whenever there is
+ * room in the buffer. As ADPCM blocks using filter 0 carry no state from one
+ * block to the next, a simple wave can be written by storing its samples as
+ * 4-bit values and using each block's shift factor as a volume control.
+ *
+ * The stream's channel is also routed through the SPU's reverb unit. Use the
+ * left and right buttons to go through the reverb presets, press start to stop
+ * or restart the stream and hold the cross button to stop filling the buffer,
+ * simulating a data source that cannot keep up: the stream will play whatever
+ * is left in the buffer, then mute itself until more data is available.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/spu.h"
+#include "ps1/spustream.h"
+#include "ps1/system.h"
+
+static SPUStream stream;
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		startPadPoll();
+	}
+
+	handleSPUStreamInterrupt(&stream);
+	handleSIO0Interrupts();
+}
+
+/* Melody generator */
+
+#define SAMPLE_RATE  22050
+#define NOTE_BLOCKS  128
+#define NUM_NOTES    15
+#define DECAY_BLOCKS 12
+
+// Phase increments for a two-octave A minor pentatonic scale, with a full
+// period of the wave being 65536 units.
+#define PHASE_STEP(freq) ((uint32_t) ((freq) * 65536.0 / SAMPLE_RATE + 0.5))
+
+static const uint32_t noteSteps[NUM_NOTES] = {
+	PHASE_STEP( 220.00), PHASE_STEP( 261.63), PHASE_STEP( 293.66),
+	PHASE_STEP( 329.63), PHASE_STEP( 392.00), PHASE_STEP( 440.00),
+	PHASE_STEP( 523.25), PHASE_STEP( 587.33), PHASE_STEP( 659.26),
+	PHASE_STEP( 783.99), PHASE_STEP( 880.00), PHASE_STEP(1046.50),
+	PHASE_STEP(1174.66), PHASE_STEP(1318.51), PHASE_STEP(1567.98)
+};
+
+typedef struct {
+	uint32_t phase, step, seed;
+	int      note, position;
+} Generator;
+
+static void nextNote(Generator *gen) {
+	// Move up or down the scale by up to two notes at random.
+	gen->seed  = gen->seed * 1103515245 + 12345;
+	gen->note += (int) ((gen->seed >> 16) % 5) - 2;
+
+	if (gen->note < 0)
+		gen->note = 1;
+	if (gen->note >= NUM_NOTES)
+		gen->note = NUM_NOTES - 2;
+
+	gen->step = noteSteps[gen->note];
+}
+
+static int nextSample(Generator *gen) {
+	// Generate a triangle wave ranging from -8 to 7.
+	int value = (gen->phase >> 11) & 31;
+
+	gen->phase += gen->step;
+	return (value < 16) ? (value - 8) : (23 - value);
+}
+
+static void generateChunk(Generator *gen, uint8_t *chunk, size_t length) {
+	for (; length > 0; length -= SPU_ADPCM_BLOCK_SIZE) {
+		if (!gen->position)
+			nextNote(gen);
+
+		// Each block's samples are scaled by 2 ^ (12 - shift); increasing the
+		// shift over time produces a simple exponential decay, with a shift
+		// of 12 being nearly silent.
+		chunk[0] = 2 + gen->position / DECAY_BLOCKS;
+		chunk[1] = 0;
+
+		for (int i = 2; i < SPU_ADPCM_BLOCK_SIZE; i++) {
+			int low  = nextSample(gen);
+			int high = nextSample(gen);
+
+			chunk[i] = (low & 15) | ((high & 15) << 4);
+		}
+
+		chunk += SPU_ADPCM_BLOCK_SIZE;
+
+		if (++(gen->position) >= NOTE_BLOCKS)
+			gen->position = 0;
+	}
+}
+
+/* Main */
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define HEAP_BLOCKS    4
+#define NUM_CHUNKS     4
+#define CHUNK_LENGTH   4096
+#define STREAM_VOLUME  0x3000
+#define REVERB_VOLUME  0x3000
+
+// ADPCM blocks hold 28 samples each.
+#define CHUNK_SAMPLES ((CHUNK_LENGTH / SPU_ADPCM_BLOCK_SIZE) * 28)
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+static SPUHeap  heap;
+static SPUBlock heapBlocks[HEAP_BLOCKS];
+static uint8_t  streamBuffer[NUM_CHUNKS * CHUNK_LENGTH]
+	__attribute__((aligned(4)));
+
+static const char *const reverbNames[] = {
+	"off",
+	"room",
+	"small studio",
+	"medium studio",
+	"large studio",
+	"hall",
+	"space echo",
+	"echo",
+	"delay",
+	"half echo"
+};
+
+static const char *const streamStates[] = {
+	"stopped", // SPUSTREAM_STOPPED
+	"playing", // SPUSTREAM_PLAYING
+	"ending",  // SPUSTREAM_ENDING
+	"stalled"  // SPUSTREAM_STALLED
+};
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initSPU();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	// Leave room at the end of SPU RAM for the largest reverb work area, so
+	// that any preset can be selected without overwriting the stream's
+	// buffer.
+	initSPUHeap(
+		&heap,
+		SPU_HEAP_START,
+		SPU_RAM_SIZE - getSPUReverbSize(SPU_REVERB_PRESET_DELAY),
+		heapBlocks,
+		HEAP_BLOCKS
+	);
+
+	if (!initSPUStream(
+		&stream,
+		&heap,
+		streamBuffer,
+		NUM_CHUNKS,
+		CHUNK_LENGTH
+	)) {
+		puts("Unable to allocate SPU RAM for the stream");
+
+		for (;;)
+			__asm__ volatile("");
+	}
+
+	int reverb = SPU_REVERB_PRESET_HALL;
+
+	setSPUReverb(reverb, REVERB_VOLUME, REVERB_VOLUME);
+	setSPUReverbChannels(1 << stream.channel);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	Generator generator = {
+		.phase    = 0,
+		.step     = 0,
+		.seed     = 1,
+		.note     = NUM_NOTES / 2,
+		.position = 0
+	};
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	bool     playing     = true;
+	uint16_t lastButtons = 0;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if (pressed & PAD_START) {
+			playing = !playing;
+
+			if (!playing)
+				stopSPUStream(&stream);
+		}
+
+		if (pressed & (PAD_LEFT | PAD_RIGHT)) {
+			const int numPresets = SPU_REVERB_PRESET_HALF_ECHO + 1;
+
+			if (pressed & PAD_LEFT)
+				reverb = (reverb + numPresets - 1) % numPresets;
+			else
+				reverb = (reverb + 1) % numPresets;
+
+			setSPUReverb(reverb, REVERB_VOLUME, REVERB_VOLUME);
+		}
+
+		// Refill the ring buffer, unless the cross button is being held down
+		// to simulate a slow data source. In a real game this is where data
+		// would be copied from RAM or CD-ROM reads would be issued.
+		if (!(buttons & PAD_CROSS)) {
+			uint8_t *chunk;
+
+			while ((chunk = getSPUStreamFreeChunk(&stream))) {
+				generateChunk(&generator, chunk, CHUNK_LENGTH);
+				commitSPUStreamChunk(&stream);
+			}
+		}
+
+		// (Re)start the stream once enough data has been buffered, either
+		// initially or after the buffer ran empty.
+		if (playing && !isSPUStreamPlaying(&stream))
+			startSPUStream(
+				&stream,
+				spu_pitch(SAMPLE_RATE),
+				STREAM_VOLUME,
+				STREAM_VOLUME
+			);
+
+		// Copy the statistics with interrupts disabled, as the SPU interrupt
+		// may otherwise update them halfway through.
+		disableInterrupts();
+
+		SPUStreamStats stats    = stream.stats;
+		int            status   = stream.status;
+		int            buffered = getSPUStreamBufferedChunks(&stream);
+
+		enableInterrupts();
+
+		int seconds = (stats.chunks * CHUNK_SAMPLES) / SAMPLE_RATE;
+
+		char buffer[512];
+
+		sprintf(
+			buffer,
+			"State:\t\t%s\n"
+			"Reverb:\t\t%s\n"
+			"Buffered:\t%d/%d chunks\n"
+			"Uploaded:\t%d chunks (%d:%02d)\n"
+			"Underruns:\t%d\n"
+			"SPU RAM used:\t%d bytes\n"
+			"Reverb area:\t%d bytes",
+			streamStates[status],
+			reverbNames[reverb],
+			buffered,
+			NUM_CHUNKS,
+			stats.chunks,
+			seconds / 60,
+			seconds % 60,
+			stats.underruns,
+			CHUNK_LENGTH * 2,
+			getSPUReverbSize(reverb)
+		);
+		printString(chain, &font, 16, 16, buffer);
+
+		printString(
+			chain,
+			&font,
+			16,
+			200,
+			"[START] Stop/restart  [LEFT/RIGHT] Reverb\n"
+			"[X] Hold to starve the stream"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		waitForVSync();
+		sendLinkedList(chain->data);
+	}
+
+	return 0;
+}
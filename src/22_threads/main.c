@@ -0,0 +1,390 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * This example shows how the cooperative threads in ps1/thread.c can be used
+ * to write loading code as a plain sequence of steps, instead of a state
+ * machine advanced by the main loop. As with the CD-ROM example, the build
+ * process generates a disc image containing this example's source code.
+ *
+ * A loader thread mounts the disc, then loads each file in turn and counts its
+ * lines and words. Whenever it has to wait for the drive, it suspends itself
+ * until the read has completed, letting other threads run in the meantime; it
+ * also yields periodically while processing each file, so that it never holds
+ * the CPU for long. A second thread searches for prime numbers forever, using
+ * up whatever CPU time is left. The main thread draws the screen and then
+ * waits for the next vertical blank, again letting the other threads run until
+ * it is woken up by the vblank interrupt. The frame rate stays constant no
+ * matter how much work the other threads are doing.
+ *
+ * Press X to load all files again (after the first pass most of them will be
+ * served from the sector cache).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/cdcache.h"
+#include "ps1/cdrom.h"
+#include "ps1/gpucmd.h"
+#include "ps1/iso9660.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+#include "ps1/thread.h"
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		signalThreadEvents(THREAD_EVENT_VSYNC);
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+	handleCDROMInterrupts();
+}
+
+/* Loader thread */
+
+static const char *const fileNames[] = {
+	"SRC/MAIN.C",
+	"SRC/GPU.C",
+	"SRC/GPU.H",
+	"SRC/FONT.C",
+	"SRC/FONT.H"
+};
+
+#define NUM_FILES        ((int) (sizeof(fileNames) / sizeof(const char *)))
+#define MAX_FILE_SIZE    (16 * CDCACHE_SECTOR_SIZE)
+#define INDEX_SIZE       64
+#define CACHE_SLOTS      32
+#define READ_AHEAD       8
+#define MAX_KEPT_SECTORS 8
+#define YIELD_INTERVAL   256
+
+typedef struct {
+	int  lines, words;
+	bool loaded;
+} FileInfo;
+
+static ISO9660FS    iso;
+static ISO9660Entry isoIndex[INDEX_SIZE];
+static CDCache      cache;
+static CDCacheSlot  cacheSlots[CACHE_SLOTS];
+
+static uint8_t cacheBuffer[CACHE_SLOTS * CDCACHE_SECTOR_SIZE]
+	__attribute__((aligned(4)));
+static uint8_t fileBuffer[MAX_FILE_SIZE] __attribute__((aligned(4)));
+
+// As threads only switch when the running one yields or waits, these can be
+// shared between threads without any locking.
+static const char *loaderStatus = "Idle";
+static FileInfo   fileInfo[NUM_FILES];
+
+static bool isMountDone(void *arg) {
+	return !isISO9660Busy((const ISO9660FS *) arg);
+}
+
+static bool isReadDone(void *arg) {
+	return (((const CDCacheRead *) arg)->status != CDROM_PENDING);
+}
+
+static void processFile(FileInfo *info, const char *data, int length) {
+	bool inWord = false;
+
+	info->lines = 0;
+	info->words = 0;
+
+	for (int i = 0; i < length; i++) {
+		char ch = data[i];
+
+		if (ch == '\n')
+			info->lines++;
+
+		if ((ch == ' ') || (ch == '\t') || (ch == '\n')) {
+			inWord = false;
+		} else if (!inWord) {
+			inWord = true;
+			info->words++;
+		}
+
+		// Give other threads a chance to run every few hundred bytes.
+		if (!(i % YIELD_INTERVAL))
+			yieldThread();
+	}
+
+	info->loaded = true;
+}
+
+static void loaderThread(void *arg) {
+	if (iso.status != ISO9660_OK) {
+		loaderStatus = "Mounting disc...";
+
+		mountISO9660(&iso, isoIndex, INDEX_SIZE, 0, 0);
+		waitThreadCondition(&isMountDone, &iso);
+
+		if (iso.status != ISO9660_OK) {
+			loaderStatus = "Failed to mount disc";
+			return;
+		}
+	}
+
+	for (int i = 0; i < NUM_FILES; i++)
+		fileInfo[i].loaded = false;
+
+	for (int i = 0; i < NUM_FILES; i++) {
+		const ISO9660Entry *entry = findISO9660File(&iso, fileNames[i]);
+
+		if (!entry || (entry->length > MAX_FILE_SIZE))
+			continue;
+
+		loaderStatus = "Reading file...";
+
+		CDCacheRead read;
+
+		read.lba      = entry->lba;
+		read.count    =
+			(entry->length + CDCACHE_SECTOR_SIZE - 1) / CDCACHE_SECTOR_SIZE;
+		read.data     = fileBuffer;
+		read.callback = 0;
+
+		queueCDCacheRead(&cache, &read);
+		waitThreadCondition(&isReadDone, &read);
+
+		if (read.status != CDROM_OK) {
+			loaderStatus = "Failed to read file";
+			return;
+		}
+
+		loaderStatus = "Processing file...";
+		processFile(&fileInfo[i], (const char *) fileBuffer, entry->length);
+	}
+
+	loaderStatus = "Done";
+}
+
+/* Prime search thread */
+
+static volatile uint32_t primesFound = 0, lastPrime = 0;
+
+static void primeThread(void *arg) {
+	for (uint32_t value = 3;; value += 2) {
+		bool isPrime = true;
+
+		for (uint32_t divisor = 3; (divisor * divisor) <= value; divisor += 2) {
+			if (!(value % divisor)) {
+				isPrime = false;
+				break;
+			}
+		}
+
+		if (isPrime) {
+			primesFound++;
+			lastPrime = value;
+		}
+
+		yieldThread();
+	}
+}
+
+/* Main */
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define MAX_THREADS 2
+#define STACK_SIZE  0x800
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+static Thread  threads[MAX_THREADS];
+static uint8_t threadStacks[MAX_THREADS * STACK_SIZE]
+	__attribute__((aligned(8)));
+
+static const char *const threadStates[] = {
+	"finished",  // THREAD_FREE
+	"ready",     // THREAD_READY
+	"waiting",   // THREAD_WAITING_EVENTS
+	"waiting"    // THREAD_WAITING_CONDITION
+};
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initCDROM();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	initCDCache(
+		&cache,
+		cacheSlots,
+		cacheBuffer,
+		CACHE_SLOTS,
+		READ_AHEAD,
+		MAX_KEPT_SECTORS
+	);
+
+	// Set up the scheduler before enabling interrupts, as the interrupt
+	// handler raises thread events.
+	initThreads(threads, MAX_THREADS, threadStacks, STACK_SIZE);
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	Thread *loader = createThread(&loaderThread, 0);
+	Thread *primes = createThread(&primeThread, 0);
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	uint32_t frameCounter = 0, lastPrimes = 0;
+	uint16_t lastButtons  = 0;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if ((pressed & PAD_CROSS) && !isThreadRunning(loader))
+			loader = createThread(&loaderThread, 0);
+
+		// Show how many primes the background thread found during the last
+		// frame, which is a rough measure of how much CPU time was left over.
+		uint32_t found = primesFound;
+		int      rate  = found - lastPrimes;
+
+		lastPrimes = found;
+
+		char buffer[1024], *output = buffer;
+
+		output += sprintf(
+			output,
+			"Frame counter:\t%d\n"
+			"Loader:\t\t%s (%d bytes stack)\n"
+			"Primes:\t\t%s (%d bytes stack)\n"
+			"Status:\t\t%s\n"
+			"Primes found:\t%d (+%d), last %d\n"
+			"Cache:\t\t%d hits, %d misses\n\n",
+			frameCounter,
+			threadStates[loader->state],
+			getThreadStackUsage(loader),
+			threadStates[primes->state],
+			getThreadStackUsage(primes),
+			loaderStatus,
+			found,
+			rate,
+			lastPrime,
+			cache.stats.hits,
+			cache.stats.misses
+		);
+
+		for (int i = 0; i < NUM_FILES; i++) {
+			const FileInfo *info = &fileInfo[i];
+
+			if (info->loaded)
+				output += sprintf(
+					output,
+					"%s:\t%d lines, %d words\n",
+					fileNames[i],
+					info->lines,
+					info->words
+				);
+			else
+				output += sprintf(output, "%s:\t-\n", fileNames[i]);
+		}
+
+		printString(chain, &font, 16, 16, buffer);
+		printString(chain, &font, 16, 216, "[X] Load files again");
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		// Instead of busy-waiting for vblank, let the other threads run until
+		// the interrupt handler wakes this thread up again.
+		waitForGP0Ready();
+		waitThreadVSync();
+		sendLinkedList(chain->data);
+		frameCounter++;
+	}
+
+	return 0;
+}
@@ -0,0 +1,501 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * This example shows how the job scheduler in ps1/jobs.c can be used to keep
+ * the CPU busy while the GPU and SPU are processing data. Each frame's work is
+ * split into a handful of jobs, each declaring which other jobs and devices it
+ * has to wait for:
+ *
+ * - "simulate" moves a number of particles around the screen;
+ * - "build" generates the display list for the next frame once the particles
+ *   have been moved;
+ * - "flip" waits for the GPU to finish drawing the previous frame, then
+ *   displays it;
+ * - "draw" sends the display list to the GPU once it has been built and the
+ *   buffer it renders to is no longer being displayed;
+ * - "mix" fills a buffer with sound data (a stand-in for an actual software
+ *   mixer or decoder) once the previous frame's SPU transfer has finished
+ *   reading it;
+ * - "upload" transfers the buffer to SPU RAM;
+ * - "vblank" does nothing but marks the end of the frame.
+ *
+ * Whenever a job is waiting for hardware, such as "flip" waiting for the GPU
+ * to finish drawing, any other job that is ready runs in the meantime. The
+ * bottom of the screen shows a timeline of the previous frame, with idle CPU
+ * time in grey. Each particle is drawn as a large semi-transparent rectangle,
+ * so adding more of them quickly makes the GPU the bottleneck: once that
+ * happens, "mix" moves in front of "flip" in the timeline and the idle period
+ * before "flip" grows.
+ *
+ * Use the up and down buttons on the D-pad to change the number of particles.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/gpucmd.h"
+#include "ps1/jobs.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/spu.h"
+#include "ps1/system.h"
+
+static volatile uint32_t vsyncCounter = 0;
+
+static void interruptHandler(void *arg) {
+	if (acknowledgeInterrupt(IRQ_VSYNC)) {
+		handleVSyncInterrupt();
+		vsyncCounter++;
+		startPadPoll();
+	}
+
+	handleSIO0Interrupts();
+}
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+#define MAX_PARTICLES   256
+#define PARTICLE_STEP    32
+#define PARTICLE_SIZE    32
+#define MIX_LENGTH     8192
+#define MAX_TIMELINE     32
+
+#define TIMELINE_X       16
+#define TIMELINE_Y      204
+#define TIMELINE_WIDTH  288
+#define TIMELINE_HEIGHT   8
+
+/* Particle jobs */
+
+typedef struct {
+	int16_t x, y, vx, vy;
+	uint8_t r, g, b;
+} Particle;
+
+static Particle particles[MAX_PARTICLES];
+static int      numParticles = 64;
+
+static void simulateJob(void *arg) {
+	for (int i = 0; i < numParticles; i++) {
+		Particle *p = &particles[i];
+
+		p->x += p->vx;
+		p->y += p->vy;
+
+		if ((p->x < 0) || (p->x > (SCREEN_WIDTH - PARTICLE_SIZE)))
+			p->vx = -(p->vx);
+		if ((p->y < 0) || (p->y > (SCREEN_HEIGHT - PARTICLE_SIZE)))
+			p->vy = -(p->vy);
+	}
+}
+
+static void initParticles(void) {
+	uint32_t seed = 1;
+
+	for (int i = 0; i < MAX_PARTICLES; i++) {
+		Particle *p = &particles[i];
+
+		seed  = seed * 1103515245 + 12345;
+		p->x  = (seed >> 16) % (SCREEN_WIDTH - PARTICLE_SIZE);
+		p->vx = ((seed >> 8) & 3) + 1;
+		p->r  = seed >> 24;
+		seed  = seed * 1103515245 + 12345;
+		p->y  = (seed >> 16) % (SCREEN_HEIGHT - PARTICLE_SIZE);
+		p->vy = ((seed >> 8) & 3) + 1;
+		p->g  = seed >> 24;
+		p->b  = 255 - p->r;
+	}
+}
+
+/* Display jobs */
+
+typedef struct {
+	const char *name;
+	uint8_t    r, g, b;
+} JobColor;
+
+static const JobColor jobColors[] = {
+	{ "simulate", 255,  64,  64 },
+	{ "build",    255, 192,  64 },
+	{ "flip",     255, 255, 255 },
+	{ "draw",      64, 255,  64 },
+	{ "mix",       64, 192, 255 },
+	{ "upload",   160,  64, 255 },
+	{ "vblank",   255,  64, 255 }
+};
+
+#define NUM_JOB_COLORS ((int) (sizeof(jobColors) / sizeof(JobColor)))
+
+static TextureInfo font;
+static DMAChain    dmaChains[2];
+static bool        usingSecondFrame = false;
+static int         linesPerFrame    = 263;
+
+// Copy of the previous frame's timeline, which is drawn while the current
+// frame's timeline is being recorded.
+static JobTimelineEntry lastTimeline[MAX_TIMELINE];
+static int              lastNumEntries = 0;
+static uint16_t         lastBusyTime = 0, lastIdleTime = 0;
+
+static const JobColor *getJobColor(const char *name) {
+	static const JobColor idleColor = { 0, 96, 96, 96 };
+
+	// Timeline entries point to the names stored in each job, which in turn
+	// point to the same strings as this table.
+	for (int i = 0; i < NUM_JOB_COLORS; i++) {
+		if (jobColors[i].name == name)
+			return &jobColors[i];
+	}
+
+	return &idleColor;
+}
+
+static void drawRectangle(
+	DMAChain       *chain,
+	const JobColor *color,
+	int            x,
+	int            y,
+	int            width,
+	int            height
+) {
+	uint32_t *ptr = allocatePacket(chain, 3);
+
+	ptr[0] = gp0_rgb(color->r, color->g, color->b)
+		| gp0_rectangle(false, false, false);
+	ptr[1] = gp0_xy(x, y);
+	ptr[2] = gp0_xy(width, height);
+}
+
+static void drawTimeline(DMAChain *chain) {
+	for (int i = 0; i < lastNumEntries; i++) {
+		const JobTimelineEntry *entry = &lastTimeline[i];
+
+		int start = (entry->start * TIMELINE_WIDTH) / linesPerFrame;
+		int end   = (entry->end   * TIMELINE_WIDTH) / linesPerFrame;
+
+		if (start >= TIMELINE_WIDTH)
+			break;
+		if (end > TIMELINE_WIDTH)
+			end = TIMELINE_WIDTH;
+
+		// Make sure even very short jobs show up as at least one pixel.
+		drawRectangle(
+			chain,
+			getJobColor(entry->name),
+			TIMELINE_X + start,
+			TIMELINE_Y,
+			(end > start) ? (end - start) : 1,
+			TIMELINE_HEIGHT
+		);
+	}
+
+	// Draw a marker at the end of the frame.
+	static const JobColor markerColor = { 0, 255, 255, 255 };
+
+	drawRectangle(
+		chain,
+		&markerColor,
+		TIMELINE_X + TIMELINE_WIDTH,
+		TIMELINE_Y - 2,
+		1,
+		TIMELINE_HEIGHT + 4
+	);
+}
+
+static void drawLegend(DMAChain *chain) {
+	char buffer[512], *output = buffer;
+	int  y = 16;
+
+	output += sprintf(
+		output,
+		"Particles:\t%d (%d%% CPU idle)\n\n",
+		numParticles,
+		(lastIdleTime * 100) / (lastBusyTime + lastIdleTime + 1)
+	);
+
+	for (int i = 0; i < NUM_JOB_COLORS; i++) {
+		const JobColor *color = &jobColors[i];
+		int            lines  = 0;
+
+		for (int j = 0; j < lastNumEntries; j++) {
+			if (lastTimeline[j].name == color->name)
+				lines += lastTimeline[j].end - lastTimeline[j].start;
+		}
+
+		drawRectangle(
+			chain,
+			color,
+			16,
+			y + (i + 2) * FONT_LINE_HEIGHT,
+			6,
+			6
+		);
+		output += sprintf(
+			output,
+			"  %s:\t%d lines\n",
+			color->name,
+			lines
+		);
+	}
+
+	output += sprintf(output, "  idle:\t\t%d lines\n", lastIdleTime);
+	drawRectangle(
+		chain,
+		getJobColor(0),
+		16,
+		y + (NUM_JOB_COLORS + 2) * FONT_LINE_HEIGHT,
+		6,
+		6
+	);
+
+	printString(chain, &font, 16, y, buffer);
+	printString(chain, &font, 16, 216, "[Up/Down] Change particle count");
+}
+
+static void buildJob(void *arg) {
+	int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+	int bufferY = 0;
+
+	DMAChain *chain = &dmaChains[usingSecondFrame];
+	uint32_t *ptr;
+
+	chain->nextPacket = chain->data;
+
+	ptr    = allocatePacket(chain, 4);
+	ptr[0] = gp0_texpage(
+		gp0_page(0, 0, GP0_BLEND_ADD, GP0_COLOR_4BPP),
+		true,
+		false
+	);
+	ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+	ptr[2] = gp0_fbOffset2(
+		bufferX + SCREEN_WIDTH  - 1,
+		bufferY + SCREEN_HEIGHT - 2
+	);
+	ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+	ptr    = allocatePacket(chain, 3);
+	ptr[0] = gp0_rgb(16, 16, 16) | gp0_vramFill();
+	ptr[1] = gp0_xy(bufferX, bufferY);
+	ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+	// Semi-transparent rectangles are drawn by reading back each pixel from
+	// VRAM and blending it, which makes them much slower than opaque ones.
+	for (int i = 0; i < numParticles; i++) {
+		const Particle *p = &particles[i];
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(p->r / 2, p->g / 2, p->b / 2)
+			| gp0_rectangle(false, false, true);
+		ptr[1] = gp0_xy(p->x, p->y);
+		ptr[2] = gp0_xy(PARTICLE_SIZE, PARTICLE_SIZE);
+	}
+
+	drawLegend(chain);
+	drawTimeline(chain);
+
+	*(chain->nextPacket) = gp0_endTag(0);
+}
+
+static void flipJob(void *arg) {
+	// Display the frame that was drawn during the previous frame, which is
+	// guaranteed to be complete as this job waits for the GPU to go idle.
+	int bufferX = usingSecondFrame ? 0 : SCREEN_WIDTH;
+
+	GPU_GP1 = gp1_fbOffset(bufferX, 0);
+}
+
+static void drawJob(void *arg) {
+	sendLinkedList(dmaChains[usingSecondFrame].data);
+	usingSecondFrame = !usingSecondFrame;
+}
+
+/* Sound jobs */
+
+static uint8_t  mixBuffer[MIX_LENGTH] __attribute__((aligned(4)));
+static uint16_t mixSeed = 1;
+
+static void mixJob(void *arg) {
+	// Fill the buffer with filtered noise using a 16-bit Galois LFSR. The data
+	// is uploaded but never played back.
+	uint8_t last = 0;
+
+	for (int i = 0; i < MIX_LENGTH; i++) {
+		mixSeed = (mixSeed >> 1) ^ (-(mixSeed & 1) & 0xb400);
+		last    = (last + (mixSeed & 0xff)) / 2;
+
+		mixBuffer[i] = last;
+	}
+}
+
+static void uploadJob(void *arg) {
+	uploadSPUData(SPU_HEAP_START, mixBuffer, MIX_LENGTH);
+}
+
+/* Frame pacing */
+
+static uint32_t frameStartCounter = 0;
+
+static bool isNewFrame(void *arg) {
+	return (vsyncCounter != frameStartCounter);
+}
+
+static void vblankJob(void *arg) {}
+
+/* Main */
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+static Job simulate = {
+	.name = "simulate",
+	.func = &simulateJob
+};
+static Job build = {
+	.name         = "build",
+	.func         = &buildJob,
+	.dependencies = { &simulate }
+};
+static Job flip = {
+	.name    = "flip",
+	.func    = &flipJob,
+	.devices = JOB_DEVICE_GPU
+};
+static Job draw = {
+	.name         = "draw",
+	.func         = &drawJob,
+	.devices      = JOB_DEVICE_GPU,
+	.dependencies = { &build, &flip }
+};
+static Job mix = {
+	.name    = "mix",
+	.func    = &mixJob,
+	.devices = JOB_DEVICE_SPU
+};
+static Job upload = {
+	.name         = "upload",
+	.func         = &uploadJob,
+	.dependencies = { &mix }
+};
+static Job vblank = {
+	.name         = "vblank",
+	.func         = &vblankJob,
+	.dependencies = { &draw, &upload },
+	.condition    = &isNewFrame
+};
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+	initSPU();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+		linesPerFrame = 314;
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+		linesPerFrame = 263;
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(true);
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	initParticles();
+
+	setInterruptHandler(&interruptHandler, 0);
+
+	IRQ_STAT  = ~(1 << IRQ_VSYNC);
+	IRQ_MASK |= 1 << IRQ_VSYNC;
+	enableInterrupts();
+
+	JobQueue         queue;
+	JobTimelineEntry timeline[MAX_TIMELINE];
+
+	initJobQueue(&queue, timeline, MAX_TIMELINE);
+	waitForVSync();
+
+	uint16_t lastButtons = 0;
+
+	for (int frame = 0;; frame++) {
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if ((pressed & PAD_UP) && (numParticles < MAX_PARTICLES))
+			numParticles += PARTICLE_STEP;
+		if ((pressed & PAD_DOWN) && (numParticles > PARTICLE_STEP))
+			numParticles -= PARTICLE_STEP;
+
+		// Jobs must be submitted after all of their dependencies. The order
+		// also sets their priority: whenever more than one job is ready, the
+		// one submitted first runs first.
+		beginJobFrame(&queue);
+		frameStartCounter = vsyncCounter;
+
+		submitJob(&queue, &simulate);
+		submitJob(&queue, &build);
+		submitJob(&queue, &flip);
+		submitJob(&queue, &draw);
+		submitJob(&queue, &mix);
+		submitJob(&queue, &upload);
+		submitJob(&queue, &vblank);
+		runJobs(&queue);
+
+		// Keep a copy of this frame's timeline so it can be drawn during the
+		// next one.
+		for (int i = 0; i < queue.numEntries; i++)
+			lastTimeline[i] = timeline[i];
+
+		lastNumEntries = queue.numEntries;
+		lastBusyTime   = queue.busyTime;
+		lastIdleTime   = queue.idleTime;
+
+		// Only enable the display once the first frame has been drawn.
+		if (frame == 1)
+			GPU_GP1 = gp1_dispBlank(false);
+	}
+
+	return 0;
+}
@@ -0,0 +1,331 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Up to this point, all examples have used a single interrupt handler that
+ * checks each IRQ source in turn, runs with interrupts disabled and never
+ * touches the GTE. This example instead registers a separate handler for each
+ * IRQ using setIRQHandler(), and shows how the flags it takes affect latency
+ * and correctness:
+ *
+ * - the vblank handler deliberately wastes a few hundred microseconds,
+ *   simulating a handler that has a lot of work to do. If IRQ_HANDLER_NESTED
+ *   is set, other interrupts can preempt it; otherwise they have to wait for
+ *   it to return;
+ * - a timer 2 handler runs a few thousand times per second and uses the GTE,
+ *   while the main loop is also using the GTE continuously and checking its
+ *   results. If IRQ_HANDLER_USES_GTE is not set, the handler will sooner or
+ *   later overwrite the GTE registers while the main loop is in the middle of
+ *   a calculation, producing wrong results.
+ *
+ * The timer 2 handler measures its own latency by reading the timer's counter,
+ * which is reset when the IRQ is fired. The exception handler additionally
+ * keeps track of how long it takes to get from the exception vector to the
+ * first handler and back, using timer 1 as a free-running cycle counter.
+ *
+ * Press X to toggle IRQ_HANDLER_NESTED on the vblank handler and O to toggle
+ * IRQ_HANDLER_USES_GTE on the timer handler.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "font.h"
+#include "gpu.h"
+#include "ps1/cop0.h"
+#include "ps1/gpucmd.h"
+#include "ps1/gte.h"
+#include "ps1/pad.h"
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+#define TIMER_RATE     2000
+#define VBLANK_WORK    3000
+#define LATENCY_TIMER     1
+
+/* Interrupt handlers */
+
+static volatile uint32_t vsyncCounter = 0;
+static volatile uint32_t timerCount = 0, timerResult = 0;
+static volatile uint16_t lastTimerLatency = 0, maxTimerLatency = 0;
+
+static void vblankHandler(void *arg) {
+	if (!acknowledgeInterrupt(IRQ_VSYNC))
+		return;
+
+	handleVSyncInterrupt();
+	vsyncCounter++;
+	startPadPoll();
+
+	// Simulate a handler that takes a long time to run.
+	for (int i = 0; i < VBLANK_WORK; i++)
+		__asm__ volatile("");
+}
+
+static void timerHandler(void *arg) {
+	// Timer 2 is reset to zero whenever it fires an IRQ, so its current value
+	// is the time elapsed since the IRQ was raised (in units of 8 cycles).
+	uint16_t latency = TIMER_VALUE(2);
+
+	if (!acknowledgeInterrupt(IRQ_TIMER2))
+		return;
+
+	lastTimerLatency = latency;
+	if (latency > maxTimerLatency)
+		maxTimerLatency = latency;
+
+	// Square a vector using the GTE, which overwrites the IR and MAC registers.
+	uint32_t count = ++timerCount;
+
+	gte_setDataReg(GTE_IR1, count & 0x7f);
+	gte_setDataReg(GTE_IR2, (count >> 7) & 0x7f);
+	gte_setDataReg(GTE_IR3, 0x7f);
+	gte_command(GTE_CMD_SQR);
+
+	timerResult += gte_getDataReg(GTE_MAC1);
+}
+
+static void sio0Handler(void *arg) {
+	handleSIO0Interrupts();
+}
+
+/* GTE test */
+
+// Runs a calculation on the GTE and checks its result. Interrupts may occur at
+// any point while this is running, including between setting the inputs,
+// issuing the command and reading back the outputs.
+static bool testGTE(int value) {
+	int a = value & 0xff, b = (value >> 8) & 0xff, c = (value >> 16) & 0xff;
+
+	gte_setDataReg(GTE_IR1, a);
+	gte_setDataReg(GTE_IR2, b);
+	gte_setDataReg(GTE_IR3, c);
+
+	for (int i = 0; i < 8; i++)
+		__asm__ volatile("");
+
+	gte_command(GTE_CMD_SQR);
+
+	for (int i = 0; i < 8; i++)
+		__asm__ volatile("");
+
+	if (gte_getDataReg(GTE_MAC1) != (uint32_t) (a * a))
+		return false;
+	if (gte_getDataReg(GTE_MAC2) != (uint32_t) (b * b))
+		return false;
+	if (gte_getDataReg(GTE_MAC3) != (uint32_t) (c * c))
+		return false;
+
+	return true;
+}
+
+/* Main */
+
+#define SCREEN_WIDTH     320
+#define SCREEN_HEIGHT    240
+#define FONT_WIDTH        96
+#define FONT_HEIGHT       56
+#define FONT_COLOR_DEPTH GP0_COLOR_4BPP
+
+extern const uint8_t fontTexture[], fontPalette[];
+
+int main(int argc, const char **argv) {
+	installExceptionHandler();
+	initSerialIO(115200);
+	initSIO0();
+	initPads();
+
+	if ((GPU_GP1 & GP1_STAT_FB_MODE_BITMASK) == GP1_STAT_FB_MODE_PAL) {
+		puts("Using PAL mode");
+		setupGPU(GP1_MODE_PAL, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		puts("Using NTSC mode");
+		setupGPU(GP1_MODE_NTSC, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+
+	GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	GPU_GP1 = gp1_dispBlank(false);
+
+	TextureInfo font;
+
+	uploadIndexedTexture(
+		&font,
+		fontTexture,
+		fontPalette,
+		SCREEN_WIDTH * 2,
+		0,
+		SCREEN_WIDTH * 2,
+		FONT_HEIGHT,
+		FONT_WIDTH,
+		FONT_HEIGHT,
+		FONT_COLOR_DEPTH
+	);
+
+	cop0_setReg(COP0_STATUS, cop0_getReg(COP0_STATUS) | COP0_STATUS_CU2);
+
+	// Set up timer 1 to count CPU cycles (the system clock runs at the same
+	// frequency as the CPU) and timer 2 to fire an IRQ at a fixed rate.
+	TIMER_CTRL(1) = 0;
+	setInterruptTimer(LATENCY_TIMER);
+
+	TIMER_CTRL  (2) = 0;
+	TIMER_RELOAD(2) = (F_CPU / 8) / TIMER_RATE;
+	TIMER_CTRL  (2) = 0
+		| TIMER_CTRL_RELOAD
+		| TIMER_CTRL_IRQ_ON_RELOAD
+		| TIMER_CTRL_IRQ_REPEAT
+		| TIMER_CTRL_PRESCALE;
+
+	bool vblankNested = true, timerUsesGTE = true;
+
+	setIRQHandler(IRQ_VSYNC,  &vblankHandler, 0, IRQ_HANDLER_NESTED);
+	setIRQHandler(IRQ_TIMER2, &timerHandler,  0, IRQ_HANDLER_USES_GTE);
+	setIRQHandler(IRQ_SIO0,   &sio0Handler,   0, 0);
+	setIRQHandler(IRQ_TIMER0, &sio0Handler,   0, 0);
+
+	IRQ_STAT  = ~((1 << IRQ_VSYNC) | (1 << IRQ_TIMER2));
+	IRQ_MASK |= (1 << IRQ_VSYNC) | (1 << IRQ_TIMER2);
+	enableInterrupts();
+
+	DMAChain dmaChains[2];
+	bool     usingSecondFrame = false;
+
+	uint32_t gteTests = 0, gteErrors = 0, lastTimerCount = 0;
+	uint16_t lastButtons = 0;
+
+	for (;;) {
+		int bufferX = usingSecondFrame ? SCREEN_WIDTH : 0;
+		int bufferY = 0;
+
+		DMAChain *chain  = &dmaChains[usingSecondFrame];
+		usingSecondFrame = !usingSecondFrame;
+
+		uint32_t *ptr;
+
+		GPU_GP1 = gp1_fbOffset(bufferX, bufferY);
+
+		chain->nextPacket = chain->data;
+
+		ptr    = allocatePacket(chain, 4);
+		ptr[0] = gp0_texpage(0, true, false);
+		ptr[1] = gp0_fbOffset1(bufferX, bufferY);
+		ptr[2] = gp0_fbOffset2(
+			bufferX + SCREEN_WIDTH  - 1,
+			bufferY + SCREEN_HEIGHT - 2
+		);
+		ptr[3] = gp0_fbOrigin(bufferX, bufferY);
+
+		ptr    = allocatePacket(chain, 3);
+		ptr[0] = gp0_rgb(64, 64, 64) | gp0_vramFill();
+		ptr[1] = gp0_xy(bufferX, bufferY);
+		ptr[2] = gp0_xy(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+		const PadState *pad    = getPadState(0, 0);
+		uint16_t       buttons = pad->connected ? pad->buttons : 0;
+		uint16_t       pressed = buttons & ~lastButtons;
+
+		lastButtons = buttons;
+
+		if (pressed & PAD_CROSS) {
+			vblankNested = !vblankNested;
+			setIRQHandler(
+				IRQ_VSYNC,
+				&vblankHandler,
+				0,
+				vblankNested ? IRQ_HANDLER_NESTED : 0
+			);
+		}
+		if (pressed & PAD_CIRCLE) {
+			timerUsesGTE = !timerUsesGTE;
+			setIRQHandler(
+				IRQ_TIMER2,
+				&timerHandler,
+				0,
+				timerUsesGTE ? IRQ_HANDLER_USES_GTE : 0
+			);
+		}
+		if (pressed & (PAD_CROSS | PAD_CIRCLE)) {
+			gteErrors       = 0;
+			maxTimerLatency = 0;
+		}
+
+		InterruptStats stats;
+
+		getInterruptStats(&stats, true);
+
+		uint32_t count = timerCount;
+		int      rate  = count - lastTimerCount;
+
+		lastTimerCount = count;
+
+		char buffer[1024];
+
+		sprintf(
+			buffer,
+			"Vblank handler:\t%s\n"
+			"Timer handler:\t%s\n\n"
+			"Exceptions:\t\t%d this frame\n"
+			"Max depth:\t\t%d\n"
+			"Entry time:\t\t%d cycles (max %d)\n"
+			"Total time:\t\t%d cycles (max %d)\n\n"
+			"Timer IRQs:\t\t%d this frame\n"
+			"Timer latency:\t%d cycles (max %d)\n\n"
+			"GTE tests:\t\t%d\n"
+			"GTE errors:\t\t%d\n",
+			vblankNested ? "nested" : "not nested",
+			timerUsesGTE ? "saves GTE" : "does not save GTE",
+			stats.count,
+			stats.maxDepth,
+			stats.lastEntryTime,
+			stats.maxEntryTime,
+			stats.lastTotalTime,
+			stats.maxTotalTime,
+			rate,
+			lastTimerLatency * 8,
+			maxTimerLatency  * 8,
+			gteTests,
+			gteErrors
+		);
+
+		printString(chain, &font, 16, 16, buffer);
+		printString(
+			chain,
+			&font,
+			16,
+			206,
+			"[X] Toggle nesting\n[O] Toggle GTE saving"
+		);
+
+		*(chain->nextPacket) = gp0_endTag(0);
+
+		waitForGP0Ready();
+		sendLinkedList(chain->data);
+
+		// Keep the GTE busy until the next frame.
+		uint32_t counter = vsyncCounter;
+
+		while (counter == vsyncCounter) {
+			if (!testGTE(gteTests++))
+				gteErrors++;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The PS1's DMA controller has no memory-to-memory mode, so the only way to get
+ * it to fill or copy main RAM is to bounce data through a peripheral that can
+ * both receive and send it back. The GPU is the best candidate for this, as
+ * its DMA channel runs at roughly one word per cycle in both directions and
+ * VRAM can be filled with a constant value almost instantly using the GPU's
+ * fill command. The OTC channel is not usable for this purpose, as it can only
+ * write a linked list of pointers rather than arbitrary values.
+ *
+ * Filling is thus done by clearing a "scratch" area of VRAM to the desired
+ * value and reading it back to RAM, while copying is done by uploading the
+ * source buffer to the scratch area and reading it back into the destination.
+ * Any unaligned bytes at the beginning or end of the buffer, which DMA can't
+ * handle, are processed by the CPU using the regular memset() and memcpy().
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/bulkmem.h"
+#include "ps1/gpucmd.h"
+#include "ps1/registers.h"
+
+// The GPU's FIFO can hold up to 16 words, so DMA transfers must be split into
+// chunks of this size. The scratch area's width is constrained so that each
+// line is always a multiple of the chunk size.
+#define DMA_CHUNK_SIZE 16
+#define DMA_CHUNK_BYTES (DMA_CHUNK_SIZE * 4)
+
+static int _scratchX, _scratchY, _scratchWidth, _scratchHeight;
+
+// Keep track of which value the scratch area was last filled with, so that
+// consecutive fills with the same value can skip clearing VRAM again.
+static int _scratchValue = -1;
+
+static size_t _fillThreshold = BULK_FILL_THRESHOLD;
+static size_t _copyThreshold = BULK_COPY_THRESHOLD;
+
+/* GPU and DMA helpers */
+
+static void _waitForGPU(void) {
+	while (!(GPU_GP1 & GP1_STAT_CMD_READY))
+		__asm__ volatile("");
+}
+
+static void _waitForDMA(void) {
+	while (DMA_CHCR(DMA_GPU) & DMA_CHCR_ENABLE)
+		__asm__ volatile("");
+}
+
+static void _transferRect(
+	void *data,
+	int  x,
+	int  y,
+	int  width,
+	int  height,
+	bool write
+) {
+	size_t length = (width * height) * 2;
+
+	_waitForDMA();
+	_waitForGPU();
+
+	GPU_GP0 = write ? gp0_vramWrite() : gp0_vramRead();
+	GPU_GP0 = gp0_xy(x, y);
+	GPU_GP0 = gp0_xy(width, height);
+
+	// When reading, the GPU must be given some time to fetch the first pixels
+	// from VRAM and the DMA request signal must be temporarily repurposed to
+	// let the DMA controller know when data is available to be read.
+	if (write) {
+		GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+	} else {
+		while (!(GPU_GP1 & GP1_STAT_READ_READY))
+			__asm__ volatile("");
+
+		GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_READ);
+	}
+
+	DMA_MADR(DMA_GPU) = (uint32_t) data;
+	DMA_BCR (DMA_GPU) = DMA_CHUNK_SIZE | ((length / DMA_CHUNK_BYTES) << 16);
+	DMA_CHCR(DMA_GPU) = 0
+		| (write ? DMA_CHCR_WRITE : DMA_CHCR_READ)
+		| DMA_CHCR_MODE_SLICE
+		| DMA_CHCR_ENABLE;
+
+	_waitForDMA();
+
+	if (!write)
+		GPU_GP1 = gp1_dmaRequestMode(GP1_DREQ_GP0_WRITE);
+}
+
+// Moves up to one scratch area's worth of data between RAM and VRAM, using a
+// rectangle spanning as many full lines as possible plus an additional partial
+// line for any leftover data.
+static void _transferScratch(void *data, size_t length, bool write) {
+	size_t lineLength = _scratchWidth * 2;
+	int    lines      = length / lineLength;
+	int    remainder  = length % lineLength;
+
+	if (lines) {
+		_transferRect(data, _scratchX, _scratchY, _scratchWidth, lines, write);
+		data = (void *) ((uintptr_t) data + lines * lineLength);
+	}
+	if (remainder) {
+		int y = _scratchY + lines;
+
+		_transferRect(data, _scratchX, y, remainder / 2, 1, write);
+	}
+}
+
+/* Public API */
+
+void initBulkMemory(int x, int y, int width, int height) {
+	assert(!(x % 16) && !(width % 32));
+	assert((width <= 1024) && (height > 0) && (height < 512));
+
+	_scratchX      = x;
+	_scratchY      = y;
+	_scratchWidth  = width;
+	_scratchHeight = height;
+	_scratchValue  = -1;
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_GPU);
+}
+
+void setBulkThresholds(size_t fillThreshold, size_t copyThreshold) {
+	_fillThreshold = fillThreshold;
+	_copyThreshold = copyThreshold;
+}
+
+void *bulkFill(void *dest, int ch, size_t count) {
+	ch &= 0xff;
+
+	// The GPU's fill command takes a 24-bit RGB color, which gets converted to
+	// a 15-bit VRAM pixel with the most significant bit always cleared. Only
+	// byte values with bit 7 cleared can thus be represented.
+	// Buffers too short to contain at least one aligned DMA chunk are also
+	// handled entirely by the CPU; this additionally prevents the length from
+	// underflowing once the alignment head is subtracted from it, even if the
+	// threshold has been set to zero.
+	uintptr_t ptr  = (uintptr_t) dest;
+	size_t    head = (4 - (ptr % 4)) % 4;
+
+	if (
+		!_scratchWidth ||
+		(count < _fillThreshold) ||
+		(count < (head + DMA_CHUNK_BYTES)) ||
+		(ch & 0x80)
+	)
+		return memset(dest, ch, count);
+
+	// Fill any bytes preceding the first aligned word using the CPU, then
+	// determine how much data can be transferred through DMA.
+	memset(dest, ch, head);
+	ptr   += head;
+	count -= head;
+
+	size_t dmaLength = count - (count % DMA_CHUNK_BYTES);
+	size_t tail      = count - dmaLength;
+
+	if (_scratchValue != ch) {
+		uint16_t pixel = ch | (ch << 8);
+
+		_waitForGPU();
+		GPU_GP0 = 0
+			| gp0_rgb(
+				(pixel <<  3) & 0xf8,
+				(pixel >>  2) & 0xf8,
+				(pixel >>  7) & 0xf8
+			)
+			| gp0_vramFill();
+		GPU_GP0 = gp0_xy(_scratchX, _scratchY);
+		GPU_GP0 = gp0_xy(_scratchWidth - 1, _scratchHeight);
+
+		_scratchValue = ch;
+	}
+
+	size_t scratchLength = _scratchWidth * _scratchHeight * 2;
+
+	while (dmaLength) {
+		size_t length = (dmaLength < scratchLength) ? dmaLength : scratchLength;
+
+		_transferScratch((void *) ptr, length, false);
+		ptr       += length;
+		dmaLength -= length;
+	}
+
+	memset((void *) ptr, ch, tail);
+	return dest;
+}
+
+void *bulkCopy(void *dest, const void *src, size_t count) {
+	uintptr_t destPtr = (uintptr_t) dest;
+	uintptr_t srcPtr  = (uintptr_t) src;
+	size_t    head    = (4 - (destPtr % 4)) % 4;
+
+	// DMA can only move whole words, so the source and destination must have
+	// the same alignment for any part of the copy to be offloaded. As with
+	// bulkFill(), there must be room for at least one chunk after the head.
+	if (
+		!_scratchWidth ||
+		(count < _copyThreshold) ||
+		(count < (head + DMA_CHUNK_BYTES)) ||
+		((destPtr % 4) != (srcPtr % 4))
+	)
+		return memcpy(dest, src, count);
+
+	memcpy(dest, src, head);
+	destPtr += head;
+	srcPtr  += head;
+	count   -= head;
+
+	size_t dmaLength = count - (count % DMA_CHUNK_BYTES);
+	size_t tail      = count - dmaLength;
+
+	size_t scratchLength = _scratchWidth * _scratchHeight * 2;
+	_scratchValue        = -1;
+
+	while (dmaLength) {
+		size_t length = (dmaLength < scratchLength) ? dmaLength : scratchLength;
+
+		_transferScratch((void *) srcPtr, length, true);
+		_transferScratch((void *) destPtr, length, false);
+		destPtr   += length;
+		srcPtr    += length;
+		dmaLength -= length;
+	}
+
+	memcpy((void *) destPtr, (const void *) srcPtr, tail);
+	return dest;
+}
@@ -0,0 +1,73 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+// Default thresholds (in bytes) above which bulkFill() and bulkCopy() will
+// offload the operation to DMA rather than calling memset() or memcpy(). These
+// are conservative estimates; the bulk memory example measures the actual
+// crossover points and prints updated values that can be passed to
+// setBulkThresholds().
+#define BULK_FILL_THRESHOLD 2048
+#define BULK_COPY_THRESHOLD 1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reserves a rectangular area of VRAM to be used as a staging buffer for
+ * DMA fills and copies, and enables the GPU DMA channel. The area's width must
+ * be a multiple of 32 pixels (64 bytes); larger areas reduce the number of DMA
+ * transfers needed for each operation. The GPU must not be drawing or
+ * displaying anything in this area.
+ *
+ * @param x
+ * @param y
+ * @param width
+ * @param height
+ */
+void initBulkMemory(int x, int y, int width, int height);
+
+/**
+ * @brief Changes the minimum lengths at which bulkFill() and bulkCopy() switch
+ * from CPU to DMA transfers.
+ *
+ * @param fillThreshold
+ * @param copyThreshold
+ */
+void setBulkThresholds(size_t fillThreshold, size_t copyThreshold);
+
+/**
+ * @brief Drop-in replacement for memset() which uses the GPU to fill large
+ * buffers. Fills whose byte value has the most significant bit set cannot be
+ * represented by the GPU's fill command and always fall back to memset(). The
+ * GPU must be idle when this function is called, and will be idle again by the
+ * time it returns.
+ */
+void *bulkFill(void *dest, int ch, size_t count);
+
+/**
+ * @brief Drop-in replacement for memcpy() which bounces large buffers through
+ * VRAM using the GPU DMA channel. The same restrictions as bulkFill() apply.
+ */
+void *bulkCopy(void *dest, const void *src, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
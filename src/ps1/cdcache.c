@@ -0,0 +1,388 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Reading from a CD is dominated by seek times: a double speed drive transfers
+ * a sector in about 6.7 milliseconds once it is in position, but getting there
+ * can take anywhere between a few tens and several hundred milliseconds. This
+ * cache sits between the filesystem and the CD-ROM driver and tries to avoid
+ * seeks in three ways:
+ *
+ * - whenever a read misses the cache, a few more sectors are read after it
+ *   while the drive is already in position and placed in the cache, so that
+ *   sequential reads of small files laid out next to each other on the disc
+ *   are served from memory;
+ * - the contents of short reads (e.g. small files loaded over and over) are
+ *   kept in the cache, with the least recently used sectors being evicted
+ *   first when the cache is full;
+ * - the game can hint at files it will need soon, which are then read into the
+ *   cache in the background whenever the drive would otherwise be idle.
+ *
+ * Sectors are always transferred by the driver using DMA directly into either
+ * the destination buffer or a cache slot; the only copies made by the CPU are
+ * from the cache to the destination buffer when a read hits the cache.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ps1/cdcache.h"
+#include "ps1/cdrom.h"
+#include "ps1/system.h"
+
+#define NO_SECTOR 0xffffffff
+
+static void _processQueue(CDCache *cache);
+
+/* Slot management */
+
+static uint8_t *_getSlotData(CDCache *cache, const CDCacheSlot *slot) {
+	return &cache->buffer[(slot - cache->slots) * CDCACHE_SECTOR_SIZE];
+}
+
+static CDCacheSlot *_findSlot(CDCache *cache, uint32_t lba) {
+	for (int i = 0; i < cache->numSlots; i++) {
+		CDCacheSlot *slot = &cache->slots[i];
+
+		if (slot->lba == lba) {
+			slot->lastUsed = cache->useCounter++;
+			return slot;
+		}
+	}
+
+	return 0;
+}
+
+static CDCacheSlot *_allocateSlot(CDCache *cache, uint32_t lba) {
+	// Reuse the slot already holding the sector if any, otherwise evict the
+	// least recently used one (empty slots are never used, so they are picked
+	// first as their counter is zero).
+	CDCacheSlot *oldest = &cache->slots[0];
+
+	for (int i = 0; i < cache->numSlots; i++) {
+		CDCacheSlot *slot = &cache->slots[i];
+
+		if (slot->lba == lba) {
+			oldest = slot;
+			break;
+		}
+		if ((slot->lba == NO_SECTOR) || (slot->lastUsed < oldest->lastUsed))
+			oldest = slot;
+	}
+
+	oldest->lba      = lba;
+	oldest->lastUsed = cache->useCounter++;
+	return oldest;
+}
+
+/* Disc read handling */
+
+static void *_getBuffer(CDROMRequest *request, int index) {
+	CDCache     *cache = (CDCache *) request->arg;
+	CDCacheRead *read  = cache->current;
+
+	// Sectors belonging to a read that bypasses the cache go straight to its
+	// destination, everything else (including read-ahead) to a cache slot.
+	if (read && !cache->keepSectors) {
+		int offset = read->completed + index;
+
+		if (offset < read->count)
+			return (uint8_t *) read->data + offset * CDCACHE_SECTOR_SIZE;
+	}
+
+	return _getSlotData(cache, _allocateSlot(cache, cache->readLBA + index));
+}
+
+static void _finishRead(CDCache *cache, CDCacheRead *read, CDROMStatus status) {
+	cache->queueHead = read->next;
+
+	if (!cache->queueHead)
+		cache->queueTail = 0;
+
+	read->status = status;
+
+	if (read->callback)
+		read->callback(read);
+}
+
+static void _requestCallback(CDROMRequest *request) {
+	CDCache     *cache = (CDCache *) request->arg;
+	CDCacheRead *read  = cache->current;
+	int         count  = request->completed;
+
+	cache->reading            = false;
+	cache->current            = 0;
+	cache->nextLBA            = cache->readLBA + count;
+	cache->stats.sectorsRead += count;
+
+	if (read) {
+		int userCount = read->count - read->completed;
+
+		if (userCount > count)
+			userCount = count;
+
+		// If the read went through the cache, the sectors must be copied to
+		// the destination now that they have all been transferred. The read
+		// length is capped so that no sector gets evicted before this point,
+		// but should one be missing anyway, the rest of the read is retried
+		// rather than handing stale data to the caller.
+		if (cache->keepSectors) {
+			for (int i = 0; i < userCount; i++) {
+				CDCacheSlot *slot = _findSlot(cache, cache->readLBA + i);
+				uint8_t     *ptr  = (uint8_t *) read->data
+					+ (read->completed + i) * CDCACHE_SECTOR_SIZE;
+
+				if (!slot) {
+					userCount = i;
+					break;
+				}
+
+				memcpy(ptr, _getSlotData(cache, slot), CDCACHE_SECTOR_SIZE);
+			}
+		}
+
+		read->completed += userCount;
+
+		// Errors that occur while reading ahead (such as running into the end
+		// of the disc) are not reported, as the read itself has succeeded.
+		if (read->completed >= read->count)
+			_finishRead(cache, read, CDROM_OK);
+		else if (request->status != CDROM_OK)
+			_finishRead(cache, read, request->status);
+	}
+
+	_processQueue(cache);
+}
+
+static void _startDiscRead(
+	CDCache     *cache,
+	CDCacheRead *read,
+	uint32_t    lba,
+	int         count,
+	bool        keepSectors
+) {
+	CDROMRequest *request = &cache->request;
+
+	if (lba != cache->nextLBA)
+		cache->stats.seeks++;
+
+	cache->reading     = true;
+	cache->keepSectors = keepSectors;
+	cache->current     = read;
+	cache->readLBA     = lba;
+
+	request->command     = CDROM_CMD_READ_N;
+	request->paramLength = 0;
+	request->lba         = lba;
+	request->count       = count;
+	request->getBuffer   = &_getBuffer;
+	request->callback    = &_requestCallback;
+	request->arg         = cache;
+	queueCDROMRequest(request);
+}
+
+static bool _startRead(CDCache *cache, CDCacheRead *read) {
+	// Serve as many sectors as possible from the cache, then read the rest
+	// from the disc (even if some of them are also cached, as splitting the
+	// read would only introduce more seeks).
+	for (; read->completed < read->count; read->completed++) {
+		CDCacheSlot *slot = _findSlot(cache, read->lba + read->completed);
+
+		if (!slot)
+			break;
+
+		memcpy(
+			(uint8_t *) read->data + read->completed * CDCACHE_SECTOR_SIZE,
+			_getSlotData(cache, slot),
+			CDCACHE_SECTOR_SIZE
+		);
+		cache->stats.hits++;
+	}
+
+	int remaining = read->count - read->completed;
+
+	if (!remaining) {
+		_finishRead(cache, read, CDROM_OK);
+		return false;
+	}
+
+	// When reading through the cache, all sectors read (including read-ahead)
+	// must fit in the cache at the same time, as otherwise the last ones would
+	// evict the requested ones before they are copied to the destination.
+	int  length = remaining + cache->readAhead;
+	bool keep   = (read->count <= cache->maxKeptSectors) &&
+		(remaining <= cache->numSlots);
+
+	if (keep && (length > cache->numSlots))
+		length = cache->numSlots;
+
+	cache->stats.misses += remaining;
+	_startDiscRead(cache, read, read->lba + read->completed, length, keep);
+	return true;
+}
+
+static bool _startPrefetch(CDCache *cache) {
+	int      index = cache->firstHint;
+	uint32_t lba   = cache->hintLBA[index];
+	int      count = cache->hintCount[index];
+
+	// Skip any sectors that are already cached at the beginning of the hinted
+	// range, then read the next chunk. Chunks are kept small so that reads
+	// never have to wait long for a prefetch to finish.
+	while (count && _findSlot(cache, lba)) {
+		lba++;
+		count--;
+	}
+
+	// Chunks must also fit in half of the cache, but never be empty unless the
+	// hint has been fully consumed, as the hint would otherwise never advance.
+	int chunk = count;
+	int limit = cache->numSlots / 2;
+
+	if (limit < 1)
+		limit = 1;
+	if (chunk > CDCACHE_PREFETCH_CHUNK)
+		chunk = CDCACHE_PREFETCH_CHUNK;
+	if (chunk > limit)
+		chunk = limit;
+
+	cache->hintLBA  [index] = lba   + chunk;
+	cache->hintCount[index] = count - chunk;
+
+	if (cache->hintCount[index] == 0) {
+		cache->firstHint = (index + 1) % CDCACHE_MAX_HINTS;
+		cache->numHints--;
+	}
+	if (!chunk)
+		return false;
+
+	cache->stats.prefetched += chunk;
+	_startDiscRead(cache, 0, lba, chunk, true);
+	return true;
+}
+
+static void _processQueue(CDCache *cache) {
+	// Reads always take priority over prefetching. Keep going until either a
+	// disc read has been issued or there is nothing left to do.
+	while (!cache->reading) {
+		if (cache->queueHead) {
+			if (_startRead(cache, cache->queueHead))
+				return;
+		} else if (cache->numHints) {
+			if (_startPrefetch(cache))
+				return;
+		} else {
+			return;
+		}
+	}
+}
+
+/* Public API */
+
+void initCDCache(
+	CDCache     *cache,
+	CDCacheSlot *slots,
+	uint8_t     *buffer,
+	int         numSlots,
+	int         readAhead,
+	int         maxKeptSectors
+) {
+	cache->buffer         = buffer;
+	cache->slots          = slots;
+	cache->numSlots       = numSlots;
+	cache->readAhead      = readAhead;
+	cache->maxKeptSectors = maxKeptSectors;
+	cache->trace          = false;
+	cache->queueHead      = 0;
+	cache->queueTail      = 0;
+	cache->firstHint      = 0;
+	cache->numHints       = 0;
+	cache->reading        = false;
+	cache->current        = 0;
+	cache->nextLBA        = NO_SECTOR;
+
+	memset(&cache->stats, 0, sizeof(CDCacheStats));
+	invalidateCDCache(cache);
+}
+
+void queueCDCacheRead(CDCache *cache, CDCacheRead *read) {
+	bool enabled = disableInterrupts();
+
+	read->next      = 0;
+	read->status    = CDROM_PENDING;
+	read->completed = 0;
+
+#ifndef NDEBUG
+	if (cache->trace)
+		printf("cdcache: read %d %d\n", read->lba, read->count);
+#endif
+
+	if (cache->queueTail)
+		cache->queueTail->next = read;
+	else
+		cache->queueHead = read;
+
+	cache->queueTail = read;
+
+	_processQueue(cache);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+bool prefetchCDCache(CDCache *cache, uint32_t lba, int count) {
+	bool enabled = disableInterrupts();
+	bool added   = (cache->numHints < CDCACHE_MAX_HINTS);
+
+	if (added && (count > 0)) {
+		int index = (cache->firstHint + cache->numHints) % CDCACHE_MAX_HINTS;
+
+		cache->hintLBA  [index] = lba;
+		cache->hintCount[index] = count;
+		cache->numHints++;
+
+		_processQueue(cache);
+	}
+
+	if (enabled)
+		enableInterrupts();
+
+	return added;
+}
+
+void cancelCDCachePrefetch(CDCache *cache) {
+	bool enabled = disableInterrupts();
+
+	cache->numHints = 0;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+bool isCDCacheBusy(const CDCache *cache) {
+	return cache->reading || cache->queueHead || cache->numHints;
+}
+
+void invalidateCDCache(CDCache *cache) {
+	for (int i = 0; i < cache->numSlots; i++) {
+		cache->slots[i].lba      = NO_SECTOR;
+		cache->slots[i].lastUsed = 0;
+	}
+
+	cache->useCounter = 1;
+	cache->nextLBA    = NO_SECTOR;
+}
@@ -0,0 +1,169 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+
+#define CDCACHE_SECTOR_SIZE    2048
+#define CDCACHE_MAX_HINTS      8
+#define CDCACHE_PREFETCH_CHUNK 16
+
+typedef struct {
+	uint32_t lba;      // Sector held by this slot, 0xffffffff if none
+	uint32_t lastUsed; // Value of the cache's use counter when last accessed
+} CDCacheSlot;
+
+typedef struct {
+	uint32_t hits;        // Requested sectors found in the cache
+	uint32_t misses;      // Requested sectors that had to be read from the disc
+	uint32_t seeks;       // Disc reads not starting where the last one ended
+	uint32_t sectorsRead; // Total sectors read (including read-ahead/prefetch)
+	uint32_t prefetched;  // Sectors read as a result of prefetch hints
+} CDCacheStats;
+
+typedef struct CDCacheRead CDCacheRead;
+typedef void (*CDCacheCallback)(CDCacheRead *read);
+
+struct CDCacheRead {
+	CDCacheRead *next;
+
+	// These fields must be filled in before queueing the read. The data buffer
+	// must be 4-byte aligned and at least count * CDCACHE_SECTOR_SIZE bytes
+	// long.
+	uint32_t lba;
+	uint16_t count;
+	void     *data;
+
+	// Optional function called once the read has completed (or failed),
+	// usually from the interrupt handler, plus an arbitrary argument for it.
+	CDCacheCallback callback;
+	void            *arg;
+
+	// These fields are updated by the cache. The status is one of the
+	// CDROMStatus values.
+	volatile uint8_t  status;
+	volatile uint16_t completed;
+};
+
+typedef struct {
+	// Sector slots and their tags, provided by the caller.
+	uint8_t     *buffer;
+	CDCacheSlot *slots;
+	int         numSlots;
+
+	// Number of additional sectors read into the cache after each read that
+	// misses it, and maximum length of reads whose contents are kept in the
+	// cache. Both can be changed at any time.
+	int readAhead, maxKeptSectors;
+
+	// If set, each read queued is logged to the serial port (in debug builds
+	// only) so that an access trace for the disc image builder can be
+	// generated from the log using tools/convertTraceLog.py.
+	bool trace;
+
+	// Counters updated by the cache. The average number of sectors read per
+	// seek is sectorsRead / seeks.
+	CDCacheStats stats;
+
+	// Internal state.
+	CDCacheRead  *queueHead, *queueTail;
+	uint32_t     hintLBA[CDCACHE_MAX_HINTS];
+	uint16_t     hintCount[CDCACHE_MAX_HINTS];
+	uint8_t      firstHint, numHints;
+	CDROMRequest request;
+	bool         reading, keepSectors;
+	CDCacheRead  *current;
+	uint32_t     readLBA, nextLBA, useCounter;
+} CDCache;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a sector cache using the given slots. The buffer must be
+ * 4-byte aligned and numSlots * CDCACHE_SECTOR_SIZE bytes long, and at least
+ * one slot must be provided. readAhead + maxKeptSectors should not exceed the
+ * number of slots; the amount of data read ahead is reduced if necessary to
+ * prevent reads from evicting their own sectors. initCDROM() must have
+ * been called prior to this, and the drive must be set up to return 2048-byte
+ * sectors.
+ *
+ * @param cache
+ * @param slots
+ * @param buffer
+ * @param numSlots
+ * @param readAhead
+ * @param maxKeptSectors
+ */
+void initCDCache(
+	CDCache     *cache,
+	CDCacheSlot *slots,
+	uint8_t     *buffer,
+	int         numSlots,
+	int         readAhead,
+	int         maxKeptSectors
+);
+
+/**
+ * @brief Appends a read to the queue. Sectors already in the cache are copied
+ * to the destination, while the rest are read from the disc along with
+ * readAhead more sectors, which are placed in the cache. Reads no longer than
+ * maxKeptSectors are read through the cache (so that they can be served from
+ * it again later), longer ones are transferred directly to the destination.
+ * Can be called from an interrupt handler.
+ *
+ * @param cache
+ * @param read
+ */
+void queueCDCacheRead(CDCache *cache, CDCacheRead *read);
+
+/**
+ * @brief Hints that the given sectors are going to be read soon. The sectors
+ * are read into the cache in small chunks whenever no other read is pending,
+ * so that a read queued in the meantime only has to wait for the current
+ * chunk to finish.
+ *
+ * @param cache
+ * @param lba
+ * @param count
+ * @return False if too many hints are already pending, true otherwise
+ */
+bool prefetchCDCache(CDCache *cache, uint32_t lba, int count);
+
+/**
+ * @brief Discards all pending prefetch hints. Any chunk already being read is
+ * still placed in the cache.
+ */
+void cancelCDCachePrefetch(CDCache *cache);
+
+/**
+ * @brief Returns whether any read or prefetch is in progress or pending.
+ */
+bool isCDCacheBusy(const CDCache *cache);
+
+/**
+ * @brief Discards the contents of the cache, e.g. after the disc is changed.
+ * Must not be called while the cache is busy.
+ */
+void invalidateCDCache(CDCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,435 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The CD-ROM drive is controlled by a dedicated microcontroller, which accepts
+ * commands (each with up to 16 parameter bytes) through a set of FIFOs and
+ * signals their progress by raising one of five interrupt types:
+ *
+ * - INT3 (acknowledge) is fired once the command has been accepted, with the
+ *   drive's status byte (and, for some commands, additional data) as response;
+ * - INT2 (complete) is fired by commands that take a while to execute, such as
+ *   seeking or stopping the spindle, once they have finished;
+ * - INT1 (data ready) is fired whenever a sector has been read into the sector
+ *   buffer while reading;
+ * - INT4 (data end) is fired when the end of the disc or track is reached;
+ * - INT5 (error) replaces either of the first two if a command fails, with an
+ *   error code as the second response byte.
+ *
+ * Only one command can be in flight at a time, and each interrupt must be
+ * acknowledged before the drive can send the next one. This driver thus keeps
+ * a queue of requests and only sends a command after the previous one has been
+ * fully acknowledged. Data sectors are transferred straight from the sector
+ * buffer to their destination using DMA as soon as INT1 is received; the CPU
+ * is stalled for the duration of the transfer (a few hundred microseconds, as
+ * the drive's data port is only 8 bits wide) but never has to copy any data
+ * itself.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+#include "ps1/registers.h"
+#include "ps1/system.h"
+
+typedef enum {
+	STEP_IDLE     = 0,
+	STEP_SETLOC   = 1, // Setloc sent before a read, waiting for INT3
+	STEP_COMMAND  = 2, // Command sent, waiting for INT3
+	STEP_COMPLETE = 3, // Waiting for INT2
+	STEP_DATA     = 4, // Waiting for INT1 (one per sector)
+	STEP_PAUSE    = 5, // Pause sent after the last sector, waiting for INT3
+	STEP_PAUSED   = 6  // Waiting for the pause command's INT2
+} RequestStep;
+
+static CDROMRequest *_queueHead = 0, *_queueTail = 0;
+static RequestStep  _step        = STEP_IDLE;
+static uint8_t      _mode        = 0;
+static uint8_t      _driveStatus = 0;
+
+static CDROMSectorCallback _sectorCallback    = 0;
+static void                *_sectorCallbackArg = 0;
+static bool                _inSectorCallback   = false;
+
+static void _startRequest(CDROMRequest *request);
+
+/* Command helpers */
+
+static bool _isReadCommand(uint8_t command) {
+	return
+		(command == CDROM_CMD_READ_N) ||
+		(command == CDROM_CMD_READ_S);
+}
+
+static bool _hasSecondResponse(uint8_t command) {
+	switch (command) {
+		case CDROM_CMD_STANDBY:
+		case CDROM_CMD_STOP:
+		case CDROM_CMD_PAUSE:
+		case CDROM_CMD_INIT:
+		case CDROM_CMD_SETSESSION:
+		case CDROM_CMD_SEEK_L:
+		case CDROM_CMD_SEEK_P:
+		case CDROM_CMD_GET_ID:
+		case CDROM_CMD_READ_TOC:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static void _sendCommand(uint8_t command, const uint8_t *params, int length) {
+	// The busy flag is only set for a few microseconds while the drive's
+	// microcontroller is fetching the previous command.
+	while (CDROM_HSTS & CDROM_HSTS_BUSYSTS)
+		__asm__ volatile("");
+
+	// Keep track of the sector size, so that the right amount of data can be
+	// transferred when reading.
+	if ((command == CDROM_CMD_SETMODE) && length)
+		_mode = params[0];
+
+	CDROM_ADDRESS = 1;
+	CDROM_HCLRCTL = CDROM_HCLRCTL_CLRPRM;
+	CDROM_ADDRESS = 0;
+
+	for (; length > 0; length--)
+		CDROM_PARAMETER = *(params++);
+
+	CDROM_COMMAND = command;
+}
+
+static int _getSectorSize(void) {
+	// The controller can also return 2328-byte sectors (bit 4 alone), but that
+	// mode is of little use as it skips the XA subheader.
+	return ((_mode & CDROM_MODE_SIZE_BITMASK) == CDROM_MODE_SIZE_2340)
+		? 2340
+		: 2048;
+}
+
+static void _openSectorBuffer(void) {
+	// Request the sector buffer to be exposed to the data FIFO. Each read
+	// from the FIFO (by either the CPU or DMA) then advances through it.
+	CDROM_ADDRESS = 0;
+	CDROM_HCHPCTL = 0;
+	CDROM_HCHPCTL = CDROM_HCHPCTL_BFRD;
+}
+
+static void _closeSectorBuffer(void) {
+	CDROM_ADDRESS = 0;
+	CDROM_HCHPCTL = 0;
+}
+
+static void _transferData(void *data, int length) {
+	// Unaligned or odd-sized chunks are read by the CPU, everything else is
+	// pulled by the DMA controller in a single burst.
+	if ((((uint32_t) data | length) % 4) == 0) {
+		DMA_MADR(DMA_CDROM) = (uint32_t) data;
+		DMA_BCR (DMA_CDROM) = (length / 4) | (1 << 16);
+		DMA_CHCR(DMA_CDROM) = 0
+			| DMA_CHCR_READ
+			| DMA_CHCR_MODE_BURST
+			| DMA_CHCR_ENABLE
+			| DMA_CHCR_TRIGGER;
+
+		while (DMA_CHCR(DMA_CDROM) & DMA_CHCR_ENABLE)
+			__asm__ volatile("");
+	} else {
+		uint8_t *ptr = (uint8_t *) data;
+
+		for (; length > 0; length--)
+			*(ptr++) = CDROM_RDDATA;
+	}
+}
+
+static void _readSector(CDROMRequest *request) {
+	int     size = _getSectorSize();
+	uint8_t *ptr;
+
+	if (request->getBuffer)
+		ptr = request->getBuffer(request, request->completed);
+	else
+		ptr = (uint8_t *) request->data + request->completed * size;
+
+	_openSectorBuffer();
+	_transferData(ptr, size);
+	_closeSectorBuffer();
+
+	request->completed++;
+}
+
+/* Request state machine */
+
+static void _finishRequest(CDROMRequest *request, CDROMStatus status) {
+	_queueHead = request->next;
+	_step      = STEP_IDLE;
+
+	if (!_queueHead)
+		_queueTail = 0;
+
+	request->status = status;
+
+	if (request->callback)
+		request->callback(request);
+
+	// The callback may have queued another request, which would have been
+	// started already.
+	if (_queueHead && (_step == STEP_IDLE))
+		_startRequest(_queueHead);
+}
+
+static void _startRequest(CDROMRequest *request) {
+	if (_isReadCommand(request->command)) {
+		CDROMMSF msf;
+
+		cdrom_convertLBAToMSF(&msf, request->lba);
+		_sendCommand(CDROM_CMD_SETLOC, (const uint8_t *) &msf, sizeof(msf));
+		_step = STEP_SETLOC;
+	} else {
+		_sendCommand(request->command, request->params, request->paramLength);
+		_step = STEP_COMMAND;
+	}
+}
+
+static void _saveResponse(
+	CDROMRequest  *request,
+	const uint8_t *response,
+	int           length
+) {
+	request->responseLength = length;
+
+	for (int i = 0; i < length; i++)
+		request->response[i] = response[i];
+}
+
+static void _handleResponse(
+	CDROMIRQType  type,
+	const uint8_t *response,
+	int           length
+) {
+	CDROMRequest *request = _queueHead;
+
+	// Responses that do not belong to any request (e.g. errors caused by the
+	// lid being opened while idle) are ignored.
+	if (!request || (_step == STEP_IDLE))
+		return;
+
+	if (type == CDROM_IRQ_ERROR) {
+		_saveResponse(request, response, length);
+		_finishRequest(request, CDROM_ERROR);
+		return;
+	}
+	if (type == CDROM_IRQ_DATA_END) {
+		_finishRequest(request, CDROM_DATA_END);
+		return;
+	}
+
+	switch (_step) {
+		case STEP_SETLOC:
+			if (type != CDROM_IRQ_ACKNOWLEDGE)
+				break;
+
+			_sendCommand(
+				request->command,
+				request->params,
+				request->paramLength
+			);
+			_step = STEP_COMMAND;
+			break;
+
+		case STEP_COMMAND:
+			if (type != CDROM_IRQ_ACKNOWLEDGE)
+				break;
+
+			_saveResponse(request, response, length);
+
+			if (_isReadCommand(request->command)) {
+				if (request->count)
+					_step = STEP_DATA;
+				else
+					_finishRequest(request, CDROM_OK);
+			} else if (_hasSecondResponse(request->command)) {
+				_step = STEP_COMPLETE;
+			} else {
+				_finishRequest(request, CDROM_OK);
+			}
+			break;
+
+		case STEP_COMPLETE:
+			if (type != CDROM_IRQ_COMPLETE)
+				break;
+
+			_saveResponse(request, response, length);
+			_finishRequest(request, CDROM_OK);
+			break;
+
+		case STEP_DATA:
+			// The sector itself has already been transferred by the interrupt
+			// handler at this point.
+			if (request->completed < request->count)
+				break;
+
+			_sendCommand(CDROM_CMD_PAUSE, 0, 0);
+			_step = STEP_PAUSE;
+			break;
+
+		case STEP_PAUSE:
+			if (type == CDROM_IRQ_ACKNOWLEDGE)
+				_step = STEP_PAUSED;
+			break;
+
+		case STEP_PAUSED:
+			if (type == CDROM_IRQ_COMPLETE)
+				_finishRequest(request, CDROM_OK);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* Public API */
+
+void initCDROM(void) {
+	_queueHead   = 0;
+	_queueTail   = 0;
+	_step        = STEP_IDLE;
+	_mode        = 0;
+	_driveStatus = 0;
+
+	_sectorCallback    = 0;
+	_sectorCallbackArg = 0;
+	_inSectorCallback  = false;
+
+	// Discard any pending interrupt and parameter, then enable all interrupt
+	// types.
+	CDROM_ADDRESS   = 1;
+	CDROM_HCLRCTL   = CDROM_HCLRCTL_CLRINT_BITMASK | CDROM_HCLRCTL_CLRPRM;
+	CDROM_HINTMSK_W = CDROM_HINT_INT_BITMASK;
+	CDROM_ADDRESS   = 0;
+	CDROM_HCHPCTL   = 0;
+
+	// Route CD audio and XA-ADPCM to the SPU at full volume, without mixing
+	// the left and right channels together.
+	CDROM_ADDRESS = 2;
+	CDROM_ATV0    = 0x80;
+	CDROM_ATV1    = 0x00;
+	CDROM_ADDRESS = 3;
+	CDROM_ATV2    = 0x80;
+	CDROM_ATV3    = 0x00;
+	CDROM_ADPCTL  = CDROM_ADPCTL_CHNGATV;
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_CDROM);
+
+	IRQ_STAT  = ~(1 << IRQ_CDROM);
+	IRQ_MASK |= 1 << IRQ_CDROM;
+}
+
+void handleCDROMInterrupts(void) {
+	if (!acknowledgeInterrupt(IRQ_CDROM))
+		return;
+
+	CDROM_ADDRESS = 1;
+
+	CDROMIRQType type = CDROM_HINTSTS & CDROM_HINT_INT_BITMASK;
+	uint8_t      response[CDROM_MAX_RESPONSE];
+	int          length = 0;
+
+	if (type == CDROM_IRQ_NONE)
+		return;
+
+	while (
+		(CDROM_HSTS & CDROM_HSTS_RSLRRDY) &&
+		(length < CDROM_MAX_RESPONSE)
+	)
+		response[length++] = CDROM_RESULT;
+
+	if (length)
+		_driveStatus = response[0];
+
+	// Data must be pulled from the sector buffer before acknowledging INT1, as
+	// the drive may otherwise overwrite it with the next sector.
+	if (type == CDROM_IRQ_DATA_READY) {
+		if (_step == STEP_DATA) {
+			CDROMRequest *request = _queueHead;
+
+			if (request->completed < request->count)
+				_readSector(request);
+		} else if (_sectorCallback) {
+			_inSectorCallback = true;
+			_openSectorBuffer();
+			_sectorCallback(_sectorCallbackArg);
+			_closeSectorBuffer();
+			_inSectorCallback = false;
+		}
+	}
+
+	// Only one interrupt is reported at a time. If another one is pending, the
+	// drive will raise the IRQ again shortly after this one is acknowledged.
+	CDROM_ADDRESS = 1;
+	CDROM_HCLRCTL = CDROM_HCLRCTL_CLRINT_BITMASK;
+
+	_handleResponse(type, response, length);
+
+	// Requests queued by the sector callback could not be started until the
+	// interrupt was acknowledged.
+	if (_queueHead && (_step == STEP_IDLE))
+		_startRequest(_queueHead);
+}
+
+void queueCDROMRequest(CDROMRequest *request) {
+	bool enabled = disableInterrupts();
+
+	request->next           = 0;
+	request->status         = CDROM_PENDING;
+	request->responseLength = 0;
+	request->completed      = 0;
+
+	if (_queueTail)
+		_queueTail->next = request;
+	else
+		_queueHead = request;
+
+	_queueTail = request;
+
+	if ((_step == STEP_IDLE) && !_inSectorCallback)
+		_startRequest(_queueHead);
+	if (enabled)
+		enableInterrupts();
+}
+
+bool isCDROMBusy(void) {
+	return (_queueHead != 0);
+}
+
+void setCDROMSectorCallback(CDROMSectorCallback callback, void *arg) {
+	bool enabled = disableInterrupts();
+
+	_sectorCallback    = callback;
+	_sectorCallbackArg = arg;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void readCDROMSectorData(void *data, int length) {
+	_transferData(data, length);
+}
+
+uint8_t getCDROMDriveStatus(void) {
+	return _driveStatus;
+}
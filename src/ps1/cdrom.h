@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define DEF(type) static inline type __attribute__((always_inline))
@@ -208,3 +209,130 @@ typedef enum {
 } CDROMModeFlag;
 
 #undef DEF
+
+/* Driver API */
+
+// The response FIFO can hold up to 16 bytes, although no command currently
+// returns more than 10.
+#define CDROM_MAX_PARAMS   8
+#define CDROM_MAX_RESPONSE 16
+
+typedef enum {
+	CDROM_PENDING  = 0,
+	CDROM_OK       = 1,
+	CDROM_ERROR    = 2, // Drive returned an error (see response[1])
+	CDROM_DATA_END = 3  // End of disc or track reached while reading
+} CDROMStatus;
+
+typedef struct CDROMRequest CDROMRequest;
+typedef void (*CDROMCallback)(CDROMRequest *request);
+typedef void *(*CDROMBufferCallback)(CDROMRequest *request, int index);
+typedef void (*CDROMSectorCallback)(void *arg);
+
+struct CDROMRequest {
+	CDROMRequest *next;
+
+	// These fields must be filled in before queueing the request. The LBA,
+	// count and data fields are only used by CDROM_CMD_READ_N and
+	// CDROM_CMD_READ_S: the driver seeks to the given LBA, transfers the given
+	// number of sectors to the data buffer (which must be 4-byte aligned and
+	// large enough to hold them all) and pauses the drive once done. If count
+	// is zero, the request is completed as soon as reading starts and the
+	// drive is left running, e.g. to play back XA-ADPCM audio.
+	uint8_t  command, paramLength;
+	uint8_t  params[CDROM_MAX_PARAMS];
+	uint32_t lba;
+	uint16_t count;
+	void     *data;
+
+	// Optional function called from the interrupt handler before each sector
+	// is transferred, returning the address it shall be placed at. If set,
+	// the data field is ignored and sectors can be scattered across memory.
+	CDROMBufferCallback getBuffer;
+
+	// Optional function called once the request has completed (or failed),
+	// usually from the interrupt handler, plus an arbitrary argument for it.
+	CDROMCallback callback;
+	void          *arg;
+
+	// These fields are updated by the driver. The response is the last one
+	// returned by the drive for the command itself (i.e. the second response
+	// for commands that have one); the number of completed sectors is valid
+	// even if the request failed partway through.
+	volatile uint8_t  status;
+	uint8_t           responseLength;
+	uint8_t           response[CDROM_MAX_RESPONSE];
+	volatile uint16_t completed;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Resets the CD-ROM controller's interrupt and parameter state, enables
+ * its DMA channel and unmasks the CD-ROM IRQ. installExceptionHandler() must
+ * have been called prior to this, and handleCDROMInterrupts() must be called
+ * from the interrupt handler.
+ */
+void initCDROM(void);
+
+/**
+ * @brief Interrupt handler for the driver. Checks for and acknowledges the
+ * CD-ROM IRQ, transferring data sectors to their destination and advancing the
+ * state of the current request.
+ */
+void handleCDROMInterrupts(void);
+
+/**
+ * @brief Appends a request to the queue and sends its command immediately if
+ * the drive is idle. The request structure as well as its data buffer must
+ * remain valid until its status is no longer CDROM_PENDING. Can be called from
+ * an interrupt handler (including from a request's callback).
+ *
+ * @param request
+ */
+void queueCDROMRequest(CDROMRequest *request);
+
+/**
+ * @brief Returns whether any request is currently in progress or queued.
+ */
+bool isCDROMBusy(void);
+
+/**
+ * @brief Sets a function to be called from the interrupt handler whenever a
+ * sector is read outside of a request, i.e. after a read request with a count
+ * of zero has left the drive running. The function may pull any part of the
+ * sector using readCDROMSectorData() and shall not block; any data it does not
+ * read is discarded. Requests queued by the callback are started once the
+ * sector's interrupt has been acknowledged. Pass a null pointer to go back to
+ * ignoring such sectors.
+ *
+ * @param callback
+ * @param arg
+ */
+void setCDROMSectorCallback(CDROMSectorCallback callback, void *arg);
+
+/**
+ * @brief Reads the next length bytes of the current sector into the given
+ * buffer. Can only be called from a sector callback. If the buffer is 4-byte
+ * aligned and the length is a multiple of 4 the data is transferred using DMA,
+ * otherwise it is read byte by byte; small reads (such as the XA subheader)
+ * can thus be used to inspect a sector before deciding whether to transfer the
+ * rest of it.
+ *
+ * @param data
+ * @param length
+ */
+void readCDROMSectorData(void *data, int length);
+
+/**
+ * @brief Returns the most recent status byte reported by the drive (a
+ * combination of CDROMCommandStatusFlag values), including those sent in
+ * responses not associated with any request.
+ */
+uint8_t getCDROMDriveStatus(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,276 @@
+# ps1-bare-metal - (C) 2023-2025 spicyjpeg
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+.set noreorder
+.set noat
+
+# This file contains a minimal exception handler, which switches to a dedicated
+# stack, saves all registers that are not preserved across function calls and
+# invokes _handleException() (in system.c) to do the actual work. Registers
+# preserved by the C calling convention ($s0-$s7, $gp, $fp) do not need to be
+# saved, as the C code will take care of restoring them if it uses them.
+#
+# Interrupt handlers may re-enable interrupts (see setIRQHandler()), so the
+# handler keeps track of how deeply exceptions are nested. The first exception
+# switches to the top of the exception stack, while nested ones allocate their
+# frame right below the interrupted handler's stack pointer. GTE registers are
+# not saved here, as most handlers never touch the GTE; the dispatcher in
+# system.c saves them using _saveGTEContext() only before calling a handler
+# that has asked for it.
+
+.set EXCEPTION_STACK_SIZE, 0x1000
+
+.set COP0_CAUSE, $13
+.set COP0_EPC,   $14
+
+# The first 16 bytes of the frame are reserved for _handleException() to spill
+# its arguments into, as required by the MIPS calling convention.
+.set FRAME_AT,   0x10
+.set FRAME_V0,   0x14
+.set FRAME_V1,   0x18
+.set FRAME_A0,   0x1c
+.set FRAME_A1,   0x20
+.set FRAME_A2,   0x24
+.set FRAME_A3,   0x28
+.set FRAME_T0,   0x2c
+.set FRAME_T1,   0x30
+.set FRAME_T2,   0x34
+.set FRAME_T3,   0x38
+.set FRAME_T4,   0x3c
+.set FRAME_T5,   0x40
+.set FRAME_T6,   0x44
+.set FRAME_T7,   0x48
+.set FRAME_T8,   0x4c
+.set FRAME_T9,   0x50
+.set FRAME_RA,   0x54
+.set FRAME_HI,   0x58
+.set FRAME_LO,   0x5c
+.set FRAME_SP,   0x60
+.set FRAME_SIZE, 0x68
+
+.set GTE_CONTEXT_DATA,    0x00
+.set GTE_CONTEXT_CONTROL, 0x80
+
+.section .text._exceptionVector, "ax", @progbits
+.global _exceptionVector
+.type _exceptionVector, @function
+
+_exceptionVector:
+	# This stub is copied by installExceptionHandler() to the location the CPU
+	# jumps to when an exception occurs (0x80000080). There are only a few
+	# bytes available there, so all it does is jumping to the actual handler.
+	# $k0 and $k1 are reserved for use by exception handlers and can be freely
+	# overwritten.
+	lui   $k0, %hi(_exceptionHandler)
+	addiu $k0, %lo(_exceptionHandler)
+	jr    $k0
+	nop
+
+.section .text._exceptionHandler, "ax", @progbits
+.type _exceptionHandler, @function
+
+_exceptionHandler:
+	# If a timer was selected using setInterruptTimer(), sample it before doing
+	# anything else so that the measured latency includes the time taken to
+	# save registers. $k0 and $k1 are the only registers available at this
+	# point and are both needed to allocate the frame, so the value is kept in
+	# memory until it can be passed to _handleException(). A nested exception
+	# can't overwrite it in the meantime, as interrupts are disabled until the
+	# dispatcher re-enables them.
+	lui   $k1, %hi(_interruptTimer)
+	lw    $k0, %lo(_interruptTimer)($k1)
+	nop
+	beqz  $k0, .LtimerSampled
+	lui   $k1, %hi(_exceptionEntryTime)
+	lhu   $k0, 0($k0)
+	nop
+
+.LtimerSampled:
+	sw    $k0, %lo(_exceptionEntryTime)($k1)
+
+	# Increment the nesting depth. If this is not a nested exception, allocate
+	# a frame at the top of the exception stack; using a separate stack means
+	# the handler works even if the interrupted code's stack is almost full (or
+	# not set up at all). A nested exception can only interrupt a handler,
+	# which is already running on the exception stack, so its frame is simply
+	# allocated below the current stack pointer (in the branch's delay slot).
+	lui   $k0, %hi(_exceptionDepth)
+	lw    $k1, %lo(_exceptionDepth)($k0)
+	nop
+	addiu $k1, 1
+	sw    $k1, %lo(_exceptionDepth)($k0)
+	addiu $k1, -1
+	bnez  $k1, .LframeAllocated
+	addiu $k0, $sp, -FRAME_SIZE
+
+	lui   $k0, %hi(_exceptionStack + EXCEPTION_STACK_SIZE - FRAME_SIZE)
+	addiu $k0, %lo(_exceptionStack + EXCEPTION_STACK_SIZE - FRAME_SIZE)
+
+.LframeAllocated:
+	# Save the current stack pointer into the frame.
+	sw    $sp, FRAME_SP($k0)
+	move  $sp, $k0
+
+	sw    $at, FRAME_AT($sp)
+	sw    $v0, FRAME_V0($sp)
+	sw    $v1, FRAME_V1($sp)
+	sw    $a0, FRAME_A0($sp)
+	sw    $a1, FRAME_A1($sp)
+	sw    $a2, FRAME_A2($sp)
+	sw    $a3, FRAME_A3($sp)
+	sw    $t0, FRAME_T0($sp)
+	sw    $t1, FRAME_T1($sp)
+	sw    $t2, FRAME_T2($sp)
+	sw    $t3, FRAME_T3($sp)
+	sw    $t4, FRAME_T4($sp)
+	sw    $t5, FRAME_T5($sp)
+	sw    $t6, FRAME_T6($sp)
+	sw    $t7, FRAME_T7($sp)
+	sw    $t8, FRAME_T8($sp)
+	sw    $t9, FRAME_T9($sp)
+	sw    $ra, FRAME_RA($sp)
+
+	mfhi  $v0
+	mflo  $v1
+	sw    $v0, FRAME_HI($sp)
+	sw    $v1, FRAME_LO($sp)
+
+	# epc = _handleException(cause, epc, entryTime);
+	lui   $a2, %hi(_exceptionEntryTime)
+	lw    $a2, %lo(_exceptionEntryTime)($a2)
+	mfc0  $a0, COP0_CAUSE
+	mfc0  $a1, COP0_EPC
+	jal   _handleException
+	nop
+
+	# Keep the returned address in $k1, which is not going to be modified by
+	# anything else until the handler returns, as _handleException() always
+	# returns with interrupts disabled. The nesting depth can then be
+	# decremented using $v0, which is restored afterwards.
+	move  $k1, $v0
+
+	lui   $k0, %hi(_exceptionDepth)
+	lw    $v0, %lo(_exceptionDepth)($k0)
+	nop
+	addiu $v0, -1
+	sw    $v0, %lo(_exceptionDepth)($k0)
+
+	lw    $v0, FRAME_HI($sp)
+	lw    $v1, FRAME_LO($sp)
+	mthi  $v0
+	mtlo  $v1
+
+	lw    $at, FRAME_AT($sp)
+	lw    $v0, FRAME_V0($sp)
+	lw    $v1, FRAME_V1($sp)
+	lw    $a0, FRAME_A0($sp)
+	lw    $a1, FRAME_A1($sp)
+	lw    $a2, FRAME_A2($sp)
+	lw    $a3, FRAME_A3($sp)
+	lw    $t0, FRAME_T0($sp)
+	lw    $t1, FRAME_T1($sp)
+	lw    $t2, FRAME_T2($sp)
+	lw    $t3, FRAME_T3($sp)
+	lw    $t4, FRAME_T4($sp)
+	lw    $t5, FRAME_T5($sp)
+	lw    $t6, FRAME_T6($sp)
+	lw    $t7, FRAME_T7($sp)
+	lw    $t8, FRAME_T8($sp)
+	lw    $t9, FRAME_T9($sp)
+	lw    $ra, FRAME_RA($sp)
+	lw    $sp, FRAME_SP($sp)
+
+	# Return to the interrupted code. The rfe instruction, placed in the jump's
+	# delay slot, restores the interrupt enable and privilege level flags the
+	# CPU had prior to the exception.
+	jr    $k1
+	rfe
+
+# These functions save and restore all GTE registers to and from a GTEContext
+# structure (defined in system.c). Reading a GTE register stalls the CPU until
+# any command in progress has completed. Some data registers can't be restored
+# by writing them back directly: SXYP (15) pushes a new entry into the screen
+# coordinate FIFO, IRGB (28) overwrites IR1-IR3, while ORGB (29) and LZCR (31)
+# are read-only and computed from other registers. These are skipped, as their
+# values are restored through the registers they mirror.
+
+.section .text._saveGTEContext, "ax", @progbits
+.global _saveGTEContext
+.type _saveGTEContext, @function
+
+_saveGTEContext:
+	.irp reg, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15
+	mfc2  $t0, $\reg
+	cfc2  $t1, $\reg
+	sw    $t0, (GTE_CONTEXT_DATA    + \reg * 4)($a0)
+	sw    $t1, (GTE_CONTEXT_CONTROL + \reg * 4)($a0)
+	.endr
+	.irp reg, 16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+	mfc2  $t0, $\reg
+	cfc2  $t1, $\reg
+	sw    $t0, (GTE_CONTEXT_DATA    + \reg * 4)($a0)
+	sw    $t1, (GTE_CONTEXT_CONTROL + \reg * 4)($a0)
+	.endr
+
+	jr    $ra
+	nop
+
+.section .text._restoreGTEContext, "ax", @progbits
+.global _restoreGTEContext
+.type _restoreGTEContext, @function
+
+_restoreGTEContext:
+	.irp reg, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14
+	lw    $t0, (GTE_CONTEXT_DATA + \reg * 4)($a0)
+	nop
+	mtc2  $t0, $\reg
+	.endr
+	.irp reg, 16,17,18,19,20,21,22,23,24,25,26,27,30
+	lw    $t0, (GTE_CONTEXT_DATA + \reg * 4)($a0)
+	nop
+	mtc2  $t0, $\reg
+	.endr
+
+	.irp reg, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15
+	lw    $t0, (GTE_CONTEXT_CONTROL + \reg * 4)($a0)
+	nop
+	ctc2  $t0, $\reg
+	.endr
+	.irp reg, 16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+	lw    $t0, (GTE_CONTEXT_CONTROL + \reg * 4)($a0)
+	nop
+	ctc2  $t0, $\reg
+	.endr
+
+	jr    $ra
+	nop
+
+.section .bss._exceptionStack, "aw", @nobits
+.balign 8
+
+_exceptionStack:
+	.space EXCEPTION_STACK_SIZE
+
+.section .bss._exceptionDepth, "aw", @nobits
+.global _exceptionDepth
+.balign 4
+
+_exceptionDepth:
+	.space 4
+
+.section .bss._exceptionEntryTime, "aw", @nobits
+.balign 4
+
+_exceptionEntryTime:
+	.space 4
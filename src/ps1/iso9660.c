@@ -0,0 +1,363 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * An ISO9660 filesystem is laid out as a tree of directories, each of which is
+ * a list of variable-length records stored in one or more sectors. Looking up
+ * a path the naive way requires reading one directory per path component, and
+ * as every read on a real drive may involve a seek taking 100 milliseconds or
+ * more, doing so for every file loaded quickly adds up. Instead, this module
+ * walks the whole tree once when the disc is mounted and stores the location
+ * of every file in a hash table indexed by a hash of its full path, so that
+ * any path can then be resolved without accessing the disc at all.
+ *
+ * Directory records are laid out as follows (all multi-byte fields are stored
+ * in both little and big endian, only the former is used here):
+ *
+ *   Offset  Length  Field
+ *        0       1  Record length (0 = no more records in this sector)
+ *        2       8  LBA of the file's first sector
+ *       10       8  File length in bytes
+ *       25       1  Flags (bit 1 = directory)
+ *       32       1  Name length
+ *       33       N  Name ("\0" for the directory itself, "\1" for its parent)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/cdrom.h"
+#include "ps1/iso9660.h"
+
+#define PVD_ROOT_RECORD_OFFSET 156
+
+#define RECORD_LBA_OFFSET          2
+#define RECORD_LENGTH_OFFSET      10
+#define RECORD_FLAGS_OFFSET       25
+#define RECORD_NAME_LENGTH_OFFSET 32
+#define RECORD_NAME_OFFSET        33
+#define RECORD_FLAG_DIRECTORY     (1 << 1)
+
+// 32-bit FNV-1a hash parameters. FNV-1a is trivial to compute incrementally,
+// so the hash of a file's path can be derived from the hash of its parent
+// directory's path.
+#define FNV_BASIS 0x811c9dc5
+#define FNV_PRIME 0x01000193
+
+typedef enum {
+	STEP_SETMODE   = 0,
+	STEP_PVD       = 1,
+	STEP_DIRECTORY = 2
+} MountStep;
+
+/* Path hashing */
+
+static uint32_t _hashChar(uint32_t hash, char ch) {
+	if ((ch >= 'a') && (ch <= 'z'))
+		ch += 'A' - 'a';
+
+	return (hash ^ (uint8_t) ch) * FNV_PRIME;
+}
+
+static int _trimName(const char *name, int length) {
+	// Strip the version number, as well as the trailing period ISO9660 adds to
+	// names without an extension.
+	for (int i = 0; i < length; i++) {
+		if (name[i] == ';') {
+			length = i;
+			break;
+		}
+	}
+
+	while (length && (name[length - 1] == '.'))
+		length--;
+
+	return length;
+}
+
+static uint32_t _hashComponent(uint32_t hash, const char *name, int length) {
+	length = _trimName(name, length);
+	hash   = _hashChar(hash, '/');
+
+	for (int i = 0; i < length; i++)
+		hash = _hashChar(hash, name[i]);
+
+	return hash;
+}
+
+/* Index management */
+
+static ISO9660Status _addEntry(
+	ISO9660FS *fs,
+	uint32_t  hash,
+	uint32_t  lba,
+	uint32_t  length,
+	int       flags
+) {
+	// The hash value zero is reserved for empty slots. At least one slot must
+	// be kept empty, as lookups stop at the first empty slot they find.
+	if (!hash)
+		return ISO9660_HASH_COLLISION;
+
+	int mask = fs->tableSize - 1;
+
+	if (fs->numEntries >= mask)
+		return ISO9660_INDEX_FULL;
+
+	for (int i = hash & mask;; i = (i + 1) & mask) {
+		ISO9660Entry *entry = &fs->entries[i];
+
+		if (entry->hash == hash)
+			return ISO9660_HASH_COLLISION;
+		if (entry->hash)
+			continue;
+
+		entry->hash   = hash;
+		entry->lba    = lba;
+		entry->flags  = flags;
+		entry->length = length;
+
+		fs->numEntries++;
+		return ISO9660_OK;
+	}
+}
+
+static uint32_t _readLE32(const uint8_t *ptr) {
+	return 0
+		| (ptr[0] <<  0)
+		| (ptr[1] <<  8)
+		| (ptr[2] << 16)
+		| (ptr[3] << 24);
+}
+
+static ISO9660Status _parseDirectorySector(ISO9660FS *fs) {
+	const uint8_t *sector = fs->sector;
+	uint32_t      parent  = fs->directory->hash;
+
+	// Records never cross sector boundaries; the rest of the sector is padded
+	// with zeroes after the last record.
+	for (int offset = 0; offset < ISO9660_SECTOR_SIZE;) {
+		const uint8_t *record = &sector[offset];
+		int           length  = record[0];
+
+		if (!length || ((offset + length) > ISO9660_SECTOR_SIZE))
+			break;
+
+		offset += length;
+
+		const char *name      = (const char *) &record[RECORD_NAME_OFFSET];
+		int        nameLength = record[RECORD_NAME_LENGTH_OFFSET];
+
+		if ((nameLength == 1) && ((name[0] == 0) || (name[0] == 1)))
+			continue;
+
+		ISO9660Status status = _addEntry(
+			fs,
+			_hashComponent(parent, name, nameLength),
+			_readLE32(&record[RECORD_LBA_OFFSET]),
+			_readLE32(&record[RECORD_LENGTH_OFFSET]),
+			(record[RECORD_FLAGS_OFFSET] & RECORD_FLAG_DIRECTORY)
+				? ISO9660_ENTRY_DIRECTORY
+				: 0
+		);
+
+		if (status != ISO9660_OK)
+			return status;
+	}
+
+	return ISO9660_OK;
+}
+
+/* Mount state machine */
+
+static void _finish(ISO9660FS *fs, ISO9660Status status) {
+	fs->status = status;
+
+	if (fs->callback)
+		fs->callback(fs);
+}
+
+static void _readSector(ISO9660FS *fs, uint32_t lba) {
+	CDROMRequest *request = &fs->request;
+
+	request->command     = CDROM_CMD_READ_N;
+	request->paramLength = 0;
+	request->lba         = lba;
+	request->count       = 1;
+	request->data        = fs->sector;
+	request->getBuffer   = 0;
+	queueCDROMRequest(request);
+}
+
+static void _scanNextDirectory(ISO9660FS *fs) {
+	// Directories are added to the table as they are found and scanned in
+	// whatever order they happen to be stored in it. Looking for the next one
+	// is much cheaper than reading a sector, so a separate queue is not worth
+	// the extra memory.
+	for (int i = 0; i < fs->tableSize; i++) {
+		ISO9660Entry *entry = &fs->entries[i];
+
+		if (!entry->hash)
+			continue;
+		if (!(entry->flags & ISO9660_ENTRY_DIRECTORY))
+			continue;
+		if (entry->flags & ISO9660_ENTRY_SCANNED)
+			continue;
+
+		fs->directory   = entry;
+		fs->sectorIndex = 0;
+		fs->step        = STEP_DIRECTORY;
+		_readSector(fs, entry->lba);
+		return;
+	}
+
+	_finish(fs, ISO9660_OK);
+}
+
+static void _requestCallback(CDROMRequest *request) {
+	ISO9660FS     *fs = (ISO9660FS *) request->arg;
+	ISO9660Status status;
+
+	if (request->status != CDROM_OK) {
+		_finish(fs, ISO9660_DRIVE_ERROR);
+		return;
+	}
+
+	switch (fs->step) {
+		case STEP_SETMODE:
+			fs->step = STEP_PVD;
+			_readSector(fs, ISO9660_PVD_LBA);
+			break;
+
+		case STEP_PVD:
+			if (
+				(fs->sector[0] != 1) ||
+				memcmp(&fs->sector[1], "CD001", 5)
+			) {
+				_finish(fs, ISO9660_NOT_ISO9660);
+				return;
+			}
+
+			const uint8_t *root = &fs->sector[PVD_ROOT_RECORD_OFFSET];
+
+			status = _addEntry(
+				fs,
+				FNV_BASIS,
+				_readLE32(&root[RECORD_LBA_OFFSET]),
+				_readLE32(&root[RECORD_LENGTH_OFFSET]),
+				ISO9660_ENTRY_DIRECTORY
+			);
+
+			if (status != ISO9660_OK) {
+				_finish(fs, status);
+				return;
+			}
+
+			_scanNextDirectory(fs);
+			break;
+
+		case STEP_DIRECTORY:
+			status = _parseDirectorySector(fs);
+
+			if (status != ISO9660_OK) {
+				_finish(fs, status);
+				return;
+			}
+
+			ISO9660Entry *directory = fs->directory;
+
+			fs->sectorIndex++;
+
+			if ((fs->sectorIndex * ISO9660_SECTOR_SIZE) < directory->length) {
+				_readSector(fs, directory->lba + fs->sectorIndex);
+				return;
+			}
+
+			directory->flags |= ISO9660_ENTRY_SCANNED;
+			_scanNextDirectory(fs);
+			break;
+	}
+}
+
+/* Public API */
+
+void mountISO9660(
+	ISO9660FS       *fs,
+	ISO9660Entry    *entries,
+	int             tableSize,
+	ISO9660Callback callback,
+	void            *arg
+) {
+	fs->entries    = entries;
+	fs->tableSize  = tableSize;
+	fs->numEntries = 0;
+	fs->status     = ISO9660_PENDING;
+	fs->callback   = callback;
+	fs->arg        = arg;
+	fs->step       = STEP_SETMODE;
+
+	memset(entries, 0, tableSize * sizeof(ISO9660Entry));
+
+	CDROMRequest *request = &fs->request;
+
+	request->command     = CDROM_CMD_SETMODE;
+	request->paramLength = 1;
+	request->params[0]   = CDROM_MODE_SPEED_2X | CDROM_MODE_SIZE_2048;
+	request->callback    = &_requestCallback;
+	request->arg         = fs;
+	queueCDROMRequest(request);
+}
+
+bool isISO9660Busy(const ISO9660FS *fs) {
+	return (fs->status == ISO9660_PENDING);
+}
+
+uint32_t hashISO9660Path(const char *path) {
+	uint32_t hash = FNV_BASIS;
+
+	for (;;) {
+		while ((*path == '/') || (*path == '\\'))
+			path++;
+
+		if (!*path)
+			return hash;
+
+		const char *end = path;
+
+		while (*end && (*end != '/') && (*end != '\\'))
+			end++;
+
+		hash = _hashComponent(hash, path, end - path);
+		path = end;
+	}
+}
+
+const ISO9660Entry *findISO9660File(const ISO9660FS *fs, const char *path) {
+	uint32_t hash = hashISO9660Path(path);
+	int      mask = fs->tableSize - 1;
+
+	if (!hash || (fs->status != ISO9660_OK))
+		return 0;
+
+	for (int i = hash & mask;; i = (i + 1) & mask) {
+		const ISO9660Entry *entry = &fs->entries[i];
+
+		if (entry->hash == hash)
+			return entry;
+		if (!entry->hash)
+			return 0;
+	}
+}
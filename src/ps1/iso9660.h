@@ -0,0 +1,130 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+
+#define ISO9660_SECTOR_SIZE 2048
+#define ISO9660_PVD_LBA     16
+
+typedef enum {
+	ISO9660_PENDING        = 0,
+	ISO9660_OK             = 1,
+	ISO9660_DRIVE_ERROR    = 2, // CD-ROM request failed (no disc, read error)
+	ISO9660_NOT_ISO9660    = 3, // Primary volume descriptor missing or invalid
+	ISO9660_INDEX_FULL     = 4, // More files and directories than index slots
+	ISO9660_HASH_COLLISION = 5  // Two paths on the disc have the same hash
+} ISO9660Status;
+
+typedef enum {
+	ISO9660_ENTRY_DIRECTORY = 1 << 0,
+	ISO9660_ENTRY_SCANNED   = 1 << 1  // Directory contents already indexed
+} ISO9660EntryFlag;
+
+// Each file or directory on the disc is identified in the index by a 32-bit
+// hash of its full path rather than by its name, keeping entries down to 12
+// bytes. An entry whose hash is zero is unused.
+typedef struct {
+	uint32_t hash;
+	uint32_t lba : 24, flags : 8;
+	uint32_t length;
+} ISO9660Entry;
+
+typedef struct ISO9660FS ISO9660FS;
+typedef void (*ISO9660Callback)(ISO9660FS *fs);
+
+struct ISO9660FS {
+	// Open addressing hash table provided by the caller, whose size must be a
+	// power of two.
+	ISO9660Entry *entries;
+	int          tableSize, numEntries;
+
+	// Result of the last mount, ISO9660_PENDING while it is in progress.
+	volatile uint8_t status;
+
+	// Internal state of the mount operation.
+	ISO9660Callback callback;
+	void            *arg;
+	CDROMRequest    request;
+	uint8_t         step;
+	ISO9660Entry    *directory;
+	uint32_t        sectorIndex;
+	uint8_t         sector[ISO9660_SECTOR_SIZE] __attribute__((aligned(4)));
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reads the primary volume descriptor and walks the entire directory
+ * tree of the disc, filling the given table with an entry for each file and
+ * directory. The table should have at least twice as many slots as there are
+ * files and directories on the disc to keep lookups fast. Once the operation
+ * has completed successfully, files can be looked up with findISO9660File()
+ * without accessing the disc.
+ *
+ * The drive is switched to double speed and 2048-byte sectors before reading.
+ * initCDROM() must have been called prior to this. The callback is invoked
+ * once the operation has completed or failed, usually from the interrupt
+ * handler.
+ *
+ * @param fs
+ * @param entries
+ * @param tableSize Number of entries in the table (must be a power of two)
+ * @param callback Optional
+ * @param arg
+ */
+void mountISO9660(
+	ISO9660FS       *fs,
+	ISO9660Entry    *entries,
+	int             tableSize,
+	ISO9660Callback callback,
+	void            *arg
+);
+
+/**
+ * @brief Returns whether the filesystem is currently being mounted.
+ */
+bool isISO9660Busy(const ISO9660FS *fs);
+
+/**
+ * @brief Calculates the hash used to identify a path in the index. Paths are
+ * case-insensitive, may use either forward slashes or backslashes as
+ * separators and may optionally start with a separator and end with a version
+ * number (";1").
+ *
+ * @param path
+ * @return Hash of the normalized path
+ */
+uint32_t hashISO9660Path(const char *path);
+
+/**
+ * @brief Looks up a file or directory in the index built by mountISO9660(),
+ * without accessing the disc.
+ *
+ * @param fs
+ * @param path
+ * @return Pointer to the entry, or a null pointer if not found
+ */
+const ISO9660Entry *findISO9660File(const ISO9660FS *fs, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
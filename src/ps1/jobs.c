@@ -0,0 +1,217 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * The PS1 has several units that work independently of the CPU once a
+ * transfer has been started (the GPU, MDEC, SPU and CD-ROM drive, each with
+ * its own DMA channel), but code is usually written as a sequence of steps
+ * that busy-waits for each transfer to finish before moving on. This small
+ * scheduler instead lets each frame's work be split into jobs, each of which
+ * declares the jobs it depends on, the devices that must be idle before it
+ * can run and optionally an arbitrary condition. Whenever a job is waiting for
+ * hardware, the scheduler runs any other job that is ready in the meantime,
+ * so that CPU work overlaps with transfers and rendering.
+ *
+ * Jobs always run to completion and are never preempted. To show where the
+ * CPU time goes, the scheduler records a timeline of which job ran when and
+ * for how long the CPU was left idle, measured in scanlines using timer 1.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+#include "ps1/jobs.h"
+#include "ps1/mdec.h"
+#include "ps1/registers.h"
+#include "ps1/spu.h"
+
+/* Device and dependency checks */
+
+bool areJobDevicesIdle(uint32_t devices) {
+	if (devices & JOB_DEVICE_GPU) {
+		if (DMA_CHCR(DMA_GPU) & DMA_CHCR_ENABLE)
+			return false;
+		if (!(GPU_GP1 & GP1_STAT_CMD_READY))
+			return false;
+	}
+	if ((devices & JOB_DEVICE_MDEC_IN) && isMDECFeeding())
+		return false;
+	if ((devices & JOB_DEVICE_MDEC_OUT) && isMDECReceiving())
+		return false;
+	if ((devices & JOB_DEVICE_SPU) && isSPUTransferBusy())
+		return false;
+	if ((devices & JOB_DEVICE_CDROM) && isCDROMBusy())
+		return false;
+	if (devices & JOB_DEVICE_OTC) {
+		if (DMA_CHCR(DMA_OTC) & DMA_CHCR_ENABLE)
+			return false;
+	}
+
+	return true;
+}
+
+static bool _isJobReady(const Job *job) {
+	for (int i = 0; i < JOB_MAX_DEPENDENCIES; i++) {
+		const Job *dependency = job->dependencies[i];
+
+		if (dependency && (dependency->state != JOB_DONE))
+			return false;
+	}
+
+	// Devices are only checked once all dependencies have completed, as a
+	// job usually waits for a transfer started by one of them.
+	if (!areJobDevicesIdle(job->devices))
+		return false;
+	if (job->condition && !job->condition(job->conditionArg))
+		return false;
+
+	return true;
+}
+
+/* Timeline */
+
+static uint16_t _getTime(const JobQueue *queue) {
+	return TIMER_VALUE(1) - queue->frameStart;
+}
+
+static void _addTimelineEntry(
+	JobQueue   *queue,
+	const char *name,
+	uint16_t   start,
+	uint16_t   end
+) {
+	if (name)
+		queue->busyTime += end - start;
+	else
+		queue->idleTime += end - start;
+
+	if (queue->numEntries >= queue->maxEntries)
+		return;
+
+	JobTimelineEntry *entry = &(queue->timeline)[queue->numEntries];
+
+	// Merge consecutive idle periods into a single entry.
+	if (queue->numEntries && !name && !entry[-1].name) {
+		entry[-1].end = end;
+		return;
+	}
+
+	queue->numEntries++;
+
+	entry->name  = name;
+	entry->start = start;
+	entry->end   = end;
+}
+
+/* Scheduler */
+
+static Job *_takeReadyJob(JobQueue *queue) {
+	Job *previous = 0;
+
+	for (Job *job = queue->head; job; previous = job, job = job->next) {
+		if (!_isJobReady(job))
+			continue;
+
+		if (previous)
+			previous->next = job->next;
+		else
+			queue->head    = job->next;
+
+		if (queue->tail == job)
+			queue->tail = previous;
+
+		job->next = 0;
+		return job;
+	}
+
+	return 0;
+}
+
+static void _runJob(JobQueue *queue, Job *job) {
+	uint16_t start = _getTime(queue);
+
+	job->func(job->arg);
+	job->state = JOB_DONE;
+
+	_addTimelineEntry(queue, job->name, start, _getTime(queue));
+}
+
+void initJobQueue(JobQueue *queue, JobTimelineEntry *timeline, int maxEntries) {
+	queue->timeline   = timeline;
+	queue->maxEntries = maxEntries;
+	queue->head       = 0;
+	queue->tail       = 0;
+
+	TIMER_CTRL(1) = TIMER_CTRL_EXT_CLOCK;
+
+	beginJobFrame(queue);
+}
+
+void beginJobFrame(JobQueue *queue) {
+	queue->numEntries = 0;
+	queue->busyTime   = 0;
+	queue->idleTime   = 0;
+	queue->frameStart = TIMER_VALUE(1);
+}
+
+void submitJob(JobQueue *queue, Job *job) {
+	job->next  = 0;
+	job->state = JOB_PENDING;
+
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head       = job;
+
+	queue->tail = job;
+}
+
+int runReadyJobs(JobQueue *queue) {
+	Job *job;
+
+	while ((job = _takeReadyJob(queue)))
+		_runJob(queue, job);
+
+	int pending = 0;
+
+	for (job = queue->head; job; job = job->next)
+		pending++;
+
+	return pending;
+}
+
+void runJobs(JobQueue *queue) {
+	while (queue->head) {
+		Job *job = _takeReadyJob(queue);
+
+		if (job) {
+			_runJob(queue, job);
+			continue;
+		}
+
+		// Nothing can run until a device finishes its work or a condition
+		// becomes true, so wait for any job to become ready and record the
+		// time spent doing so.
+		uint16_t start = _getTime(queue);
+
+		while (!(job = _takeReadyJob(queue)))
+			__asm__ volatile("");
+
+		_addTimelineEntry(queue, 0, start, _getTime(queue));
+		_runJob(queue, job);
+	}
+}
@@ -0,0 +1,152 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JOB_MAX_DEPENDENCIES 4
+
+// Devices a job can wait for. A job only runs once all the devices it depends
+// on are idle, which is usually used to make sure a transfer started by a
+// previous job has completed.
+typedef enum {
+	JOB_DEVICE_GPU      = 1 << 0, // GPU DMA idle and GPU ready for commands
+	JOB_DEVICE_MDEC_IN  = 1 << 1, // MDEC input DMA channel idle
+	JOB_DEVICE_MDEC_OUT = 1 << 2, // MDEC output DMA channel idle
+	JOB_DEVICE_SPU      = 1 << 3, // SPU DMA transfer completed
+	JOB_DEVICE_CDROM    = 1 << 4, // No CD-ROM request in progress
+	JOB_DEVICE_OTC      = 1 << 5  // Ordering table clear DMA channel idle
+} JobDevice;
+
+typedef enum {
+	JOB_IDLE    = 0,
+	JOB_PENDING = 1,
+	JOB_DONE    = 2
+} JobState;
+
+typedef struct Job Job;
+typedef void (*JobFunction)(void *arg);
+typedef bool (*JobCondition)(void *arg);
+
+struct Job {
+	Job *next;
+
+	// These fields must be filled in before submitting the job. Dependencies
+	// are other jobs that must have completed first, and must have been
+	// submitted before this one; unused slots must be null pointers. The
+	// condition is an optional function the scheduler polls until it returns
+	// true, e.g. to check whether a CD-ROM read has completed.
+	const char   *name;
+	JobFunction  func;
+	void         *arg;
+	uint32_t     devices;
+	Job          *dependencies[JOB_MAX_DEPENDENCIES];
+	JobCondition condition;
+	void         *conditionArg;
+
+	// Updated by the scheduler.
+	volatile uint8_t state;
+};
+
+typedef struct {
+	// Name of the job that ran during this period, or a null pointer if the
+	// CPU was idle waiting for a job to become ready. Times are in scanlines
+	// since the call to beginJobFrame().
+	const char *name;
+	uint16_t   start, end;
+} JobTimelineEntry;
+
+typedef struct {
+	// Timeline buffer provided by the caller, filled in by the scheduler as
+	// jobs run. Once full, further periods are only counted in the totals.
+	JobTimelineEntry *timeline;
+	int              maxEntries, numEntries;
+
+	// Total time spent running jobs and waiting for them since the last call
+	// to beginJobFrame(), in scanlines.
+	uint16_t busyTime, idleTime;
+
+	// Internal state.
+	Job      *head, *tail;
+	uint16_t frameStart;
+} JobQueue;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a job queue using the given timeline buffer. Timer 1 is
+ * set up to count horizontal blanking periods, which are used as the time unit
+ * for the timeline (one scanline is about 64 microseconds).
+ *
+ * @param queue
+ * @param timeline
+ * @param maxEntries
+ */
+void initJobQueue(JobQueue *queue, JobTimelineEntry *timeline, int maxEntries);
+
+/**
+ * @brief Clears the timeline and totals and marks the current time as the
+ * beginning of a new frame. Should be called once per frame, right after
+ * waiting for vertical blank.
+ *
+ * @param queue
+ */
+void beginJobFrame(JobQueue *queue);
+
+/**
+ * @brief Adds a job to the end of the queue. Jobs are picked in the order they
+ * were submitted among those that are ready to run. A job must not be
+ * submitted again until it has completed.
+ *
+ * @param queue
+ * @param job
+ */
+void submitJob(JobQueue *queue, Job *job);
+
+/**
+ * @brief Runs jobs that are ready, without waiting for any device or
+ * condition, until no more jobs are ready.
+ *
+ * @param queue
+ * @return Number of jobs still pending in the queue
+ */
+int runReadyJobs(JobQueue *queue);
+
+/**
+ * @brief Runs all jobs in the queue, waiting for devices and conditions as
+ * needed. Time spent waiting is recorded in the timeline as idle periods.
+ * Does not return if a job's condition never becomes true.
+ *
+ * @param queue
+ */
+void runJobs(JobQueue *queue);
+
+/**
+ * @brief Returns whether the given devices (a combination of JobDevice flags)
+ * are all idle.
+ *
+ * @param devices
+ */
+bool areJobDevicesIdle(uint32_t devices);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The MDEC ("motion decoder") is a fixed-function JPEG-like image decompressor,
+ * which takes blocks of quantized DCT coefficients (in run-length encoded form)
+ * and outputs RGB pixel data after performing dequantization, inverse DCT and
+ * color space conversion. Decoding the variable-length bitstream stored on the
+ * disc into run-length codes is left to the CPU.
+ *
+ * Both the MDEC's input and output are connected to dedicated DMA channels,
+ * which are driven by the MDEC's data request signals: once a transfer is
+ * started the DMA controller will move a 32-word chunk whenever the MDEC is
+ * ready to accept or provide one, leaving the CPU free to do other work in
+ * the meantime.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/mdec.h"
+#include "ps1/registers.h"
+#include "ps1/system.h"
+
+#define DICR_CONFIG_BITMASK \
+	(DMA_DICR_CH_MODE_BITMASK | DMA_DICR_CH_ENABLE_BITMASK | DMA_DICR_IRQ_ENABLE)
+
+// MPEG-1 default intra quantization table, in zigzag order. The first entry
+// is the DC coefficient's scale and is not affected by the quantization scale
+// given in each block's first code.
+static const uint8_t _defaultQuantTable[64] = {
+	 2, 16, 16, 19, 16, 19, 22, 22,
+	22, 22, 22, 22, 26, 24, 26, 27,
+	27, 27, 26, 26, 26, 26, 27, 27,
+	27, 29, 29, 29, 34, 34, 34, 29,
+	29, 29, 27, 27, 29, 29, 32, 32,
+	34, 34, 37, 38, 37, 35, 35, 34,
+	35, 38, 38, 40, 40, 40, 48, 48,
+	46, 46, 56, 56, 58, 69, 69, 83
+};
+
+// DCT basis matrix scaled by 2^15 (with the first row scaled by an additional
+// 1/sqrt(2) factor), i.e. 2^15 * cos((2 * x + 1) * y * pi / 16). Values are
+// rounded down rather than towards zero, so that the table matches the one
+// used by the official SDK (whose negative entries are one lower than the
+// respective positive ones).
+static const int16_t _idctTable[64] = {
+	 23170,  23170,  23170,  23170,  23170,  23170,  23170,  23170,
+	 32138,  27245,  18204,   6392,  -6393, -18205, -27246, -32139,
+	 30273,  12539, -12540, -30274, -30274, -12540,  12539,  30273,
+	 27245,  -6393, -32139, -18205,  18204,  32138,   6392, -27246,
+	 23170, -23171, -23171,  23170,  23170, -23171, -23171,  23170,
+	 18204, -32139,   6392,  27245, -27246,  -6393,  32138, -18205,
+	 12539, -30274,  30273, -12540, -12540,  30273, -30274,  12539,
+	  6392, -18205,  27245, -32139,  32138, -27246,  18204,  -6393
+};
+
+/* Command helpers */
+
+static void _waitForIdle(void) {
+	while (MDEC1 & MDEC_STAT_BUSY)
+		__asm__ volatile("");
+}
+
+static void _writeWords(const void *data, int length) {
+	// Tables are small enough to be written by the CPU without bothering with
+	// DMA. The input FIFO must not be written to while full.
+	const uint32_t *ptr = (const uint32_t *) data;
+
+	for (; length > 0; length--) {
+		while (MDEC1 & MDEC_STAT_DATA_FULL)
+			__asm__ volatile("");
+
+		MDEC0 = *(ptr++);
+	}
+}
+
+/* Public API */
+
+void initMDEC(void) {
+	MDEC1 = MDEC_CTRL_RESET;
+	MDEC1 = MDEC_CTRL_DMA_OUT | MDEC_CTRL_DMA_IN;
+
+	DMA_DPCR |= 0
+		| DMA_DPCR_CH_ENABLE(DMA_MDEC_IN)
+		| DMA_DPCR_CH_ENABLE(DMA_MDEC_OUT);
+
+	uploadMDECQuantTables(_defaultQuantTable, _defaultQuantTable);
+
+	_waitForIdle();
+	MDEC0 = MDEC_CMD_OP_SET_IDCT_TABLE;
+	_writeWords(_idctTable, sizeof(_idctTable) / 4);
+}
+
+void uploadMDECQuantTables(const uint8_t *luma, const uint8_t *chroma) {
+	_waitForIdle();
+	MDEC0 = MDEC_CMD_OP_SET_QUANT_TABLE | MDEC_CMD_USE_CHROMA;
+	_writeWords(luma,   64 / 4);
+	_writeWords(chroma, 64 / 4);
+}
+
+void feedMDEC(const uint32_t *data, int length, uint32_t flags) {
+	while (DMA_CHCR(DMA_MDEC_IN) & DMA_CHCR_ENABLE)
+		__asm__ volatile("");
+
+	_waitForIdle();
+	MDEC0 = MDEC_CMD_OP_DECODE | (flags & ~MDEC_CMD_LENGTH_BITMASK) | length;
+
+	DMA_MADR(DMA_MDEC_IN) = (uint32_t) data;
+	DMA_BCR (DMA_MDEC_IN) = MDEC_DMA_CHUNK_SIZE
+		| ((length / MDEC_DMA_CHUNK_SIZE) << 16);
+	DMA_CHCR(DMA_MDEC_IN) = 0
+		| DMA_CHCR_WRITE
+		| DMA_CHCR_MODE_SLICE
+		| DMA_CHCR_ENABLE;
+}
+
+void receiveMDEC(void *data, int length) {
+	waitForMDECOutput();
+
+	DMA_MADR(DMA_MDEC_OUT) = (uint32_t) data;
+	DMA_BCR (DMA_MDEC_OUT) = MDEC_DMA_CHUNK_SIZE
+		| ((length / MDEC_DMA_CHUNK_SIZE) << 16);
+	DMA_CHCR(DMA_MDEC_OUT) = 0
+		| DMA_CHCR_READ
+		| DMA_CHCR_MODE_SLICE
+		| DMA_CHCR_ENABLE;
+}
+
+void setMDECInterrupt(bool enable) {
+	bool     enabled = disableInterrupts();
+	uint32_t dicr    = DMA_DICR & DICR_CONFIG_BITMASK;
+
+	// Writing back the channel status bits as they were read would clear
+	// them, so they are masked out above.
+	if (enable)
+		dicr |= DMA_DICR_CH_ENABLE(DMA_MDEC_OUT) | DMA_DICR_IRQ_ENABLE;
+	else
+		dicr &= ~DMA_DICR_CH_ENABLE(DMA_MDEC_OUT);
+
+	DMA_DICR = dicr;
+
+	if (enable) {
+		IRQ_STAT  = ~(1 << IRQ_DMA);
+		IRQ_MASK |= 1 << IRQ_DMA;
+	}
+	if (enabled)
+		enableInterrupts();
+}
+
+bool acknowledgeMDECInterrupt(void) {
+	if (!(DMA_DICR & DMA_DICR_CH_STAT(DMA_MDEC_OUT)))
+		return false;
+
+	// The DMA IRQ is only raised when the DICR master flag goes from 0 to 1,
+	// so the channel flag must be cleared for the next transfer to raise it
+	// again.
+	acknowledgeInterrupt(IRQ_DMA);
+	DMA_DICR = (DMA_DICR & DICR_CONFIG_BITMASK)
+		| DMA_DICR_CH_STAT(DMA_MDEC_OUT);
+	return true;
+}
+
+bool isMDECFeeding(void) {
+	return (DMA_CHCR(DMA_MDEC_IN) & DMA_CHCR_ENABLE) ? true : false;
+}
+
+bool isMDECReceiving(void) {
+	return (DMA_CHCR(DMA_MDEC_OUT) & DMA_CHCR_ENABLE) ? true : false;
+}
+
+void waitForMDECOutput(void) {
+	while (DMA_CHCR(DMA_MDEC_OUT) & DMA_CHCR_ENABLE)
+		__asm__ volatile("");
+}
@@ -0,0 +1,123 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The MDEC takes a stream of 16-bit run-length codes, one block at a time in
+// Cr, Cb, Y0, Y1, Y2, Y3 order. The first code of each block holds the
+// quantization scale (bits 10-15) and DC coefficient (bits 0-9), all others a
+// number of zero coefficients to skip (bits 10-15) followed by a non-zero
+// coefficient (bits 0-9). Each block is terminated by MDEC_END_OF_BLOCK.
+#define MDEC_END_OF_BLOCK 0xfe00
+
+// Data is transferred in and out of the MDEC in 32-word chunks; all transfer
+// lengths must thus be multiples of this value.
+#define MDEC_DMA_CHUNK_SIZE 32
+
+// Size of a decoded 16x16 macroblock in words.
+#define MDEC_MACROBLOCK_SIZE_16BPP ((16 * 16 * 2) / 4)
+#define MDEC_MACROBLOCK_SIZE_24BPP ((16 * 16 * 3) / 4)
+
+#define mdec_dc(scale, value)  (((scale) << 10) | ((value) & 0x3ff))
+#define mdec_ac(run, value)    (((run)   << 10) | ((value) & 0x3ff))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Resets the MDEC, uploads the default quantization and IDCT tables and
+ * enables the MDEC's DMA channels. The default quantization table is the one
+ * used by most PS1 video encoders (the MPEG-1 intra table), for both luma and
+ * chroma blocks.
+ */
+void initMDEC(void);
+
+/**
+ * @brief Uploads custom quantization tables, which must be 64 bytes long each
+ * and in zigzag order. Must not be called while the MDEC is busy.
+ *
+ * @param luma
+ * @param chroma
+ */
+void uploadMDECQuantTables(const uint8_t *luma, const uint8_t *chroma);
+
+/**
+ * @brief Sends a decode command to the MDEC and starts transferring the given
+ * run-length codes to it in the background. The length is in 32-bit words and
+ * must be a multiple of MDEC_DMA_CHUNK_SIZE (pad the data with
+ * MDEC_END_OF_BLOCK codes if necessary). The output format is specified by
+ * passing one of the MDEC_CMD_FORMAT_* values along with any other decode
+ * flags. The MDEC stalls once its output FIFO is full, so receiveMDEC() must
+ * be called to retrieve the decoded data in order for the input transfer to
+ * complete.
+ *
+ * @param data
+ * @param length
+ * @param flags
+ */
+void feedMDEC(const uint32_t *data, int length, uint32_t flags);
+
+/**
+ * @brief Starts transferring decoded data from the MDEC to the given buffer
+ * in the background. The length is in 32-bit words and must be a multiple of
+ * MDEC_DMA_CHUNK_SIZE; the data is returned in 16x16 macroblocks (or 8x8
+ * blocks in 4bpp and 8bpp modes) in the order they were fed.
+ *
+ * @param data
+ * @param length
+ */
+void receiveMDEC(void *data, int length);
+
+/**
+ * @brief Enables or disables raising an interrupt each time a transfer
+ * started by receiveMDEC() completes. The interrupt must then be acknowledged
+ * by calling acknowledgeMDECInterrupt() from the interrupt handler.
+ *
+ * @param enable
+ */
+void setMDECInterrupt(bool enable);
+
+/**
+ * @brief Checks for and acknowledges the DMA interrupt raised when a receive
+ * transfer completes.
+ *
+ * @return True if the interrupt was pending
+ */
+bool acknowledgeMDECInterrupt(void);
+
+/**
+ * @brief Returns whether the transfer started by feedMDEC() is still running.
+ */
+bool isMDECFeeding(void);
+
+/**
+ * @brief Returns whether the transfer started by receiveMDEC() is still
+ * running.
+ */
+bool isMDECReceiving(void);
+
+/**
+ * @brief Waits for the transfer started by receiveMDEC() to complete.
+ */
+void waitForMDECOutput(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,432 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The MDEC only understands run-length codes, which are far too large to be
+ * streamed from the disc as-is. Video frames are thus stored in a compressed
+ * "bitstream" format, in which each run-length code is replaced by a variable
+ * length code taken from the MPEG-1 AC coefficient table (codes not present in
+ * the table are stored using a 22-bit escape sequence instead). DC
+ * coefficients are either stored as raw 10-bit values (version 2) or, in
+ * version 3, as the difference from the previous block of the same component
+ * using the MPEG-1 DC tables.
+ *
+ * Decoding this bitstream is by far the most expensive part of video playback
+ * on the CPU side, so the decoder is built around two ideas:
+ *
+ * - the bitstream is read 32 bits at a time into a 32-bit window, which always
+ *   holds at least 32 valid bits (backed by a second "reserve" word) so that
+ *   any code, including escape sequences, can be extracted from it without
+ *   checking whether a refill is needed first;
+ * - AC codes are matched through a two-level lookup table, whose entries hold
+ *   the run-length code to output (minus its sign) and the length of the
+ *   variable length code packed in a single 16-bit value. The first level
+ *   resolves all codes up to 8 bits long with a single lookup; longer codes
+ *   are rare and only take a short loop and a second lookup.
+ *
+ * The tables are generated at runtime from the compact list of codes below,
+ * so that they can be placed anywhere in memory (including the scratchpad).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/mdec.h"
+#include "ps1/mdecbs.h"
+
+#define BLOCKS_PER_MACROBLOCK 6
+#define MAX_BLOCK_LENGTH      (1 + 63 + 1)
+
+typedef struct {
+	uint8_t  length;
+	uint16_t code;
+	uint8_t  run, level;
+} ACCode;
+
+// MPEG-1 AC coefficient table, sorted by code length and excluding the end of
+// block and escape codes. Each code is followed by a sign bit.
+static const ACCode _acTable[] = {
+	{  2, 0x0003,  0,  1 }, {  3, 0x0003,  1,  1 }, {  4, 0x0004,  0,  2 },
+	{  4, 0x0005,  2,  1 }, {  5, 0x0005,  0,  3 }, {  5, 0x0006,  4,  1 },
+	{  5, 0x0007,  3,  1 }, {  6, 0x0004,  7,  1 }, {  6, 0x0005,  6,  1 },
+	{  6, 0x0006,  1,  2 }, {  6, 0x0007,  5,  1 }, {  7, 0x0004,  2,  2 },
+	{  7, 0x0005,  9,  1 }, {  7, 0x0006,  0,  4 }, {  7, 0x0007,  8,  1 },
+	{  8, 0x0020, 13,  1 }, {  8, 0x0021,  0,  6 }, {  8, 0x0022, 12,  1 },
+	{  8, 0x0023, 11,  1 }, {  8, 0x0024,  3,  2 }, {  8, 0x0025,  1,  3 },
+	{  8, 0x0026,  0,  5 }, {  8, 0x0027, 10,  1 }, { 10, 0x0008, 16,  1 },
+	{ 10, 0x0009,  5,  2 }, { 10, 0x000a,  0,  7 }, { 10, 0x000b,  2,  3 },
+	{ 10, 0x000c,  1,  4 }, { 10, 0x000d, 15,  1 }, { 10, 0x000e, 14,  1 },
+	{ 10, 0x000f,  4,  2 }, { 12, 0x0010,  0, 11 }, { 12, 0x0011,  8,  2 },
+	{ 12, 0x0012,  4,  3 }, { 12, 0x0013,  0, 10 }, { 12, 0x0014,  2,  4 },
+	{ 12, 0x0015,  7,  2 }, { 12, 0x0016, 21,  1 }, { 12, 0x0017, 20,  1 },
+	{ 12, 0x0018,  0,  9 }, { 12, 0x0019, 19,  1 }, { 12, 0x001a, 18,  1 },
+	{ 12, 0x001b,  1,  5 }, { 12, 0x001c,  3,  3 }, { 12, 0x001d,  0,  8 },
+	{ 12, 0x001e,  6,  2 }, { 12, 0x001f, 17,  1 }, { 13, 0x0010, 10,  2 },
+	{ 13, 0x0011,  9,  2 }, { 13, 0x0012,  5,  3 }, { 13, 0x0013,  3,  4 },
+	{ 13, 0x0014,  2,  5 }, { 13, 0x0015,  1,  7 }, { 13, 0x0016,  1,  6 },
+	{ 13, 0x0017,  0, 15 }, { 13, 0x0018,  0, 14 }, { 13, 0x0019,  0, 13 },
+	{ 13, 0x001a,  0, 12 }, { 13, 0x001b, 26,  1 }, { 13, 0x001c, 25,  1 },
+	{ 13, 0x001d, 24,  1 }, { 13, 0x001e, 23,  1 }, { 13, 0x001f, 22,  1 },
+	{ 14, 0x0010,  0, 31 }, { 14, 0x0011,  0, 30 }, { 14, 0x0012,  0, 29 },
+	{ 14, 0x0013,  0, 28 }, { 14, 0x0014,  0, 27 }, { 14, 0x0015,  0, 26 },
+	{ 14, 0x0016,  0, 25 }, { 14, 0x0017,  0, 24 }, { 14, 0x0018,  0, 23 },
+	{ 14, 0x0019,  0, 22 }, { 14, 0x001a,  0, 21 }, { 14, 0x001b,  0, 20 },
+	{ 14, 0x001c,  0, 19 }, { 14, 0x001d,  0, 18 }, { 14, 0x001e,  0, 17 },
+	{ 14, 0x001f,  0, 16 }, { 15, 0x0010,  0, 40 }, { 15, 0x0011,  0, 39 },
+	{ 15, 0x0012,  0, 38 }, { 15, 0x0013,  0, 37 }, { 15, 0x0014,  0, 36 },
+	{ 15, 0x0015,  0, 35 }, { 15, 0x0016,  0, 34 }, { 15, 0x0017,  0, 33 },
+	{ 15, 0x0018,  0, 32 }, { 15, 0x0019,  1, 14 }, { 15, 0x001a,  1, 13 },
+	{ 15, 0x001b,  1, 12 }, { 15, 0x001c,  1, 11 }, { 15, 0x001d,  1, 10 },
+	{ 15, 0x001e,  1,  9 }, { 15, 0x001f,  1,  8 }, { 16, 0x0010,  1, 18 },
+	{ 16, 0x0011,  1, 17 }, { 16, 0x0012,  1, 16 }, { 16, 0x0013,  1, 15 },
+	{ 16, 0x0014,  6,  3 }, { 16, 0x0015, 16,  2 }, { 16, 0x0016, 15,  2 },
+	{ 16, 0x0017, 14,  2 }, { 16, 0x0018, 13,  2 }, { 16, 0x0019, 12,  2 },
+	{ 16, 0x001a, 11,  2 }, { 16, 0x001b, 31,  1 }, { 16, 0x001c, 30,  1 },
+	{ 16, 0x001d, 29,  1 }, { 16, 0x001e, 28,  1 }, { 16, 0x001f, 27,  1 }
+};
+
+#define AC_TABLE_LENGTH (sizeof(_acTable) / sizeof(ACCode))
+
+/* Lookup table generation */
+
+// Each table entry is laid out like a run-length code, with the length of the
+// variable length code (minus one) stored in the upper bits of the coefficient
+// field. As no code has a coefficient of zero, entries whose coefficient field
+// is zero are used to mark special codes.
+#define ENTRY_LEVEL_BITMASK (63 << 0)
+#define ENTRY_CODE_BITMASK  (ENTRY_LEVEL_BITMASK | (63 << 10))
+
+#define entry_pack(run, length, level) \
+	(((run) << 10) | (((length) - 1) << 6) | (level))
+#define entry_getLength(entry) ((((entry) >> 6) & 15) + 1)
+
+typedef enum {
+	ENTRY_INVALID = 0 << 10,
+	ENTRY_LONG    = 1 << 10, // Code longer than 8 bits, use second level
+	ENTRY_ESCAPE  = 2 << 10,
+	ENTRY_EOB     = 3 << 10
+} SpecialEntry;
+
+#define EOB_LENGTH    2
+#define EOB_CODE      0x2
+#define ESCAPE_LENGTH 6
+#define ESCAPE_CODE   0x01
+#define LONG_ZEROES   6
+
+static MDECBSTables       _defaultTables;
+static const MDECBSTables *_tables = 0;
+
+static void _fillEntries(
+	uint16_t *table,
+	int      indexBits,
+	uint32_t prefix,
+	int      prefixLength,
+	uint16_t entry
+) {
+	// Codes shorter than the index match all entries sharing their prefix.
+	int shift = indexBits - prefixLength;
+
+	for (int i = 0; i < (1 << shift); i++)
+		table[(prefix << shift) | i] = entry;
+}
+
+void initMDECBitstream(MDECBSTables *tables) {
+	if (!tables)
+		tables = &_defaultTables;
+
+	for (int i = 0; i < 256; i++)
+		tables->ac[i] = ENTRY_INVALID;
+	for (int i = 0; i < (6 * 16); i++)
+		tables->acLong[i / 16][i % 16] = ENTRY_INVALID;
+
+	_fillEntries(tables->ac, 8, 0, LONG_ZEROES, ENTRY_LONG);
+	_fillEntries(
+		tables->ac, 8, ESCAPE_CODE, ESCAPE_LENGTH, ENTRY_ESCAPE
+	);
+	_fillEntries(tables->ac, 8, EOB_CODE, EOB_LENGTH, ENTRY_EOB);
+
+	const ACCode *code = _acTable;
+
+	for (; code < &_acTable[AC_TABLE_LENGTH]; code++) {
+		uint16_t entry = entry_pack(code->run, code->length, code->level);
+
+		if (code->length <= 8) {
+			_fillEntries(tables->ac, 8, code->code, code->length, entry);
+			continue;
+		}
+
+		// Long codes are indexed by the number of leading zeroes and the (up
+		// to 4) bits following the first one.
+		int zeroes = LONG_ZEROES;
+
+		while (!(code->code & (1 << (code->length - zeroes - 1))))
+			zeroes++;
+
+		int      suffixLength = code->length - zeroes - 1;
+		uint32_t suffix       = code->code & ((1 << suffixLength) - 1);
+
+		_fillEntries(
+			tables->acLong[zeroes - LONG_ZEROES],
+			4,
+			suffix,
+			suffixLength,
+			entry
+		);
+	}
+
+	_tables = tables;
+}
+
+/* Bit reader */
+
+typedef struct {
+	const uint32_t *ptr, *end;
+
+	uint32_t window, reserve;
+	int      reserveBits;
+} BitReader;
+
+static inline uint32_t _nextWord(BitReader *reader) {
+	// Reading past the end of the data yields zeroes, which do not form any
+	// valid code and thus cause decoding to fail.
+	if (reader->ptr >= reader->end)
+		return 0;
+
+	// Each 32-bit word holds two 16-bit words, the first of which (whose bits
+	// come first in the bitstream) is in the lower half.
+	uint32_t word = *(reader->ptr++);
+
+	return (word << 16) | (word >> 16);
+}
+
+static void _initReader(BitReader *reader, const void *data, int length) {
+	reader->ptr = (const uint32_t *) data;
+	reader->end = reader->ptr + (length + 3) / 4;
+
+	reader->window      = _nextWord(reader);
+	reader->reserve     = _nextWord(reader);
+	reader->reserveBits = 32;
+}
+
+static inline void _skip(BitReader *reader, int length) {
+	// Shift bits from the reserve into the window, then refill the reserve
+	// with a new word if it did not have enough bits left. The length must be
+	// in 1-31 range.
+	reader->window       = (reader->window << length)
+		| (reader->reserve >> (32 - length));
+	reader->reserve    <<= length;
+	reader->reserveBits -= length;
+
+	if (reader->reserveBits < 0) {
+		int      missing = -reader->reserveBits;
+		uint32_t word    = _nextWord(reader);
+
+		reader->window      |= word >> (32 - missing);
+		reader->reserve      = word << missing;
+		reader->reserveBits += 32;
+	}
+}
+
+/* Block decoding */
+
+static bool _decodeDC(BitReader *reader, bool chroma, int *predictor) {
+	// The DC size codes are short enough to be decoded without a table: all
+	// codes beginning with 11 are made up of a string of ones terminated by a
+	// zero, while the remaining ones are 2 bits long (with the exception of
+	// the two 3-bit luma codes beginning with 10).
+	uint32_t window = reader->window;
+	int      size, length;
+
+	if ((window >> 30) != 3) {
+		length = 2;
+		size   = window >> 30;
+
+		if (!chroma) {
+			if (size == 2) {
+				length = 3;
+				size   = ((window >> 29) & 1) ? 3 : 0;
+			} else {
+				size++;
+			}
+		}
+	} else {
+		int ones = 2;
+
+		while (((window << ones) >> 31) && (ones < 8))
+			ones++;
+
+		length = ones + 1;
+		size   = chroma ? (ones + 1) : (ones + 2);
+
+		if (size > 8)
+			return false;
+	}
+
+	if (size) {
+		// Values whose top bit is cleared are negative, offset so that the
+		// range of each size does not overlap the smaller ones.
+		int diff = (window << length) >> (32 - size);
+
+		if (!(diff & (1 << (size - 1))))
+			diff -= (1 << size) - 1;
+
+		*predictor += diff;
+	}
+
+	_skip(reader, length + size);
+	return true;
+}
+
+static inline uint32_t _decodeEntry(BitReader *reader, uint32_t entry) {
+	// Negate the coefficient if the sign bit following the code is set,
+	// without branching.
+	int      length = entry_getLength(entry);
+	int32_t  sign   = ((int32_t) (reader->window << length)) >> 31;
+	uint32_t code   = ((entry & ENTRY_CODE_BITMASK) ^ (sign & 0x3ff)) - sign;
+
+	_skip(reader, length + 1);
+	return code;
+}
+
+static uint16_t *_decodeAC(BitReader *reader, uint16_t *ptr) {
+	const MDECBSTables *tables = _tables;
+	int                index   = 0;
+
+	for (;;) {
+		uint32_t window = reader->window;
+		uint32_t entry  = tables->ac[window >> 24];
+		uint32_t code;
+
+		if (__builtin_expect(!!(entry & ENTRY_LEVEL_BITMASK), true)) {
+			code = _decodeEntry(reader, entry);
+		} else if (entry == ENTRY_EOB) {
+			_skip(reader, EOB_LENGTH);
+			break;
+		} else if (entry == ENTRY_ESCAPE) {
+			// Escape codes are followed by a 6-bit run length and a 10-bit
+			// signed coefficient, i.e. the run-length code itself.
+			code = (window >> (32 - ESCAPE_LENGTH - 16)) & 0xffff;
+			_skip(reader, ESCAPE_LENGTH + 16);
+		} else if (entry == ENTRY_LONG) {
+			int zeroes = LONG_ZEROES;
+
+			for (; !((window << zeroes) >> 31); zeroes++) {
+				if (zeroes >= (LONG_ZEROES + 5))
+					return 0;
+			}
+
+			entry = tables->acLong[zeroes - LONG_ZEROES][
+				(window << (zeroes + 1)) >> 28
+			];
+
+			if (!(entry & ENTRY_LEVEL_BITMASK))
+				return 0;
+
+			code = _decodeEntry(reader, entry);
+		} else {
+			return 0;
+		}
+
+		index += (code >> 10) + 1;
+
+		if (index > 63)
+			return 0;
+
+		*(ptr++) = code;
+	}
+
+	*(ptr++) = MDEC_END_OF_BLOCK;
+	return ptr;
+}
+
+/* Public API */
+
+int decodeMDECBitstream(
+	uint32_t   *output,
+	int        maxLength,
+	const void *input,
+	int        inputLength,
+	int        numMacroblocks
+) {
+	const MDECBSHeader *header = (const MDECBSHeader *) input;
+
+	if (inputLength < (int) sizeof(MDECBSHeader))
+		return 0;
+	if (header->magic != MDECBS_MAGIC)
+		return 0;
+	if (
+		(header->version != MDECBS_VERSION_2) &&
+		(header->version != MDECBS_VERSION_3)
+	)
+		return 0;
+
+	BitReader reader;
+
+	_initReader(
+		&reader,
+		&header[1],
+		inputLength - (int) sizeof(MDECBSHeader)
+	);
+
+	uint16_t *ptr  = (uint16_t *) output;
+	uint16_t *end  = ptr + maxLength * 2;
+	int      scale = header->quantScale & 63;
+	bool     isV3  = (header->version == MDECBS_VERSION_3);
+
+	// Version 3 keeps separate DC predictors for the Cr, Cb and Y components,
+	// all of which start from zero at the beginning of each frame.
+	int predictors[3] = { 0, 0, 0 };
+
+	for (int i = numMacroblocks; i > 0; i--) {
+		if ((end - ptr) < (MAX_BLOCK_LENGTH * BLOCKS_PER_MACROBLOCK))
+			return 0;
+
+		for (int block = 0; block < BLOCKS_PER_MACROBLOCK; block++) {
+			int component = (block < 2) ? block : 2;
+			int dc;
+
+			if (isV3) {
+				if (!_decodeDC(&reader, block < 2, &predictors[component]))
+					return 0;
+
+				// Version 3 DC values are stored in units of 4.
+				dc = predictors[component] * 4;
+			} else {
+				dc = ((int32_t) reader.window) >> 22;
+				_skip(&reader, 10);
+			}
+
+			*(ptr++) = mdec_dc(scale, dc);
+			ptr      = _decodeAC(&reader, ptr);
+
+			if (!ptr)
+				return 0;
+		}
+	}
+
+	// Pad the output with end of block codes to a multiple of the DMA chunk
+	// size.
+	int length = ((ptr - (uint16_t *) output) + 1) / 2;
+	int padded = (length + MDEC_DMA_CHUNK_SIZE - 1)
+		/ MDEC_DMA_CHUNK_SIZE * MDEC_DMA_CHUNK_SIZE;
+
+	if (padded > maxLength)
+		return 0;
+
+	for (uint16_t *padEnd = (uint16_t *) &output[padded]; ptr < padEnd;)
+		*(ptr++) = MDEC_END_OF_BLOCK;
+
+	return padded;
+}
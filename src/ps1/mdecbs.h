@@ -0,0 +1,96 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define MDECBS_MAGIC 0x3800
+
+// Each compressed frame begins with this header, followed by the bitstream
+// itself (stored as a series of 16-bit little endian words, each read starting
+// from its most significant bit).
+typedef struct __attribute__((packed)) {
+	uint16_t mdecLength; // Length of decoded data in 32-bit words
+	uint16_t magic;      // Always MDECBS_MAGIC
+	uint16_t quantScale; // Quantization scale for all blocks (0-63)
+	uint16_t version;    // Bitstream version (2 or 3)
+} MDECBSHeader;
+
+typedef enum {
+	MDECBS_VERSION_2 = 2, // DC coefficients stored as raw 10-bit values
+	MDECBS_VERSION_3 = 3  // DC coefficients delta coded using MPEG-1 tables
+} MDECBSVersion;
+
+// Lookup tables used to decode AC coefficients. The first level is indexed by
+// the next 8 bits of the bitstream and resolves all codes up to 8 bits long
+// (the vast majority of them), while longer codes, which always begin with at
+// least 6 zeroes, are resolved by the second level based on the number of
+// leading zeroes and the 4 bits following them.
+typedef struct {
+	uint16_t ac[256];
+	uint16_t acLong[6][16];
+} MDECBSTables;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Generates the lookup tables used by decodeMDECBitstream() in the
+ * given buffer, or in a statically allocated one if a null pointer is passed.
+ * The tables are small enough (704 bytes) to be placed in the scratchpad
+ * region at 0x1f800000, which is significantly faster to access than main RAM
+ * as the CPU has no data cache. Must be called before decoding any frame.
+ *
+ * @param tables
+ */
+void initMDECBitstream(MDECBSTables *tables);
+
+/**
+ * @brief Decodes a compressed frame (including its header) into run-length
+ * codes for the MDEC, writing at most maxLength 32-bit words to the output
+ * buffer. The output is padded with end-of-block codes to a multiple of
+ * MDEC_DMA_CHUNK_SIZE words, so that it can be passed as-is to feedMDEC().
+ * The input must be 4-byte aligned, as it is read 32 bits at a time (any
+ * padding up to the next multiple of 4 bytes is read but ignored).
+ *
+ * To avoid checking for overflows after each code, the decoder requires room
+ * for a worst case macroblock (195 words) to be left in the output buffer
+ * before decoding each macroblock; frames whose last macroblock would begin
+ * less than 195 words before the end of the buffer are thus rejected even if
+ * their decoded data would fit. The video encoder takes this into account
+ * when enforcing a maximum length.
+ *
+ * @param output
+ * @param maxLength
+ * @param input
+ * @param inputLength Length of the frame in bytes
+ * @param numMacroblocks Number of 16x16 macroblocks in the frame
+ * @return Number of words written, or 0 if the frame is invalid or the output
+ * buffer is too small
+ */
+int decodeMDECBitstream(
+	uint32_t   *output,
+	int        maxLength,
+	const void *input,
+	int        inputLength,
+	int        numMacroblocks
+);
+
+#ifdef __cplusplus
+}
+#endif
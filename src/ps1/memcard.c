@@ -0,0 +1,361 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Memory cards are accessed through the same bus as controllers, using packets
+ * that carry a single 128-byte sector each. A read or write packet takes about
+ * 5 milliseconds to exchange, and the card may take a further few milliseconds
+ * to commit a write to its flash memory; saving a typical 8 KB file thus takes
+ * several hundred milliseconds. This driver splits each operation into one SIO0
+ * transfer per sector and only queues the next transfer once the previous one
+ * has completed, so controller polls (and other operations) can be interleaved
+ * with it and the main loop never has to wait for the card.
+ *
+ * Sector packets are laid out as follows (the address byte is omitted):
+ *
+ *   Read request:   'R' 00 00 MSB LSB 00 00 00 00 [128 x 00] 00 00
+ *   Read response:  FLG 5A 5D --- --- 5C 5D MSB LSB [128 data] SUM 'G'
+ *   Write request:  'W' 00 00 MSB LSB [128 data] SUM 00 00 00
+ *   Write response: FLG 5A 5D --- --- [128 x --] --- 5C 5D END
+ *
+ * where SUM is the XOR of the sector index bytes and all data bytes, and END is
+ * 'G' on success, 'N' if the card received a bad checksum or 0xff if the
+ * sector index is out of range.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/memcard.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+#define MAX_RETRIES 3
+
+#define READ_LENGTH  (9 + MEMCARD_SECTOR_SIZE + 2)
+#define WRITE_LENGTH (5 + MEMCARD_SECTOR_SIZE + 4)
+
+typedef struct {
+	uint8_t  data[MEMCARD_CACHED_SECTORS][MEMCARD_SECTOR_SIZE];
+	uint16_t validMask, dirtyMask;
+} DirectoryCache;
+
+static DirectoryCache _caches[2];
+
+static MemCardOp    *_opHead = 0, *_opTail = 0;
+static bool         _transferActive = false;
+static int          _retries        = 0;
+static SIO0Transfer _transfer;
+static uint8_t      _request[READ_LENGTH], _response[READ_LENGTH];
+
+static void _processQueue(void);
+
+/* Packet helpers */
+
+static uint8_t _checksum(int sector, const uint8_t *data) {
+	uint8_t value = (sector >> 8) ^ (sector & 0xff);
+
+	for (int i = 0; i < MEMCARD_SECTOR_SIZE; i++)
+		value ^= data[i];
+
+	return value;
+}
+
+static MemCardStatus _parseRead(int sector, uint8_t *output) {
+	const uint8_t *response = _response;
+	int           length    = _transfer.respLength;
+
+	if (!length)
+		return MEMCARD_NO_CARD;
+	if ((length < 9) || (response[1] != 0x5a) || (response[2] != 0x5d))
+		return MEMCARD_PROTOCOL_ERROR;
+
+	// If the sector index is out of range, the card replies with 0xffff in
+	// place of the index and stops acknowledging bytes.
+	if ((response[7] == 0xff) && (response[8] == 0xff))
+		return MEMCARD_BAD_SECTOR;
+	if (length < READ_LENGTH)
+		return MEMCARD_PROTOCOL_ERROR;
+
+	const uint8_t *data = &response[9];
+
+	if (
+		(response[READ_LENGTH - 2] != _checksum(sector, data)) ||
+		(response[READ_LENGTH - 1] != 'G')
+	)
+		return MEMCARD_CHECKSUM_ERROR;
+
+	memcpy(output, data, MEMCARD_SECTOR_SIZE);
+	return MEMCARD_OK;
+}
+
+static MemCardStatus _parseWrite(void) {
+	const uint8_t *response = _response;
+	int           length    = _transfer.respLength;
+
+	if (!length)
+		return MEMCARD_NO_CARD;
+	if (
+		(length < WRITE_LENGTH) ||
+		(response[1] != 0x5a) ||
+		(response[2] != 0x5d)
+	)
+		return MEMCARD_PROTOCOL_ERROR;
+
+	switch (response[WRITE_LENGTH - 1]) {
+		case 'G':
+			return MEMCARD_OK;
+
+		case 'N':
+			return MEMCARD_CHECKSUM_ERROR;
+
+		default:
+			return MEMCARD_BAD_SECTOR;
+	}
+}
+
+static void _sendPacket(MemCardOp *op, int sector, const uint8_t *data) {
+	uint8_t *request = _request;
+
+	memset(request, 0, sizeof(_request));
+
+	request[3] = sector >> 8;
+	request[4] = sector & 0xff;
+
+	if (data) {
+		request[0] = SIO0_CMD_CARD_WRITE;
+		request[5 + MEMCARD_SECTOR_SIZE] = _checksum(sector, data);
+
+		memcpy(&request[5], data, MEMCARD_SECTOR_SIZE);
+		_transfer.reqLength     = WRITE_LENGTH;
+		_transfer.maxRespLength = WRITE_LENGTH;
+	} else {
+		request[0] = SIO0_CMD_CARD_READ;
+
+		_transfer.reqLength     = READ_LENGTH;
+		_transfer.maxRespLength = READ_LENGTH;
+	}
+
+	_transfer.port  = op->port;
+	_transferActive = true;
+	queueSIO0Transfer(&_transfer);
+}
+
+/* Operation state machine */
+
+static void _finishOp(MemCardOp *op, MemCardStatus status) {
+	_opHead  = op->next;
+	_retries = 0;
+
+	if (!_opHead)
+		_opTail = 0;
+
+	op->status = status;
+
+	if (op->callback)
+		op->callback(op);
+}
+
+static int _findDirtySector(const DirectoryCache *cache) {
+	for (int i = 0; i < MEMCARD_CACHED_SECTORS; i++) {
+		if ((cache->dirtyMask >> i) & 1)
+			return i;
+	}
+
+	return -1;
+}
+
+static void _transferCallback(SIO0Transfer *transfer) {
+	MemCardOp      *op    = _opHead;
+	DirectoryCache *cache = &_caches[op->port];
+
+	_transferActive = false;
+
+	int           sector = op->sector + op->completed;
+	MemCardStatus status;
+
+	if (op->type == MEMCARD_OP_READ) {
+		uint8_t *output = &op->data[op->completed * MEMCARD_SECTOR_SIZE];
+
+		status = _parseRead(sector, output);
+
+		if ((status == MEMCARD_OK) && (sector < MEMCARD_CACHED_SECTORS)) {
+			memcpy(cache->data[sector], output, MEMCARD_SECTOR_SIZE);
+			cache->validMask |= 1 << sector;
+		}
+	} else {
+		status = _parseWrite();
+
+		if ((status == MEMCARD_OK) && (op->type == MEMCARD_OP_FLUSH))
+			cache->dirtyMask &= ~(1 << _findDirtySector(cache));
+	}
+
+	switch (status) {
+		case MEMCARD_OK:
+			// Accumulate the flags returned for each sector, as the card only
+			// reports having been replaced until the first write is issued to
+			// it (which may be any sector of a multi-sector operation).
+			op->flags |= _response[0];
+			op->completed++;
+			_retries = 0;
+
+			// The flag is returned at the beginning of the same packet that
+			// clears it, so by the time it is seen the sector has already been
+			// written. Stop the operation there rather than writing any further
+			// sectors to a card that may not be the one the data was meant
+			// for. Any sectors left in the cache belong to the previous card
+			// and are discarded.
+			if (
+				(op->type != MEMCARD_OP_READ) &&
+				(_response[0] & MEMCARD_FLAG_NEW_CARD)
+			) {
+				if (op->type == MEMCARD_OP_FLUSH)
+					invalidateMemCardCache(op->port);
+
+				_finishOp(op, MEMCARD_CARD_CHANGED);
+			}
+			break;
+
+		case MEMCARD_BAD_SECTOR:
+			_finishOp(op, status);
+			break;
+
+		default:
+			// Checksum errors are usually caused by a loose connection and are
+			// worth retrying. The card may also fail to respond for a short
+			// time after a write, so retry before giving up on it.
+			if (++_retries <= MAX_RETRIES)
+				break;
+
+			if (status == MEMCARD_NO_CARD)
+				invalidateMemCardCache(op->port);
+
+			_finishOp(op, status);
+			break;
+	}
+
+	_processQueue();
+}
+
+static void _processQueue(void) {
+	// Keep going until either a transfer has been issued or the queue is empty.
+	// Accesses to cached sectors are completed immediately.
+	while (_opHead && !_transferActive) {
+		MemCardOp      *op    = _opHead;
+		DirectoryCache *cache = &_caches[op->port];
+
+		if (op->type == MEMCARD_OP_FLUSH) {
+			int sector = _findDirtySector(cache);
+
+			if (sector < 0)
+				_finishOp(op, MEMCARD_OK);
+			else
+				_sendPacket(op, sector, cache->data[sector]);
+
+			continue;
+		}
+
+		if (op->completed >= op->count) {
+			_finishOp(op, MEMCARD_OK);
+			continue;
+		}
+
+		int     sector = op->sector + op->completed;
+		uint8_t *data  = &op->data[op->completed * MEMCARD_SECTOR_SIZE];
+
+		if (sector >= MEMCARD_NUM_SECTORS) {
+			_finishOp(op, MEMCARD_BAD_SECTOR);
+			continue;
+		}
+
+		if (sector < MEMCARD_CACHED_SECTORS) {
+			uint8_t *cached = cache->data[sector];
+
+			if (op->type == MEMCARD_OP_WRITE) {
+				if (
+					!((cache->validMask >> sector) & 1) ||
+					memcmp(cached, data, MEMCARD_SECTOR_SIZE)
+				) {
+					memcpy(cached, data, MEMCARD_SECTOR_SIZE);
+					cache->validMask |= 1 << sector;
+					cache->dirtyMask |= 1 << sector;
+				}
+
+				op->completed++;
+				continue;
+			}
+			if ((cache->validMask >> sector) & 1) {
+				memcpy(data, cached, MEMCARD_SECTOR_SIZE);
+				op->completed++;
+				continue;
+			}
+		}
+
+		_sendPacket(op, sector, (op->type == MEMCARD_OP_WRITE) ? data : 0);
+	}
+}
+
+/* Public API */
+
+void initMemCards(void) {
+	_opHead         = 0;
+	_opTail         = 0;
+	_transferActive = false;
+	_retries        = 0;
+
+	_transfer.address  = SIO0_ADDR_MEMORY_CARD;
+	_transfer.request  = _request;
+	_transfer.response = _response;
+	_transfer.callback = &_transferCallback;
+	_transfer.arg      = 0;
+
+	invalidateMemCardCache(0);
+	invalidateMemCardCache(1);
+}
+
+void queueMemCardOp(MemCardOp *op) {
+	bool enabled = disableInterrupts();
+
+	op->next      = 0;
+	op->status    = MEMCARD_PENDING;
+	op->flags     = 0;
+	op->completed = 0;
+
+	if (_opTail)
+		_opTail->next = op;
+	else
+		_opHead = op;
+
+	_opTail = op;
+
+	if (!_transferActive)
+		_processQueue();
+	if (enabled)
+		enableInterrupts();
+}
+
+bool isMemCardBusy(void) {
+	return (_opHead != 0);
+}
+
+bool isMemCardCacheDirty(int port) {
+	return (_caches[port].dirtyMask != 0);
+}
+
+void invalidateMemCardCache(int port) {
+	_caches[port].validMask = 0;
+	_caches[port].dirtyMask = 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MEMCARD_SECTOR_SIZE 128
+#define MEMCARD_NUM_SECTORS 1024
+
+// The first 16 sectors of a card (the header and directory frames) are kept in
+// a write-back cache, as they are accessed far more often than any other
+// sector. Writing the same data to a cached sector does not mark it as dirty,
+// so the whole directory can be written back cheaply after modifying a single
+// entry.
+#define MEMCARD_CACHED_SECTORS 16
+
+typedef enum {
+	MEMCARD_OP_READ  = 0, // Read one or more consecutive sectors
+	MEMCARD_OP_WRITE = 1, // Write one or more consecutive sectors
+	MEMCARD_OP_FLUSH = 2  // Write back all modified sectors in the cache
+} MemCardOpType;
+
+typedef enum {
+	MEMCARD_PENDING        = 0,
+	MEMCARD_OK             = 1,
+	MEMCARD_NO_CARD        = 2, // No card inserted (or card not responding)
+	MEMCARD_CHECKSUM_ERROR = 3, // Data corrupted on the bus, retries exhausted
+	MEMCARD_BAD_SECTOR     = 4, // Sector index rejected by the card
+	MEMCARD_PROTOCOL_ERROR = 5, // Unexpected response (not a memory card?)
+
+	// Errors returned by the filesystem layer (see ps1/memcardfs.h)
+	MEMCARD_NOT_FORMATTED  = 6, // Header frame missing or invalid
+	MEMCARD_FILE_NOT_FOUND = 7,
+	MEMCARD_NO_SPACE       = 8, // Not enough free blocks for the file
+	MEMCARD_CORRUPTED      = 9, // Broken block chain in the directory
+
+	// Returned by write and flush operations that hit a newly inserted card,
+	// as well as by the filesystem layer if the card was swapped since it was
+	// mounted
+	MEMCARD_CARD_CHANGED   = 10
+} MemCardStatus;
+
+// Bits of the flag byte returned by the card in response to each command.
+typedef enum {
+	MEMCARD_FLAG_WRITE_ERROR = 1 << 2, // Last write failed
+	MEMCARD_FLAG_NEW_CARD    = 1 << 3  // No write issued since card insertion
+} MemCardFlag;
+
+typedef struct MemCardOp MemCardOp;
+typedef void (*MemCardCallback)(MemCardOp *op);
+
+struct MemCardOp {
+	MemCardOp *next;
+
+	// These fields must be filled in before queueing the operation. The count
+	// and data fields are ignored by flush operations. The data buffer must be
+	// at least count * MEMCARD_SECTOR_SIZE bytes long.
+	uint8_t         type, port;
+	uint16_t        sector, count;
+	uint8_t         *data;
+
+	// Optional function called once the operation has completed (or failed),
+	// usually from the interrupt handler, plus an arbitrary argument for it.
+	MemCardCallback callback;
+	void            *arg;
+
+	// These fields are updated by the driver. The flags are the bitwise OR of
+	// the flag bytes returned for all sectors transferred successfully. The
+	// number of completed sectors is valid even if the operation failed partway
+	// through. Write and flush operations stop with MEMCARD_CARD_CHANGED right
+	// after writing the first sector for which the card reports
+	// MEMCARD_FLAG_NEW_CARD; since the flag is cleared by that write, the only
+	// way to detect a swapped card without writing to it is to issue a read
+	// beforehand and check its flags.
+	volatile uint8_t status;
+	uint8_t          flags;
+	uint16_t         completed;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Clears the operation queue and invalidates the directory cache of both
+ * ports. initSIO0() must have been called prior to this.
+ */
+void initMemCards(void);
+
+/**
+ * @brief Appends an operation to the queue. Operations are carried out in
+ * order, one sector at a time, each sector being sent as a separate SIO0
+ * transfer so that controller polls can still take place in between. The
+ * operation structure and its data buffer must remain valid until its status
+ * changes from MEMCARD_PENDING.
+ *
+ * Reads and writes that fall entirely within the directory cache do not
+ * require any bus access; in that case the callback may be invoked before this
+ * function returns. Note that writes to cached sectors are not committed to
+ * the card until a flush operation is queued.
+ *
+ * @param op
+ */
+void queueMemCardOp(MemCardOp *op);
+
+/**
+ * @brief Returns whether any operation is currently in progress or queued.
+ */
+bool isMemCardBusy(void);
+
+/**
+ * @brief Returns whether the directory cache for the given port holds any
+ * sectors that have been modified but not yet written back to the card.
+ *
+ * @param port
+ */
+bool isMemCardCacheDirty(int port);
+
+/**
+ * @brief Discards the contents of the directory cache for the given port,
+ * including any unflushed modifications, forcing the next access to reread
+ * them from the card. The cache is invalidated automatically if the card does
+ * not respond, but this must be called manually if the card may have been
+ * swapped for another one in the meantime.
+ *
+ * @param port
+ */
+void invalidateMemCardCache(int port);
+
+#ifdef __cplusplus
+}
+#endif
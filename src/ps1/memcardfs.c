@@ -0,0 +1,659 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The memory card filesystem used by the BIOS is extremely simple. Sector 0
+ * contains a header starting with "MC", while sectors 1-15 hold one directory
+ * entry for each of the remaining 15 blocks. Files take up one or more whole
+ * blocks, chained together through the "next block" field of each entry; the
+ * first entry of a file holds its name and length. Each directory entry is
+ * protected by an XOR checksum in its last byte.
+ *
+ * All functions in this module run as a sequence of steps, each one queueing
+ * one or more memory card operations and being advanced by their completion
+ * callbacks. The directory is kept in memory once mounted and all updates to
+ * it are written through the memory card driver's directory cache, which only
+ * writes back the sectors that have actually changed.
+ *
+ * As the card can be removed at any time, directory updates are ordered so
+ * that an interrupted write never makes a file unreadable. A new file's first
+ * entry is only written once all other entries of its chain are on the card,
+ * and the old copy of a replaced file is only deleted after that. Mounting the
+ * card deletes any leftovers of an interrupted update, i.e. unreachable chain
+ * entries and duplicate copies of a file.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/memcard.h"
+#include "ps1/memcardfs.h"
+
+#define NO_BLOCK 0xffff
+#define NO_FILE  0xff
+
+// Sector in the directory block reserved for testing writes, which normally
+// holds a copy of the header.
+#define TEST_SECTOR 63
+
+typedef enum {
+	STEP_IDLE        = 0,
+	STEP_MOUNT       = 1, // Reading header and directory
+	STEP_ACKNOWLEDGE = 2, // Writing test sector to clear the "new card" flag
+	STEP_REPAIR      = 3, // Writing back directory after deleting leftovers
+	STEP_READ        = 4, // Reading data blocks
+	STEP_WRITE       = 5, // Writing data blocks to free space
+	STEP_LINK        = 6, // Writing back new entries other than the first one
+	STEP_COMMIT      = 7, // Writing back new file's first entry
+	STEP_DELETE      = 8  // Writing back deleted directory entries
+} FSStep;
+
+/* Directory helpers */
+
+static uint8_t _entryChecksum(const MemCardDirEntry *entry) {
+	const uint8_t *data = (const uint8_t *) entry;
+	uint8_t       value = 0;
+
+	for (int i = 0; i < (MEMCARD_SECTOR_SIZE - 1); i++)
+		value ^= data[i];
+
+	return value;
+}
+
+static bool _isValidEntry(const MemCardDirEntry *entry) {
+	return (entry->checksum == _entryChecksum(entry));
+}
+
+static bool _isFreeEntry(const MemCardDirEntry *entry) {
+	// Deleted files are treated as free space. Entries with invalid checksums
+	// are treated as neither free nor in use, so that they are never
+	// overwritten.
+	if (!_isValidEntry(entry))
+		return false;
+
+	return (entry->state >= MEMCARD_BLOCK_FREE) &&
+		(entry->state <= MEMCARD_BLOCK_DELETED_LAST);
+}
+
+static void _setEntry(
+	MemCardDirEntry *entry,
+	int             state,
+	uint32_t        length,
+	int             nextBlock,
+	const char      *name
+) {
+	memset(entry, 0, sizeof(MemCardDirEntry));
+
+	entry->state     = state;
+	entry->length    = length;
+	entry->nextBlock = nextBlock;
+
+	if (name)
+		strncpy(entry->name, name, MEMCARD_MAX_NAME_LENGTH);
+
+	entry->checksum = _entryChecksum(entry);
+}
+
+static int _followChain(const MemCardFS *fs, int first, uint8_t *chain) {
+	// Walk the chain starting from the given entry, making sure it does not
+	// loop or point to entries that are not part of a file.
+	int block = first;
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		const MemCardDirEntry *entry = &fs->entries[block];
+
+		if (!_isValidEntry(entry))
+			return -1;
+		if (entry->state != (i ? MEMCARD_BLOCK_MIDDLE : MEMCARD_BLOCK_FIRST)) {
+			if ((entry->state != MEMCARD_BLOCK_LAST) || !i)
+				return -1;
+		}
+
+		chain[i] = block;
+
+		if (entry->state == MEMCARD_BLOCK_LAST)
+			return i + 1;
+
+		// Single-block files are marked as "first" and have no next block.
+		block = entry->nextBlock;
+
+		if (block == NO_BLOCK)
+			return (entry->state == MEMCARD_BLOCK_FIRST) ? 1 : -1;
+		if (block >= MEMCARD_NUM_BLOCKS)
+			return -1;
+	}
+
+	return -1;
+}
+
+static void _deleteEntry(MemCardDirEntry *entry) {
+	// Deleted entries keep their contents, so that a file can be recovered as
+	// long as its blocks have not been reused.
+	entry->state   += MEMCARD_BLOCK_DELETED_FIRST - MEMCARD_BLOCK_FIRST;
+	entry->checksum = _entryChecksum(entry);
+}
+
+static void _deleteChain(MemCardFS *fs, const uint8_t *chain, int length) {
+	for (int i = 0; i < length; i++)
+		_deleteEntry(&fs->entries[chain[i]]);
+}
+
+static bool _repairDirectory(MemCardFS *fs) {
+	// Collect the entries of all readable files, ignoring any further copies
+	// of a file left behind by an interrupted replacement (findMemCardFile()
+	// only ever returns the first one).
+	uint8_t  chain[MEMCARD_NUM_BLOCKS];
+	uint16_t usedMask = 0;
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		const MemCardDirEntry *entry = &fs->entries[i];
+
+		if (!_isValidEntry(entry) || (entry->state != MEMCARD_BLOCK_FIRST))
+			continue;
+		if (findMemCardFile(fs, entry->name) != i)
+			continue;
+
+		int length = _followChain(fs, i, chain);
+
+		for (int j = 0; j < length; j++)
+			usedMask |= 1 << chain[j];
+	}
+
+	// Delete all other entries in use, i.e. duplicates, chains that do not
+	// end with a last entry and entries no file links to. Entries with
+	// invalid checksums are left untouched as usual.
+	bool changed = false;
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		MemCardDirEntry *entry = &fs->entries[i];
+
+		if (((usedMask >> i) & 1) || !_isValidEntry(entry))
+			continue;
+		if (
+			(entry->state < MEMCARD_BLOCK_FIRST) ||
+			(entry->state > MEMCARD_BLOCK_LAST)
+		)
+			continue;
+
+		_deleteEntry(entry);
+		changed = true;
+	}
+
+	return changed;
+}
+
+/* Operation state machine */
+
+static void _advance(MemCardFS *fs);
+static void _queueBlockOp(MemCardFS *fs, int type);
+static void _queueDirectoryWrite(MemCardFS *fs);
+
+static void _finish(MemCardFS *fs, MemCardStatus status) {
+	fs->step     = STEP_IDLE;
+	fs->checking = false;
+	fs->status   = status;
+
+	if (fs->callback)
+		fs->callback(fs);
+}
+
+static void _opCallback(MemCardOp *op) {
+	MemCardFS *fs = (MemCardFS *) op->arg;
+
+	// Operations are always queued in pairs or alone, with only the last one
+	// having a callback, so the status of both has to be checked.
+	MemCardStatus status = op->status;
+	uint8_t       flags  = op->flags;
+
+	if (op == &fs->ops[1]) {
+		flags |= fs->ops[0].flags;
+
+		if (fs->ops[0].status != MEMCARD_OK)
+			status = fs->ops[0].status;
+	}
+
+	// The card reports itself as new until it is written to for the first
+	// time, which mountMemCardFS() does on purpose (the driver stops the write
+	// with MEMCARD_CARD_CHANGED after it has gone through). If the flag shows
+	// up at any later point, the card has been swapped and the directory in
+	// memory no longer describes it.
+	if (fs->step == STEP_ACKNOWLEDGE) {
+		if (status == MEMCARD_CARD_CHANGED)
+			status = MEMCARD_OK;
+	} else if (fs->step != STEP_MOUNT) {
+		if ((status == MEMCARD_OK) && (flags & MEMCARD_FLAG_NEW_CARD))
+			status = MEMCARD_CARD_CHANGED;
+	}
+
+	if (status == MEMCARD_OK) {
+		if (!fs->checking) {
+			_advance(fs);
+			return;
+		}
+
+		// The card has not been swapped, so go ahead with the write the
+		// current step was waiting to issue.
+		fs->checking = false;
+
+		if (fs->step == STEP_WRITE)
+			_queueBlockOp(fs, MEMCARD_OP_WRITE);
+		else
+			_queueDirectoryWrite(fs);
+
+		return;
+	}
+
+	// If the card was swapped or the directory was being updated, the copy in
+	// memory may no longer match what is on the card. Force the card to be
+	// mounted again.
+	if (
+		(status == MEMCARD_CARD_CHANGED) ||
+		(fs->step == STEP_REPAIR) ||
+		(fs->step == STEP_LINK) ||
+		(fs->step == STEP_COMMIT) ||
+		(fs->step == STEP_DELETE)
+	) {
+		fs->mounted = false;
+		invalidateMemCardCache(fs->port);
+	}
+
+	_finish(fs, status);
+}
+
+static void _queueOp(
+	MemCardOp *op,
+	MemCardFS *fs,
+	int       type,
+	int       sector,
+	int       count,
+	void      *data,
+	bool      last
+) {
+	op->type     = type;
+	op->port     = fs->port;
+	op->sector   = sector;
+	op->count    = count;
+	op->data     = (uint8_t *) data;
+	op->callback = last ? &_opCallback : 0;
+	op->arg      = fs;
+
+	queueMemCardOp(op);
+}
+
+static void _queueBlockOp(MemCardFS *fs, int type) {
+	int index = fs->currentBlock++;
+	int block = fs->chain[index];
+
+	// Block 0 holds the directory, so directory entry N describes block N + 1.
+	_queueOp(
+		&fs->ops[0],
+		fs,
+		type,
+		(block + 1) * MEMCARD_SECTORS_PER_BLOCK,
+		MEMCARD_SECTORS_PER_BLOCK,
+		&fs->buffer[index * MEMCARD_BLOCK_SIZE],
+		true
+	);
+}
+
+static void _queueDirectoryWrite(MemCardFS *fs) {
+	// Write the entire directory to the cache (which will ignore all sectors
+	// that have not changed), then flush it to the card.
+	_queueOp(
+		&fs->ops[0],
+		fs,
+		MEMCARD_OP_WRITE,
+		1,
+		MEMCARD_NUM_BLOCKS,
+		fs->entries,
+		false
+	);
+	_queueOp(&fs->ops[1], fs, MEMCARD_OP_FLUSH, 0, 0, 0, true);
+}
+
+static void _queueWrite(MemCardFS *fs, FSStep step) {
+	// Before writing anything to the card, read the test sector and let
+	// _opCallback() check the flags returned by the card. Unlike writes, reads
+	// do not clear the "new card" flag, so a swapped card is detected before
+	// any data is written to it. The write itself (a data block for
+	// STEP_WRITE, the directory for all other steps) is queued once the read
+	// has completed. The test sector holds a copy of the header, so it can be
+	// safely read into the header buffer.
+	fs->step     = step;
+	fs->checking = true;
+
+	_queueOp(
+		&fs->ops[0],
+		fs,
+		MEMCARD_OP_READ,
+		TEST_SECTOR,
+		1,
+		fs->header,
+		true
+	);
+}
+
+static void _commitFile(MemCardFS *fs) {
+	// Make the new file visible by writing its first entry, which is the only
+	// one holding its name.
+	_setEntry(
+		&fs->entries[fs->chain[0]],
+		MEMCARD_BLOCK_FIRST,
+		fs->numBlocks * MEMCARD_BLOCK_SIZE,
+		(fs->numBlocks > 1) ? fs->chain[1] : NO_BLOCK,
+		fs->name
+	);
+
+	_queueWrite(fs, STEP_COMMIT);
+}
+
+static void _advance(MemCardFS *fs) {
+	switch (fs->step) {
+		case STEP_MOUNT:
+			if (memcmp(fs->header, "MC", 2)) {
+				_finish(fs, MEMCARD_NOT_FORMATTED);
+				return;
+			}
+
+			// Write the header to the test sector, clearing the flag the card
+			// sets on insertion so that it can later be used to tell whether
+			// the card has been swapped.
+			fs->step = STEP_ACKNOWLEDGE;
+			_queueOp(
+				&fs->ops[0],
+				fs,
+				MEMCARD_OP_WRITE,
+				TEST_SECTOR,
+				1,
+				fs->header,
+				true
+			);
+			break;
+
+		case STEP_ACKNOWLEDGE:
+			if (_repairDirectory(fs)) {
+				_queueWrite(fs, STEP_REPAIR);
+				break;
+			}
+
+			fs->mounted = true;
+			_finish(fs, MEMCARD_OK);
+			break;
+
+		case STEP_REPAIR:
+			fs->mounted = true;
+			_finish(fs, MEMCARD_OK);
+			break;
+
+		case STEP_READ:
+			if (fs->currentBlock < fs->numBlocks)
+				_queueBlockOp(fs, MEMCARD_OP_READ);
+			else
+				_finish(fs, MEMCARD_OK);
+
+			break;
+
+		case STEP_WRITE:
+			if (fs->currentBlock < fs->numBlocks) {
+				_queueWrite(fs, STEP_WRITE);
+				break;
+			}
+
+			// All data has been written, so the new file's blocks can now be
+			// linked together in the directory. The cache flushes modified
+			// sectors in ascending order, so the entries other than the first
+			// one are written back in a separate pass; until the first entry is
+			// written, they are not reachable and the file remains invisible.
+			if (fs->numBlocks == 1) {
+				_commitFile(fs);
+				break;
+			}
+
+			for (int i = 1; i < fs->numBlocks; i++) {
+				bool last = (i == (fs->numBlocks - 1));
+
+				_setEntry(
+					&fs->entries[fs->chain[i]],
+					last ? MEMCARD_BLOCK_LAST : MEMCARD_BLOCK_MIDDLE,
+					0,
+					last ? NO_BLOCK : fs->chain[i + 1],
+					0
+				);
+			}
+
+			_queueWrite(fs, STEP_LINK);
+			break;
+
+		case STEP_LINK:
+			_commitFile(fs);
+			break;
+
+		case STEP_COMMIT:
+			if (fs->oldFirstBlock == NO_FILE) {
+				_finish(fs, MEMCARD_OK);
+				break;
+			}
+
+			// Delete the old copy of the file, if any. Its entries were not
+			// touched by the commit, so its chain is still valid.
+			int length = _followChain(fs, fs->oldFirstBlock, fs->chain);
+
+			if (length > 0)
+				_deleteChain(fs, fs->chain, length);
+
+			_queueWrite(fs, STEP_DELETE);
+			break;
+
+		case STEP_DELETE:
+			_finish(fs, MEMCARD_OK);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static bool _beginOp(
+	MemCardFS         *fs,
+	FSStep            step,
+	MemCardFSCallback callback,
+	void              *arg
+) {
+	fs->step         = step;
+	fs->checking     = false;
+	fs->status       = MEMCARD_PENDING;
+	fs->callback     = callback;
+	fs->arg          = arg;
+	fs->currentBlock = 0;
+
+	if ((step != STEP_MOUNT) && !fs->mounted) {
+		_finish(fs, MEMCARD_NO_CARD);
+		return false;
+	}
+
+	return true;
+}
+
+/* Public API */
+
+void mountMemCardFS(
+	MemCardFS         *fs,
+	int               port,
+	MemCardFSCallback callback,
+	void              *arg
+) {
+	fs->port    = port;
+	fs->mounted = false;
+
+	_beginOp(fs, STEP_MOUNT, callback, arg);
+
+	// The card may have been swapped since it was last accessed, so make sure
+	// the directory is actually read from it rather than from the cache.
+	invalidateMemCardCache(port);
+
+	_queueOp(
+		&fs->ops[0],
+		fs,
+		MEMCARD_OP_READ,
+		0,
+		1,
+		fs->header,
+		false
+	);
+	_queueOp(
+		&fs->ops[1],
+		fs,
+		MEMCARD_OP_READ,
+		1,
+		MEMCARD_NUM_BLOCKS,
+		fs->entries,
+		true
+	);
+}
+
+bool isMemCardFSBusy(const MemCardFS *fs) {
+	return (fs->status == MEMCARD_PENDING);
+}
+
+int getMemCardFreeBlocks(const MemCardFS *fs) {
+	int count = 0;
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		if (_isFreeEntry(&fs->entries[i]))
+			count++;
+	}
+
+	return count;
+}
+
+int findMemCardFile(const MemCardFS *fs, const char *name) {
+	uint8_t chain[MEMCARD_NUM_BLOCKS];
+
+	for (int i = 0; i < MEMCARD_NUM_BLOCKS; i++) {
+		const MemCardDirEntry *entry = &fs->entries[i];
+
+		if (!_isValidEntry(entry) || (entry->state != MEMCARD_BLOCK_FIRST))
+			continue;
+		if (strncmp(entry->name, name, MEMCARD_MAX_NAME_LENGTH))
+			continue;
+
+		// Skip any copy whose chain is broken, e.g. an old copy of a file that
+		// was only partially deleted after being replaced.
+		if (_followChain(fs, i, chain) > 0)
+			return i;
+	}
+
+	return -1;
+}
+
+void readMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	void              *output,
+	MemCardFSCallback callback,
+	void              *arg
+) {
+	if (!_beginOp(fs, STEP_READ, callback, arg))
+		return;
+
+	int first = findMemCardFile(fs, name);
+
+	if (first < 0) {
+		_finish(fs, MEMCARD_FILE_NOT_FOUND);
+		return;
+	}
+
+	int length = _followChain(fs, first, fs->chain);
+
+	if (length < 0) {
+		_finish(fs, MEMCARD_CORRUPTED);
+		return;
+	}
+
+	fs->numBlocks = length;
+	fs->buffer    = (uint8_t *) output;
+	_advance(fs);
+}
+
+void writeMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	const void        *data,
+	size_t            length,
+	MemCardFSCallback callback,
+	void              *arg
+) {
+	if (!_beginOp(fs, STEP_WRITE, callback, arg))
+		return;
+
+	int numBlocks = (length + MEMCARD_BLOCK_SIZE - 1) / MEMCARD_BLOCK_SIZE;
+	int first     = findMemCardFile(fs, name);
+
+	if (!numBlocks)
+		numBlocks = 1;
+
+	// Allocate the new file's blocks from free space only. The old copy's
+	// blocks are not free at this point, so they cannot be picked.
+	int count = 0;
+
+	for (int i = 0; (i < MEMCARD_NUM_BLOCKS) && (count < numBlocks); i++) {
+		if (_isFreeEntry(&fs->entries[i]))
+			fs->chain[count++] = i;
+	}
+
+	if (count < numBlocks) {
+		_finish(fs, MEMCARD_NO_SPACE);
+		return;
+	}
+
+	// Keep a copy of the name until the directory is updated, so that the
+	// caller's string does not have to remain valid.
+	memset(fs->name, 0, sizeof(fs->name));
+	strncpy(fs->name, name, MEMCARD_MAX_NAME_LENGTH);
+
+	fs->numBlocks     = numBlocks;
+	fs->oldFirstBlock = (first < 0) ? NO_FILE : first;
+	fs->buffer        = (uint8_t *) data;
+	_advance(fs);
+}
+
+void deleteMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	MemCardFSCallback callback,
+	void              *arg
+) {
+	if (!_beginOp(fs, STEP_DELETE, callback, arg))
+		return;
+
+	int first = findMemCardFile(fs, name);
+
+	if (first < 0) {
+		_finish(fs, MEMCARD_FILE_NOT_FOUND);
+		return;
+	}
+
+	int length = _followChain(fs, first, fs->chain);
+
+	if (length < 0) {
+		_finish(fs, MEMCARD_CORRUPTED);
+		return;
+	}
+
+	_deleteChain(fs, fs->chain, length);
+	_queueWrite(fs, STEP_DELETE);
+}
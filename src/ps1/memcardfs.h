@@ -0,0 +1,191 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ps1/memcard.h"
+
+// A card is split into 16 blocks of 8 KB each. The first block holds the
+// header and directory, leaving 15 blocks (each one described by a directory
+// entry) for save files.
+#define MEMCARD_BLOCK_SIZE        8192
+#define MEMCARD_SECTORS_PER_BLOCK (MEMCARD_BLOCK_SIZE / MEMCARD_SECTOR_SIZE)
+#define MEMCARD_NUM_BLOCKS        15
+#define MEMCARD_MAX_NAME_LENGTH   20
+
+typedef enum {
+	MEMCARD_BLOCK_FREE           = 0xa0,
+	MEMCARD_BLOCK_FIRST          = 0x51,
+	MEMCARD_BLOCK_MIDDLE         = 0x52,
+	MEMCARD_BLOCK_LAST           = 0x53,
+	MEMCARD_BLOCK_DELETED_FIRST  = 0xa1,
+	MEMCARD_BLOCK_DELETED_MIDDLE = 0xa2,
+	MEMCARD_BLOCK_DELETED_LAST   = 0xa3
+} MemCardBlockState;
+
+typedef struct {
+	uint32_t state;     // One of the MemCardBlockState values
+	uint32_t length;    // File length in bytes (only set in the first block)
+	uint16_t nextBlock; // Index of the next block's entry, 0xffff if none
+	char     name[MEMCARD_MAX_NAME_LENGTH + 1];
+	uint8_t  _reserved[96];
+	uint8_t  checksum;  // XOR of all previous bytes
+} MemCardDirEntry;
+
+typedef struct MemCardFS MemCardFS;
+typedef void (*MemCardFSCallback)(MemCardFS *fs);
+
+struct MemCardFS {
+	uint8_t          port;
+	bool             mounted;
+	uint8_t          header[MEMCARD_SECTOR_SIZE];
+	MemCardDirEntry  entries[MEMCARD_NUM_BLOCKS];
+
+	// Result of the last operation, MEMCARD_PENDING while it is in progress.
+	volatile uint8_t status;
+
+	// Internal state of the current operation.
+	MemCardFSCallback callback;
+	void              *arg;
+	MemCardOp         ops[2];
+	uint8_t           step, numBlocks, currentBlock, oldFirstBlock;
+	bool              checking;
+	uint8_t           chain[MEMCARD_NUM_BLOCKS];
+	char              name[MEMCARD_MAX_NAME_LENGTH + 1];
+	uint8_t           *buffer;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reads the header and directory of the card in the given port into the
+ * filesystem structure. All other functions require the card to have been
+ * mounted successfully (i.e. the status to be MEMCARD_OK); the card must be
+ * mounted again if it is removed and reinserted. The callback is invoked once
+ * the operation has completed or failed, usually from the interrupt handler.
+ *
+ * Mounting a card also writes to it, both to allow any later operation to
+ * detect that the card has been swapped (in which case it fails with
+ * MEMCARD_CARD_CHANGED and the card is unmounted) and to clean up leftovers of
+ * writes that were previously interrupted. Operations that write to the card
+ * check for a swapped card before each data block and directory update, so
+ * that nothing is written to a card other than the mounted one.
+ *
+ * @param fs
+ * @param port
+ * @param callback Optional
+ * @param arg
+ */
+void mountMemCardFS(
+	MemCardFS         *fs,
+	int               port,
+	MemCardFSCallback callback,
+	void              *arg
+);
+
+/**
+ * @brief Returns whether an operation is in progress on the filesystem. No
+ * other operation may be started until the previous one has completed.
+ */
+bool isMemCardFSBusy(const MemCardFS *fs);
+
+/**
+ * @brief Returns the number of blocks not currently allocated to any file.
+ */
+int getMemCardFreeBlocks(const MemCardFS *fs);
+
+/**
+ * @brief Looks up a file by name in the mounted directory, without accessing
+ * the card. Files whose chain of blocks is broken are ignored.
+ *
+ * @param fs
+ * @param name
+ * @return Index of the file's first directory entry, -1 if not found
+ */
+int findMemCardFile(const MemCardFS *fs, const char *name);
+
+/**
+ * @brief Reads an entire file into the given buffer, which must be large enough
+ * to hold the file's length as stored in its directory entry (always a
+ * multiple of MEMCARD_BLOCK_SIZE).
+ *
+ * @param fs
+ * @param name
+ * @param output
+ * @param callback Optional
+ * @param arg
+ */
+void readMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	void              *output,
+	MemCardFSCallback callback,
+	void              *arg
+);
+
+/**
+ * @brief Creates a file or replaces an existing one with the same name. The
+ * length is rounded up to a multiple of MEMCARD_BLOCK_SIZE and the data buffer
+ * must be at least as long as the rounded length.
+ *
+ * The new contents are always written to free blocks, and the directory is
+ * only updated once all of them have been written successfully; the old copy
+ * of the file (if any) is deleted last. If the operation is interrupted, e.g.
+ * by the card being removed, the card is thus left with either the old or the
+ * new version of the file but never a partially written one; if both copies
+ * end up on the card, the one found first is kept and the other one is
+ * deleted the next time the card is mounted. As a consequence, replacing a
+ * file requires enough free space to hold both copies at the same time.
+ *
+ * @param fs
+ * @param name
+ * @param data
+ * @param length
+ * @param callback Optional
+ * @param arg
+ */
+void writeMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	const void        *data,
+	size_t            length,
+	MemCardFSCallback callback,
+	void              *arg
+);
+
+/**
+ * @brief Deletes a file by marking all of its directory entries as deleted.
+ *
+ * @param fs
+ * @param name
+ * @param callback Optional
+ * @param arg
+ */
+void deleteMemCardFile(
+	MemCardFS         *fs,
+	const char        *name,
+	MemCardFSCallback callback,
+	void              *arg
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,410 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Each port is polled using a single transfer, regardless of whether a multitap
+ * is connected to it or not. Setting the second byte of a poll request (the
+ * "multitap address") to 1 makes the multitap reply with its own ID (0x80),
+ * followed by the responses of all four controllers connected to it, each
+ * padded to 8 bytes; the request is extended accordingly to include four poll
+ * commands, one for each slot. Regular controllers ignore the multitap address
+ * and stop acknowledging bytes once their own response is over, so the same
+ * request can be sent to both without knowing in advance what is connected.
+ *
+ * Analog controllers can additionally be configured by sending a short
+ * sequence of commands: entering configuration mode, switching to analog mode
+ * (and optionally locking it), mapping the vibration motors to bytes 2 and 3 of
+ * the poll request and finally leaving configuration mode. The sequence is sent
+ * once whenever a controller is connected, one command per transfer in between
+ * polls; afterwards the motor speeds are simply included in each poll request.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/pad.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+#define MULTITAP_ID          0x80
+#define MULTITAP_SLOT_LENGTH 8
+#define MULTITAP_LENGTH      (2 + PAD_NUM_SLOTS * MULTITAP_SLOT_LENGTH)
+
+#define CONFIG_MODE_ID 0xf3
+#define CONFIG_LENGTH  8
+
+typedef enum {
+	CONFIG_STEP_ENTER    = 0,
+	CONFIG_STEP_ANALOG   = 1,
+	CONFIG_STEP_MOTORS   = 2,
+	CONFIG_STEP_PRESSURE = 3,
+	CONFIG_STEP_EXIT     = 4,
+	CONFIG_STEP_DONE     = 5
+} ConfigStep;
+
+typedef struct {
+	uint8_t      flags, state, step;
+	bool         supported;
+	SIO0Transfer transfer;
+	uint8_t      request[CONFIG_LENGTH], response[CONFIG_LENGTH];
+} PadConfig;
+
+// The states of all controllers are double buffered: the transfers started by
+// startPadPoll() are decoded into the back buffer, which is then swapped with
+// the front buffer once all ports have been polled.
+static PadState     _states[2][PAD_NUM_PORTS][PAD_NUM_SLOTS];
+static volatile int _frontBuffer = 0;
+
+static uint8_t      _requests[PAD_NUM_PORTS][MULTITAP_LENGTH];
+static uint8_t      _responses[PAD_NUM_PORTS][MULTITAP_LENGTH];
+static bool         _multitapConnected[PAD_NUM_PORTS];
+
+static SIO0Transfer _transfers[PAD_NUM_PORTS];
+static volatile int _pendingPorts = 0;
+static uint32_t     _pollDuration = 0, _pollLength = 0;
+static PadPollStats _stats;
+
+static PadPollCallback _pollCallbackFunc = 0;
+static void            *_pollCallbackArg = 0;
+
+static PadConfig    _configs[PAD_NUM_PORTS];
+static uint8_t      _motors[PAD_NUM_PORTS][2];
+
+static void _decodeSlot(PadState *state, const uint8_t *data, int length) {
+	if (length > PAD_MAX_RESPONSE_LENGTH)
+		length = PAD_MAX_RESPONSE_LENGTH;
+
+	// All controllers reply with at least 4 bytes of data. The first byte
+	// contains the device type ID in its upper nibble, while bytes 2 and 3 hold
+	// the state of all buttons as an active low bitfield. Empty multitap slots
+	// return 0xff in place of the ID.
+	if ((length < 4) || (data[0] == 0xff)) {
+		state->connected = false;
+		state->type      = 0;
+		state->buttons   = 0;
+		state->length    = 0;
+		return;
+	}
+
+	state->connected = true;
+	state->type      = data[0] >> 4;
+	state->buttons   = (data[2] | (data[3] << 8)) ^ 0xffff;
+	state->length    = length;
+
+	memcpy(state->data, data, length);
+}
+
+/* Configuration sequence */
+
+static void _configCallback(SIO0Transfer *transfer);
+
+static bool _buildConfigRequest(PadConfig *config, uint8_t *request) {
+	int flags = config->flags;
+
+	memset(request, 0, CONFIG_LENGTH);
+
+	switch (config->step) {
+		case CONFIG_STEP_ENTER:
+			request[0] = SIO0_CMD_CONFIG_MODE;
+			request[2] = 0x01; // Enter configuration mode
+			return true;
+
+		case CONFIG_STEP_ANALOG:
+			if (!(flags & (PAD_CONFIG_ANALOG | PAD_CONFIG_LOCK)))
+				return false;
+
+			request[0] = SIO0_CMD_SET_ANALOG;
+			request[2] = (flags & PAD_CONFIG_ANALOG) ? 0x01 : 0x00;
+			request[3] = (flags & PAD_CONFIG_LOCK)   ? 0x03 : 0x02;
+			return true;
+
+		case CONFIG_STEP_MOTORS:
+			if (!(flags & PAD_CONFIG_MOTORS))
+				return false;
+
+			// Map the small motor to byte 2 of the poll request and the large
+			// one to byte 3, leaving the remaining bytes unmapped.
+			memset(&request[2], 0xff, CONFIG_LENGTH - 2);
+			request[0] = SIO0_CMD_REQUEST_CONFIG;
+			request[2] = 0x00;
+			request[3] = 0x01;
+			return true;
+
+		case CONFIG_STEP_PRESSURE:
+			if (!(flags & PAD_CONFIG_PRESSURE))
+				return false;
+
+			// Enable all 18 bytes of the extended response (buttons, sticks
+			// and the pressure of each button).
+			request[0] = SIO0_CMD_RESPONSE_CONFIG;
+			request[2] = 0xff;
+			request[3] = 0xff;
+			request[4] = 0x03;
+			return true;
+
+		case CONFIG_STEP_EXIT:
+			memset(&request[2], 0x5a, CONFIG_LENGTH - 2);
+			request[0] = SIO0_CMD_CONFIG_MODE;
+			request[2] = 0x00; // Leave configuration mode
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static void _sendConfigCommand(int port) {
+	PadConfig *config = &_configs[port];
+
+	// Skip any steps that have not been requested.
+	while (config->step < CONFIG_STEP_DONE) {
+		if (_buildConfigRequest(config, config->request))
+			break;
+
+		config->step++;
+	}
+
+	if (config->step >= CONFIG_STEP_DONE) {
+		config->state = config->supported
+			? PAD_CONFIG_STATE_DONE
+			: PAD_CONFIG_STATE_UNSUPPORTED;
+		return;
+	}
+
+	SIO0Transfer *transfer = &config->transfer;
+
+	transfer->port          = port;
+	transfer->address       = SIO0_ADDR_CONTROLLER;
+	transfer->reqLength     = CONFIG_LENGTH;
+	transfer->maxRespLength = CONFIG_LENGTH;
+	transfer->request       = config->request;
+	transfer->response      = config->response;
+	transfer->callback      = &_configCallback;
+	transfer->arg           = 0;
+
+	queueSIO0Transfer(transfer);
+}
+
+static void _configCallback(SIO0Transfer *transfer) {
+	PadConfig *config = &_configs[transfer->port];
+
+	// The response to the command that enters configuration mode is a regular
+	// poll response. All other commands must be answered with the
+	// configuration mode ID; if they are not, the controller does not support
+	// configuration (or has been disconnected) and the sequence is aborted.
+	if (
+		(config->step != CONFIG_STEP_ENTER) &&
+		(config->step != CONFIG_STEP_EXIT) && (
+			(transfer->respLength < 2) ||
+			(config->response[0] != CONFIG_MODE_ID)
+		)
+	) {
+		config->supported = false;
+		config->step      = CONFIG_STEP_EXIT;
+	} else {
+		config->step++;
+	}
+
+	_sendConfigCommand(transfer->port);
+}
+
+static void _updateConfig(int port, bool connected) {
+	PadConfig *config = &_configs[port];
+
+	// Never interrupt a sequence in progress, as its transfer may still be in
+	// the queue. If the controller has been disconnected in the meantime, the
+	// sequence will fail and be restarted once it is reconnected.
+	if (config->state == PAD_CONFIG_STATE_BUSY)
+		return;
+
+	if (!connected || !config->flags) {
+		config->state = PAD_CONFIG_STATE_NONE;
+		return;
+	}
+	if (config->state != PAD_CONFIG_STATE_NONE)
+		return;
+
+	config->state     = PAD_CONFIG_STATE_BUSY;
+	config->step      = CONFIG_STEP_ENTER;
+	config->supported = true;
+	_sendConfigCommand(port);
+}
+
+/* Polling */
+
+static void _pollCallback(SIO0Transfer *transfer) {
+	int           port   = transfer->port;
+	PadState      *slots = _states[_frontBuffer ^ 1][port];
+	const uint8_t *data  = transfer->response;
+	int           length = transfer->respLength;
+
+	_multitapConnected[port] =
+		(length >= MULTITAP_LENGTH) && (data[0] == MULTITAP_ID);
+
+	if (_multitapConnected[port]) {
+		data += 2;
+
+		for (int i = 0; i < PAD_NUM_SLOTS; i++) {
+			// Each slot's length is derived from the lower nibble of its ID
+			// byte, which holds the payload length in 2-byte units.
+			int slotLength = 2 + (data[0] & 15) * 2;
+
+			if (slotLength > MULTITAP_SLOT_LENGTH)
+				slotLength = MULTITAP_SLOT_LENGTH;
+
+			_decodeSlot(&slots[i], data, slotLength);
+			data += MULTITAP_SLOT_LENGTH;
+		}
+
+		_updateConfig(port, false);
+	} else {
+		_decodeSlot(&slots[0], data, length);
+
+		for (int i = 1; i < PAD_NUM_SLOTS; i++)
+			_decodeSlot(&slots[i], 0, 0);
+
+		_updateConfig(port, slots[0].connected);
+	}
+
+	_pollDuration += transfer->duration;
+	_pollLength   += transfer->respLength;
+
+	if (--_pendingPorts)
+		return;
+
+	// All ports have been polled, so swap the buffers and update statistics.
+	_frontBuffer ^= 1;
+
+	_stats.completedPolls++;
+	_stats.lastLength  = _pollLength;
+	_stats.lastLatency = _pollDuration;
+
+	if (_pollDuration < _stats.minLatency)
+		_stats.minLatency = _pollDuration;
+	if (_pollDuration > _stats.maxLatency)
+		_stats.maxLatency = _pollDuration;
+
+	if (_pollCallbackFunc)
+		_pollCallbackFunc(_pollCallbackArg);
+}
+
+static int _buildRequest(int port) {
+	uint8_t *request = _requests[port];
+
+	memset(request, 0, MULTITAP_LENGTH);
+
+	request[0] = SIO0_CMD_POLL;
+	request[1] = 0x01; // Multitap address
+
+	// If a multitap was found during the previous poll, fill in the commands to
+	// be forwarded to each slot and let the transfer run for the full length of
+	// the multitap's response. Otherwise, the request is the same as a regular
+	// poll (including the motor speeds) and the transfer is allowed to continue
+	// for as long as the controller keeps sending data.
+	if (!_multitapConnected[port]) {
+		request[2] = _motors[port][0];
+		request[3] = _motors[port][1];
+		return 4;
+	}
+
+	for (int i = 0; i < PAD_NUM_SLOTS; i++)
+		request[2 + i * MULTITAP_SLOT_LENGTH] = SIO0_CMD_POLL;
+
+	return MULTITAP_LENGTH;
+}
+
+void initPads(void) {
+	memset(_states, 0, sizeof(_states));
+	memset(_multitapConnected, 0, sizeof(_multitapConnected));
+	memset(_configs, 0, sizeof(_configs));
+	memset(_motors, 0, sizeof(_motors));
+	memset(&_stats, 0, sizeof(_stats));
+
+	_stats.minLatency = UINT32_MAX;
+	_frontBuffer      = 0;
+	_pendingPorts     = 0;
+}
+
+bool startPadPoll(void) {
+	if (_pendingPorts) {
+		_stats.skippedPolls++;
+		return false;
+	}
+
+	_pendingPorts = PAD_NUM_PORTS;
+	_pollDuration = 0;
+	_pollLength   = 0;
+
+	for (int i = 0; i < PAD_NUM_PORTS; i++) {
+		SIO0Transfer *transfer = &_transfers[i];
+
+		transfer->port          = i;
+		transfer->address       = SIO0_ADDR_CONTROLLER;
+		transfer->reqLength     = _buildRequest(i);
+		transfer->maxRespLength = MULTITAP_LENGTH;
+		transfer->request       = _requests[i];
+		transfer->response      = _responses[i];
+		transfer->callback      = &_pollCallback;
+		transfer->arg           = 0;
+
+		queueSIO0Transfer(transfer);
+	}
+
+	return true;
+}
+
+const PadState *getPadState(int port, int slot) {
+	return &_states[_frontBuffer][port][slot];
+}
+
+bool isMultitapConnected(int port) {
+	return _multitapConnected[port];
+}
+
+const PadPollStats *getPadPollStats(void) {
+	return &_stats;
+}
+
+void setPadPollCallback(PadPollCallback callback, void *arg) {
+	bool enabled = disableInterrupts();
+
+	_pollCallbackFunc = callback;
+	_pollCallbackArg  = arg;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void setPadConfig(int port, unsigned int flags) {
+	PadConfig *config = &_configs[port];
+
+	// Force the configuration to be sent again on the next poll, unless a
+	// sequence is already in progress (in which case the new flags will be
+	// picked up by its remaining steps).
+	config->flags = flags;
+
+	if (config->state != PAD_CONFIG_STATE_BUSY)
+		config->state = PAD_CONFIG_STATE_NONE;
+}
+
+PadConfigState getPadConfigState(int port) {
+	return _configs[port].state;
+}
+
+void setPadVibration(int port, bool small, uint8_t large) {
+	_motors[port][0] = small ? 0xff : 0x00;
+	_motors[port][1] = large;
+}
@@ -0,0 +1,181 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PAD_NUM_PORTS           2
+#define PAD_NUM_SLOTS           4
+#define PAD_MAX_RESPONSE_LENGTH 20
+
+typedef enum {
+	PAD_SELECT   = 1 <<  0,
+	PAD_L3       = 1 <<  1,
+	PAD_R3       = 1 <<  2,
+	PAD_START    = 1 <<  3,
+	PAD_UP       = 1 <<  4,
+	PAD_RIGHT    = 1 <<  5,
+	PAD_DOWN     = 1 <<  6,
+	PAD_LEFT     = 1 <<  7,
+	PAD_L2       = 1 <<  8,
+	PAD_R2       = 1 <<  9,
+	PAD_L1       = 1 << 10,
+	PAD_R1       = 1 << 11,
+	PAD_TRIANGLE = 1 << 12,
+	PAD_CIRCLE   = 1 << 13,
+	PAD_CROSS    = 1 << 14,
+	PAD_SQUARE   = 1 << 15
+} PadButton;
+
+typedef enum {
+	PAD_CONFIG_ANALOG   = 1 << 0, // Switch the controller to analog mode
+	PAD_CONFIG_LOCK     = 1 << 1, // Disable the analog mode button
+	PAD_CONFIG_MOTORS   = 1 << 2, // Map vibration motors onto poll requests
+	PAD_CONFIG_PRESSURE = 1 << 3  // Report pressure (DualShock 2 only)
+} PadConfigFlag;
+
+typedef enum {
+	PAD_CONFIG_STATE_NONE        = 0, // No controller or no config requested
+	PAD_CONFIG_STATE_BUSY        = 1, // Configuration sequence in progress
+	PAD_CONFIG_STATE_DONE        = 2,
+	PAD_CONFIG_STATE_UNSUPPORTED = 3  // Controller has no configuration mode
+} PadConfigState;
+
+typedef struct {
+	bool     connected;
+	uint8_t  type;    // Device type ID (upper nibble of the first byte)
+	uint16_t buttons; // Bitfield of currently pressed buttons (active high)
+
+	// Raw poll response, including the type and button bytes. Analog
+	// controllers report their stick positions in bytes 4-7.
+	uint8_t  length;
+	uint8_t  data[PAD_MAX_RESPONSE_LENGTH];
+} PadState;
+
+typedef void (*PadPollCallback)(void *arg);
+
+typedef struct {
+	uint32_t completedPolls, skippedPolls;
+
+	// Total number of bytes exchanged over the bus by the most recent poll.
+	// This is at most 2 + 4 * 8 bytes per port, reached when a multitap is
+	// connected.
+	uint32_t lastLength;
+
+	// Time taken by the most recent poll, as well as the shortest and longest
+	// ones so far, in CPU cycles. This includes all delays and timeouts, i.e.
+	// it is the time between startPadPoll() being called and the new state
+	// becoming available (if the bus was idle).
+	uint32_t lastLatency, minLatency, maxLatency;
+} PadPollStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Clears the state of all controllers. initSIO0() must have been called
+ * prior to this.
+ */
+void initPads(void);
+
+/**
+ * @brief Starts polling all controller ports in the background. Meant to be
+ * called once per frame from the vertical blank interrupt handler; the new
+ * state becomes available through getPadState() once all ports have been
+ * polled, typically about a millisecond later. If the previous poll is still
+ * in progress (e.g. due to a memory card transfer occupying the bus) the call
+ * is ignored and counted as skipped.
+ *
+ * @return True if a new poll was started, false otherwise
+ */
+bool startPadPoll(void);
+
+/**
+ * @brief Returns the latest complete state of the controller in the given
+ * port and multitap slot. This function never blocks. The returned structure
+ * is double buffered and will not be modified until the poll after the next
+ * one completes. Controllers connected directly to a port (with no multitap)
+ * are always reported in slot 0.
+ *
+ * @param port
+ * @param slot
+ * @return Pointer to the controller's state
+ */
+const PadState *getPadState(int port, int slot);
+
+/**
+ * @brief Returns whether a multitap was detected in the given port during the
+ * last poll. Controllers connected to a newly inserted multitap show up on the
+ * poll after the one that detected it.
+ *
+ * @param port
+ */
+bool isMultitapConnected(int port);
+
+/**
+ * @brief Returns polling statistics, including the latency of the most recent
+ * poll.
+ */
+const PadPollStats *getPadPollStats(void);
+
+/**
+ * @brief Registers a function to be called from the interrupt handler each time
+ * a poll completes and the new state becomes available through getPadState().
+ * Can be used to timestamp polls or to react to input as soon as possible.
+ *
+ * @param callback
+ * @param arg Arbitrary argument passed to the callback
+ */
+void setPadPollCallback(PadPollCallback callback, void *arg);
+
+/**
+ * @brief Sets the configuration to be applied to the controller connected to
+ * the given port. The configuration is sent in the background as soon as a
+ * controller is detected and again whenever it is reconnected, so this only
+ * needs to be called once. Only controllers connected directly to a port (not
+ * through a multitap) are configured.
+ *
+ * @param port
+ * @param flags Combination of PadConfigFlag values, 0 to disable
+ */
+void setPadConfig(int port, unsigned int flags);
+
+/**
+ * @brief Returns the progress of the configuration sequence for the controller
+ * connected to the given port.
+ *
+ * @param port
+ */
+PadConfigState getPadConfigState(int port);
+
+/**
+ * @brief Sets the speed of the vibration motors of the controller connected to
+ * the given port. The values are sent as part of each poll request, so this
+ * does not cause any additional bus traffic. Vibration only works once the
+ * controller has been configured with PAD_CONFIG_MOTORS.
+ *
+ * @param port
+ * @param small True to turn on the small (high frequency) motor
+ * @param large Speed of the large motor, 0 to turn it off
+ */
+void setPadVibration(int port, bool small, uint8_t large);
+
+#ifdef __cplusplus
+}
+#endif
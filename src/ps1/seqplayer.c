@@ -0,0 +1,575 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A simple MIDI-like sequence player, driving a fixed set of SPU channels from
+ * the timer 2 interrupt. Sequences are generated from standard MIDI files by
+ * tools/convertMIDI.py, which resolves tempo changes and converts all delays
+ * into ticks at a fixed rate (usually 100-250 per second), while instrument
+ * banks are built from a JSON manifest and a set of samples by
+ * tools/buildSoundBank.py.
+ *
+ * Running the player from a timer rather than from the main loop ensures that
+ * music keeps playing at the correct speed even if the game drops frames, but
+ * also means any time it takes is stolen from whatever the main loop is doing.
+ * The work done in each tick is thus kept small and bounded: at most
+ * SEQ_MAX_EVENTS_PER_TICK events are processed (any further events are
+ * delayed by a tick), followed by one envelope update per voice. Pitches are
+ * calculated using small precomputed tables rather than exponentiation, and
+ * volume registers are only written when their value changes. The time taken
+ * by each tick is measured and reported in the player's statistics.
+ *
+ * Rather than using the SPU's hardware envelope, whose rates are expressed in
+ * an awkward exponential format and cannot be changed once a note has started,
+ * each voice has a software ADSR envelope stored as a 20-bit fixed point level
+ * which is applied by scaling the channel's volume registers on every tick.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ps1/registers.h"
+#include "ps1/seqplayer.h"
+#include "ps1/spu.h"
+#include "ps1/system.h"
+
+#define SEMITONE_STEPS 16
+#define OCTAVE_STEPS   (12 * SEMITONE_STEPS)
+#define MAX_PITCH      0x3fff
+
+// The slowest rate timer 2 can fire at using the 1/8 prescaler.
+#define MIN_TICK_RATE (((F_CPU / 8) + 0xfffe) / 0xffff)
+
+// Pitch multipliers (in 4.12 fixed point format) for each semitone within an
+// octave and for each 1/16 semitone step.
+static const uint16_t _semitoneTable[12] = {
+	4096, 4340, 4598, 4871, 5161, 5468, 5793, 6137, 6502, 6889, 7298, 7732
+};
+static const uint16_t _fineTable[SEMITONE_STEPS] = {
+	4096, 4111, 4126, 4141, 4156, 4171, 4186, 4201,
+	4216, 4231, 4247, 4262, 4277, 4293, 4308, 4324
+};
+
+/* Voice helpers */
+
+static uint16_t _getPitch(uint16_t basePitch, int offset) {
+	// Split the offset (in 1/16 semitone units) into a number of octaves and a
+	// position within the octave. The offset is never larger than a few
+	// hundred steps, so this loop only runs a handful of times at most.
+	int octave = 0;
+
+	while (offset < 0) {
+		offset += OCTAVE_STEPS;
+		octave--;
+	}
+	while (offset >= OCTAVE_STEPS) {
+		offset -= OCTAVE_STEPS;
+		octave++;
+	}
+
+	uint32_t pitch = basePitch;
+
+	pitch = (pitch * _semitoneTable[offset / SEMITONE_STEPS]) >> 12;
+	pitch = (pitch * _fineTable    [offset % SEMITONE_STEPS]) >> 12;
+
+	if (octave >= 0)
+		pitch <<= octave;
+	else
+		pitch >>= -octave;
+
+	return (pitch > MAX_PITCH) ? MAX_PITCH : pitch;
+}
+
+static void _updatePitch(const SeqPlayer *player, const SeqVoice *voice) {
+	const SeqInstrument *instrument = voice->instrument;
+	int                 offset      = player->channels[voice->channel].bend;
+
+	// Drums are always played at their root pitch.
+	if (voice->channel != SEQ_DRUM_CHANNEL)
+		offset += (voice->note - instrument->rootNote) * SEMITONE_STEPS;
+
+	SPU_CH_FREQ(voice->spuChannel) = _getPitch(instrument->basePitch, offset);
+}
+
+static int32_t _getEnvelopeStep(const SeqPlayer *player, int time) {
+	// Convert a time in milliseconds into the amount the level has to change
+	// by on each tick in order to go from zero to full volume (or vice versa)
+	// in that time.
+	int ticks = (time * player->tickRate) / 1000;
+
+	if (ticks <= 1)
+		return SEQ_ENV_MAX;
+
+	return SEQ_ENV_MAX / ticks;
+}
+
+static SeqVoice *_allocateVoice(SeqPlayer *player) {
+	// Use an idle voice if possible, otherwise take over the oldest voice
+	// being released or, failing that, the oldest voice overall.
+	SeqVoice *best = 0;
+
+	for (int i = 0; i < player->numVoices; i++) {
+		SeqVoice *voice = &(player->voices)[i];
+
+		if (voice->state == SEQ_ENV_IDLE)
+			return voice;
+		if (!best) {
+			best = voice;
+			continue;
+		}
+
+		bool releasing     = (voice->state == SEQ_ENV_RELEASE);
+		bool bestReleasing = (best->state  == SEQ_ENV_RELEASE);
+
+		if (releasing != bestReleasing) {
+			if (releasing)
+				best = voice;
+
+			continue;
+		}
+		if (((int16_t) (voice->age - best->age)) < 0)
+			best = voice;
+	}
+
+	return best;
+}
+
+/* Event handlers */
+
+static void _noteOff(SeqPlayer *player, int channel, int note) {
+	for (int i = 0; i < player->numVoices; i++) {
+		SeqVoice *voice = &(player->voices)[i];
+
+		if ((voice->channel != channel) || (voice->note != note))
+			continue;
+		if ((voice->state == SEQ_ENV_IDLE) || (voice->state == SEQ_ENV_RELEASE))
+			continue;
+
+		voice->state = SEQ_ENV_RELEASE;
+	}
+}
+
+static void _noteOn(SeqPlayer *player, int channel, int note, int velocity) {
+	if (!velocity) {
+		_noteOff(player, channel, note);
+		return;
+	}
+
+	const SeqBankHeader *header = player->bank->header;
+	int                 index   = (channel == SEQ_DRUM_CHANNEL)
+		? header->drumMap[note]
+		: header->programMap[player->channels[channel].program];
+
+	if (index >= header->numInstruments)
+		return;
+
+	const SeqInstrument *instrument = &(player->bank->instruments)[index];
+	SeqVoice            *voice      = _allocateVoice(player);
+
+	voice->channel      = channel;
+	voice->note         = note;
+	voice->state        = SEQ_ENV_ATTACK;
+	voice->age          = ++(player->voiceCounter);
+	voice->gain         = velocity * instrument->volume;
+	voice->instrument   = instrument;
+	voice->level        = 0;
+	voice->sustainLevel = (SEQ_ENV_MAX / 127) * instrument->sustain;
+
+	voice->attackStep   = _getEnvelopeStep(player, instrument->attack);
+	voice->decayStep    = _getEnvelopeStep(player, instrument->decay);
+	voice->releaseStep  = _getEnvelopeStep(player, instrument->release);
+
+	// The volume registers are set by the envelope update that follows, before
+	// the channel is actually keyed on.
+	int ch = voice->spuChannel;
+
+	_updatePitch(player, voice);
+	SPU_CH_ADDR(ch) = (player->bank->spuOffset + instrument->offset) / 8;
+
+	player->keyOn  |=   1 << ch;
+	player->keyOff &= ~(1 << ch);
+}
+
+static void _controlChange(
+	SeqPlayer *player,
+	int       channel,
+	int       controller,
+	int       value
+) {
+	switch (controller) {
+		case 7:
+			player->channels[channel].volume = value;
+			break;
+
+		case 10:
+			player->channels[channel].pan = value;
+			break;
+	}
+}
+
+static void _pitchBend(SeqPlayer *player, int channel, int bend) {
+	player->channels[channel].bend = bend;
+
+	for (int i = 0; i < player->numVoices; i++) {
+		const SeqVoice *voice = &(player->voices)[i];
+
+		if ((voice->channel == channel) && (voice->state != SEQ_ENV_IDLE))
+			_updatePitch(player, voice);
+	}
+}
+
+/* Tick processing */
+
+static void _releaseAll(SeqPlayer *player) {
+	for (int i = 0; i < player->numVoices; i++) {
+		SeqVoice *voice = &(player->voices)[i];
+
+		if (voice->state != SEQ_ENV_IDLE)
+			voice->state = SEQ_ENV_RELEASE;
+	}
+}
+
+static void _processEvents(SeqPlayer *player) {
+	if (player->delay) {
+		player->delay--;
+
+		if (player->delay)
+			return;
+	}
+
+	const uint8_t *ptr = player->nextEvent;
+
+	for (int i = 0; i < SEQ_MAX_EVENTS_PER_TICK; i++) {
+		int command = *(ptr++);
+		int channel = command & 15;
+
+		if (command < SEQ_CMD_NOTE_OFF) {
+			if (command) {
+				player->delay     = command;
+				player->nextEvent = ptr;
+				return;
+			}
+
+			// End of sequence reached.
+			if (!player->loopPoint) {
+				player->playing = false;
+				_releaseAll(player);
+				return;
+			}
+
+			ptr = player->loopPoint;
+			continue;
+		}
+
+		switch (command & 0xf0) {
+			case SEQ_CMD_NOTE_OFF:
+				_noteOff(player, channel, ptr[0]);
+				ptr += 1;
+				break;
+
+			case SEQ_CMD_NOTE_ON:
+				_noteOn(player, channel, ptr[0], ptr[1]);
+				ptr += 2;
+				break;
+
+			case SEQ_CMD_CONTROL:
+				_controlChange(player, channel, ptr[0], ptr[1]);
+				ptr += 2;
+				break;
+
+			case SEQ_CMD_PROGRAM:
+				player->channels[channel].program = ptr[0] & 127;
+				ptr += 1;
+				break;
+
+			case SEQ_CMD_PITCH_BEND:
+				_pitchBend(player, channel, (int8_t) ptr[0]);
+				ptr += 1;
+				break;
+
+			case SEQ_CMD_LONG_WAIT:
+				player->delay     = ptr[0] | (ptr[1] << 8);
+				player->nextEvent = ptr + 2;
+
+				if (player->delay)
+					return;
+
+				ptr += 2;
+				break;
+
+			default:
+				// Unknown command, most likely due to corrupted data.
+				player->playing = false;
+				_releaseAll(player);
+				return;
+		}
+	}
+
+	player->nextEvent = ptr;
+	player->stats.deferred++;
+}
+
+static void _updateVoices(SeqPlayer *player) {
+	for (int i = 0; i < player->numVoices; i++) {
+		SeqVoice *voice = &(player->voices)[i];
+
+		switch (voice->state) {
+			case SEQ_ENV_IDLE:
+				continue;
+
+			case SEQ_ENV_ATTACK:
+				voice->level += voice->attackStep;
+
+				if (voice->level >= SEQ_ENV_MAX) {
+					voice->level = SEQ_ENV_MAX;
+					voice->state = SEQ_ENV_DECAY;
+				}
+				break;
+
+			case SEQ_ENV_DECAY:
+				voice->level -= voice->decayStep;
+
+				if (voice->level <= voice->sustainLevel) {
+					voice->level = voice->sustainLevel;
+					voice->state = SEQ_ENV_SUSTAIN;
+				}
+				break;
+
+			case SEQ_ENV_RELEASE:
+				voice->level -= voice->releaseStep;
+
+				if (voice->level <= 0) {
+					voice->level    = 0;
+					voice->state    = SEQ_ENV_IDLE;
+					player->keyOff |= 1 << voice->spuChannel;
+				}
+				break;
+		}
+
+		// Scale the envelope level by the note's velocity, the instrument's
+		// and channel's volume and the master volume, then apply panning.
+		const SeqChannel *channel = &(player->channels)[voice->channel];
+
+		int volume = ((voice->level >> 8) * voice->gain) >> 12;
+		volume     = (volume * channel->volume * player->masterVolume) >> 14;
+
+		int pan   = channel->pan;
+		int left  = (pan <= 64) ? 128 : ((127 - pan) * 2);
+		int right = (pan >= 64) ? 128 : (pan * 2);
+
+		left  = (volume * left)  >> 7;
+		right = (volume * right) >> 7;
+
+		if (left > SPU_MAX_VOLUME)
+			left = SPU_MAX_VOLUME;
+		if (right > SPU_MAX_VOLUME)
+			right = SPU_MAX_VOLUME;
+
+		int ch = voice->spuChannel;
+
+		if (voice->volumeLeft != left) {
+			voice->volumeLeft = left;
+			SPU_CH_VOL_L(ch)  = left;
+		}
+		if (voice->volumeRight != right) {
+			voice->volumeRight = right;
+			SPU_CH_VOL_R(ch)   = right;
+		}
+	}
+}
+
+static void _resetChannels(SeqPlayer *player) {
+	for (int i = 0; i < SEQ_NUM_CHANNELS; i++) {
+		SeqChannel *channel = &(player->channels)[i];
+
+		channel->program = 0;
+		channel->volume  = 100;
+		channel->pan     = 64;
+		channel->bend    = 0;
+	}
+}
+
+static void _silence(SeqPlayer *player) {
+	for (int i = 0; i < player->numVoices; i++) {
+		SeqVoice *voice = &(player->voices)[i];
+
+		voice->state       = SEQ_ENV_IDLE;
+		voice->level       = 0;
+		voice->volumeLeft  = 0;
+		voice->volumeRight = 0;
+
+		SPU_CH_VOL_L(voice->spuChannel) = 0;
+		SPU_CH_VOL_R(voice->spuChannel) = 0;
+	}
+
+	SPU_FLAG_OFF1  = player->channelMask & 0xffff;
+	SPU_FLAG_OFF2  = player->channelMask >> 16;
+	player->keyOn  = 0;
+	player->keyOff = 0;
+}
+
+/* Public API */
+
+bool loadSeqBank(SeqBank *bank, SPUHeap *heap, const void *data) {
+	const SeqBankHeader *header = (const SeqBankHeader *) data;
+
+	if (header->magic != SEQ_BANK_MAGIC)
+		return false;
+
+	bank->header      = header;
+	bank->instruments = (const SeqInstrument *) &header[1];
+	bank->spuOffset   = loadSPUSample(
+		heap,
+		(const uint8_t *) data + header->dataOffset,
+		header->dataLength
+	);
+
+	if (!bank->spuOffset)
+		return false;
+
+	waitForSPUTransfer();
+	return true;
+}
+
+bool initSeqPlayer(SeqPlayer *player, const SeqBank *bank, int numVoices) {
+	uint32_t mask = reserveSPUChannels(numVoices);
+
+	if (!mask)
+		return false;
+
+	player->bank         = bank;
+	player->numVoices    = numVoices;
+	player->playing      = false;
+	player->masterVolume = 127;
+	player->channelMask  = mask;
+	player->voiceCounter = 0;
+
+	SeqVoice *voice = player->voices;
+
+	for (int ch = 0; mask; ch++, mask >>= 1) {
+		if (mask & 1)
+			(voice++)->spuChannel = ch;
+	}
+
+	_resetChannels(player);
+	_silence(player);
+	return true;
+}
+
+bool startSeqPlayer(SeqPlayer *player, const void *sequence) {
+	const SeqHeader *header = (const SeqHeader *) sequence;
+
+	if (header->magic != SEQ_MAGIC)
+		return false;
+	if (header->tickRate < MIN_TICK_RATE)
+		return false;
+
+	stopSeqPlayer(player);
+
+	const uint8_t *events = (const uint8_t *) &header[1];
+
+	player->nextEvent = events;
+	player->loopPoint = (header->loopOffset == SEQ_NO_LOOP)
+		? 0
+		: (events + header->loopOffset);
+	player->tickRate  = header->tickRate;
+	player->delay     = 0;
+
+	player->stats.ticks        = 0;
+	player->stats.deferred     = 0;
+	player->stats.lastTickTime = 0;
+	player->stats.maxTickTime  = 0;
+
+	_resetChannels(player);
+	player->playing = true;
+
+	// Configure timer 2 to count at 1/8 of the CPU clock, reset itself and
+	// fire an interrupt each time the target value is reached.
+	TIMER_CTRL  (2) = 0;
+	TIMER_RELOAD(2) = (F_CPU / 8) / player->tickRate;
+	TIMER_CTRL  (2) = 0
+		| TIMER_CTRL_RELOAD
+		| TIMER_CTRL_IRQ_ON_RELOAD
+		| TIMER_CTRL_IRQ_REPEAT
+		| TIMER_CTRL_PRESCALE;
+
+	IRQ_STAT  = ~(1 << IRQ_TIMER2);
+	IRQ_MASK |= 1 << IRQ_TIMER2;
+	return true;
+}
+
+void stopSeqPlayer(SeqPlayer *player) {
+	bool enabled = disableInterrupts();
+
+	// maskIRQ() is used rather than clearing the bit in IRQ_MASK directly, as
+	// this function may be called from within the timer's own handler.
+	TIMER_CTRL(2) = 0;
+	maskIRQ(IRQ_TIMER2);
+	IRQ_STAT      = ~(1 << IRQ_TIMER2);
+
+	player->playing = false;
+	_silence(player);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void setSeqPlayerVolume(SeqPlayer *player, int volume) {
+	player->masterVolume = volume;
+}
+
+bool handleSeqPlayerInterrupt(SeqPlayer *player) {
+	if (!acknowledgeInterrupt(IRQ_TIMER2))
+		return false;
+
+	uint16_t start = TIMER_VALUE(2);
+
+	if (player->playing)
+		_processEvents(player);
+
+	_updateVoices(player);
+
+	// Key off notes that have finished their release phase, then start new
+	// notes. As all key on and off requests for a tick are written at once,
+	// the same channel is never keyed off and on less than a sample apart.
+	if (player->keyOff) {
+		SPU_FLAG_OFF1  = player->keyOff & 0xffff;
+		SPU_FLAG_OFF2  = player->keyOff >> 16;
+		player->keyOff = 0;
+	}
+	if (player->keyOn) {
+		SPU_FLAG_ON1  = player->keyOn & 0xffff;
+		SPU_FLAG_ON2  = player->keyOn >> 16;
+		player->keyOn = 0;
+	}
+
+	// Measure how long this tick took, taking into account the timer may have
+	// been reset in the meantime if the tick took longer than its period.
+	int elapsed = TIMER_VALUE(2) - start;
+
+	if (elapsed < 0)
+		elapsed += TIMER_RELOAD(2);
+
+	SeqPlayerStats *stats = &player->stats;
+
+	stats->ticks++;
+	stats->lastTickTime = elapsed * 8;
+
+	if (stats->lastTickTime > stats->maxTickTime)
+		stats->maxTickTime = stats->lastTickTime;
+
+	return true;
+}
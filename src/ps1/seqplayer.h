@@ -0,0 +1,223 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ps1/spu.h"
+
+#define SEQ_MAGIC      0x51455350 // "PSEQ"
+#define SEQ_BANK_MAGIC 0x4b4e4250 // "PBNK"
+#define SEQ_NO_LOOP    0xffffffff
+
+#define SEQ_NUM_CHANNELS   16
+#define SEQ_DRUM_CHANNEL    9
+#define SEQ_NO_INSTRUMENT 0xff
+
+// Maximum number of events processed in a single tick. Any further events are
+// deferred to the following ticks, which bounds the time spent in the timer
+// interrupt handler even for pathologically dense sequences.
+#define SEQ_MAX_EVENTS_PER_TICK 32
+
+// Envelope levels are stored as 20-bit fixed point values (SEQ_ENV_MAX = full
+// volume).
+#define SEQ_ENV_MAX (1 << 20)
+
+/* File formats */
+
+// Sequences consist of this header followed by a stream of events. Each event
+// is made up of a command byte followed by its arguments:
+// - 0x00: end of sequence (jump to the loop point if any, stop otherwise)
+// - 0x01-0x7f: wait for the given number of ticks
+// - 0x8c <note>: note off on channel c
+// - 0x9c <note> <velocity>: note on on channel c
+// - 0xbc <controller> <value>: control change on channel c (only volume, 7,
+//   and panning, 10, are supported)
+// - 0xcc <program>: program change on channel c
+// - 0xec <bend>: pitch bend on channel c, in signed 1/16 semitone units
+// - 0xf0 <ticks (2 bytes, little endian)>: wait for longer periods of time
+typedef struct {
+	uint32_t magic;      // Always SEQ_MAGIC
+	uint16_t tickRate;   // Ticks per second
+	uint16_t _reserved;
+	uint32_t loopOffset; // Offset of the loop point in the event stream
+} SeqHeader;
+
+typedef enum {
+	SEQ_CMD_END        = 0x00,
+	SEQ_CMD_NOTE_OFF   = 0x80,
+	SEQ_CMD_NOTE_ON    = 0x90,
+	SEQ_CMD_CONTROL    = 0xb0,
+	SEQ_CMD_PROGRAM    = 0xc0,
+	SEQ_CMD_PITCH_BEND = 0xe0,
+	SEQ_CMD_LONG_WAIT  = 0xf0
+} SeqCommand;
+
+// Instrument banks consist of this header, followed by the instrument table
+// and the ADPCM data of all samples. Each program number (or note on the drum
+// channel) is mapped to an instrument through the program and drum maps.
+typedef struct {
+	uint32_t magic;          // Always SEQ_BANK_MAGIC
+	uint16_t numInstruments;
+	uint16_t _reserved;
+	uint32_t dataOffset;     // Offset of the sample data from the header
+	uint32_t dataLength;
+	uint8_t  programMap[128], drumMap[128];
+} SeqBankHeader;
+
+typedef struct {
+	uint32_t offset;    // Offset of the sample within the bank's sample data
+	uint16_t basePitch; // SPU pitch value at the root note
+	uint8_t  rootNote, volume;
+
+	// Envelope parameters. Times are in milliseconds, while the sustain level
+	// ranges from 0 to 127.
+	uint16_t attack, decay, release;
+	uint8_t  sustain, _reserved;
+} SeqInstrument;
+
+/* Player state */
+
+typedef enum {
+	SEQ_ENV_IDLE    = 0,
+	SEQ_ENV_ATTACK  = 1,
+	SEQ_ENV_DECAY   = 2,
+	SEQ_ENV_SUSTAIN = 3,
+	SEQ_ENV_RELEASE = 4
+} SeqEnvelopeState;
+
+typedef struct {
+	const SeqBankHeader *header;
+	const SeqInstrument *instruments;
+	uint32_t            spuOffset;
+} SeqBank;
+
+typedef struct {
+	uint8_t program, volume, pan;
+	int8_t  bend;
+} SeqChannel;
+
+typedef struct {
+	uint8_t  spuChannel, channel, note, state;
+	uint16_t age, gain;
+	uint16_t volumeLeft, volumeRight;
+
+	// Current envelope level and per-tick increments, in SEQ_ENV_MAX units.
+	int32_t level, sustainLevel;
+	int32_t attackStep, decayStep, releaseStep;
+
+	const SeqInstrument *instrument;
+} SeqVoice;
+
+typedef struct {
+	uint32_t ticks;    // Total number of ticks processed
+	uint32_t deferred; // Ticks which hit the SEQ_MAX_EVENTS_PER_TICK limit
+
+	// Time spent in the interrupt handler for the last tick and the longest
+	// one so far, in CPU cycles.
+	uint32_t lastTickTime, maxTickTime;
+} SeqPlayerStats;
+
+typedef struct {
+	const SeqBank *bank;
+	SeqVoice      voices[SPU_NUM_CHANNELS];
+	int           numVoices;
+	SeqChannel    channels[SEQ_NUM_CHANNELS];
+
+	// Set while the event stream is being played. Once the end of a
+	// non-looping sequence is reached, notes still being released keep being
+	// updated until stopSeqPlayer() is called.
+	volatile bool  playing;
+	uint8_t        masterVolume;
+	SeqPlayerStats stats;
+
+	// Internal state.
+	const uint8_t *nextEvent, *loopPoint;
+	uint16_t      tickRate, delay, voiceCounter;
+	uint32_t      channelMask, keyOn, keyOff;
+} SeqPlayer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Validates an instrument bank and uploads its samples to SPU RAM. The
+ * bank's data must be 4-byte aligned and must not be freed while any player
+ * uses it, as the instrument table is accessed directly from it.
+ *
+ * @param bank
+ * @param heap Heap to allocate space for the samples from
+ * @param data
+ * @return False if the bank is invalid or there is not enough SPU RAM
+ */
+bool loadSeqBank(SeqBank *bank, SPUHeap *heap, const void *data);
+
+/**
+ * @brief Initializes a player using the given bank and reserves the given
+ * number of SPU channels for it (which limits the number of notes that can be
+ * played at the same time). initSPU() must have been called prior to this.
+ *
+ * @param player
+ * @param bank
+ * @param numVoices
+ * @return False if not enough SPU channels are available
+ */
+bool initSeqPlayer(SeqPlayer *player, const SeqBank *bank, int numVoices);
+
+/**
+ * @brief Starts playing a sequence, configuring timer 2 to fire an interrupt
+ * at the sequence's tick rate. handleSeqPlayerInterrupt() must then be called
+ * from the interrupt handler. The sequence data must be kept in memory until
+ * playback is stopped.
+ *
+ * @param player
+ * @param sequence
+ * @return False if the sequence is invalid
+ */
+bool startSeqPlayer(SeqPlayer *player, const void *sequence);
+
+/**
+ * @brief Stops playback, releasing all notes and disabling the timer
+ * interrupt.
+ *
+ * @param player
+ */
+void stopSeqPlayer(SeqPlayer *player);
+
+/**
+ * @brief Sets the volume all notes are scaled by (0-127).
+ *
+ * @param player
+ * @param volume
+ */
+void setSeqPlayerVolume(SeqPlayer *player, int volume);
+
+/**
+ * @brief Handles the timer 2 interrupt, processing any events due and updating
+ * all envelopes. The amount of work done per tick is bounded by the number of
+ * voices and SEQ_MAX_EVENTS_PER_TICK.
+ *
+ * @param player
+ * @return True if the interrupt was handled
+ */
+bool handleSeqPlayerInterrupt(SeqPlayer *player);
+
+#ifdef __cplusplus
+}
+#endif
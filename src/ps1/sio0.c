@@ -0,0 +1,278 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This driver implements the same packet exchange protocol as the controller
+ * example, but rather than busy-waiting for each byte to be transferred and
+ * acknowledged it runs as a state machine driven by interrupts. The SIO0 IRQ
+ * is fired whenever a device pulses the DSR (/ACK) line, while timer 0 is used
+ * as a one-shot timer to implement both the delays required around asserting
+ * DTR and the timeout used to detect the end of a packet. The CPU is thus only
+ * busy for a few microseconds per byte, regardless of how long the transfer
+ * takes.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/registers.h"
+#include "ps1/sio0.h"
+#include "ps1/system.h"
+
+// Convert microseconds to CPU cycles, as timer 0 counts at the CPU clock rate
+// (1 us = 33.8688 = ~33.875 = 271 / 8 cycles).
+#define US_TO_CYCLES(time) ((((time) * 271) + 4) / 8)
+
+#define DTR_DELAY   US_TO_CYCLES( 60)
+#define DSR_TIMEOUT US_TO_CYCLES(120)
+
+typedef enum {
+	STATE_IDLE    = 0,
+	STATE_SELECT  = 1, // DTR asserted, waiting before sending the address
+	STATE_ADDRESS = 2, // Address sent, waiting for the device to acknowledge it
+	STATE_DATA    = 3, // Exchanging packet bytes
+	STATE_RELEASE = 4  // Waiting before releasing DTR
+} TransferState;
+
+static SIO0Transfer  *_queueHead  = 0, *_queueTail = 0;
+static TransferState _state       = STATE_IDLE;
+static int           _timerTarget = 0;
+
+/* Timer helpers */
+
+static void _setTimeout(int cycles) {
+	// Writing to the control register resets the counter. The timer is set up
+	// to reset again once it reaches the target value and fire an IRQ once, as
+	// the repeat flag is not set.
+	TIMER_RELOAD(0) = cycles;
+	TIMER_CTRL  (0) = TIMER_CTRL_RELOAD | TIMER_CTRL_IRQ_ON_RELOAD;
+	_timerTarget    = cycles;
+}
+
+static int _stopTimer(void) {
+	// Return the time elapsed since the timer was last started, then disable
+	// its IRQ and discard it in case it has already been fired.
+	int elapsed = TIMER_VALUE(0);
+
+	if (TIMER_CTRL(0) & TIMER_CTRL_RELOADED)
+		elapsed += _timerTarget;
+
+	TIMER_CTRL(0) = 0;
+	IRQ_STAT      = ~(1 << IRQ_TIMER0);
+
+	return elapsed;
+}
+
+/* State machine */
+
+static void _startTransfer(SIO0Transfer *transfer) {
+	// Select the port and assert DTR, then wait a bit to give the device time
+	// to prepare for incoming bytes.
+	if (transfer->port)
+		SIO_CTRL(0) |= SIO_CTRL_CS_PORT_2;
+	else
+		SIO_CTRL(0) &= ~SIO_CTRL_CS_PORT_2;
+
+	transfer->respLength = 0;
+	transfer->duration   = 0;
+
+	IRQ_STAT     = ~(1 << IRQ_SIO0);
+	SIO_CTRL(0) |= SIO_CTRL_DTR | SIO_CTRL_ACKNOWLEDGE;
+
+	_state = STATE_SELECT;
+	_setTimeout(DTR_DELAY);
+}
+
+static void _sendNextByte(SIO0Transfer *transfer) {
+	int index = transfer->respLength;
+
+	SIO_DATA(0) = (index < transfer->reqLength) ? transfer->request[index] : 0;
+	_setTimeout(DSR_TIMEOUT);
+}
+
+static void _endTransfer(void) {
+	_state = STATE_RELEASE;
+	_setTimeout(DTR_DELAY);
+}
+
+static void _handleAcknowledge(void) {
+	SIO0Transfer *transfer = _queueHead;
+
+	// Reset the serial interface's IRQ flag to ensure the interrupt can be
+	// triggered again by the next DSR pulse.
+	SIO_CTRL(0) |= SIO_CTRL_ACKNOWLEDGE;
+
+	if (!transfer)
+		return;
+
+	switch (_state) {
+		case STATE_ADDRESS:
+			// Discard the byte received while sending the address, then start
+			// sending the actual packet.
+			transfer->duration += _stopTimer();
+
+			while (SIO_STAT(0) & SIO_STAT_RX_NOT_EMPTY)
+				SIO_DATA(0);
+
+			_state = STATE_DATA;
+			_sendNextByte(transfer);
+			break;
+
+		case STATE_DATA:
+			// The DSR pulse is only sent after a byte has been fully exchanged,
+			// so the received byte should already be available.
+			transfer->duration += _stopTimer();
+
+			while (!(SIO_STAT(0) & SIO_STAT_RX_NOT_EMPTY))
+				__asm__ volatile("");
+
+			transfer->response[transfer->respLength++] = SIO_DATA(0);
+
+			if (transfer->respLength < transfer->maxRespLength)
+				_sendNextByte(transfer);
+			else
+				_endTransfer();
+
+			break;
+
+		default:
+			// Spurious pulse (e.g. a device acknowledging the last byte late),
+			// ignore it.
+			break;
+	}
+}
+
+static void _handleTimeout(void) {
+	SIO0Transfer *transfer = _queueHead;
+
+	if (!transfer)
+		return;
+
+	transfer->duration += _timerTarget;
+
+	switch (_state) {
+		case STATE_SELECT:
+			// Make sure the serial interface's data buffer is empty, then send
+			// the address byte and wait for the device to respond.
+			while (SIO_STAT(0) & SIO_STAT_RX_NOT_EMPTY)
+				SIO_DATA(0);
+
+			SIO_DATA(0) = transfer->address;
+			_state      = STATE_ADDRESS;
+			_setTimeout(DSR_TIMEOUT);
+			break;
+
+		case STATE_ADDRESS:
+			// No device acknowledged the address, assume nothing is connected.
+			_endTransfer();
+			break;
+
+		case STATE_DATA:
+			// Devices do not acknowledge the last byte of a packet, so a
+			// timeout is the expected way for a transfer to end. The last byte
+			// is still in the serial interface's buffer.
+			if (SIO_STAT(0) & SIO_STAT_RX_NOT_EMPTY)
+				transfer->response[transfer->respLength++] = SIO_DATA(0);
+
+			_endTransfer();
+			break;
+
+		case STATE_RELEASE:
+			// Release DTR, allowing the device to go idle, and move onto the
+			// next transfer in the queue.
+			SIO_CTRL(0) &= ~SIO_CTRL_DTR;
+			TIMER_CTRL(0) = 0;
+
+			_queueHead = transfer->next;
+			_state     = STATE_IDLE;
+
+			if (!_queueHead)
+				_queueTail = 0;
+
+			transfer->busy = false;
+
+			// The callback may queue another transfer, which will be started
+			// immediately as the bus is now idle.
+			if (transfer->callback)
+				transfer->callback(transfer);
+			if (_queueHead && (_state == STATE_IDLE))
+				_startTransfer(_queueHead);
+
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* Public API */
+
+void initSIO0(void) {
+	// Reset the serial interface, initialize it with the settings used by
+	// controllers and memory cards (250000bps, 8 data bits) and configure it to
+	// send a signal to the interrupt controller whenever the DSR input is
+	// pulsed.
+	SIO_CTRL(0) = SIO_CTRL_RESET;
+
+	SIO_MODE(0) = 0
+		| SIO_MODE_BAUD_DIV1
+		| SIO_MODE_DATA_8;
+	SIO_BAUD(0) = F_CPU / 250000;
+	SIO_CTRL(0) = 0
+		| SIO_CTRL_TX_ENABLE
+		| SIO_CTRL_RX_ENABLE
+		| SIO_CTRL_DSR_IRQ_ENABLE;
+
+	TIMER_CTRL(0) = 0;
+
+	_queueHead = 0;
+	_queueTail = 0;
+	_state     = STATE_IDLE;
+
+	IRQ_STAT  = ~((1 << IRQ_SIO0) | (1 << IRQ_TIMER0));
+	IRQ_MASK |= (1 << IRQ_SIO0) | (1 << IRQ_TIMER0);
+}
+
+void handleSIO0Interrupts(void) {
+	// The acknowledge handler stops the timer and discards its IRQ, so that a
+	// timeout that happens to occur at the same time as a DSR pulse is ignored.
+	if (acknowledgeInterrupt(IRQ_SIO0))
+		_handleAcknowledge();
+	if (acknowledgeInterrupt(IRQ_TIMER0))
+		_handleTimeout();
+}
+
+void queueSIO0Transfer(SIO0Transfer *transfer) {
+	bool enabled = disableInterrupts();
+
+	transfer->next = 0;
+	transfer->busy = true;
+
+	if (_queueTail)
+		_queueTail->next = transfer;
+	else
+		_queueHead = transfer;
+
+	_queueTail = transfer;
+
+	if (_state == STATE_IDLE)
+		_startTransfer(_queueHead);
+	if (enabled)
+		enableInterrupts();
+}
+
+bool isSIO0Busy(void) {
+	return (_queueHead != 0);
+}
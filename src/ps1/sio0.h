@@ -0,0 +1,108 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The first byte of each request packet is the "address" of the peripheral that
+// shall respond to it, as controllers and memory cards share the same bus.
+typedef enum {
+	SIO0_ADDR_CONTROLLER  = 0x01,
+	SIO0_ADDR_MEMORY_CARD = 0x81
+} SIO0Address;
+
+typedef enum {
+	SIO0_CMD_INIT_PRESSURE   = '@', // Initialize pressure sensors (config)
+	SIO0_CMD_POLL            = 'B', // Read controller state
+	SIO0_CMD_CONFIG_MODE     = 'C', // Enter or exit configuration mode
+	SIO0_CMD_SET_ANALOG      = 'D', // Set analog mode/LED state (config)
+	SIO0_CMD_GET_ANALOG      = 'E', // Get analog mode/LED state (config)
+	SIO0_CMD_GET_MOTOR_INFO  = 'F', // Get information about a motor (config)
+	SIO0_CMD_GET_MOTOR_LIST  = 'G', // Get list of all motors (config)
+	SIO0_CMD_GET_MOTOR_STATE = 'H', // Get state of vibration motors (config)
+	SIO0_CMD_GET_MODE        = 'L', // Get list of all supported modes (config)
+	SIO0_CMD_REQUEST_CONFIG  = 'M', // Configure poll request format (config)
+	SIO0_CMD_RESPONSE_CONFIG = 'O', // Configure poll response format (config)
+	SIO0_CMD_CARD_READ       = 'R', // Read 128-byte memory card sector
+	SIO0_CMD_CARD_GET_SIZE   = 'S', // Retrieve memory card size information
+	SIO0_CMD_CARD_WRITE      = 'W'  // Write 128-byte memory card sector
+} SIO0Command;
+
+typedef struct SIO0Transfer SIO0Transfer;
+typedef void (*SIO0Callback)(SIO0Transfer *transfer);
+
+struct SIO0Transfer {
+	SIO0Transfer *next;
+
+	// These fields must be filled in before queueing the transfer. The request
+	// is padded with zeroes if the response is longer than it.
+	uint8_t       port, address;
+	uint16_t      reqLength, maxRespLength;
+	const uint8_t *request;
+	uint8_t       *response;
+
+	// Optional function called from the interrupt handler once the transfer
+	// has completed (or failed), plus an arbitrary argument for it.
+	SIO0Callback  callback;
+	void          *arg;
+
+	// These fields are updated by the driver. The response length is zero if
+	// no device acknowledged the address byte; the duration is the total time
+	// spent on the bus (including delays), in CPU cycles.
+	volatile bool busy;
+	uint16_t      respLength;
+	uint32_t      duration;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Resets the controller and memory card serial interface and unmasks
+ * the SIO0 and timer 0 IRQs, the latter being used by the driver to implement
+ * delays and timeouts. installExceptionHandler() must have been called prior
+ * to this, and handleSIO0Interrupts() must be called from the interrupt
+ * handler.
+ */
+void initSIO0(void);
+
+/**
+ * @brief Interrupt handler for the driver. Checks for and acknowledges the SIO0
+ * and timer 0 IRQs, advancing the state of the current transfer.
+ */
+void handleSIO0Interrupts(void);
+
+/**
+ * @brief Appends a transfer to the queue and starts it immediately if the bus
+ * is idle. The transfer structure as well as the request and response buffers
+ * must remain valid until its busy flag is cleared. Can be called from an
+ * interrupt handler.
+ *
+ * @param transfer
+ */
+void queueSIO0Transfer(SIO0Transfer *transfer);
+
+/**
+ * @brief Returns whether any transfer is currently in progress or queued.
+ */
+bool isSIO0Busy(void);
+
+#ifdef __cplusplus
+}
+#endif
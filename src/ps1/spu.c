@@ -0,0 +1,694 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The SPU plays back up to 24 channels of ADPCM-compressed audio stored in its
+ * own 512 KB of RAM, which is not directly accessible by the CPU. Sample data
+ * can be written to it either one halfword at a time through the SPU_DATA
+ * register, which is slow and keeps the CPU busy, or through the SPU DMA
+ * channel, which moves 16 words at a time in the background; this driver only
+ * uses the latter.
+ *
+ * SPU RAM is managed by a simple first-fit allocator, which keeps a sorted
+ * list of allocated blocks in an array provided by the caller. Since samples
+ * are usually loaded once per level or scene and freed all at once, this is
+ * more than enough and avoids having to store any bookkeeping data in SPU RAM
+ * itself.
+ *
+ * Channels are assigned to sounds by the voice allocator. Each voice is given
+ * a priority when started; if no channel is free, the one playing the oldest
+ * sound with the lowest priority is taken over, so that important sounds
+ * (dialogue, music) are never cut off by a burst of less important ones.
+ * Starting a voice only involves writing its volume, pitch and address
+ * registers, as the key on and key off registers are written once per frame
+ * for all channels by updateSPU(). This is also required for correctness, as
+ * the SPU may ignore a key off followed by a key on for the same channel (or
+ * vice versa) less than one sample period (about 23 microseconds) apart.
+ *
+ * Channels can also be reserved, removing them from the pool the voice
+ * allocator picks from, in order to drive them directly (for instance from a
+ * timer interrupt handler, as the sequence player does).
+ *
+ * The reverb unit mixes the output of selected channels into a circular work
+ * area at the end of SPU RAM, applying a configurable network of delays and
+ * filters to it. As the 32 parameters that define the effect are fairly opaque,
+ * this driver only exposes the presets used by Sony's own libraries, whose
+ * values were documented by Martin Korth in psx-spx.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/registers.h"
+#include "ps1/spu.h"
+#include "ps1/system.h"
+
+#define CTRL_STAT_BITMASK    0x3f
+#define ALL_CHANNELS_BITMASK ((1 << SPU_NUM_CHANNELS) - 1)
+
+// Default envelope used for all channels: instant attack, maximum sustain
+// level and instant release.
+#define DEFAULT_ADSR1 0x00ff
+#define DEFAULT_ADSR2 0x0000
+
+// The dummy block consists of a single silent ADPCM block with the loop start
+// and loop end flags set, which stops any channel playing it immediately. It
+// is padded to the size of a DMA chunk.
+static const uint32_t _dummyBlock[SPU_DMA_CHUNK_SIZE / 4] = { 0x0500 };
+
+// Buffer of silence used to clear the reverb work area. It is placed in .bss
+// rather than .rodata so that it does not take up any space in the executable.
+static uint32_t _zeroBuffer[SPU_DMA_CHUNK_SIZE * 4];
+
+// Voice allocator state. Channels are tracked using bitmasks (bit N =
+// channel N) so that the key on and key off registers can be written directly.
+static uint32_t _activeChannels, _releasingChannels, _reservedChannels;
+static uint32_t _pendingKeyOn, _pendingKeyOff;
+static uint16_t _voiceCounter;
+static uint16_t _channelCounters[SPU_NUM_CHANNELS];
+static int      _channelPriorities[SPU_NUM_CHANNELS];
+
+/* Control register helpers */
+
+static void _setControl(uint16_t value) {
+	// Some fields of the control register are mirrored in the status register
+	// once the SPU has actually applied the new value.
+	SPU_CTRL = value;
+
+	while ((SPU_STAT & CTRL_STAT_BITMASK) != (value & CTRL_STAT_BITMASK))
+		__asm__ volatile("");
+}
+
+static void _setTransferMode(uint16_t mode) {
+	_setControl((SPU_CTRL & ~SPU_CTRL_XFER_BITMASK) | mode);
+}
+
+/* Initialization and DMA transfers */
+
+void initSPU(void) {
+	_activeChannels    = 0;
+	_releasingChannels = 0;
+	_reservedChannels  = 0;
+	_pendingKeyOn      = 0;
+	_pendingKeyOff     = 0;
+	_voiceCounter      = 0;
+
+	_setControl(0);
+
+	SPU_MASTER_VOL_L = 0;
+	SPU_MASTER_VOL_R = 0;
+	SPU_REVERB_VOL_L = 0;
+	SPU_REVERB_VOL_R = 0;
+
+	SPU_FLAG_OFF1    = 0xffff;
+	SPU_FLAG_OFF2    = ALL_CHANNELS_BITMASK >> 16;
+	SPU_FLAG_FM1     = 0;
+	SPU_FLAG_FM2     = 0;
+	SPU_FLAG_NOISE1  = 0;
+	SPU_FLAG_NOISE2  = 0;
+	SPU_FLAG_REVERB1 = 0;
+	SPU_FLAG_REVERB2 = 0;
+
+	// Move the reverb work area to the very end of SPU RAM, so that it does
+	// not overwrite any sample should reverb be enabled later.
+	SPU_REVERB_ADDR = 0xfffe;
+
+	// Set the FIFO to the "normal" transfer mode (as opposed to the modes used
+	// to fill SPU RAM with repeated data).
+	SPU_DMA_CTRL = 0x0004;
+
+	_setControl(SPU_CTRL_ENABLE);
+
+	for (int ch = 0; ch < SPU_NUM_CHANNELS; ch++) {
+		SPU_CH_VOL_L(ch) = 0;
+		SPU_CH_VOL_R(ch) = 0;
+		SPU_CH_FREQ (ch) = spu_pitch(44100);
+		SPU_CH_ADDR (ch) = SPU_DUMMY_BLOCK_ADDR / 8;
+		SPU_CH_ADSR1(ch) = DEFAULT_ADSR1;
+		SPU_CH_ADSR2(ch) = DEFAULT_ADSR2;
+	}
+
+	DMA_DPCR |= DMA_DPCR_CH_ENABLE(DMA_SPU);
+
+	uploadSPUData(SPU_DUMMY_BLOCK_ADDR, _dummyBlock, sizeof(_dummyBlock));
+	waitForSPUTransfer();
+
+	_setControl(SPU_CTRL_ENABLE | SPU_CTRL_UNMUTE | SPU_CTRL_CDDA);
+
+	SPU_MASTER_VOL_L = SPU_MAX_VOLUME;
+	SPU_MASTER_VOL_R = SPU_MAX_VOLUME;
+	SPU_CDDA_VOL_L   = 0x7fff;
+	SPU_CDDA_VOL_R   = 0x7fff;
+}
+
+void uploadSPUData(uint32_t offset, const void *data, size_t length) {
+	int  numChunks = (length + SPU_DMA_CHUNK_SIZE - 1) / SPU_DMA_CHUNK_SIZE;
+	bool enabled;
+
+	// Uploads may also be started from interrupt handlers (e.g. by the SPU
+	// streaming driver), so interrupts are disabled while the control register
+	// is being modified. The previous transfer is waited for with interrupts
+	// enabled and checked for again afterwards, in case a handler started a
+	// new one in the meantime.
+	for (;;) {
+		waitForSPUTransfer();
+		enabled = disableInterrupts();
+
+		if (!isSPUTransferBusy())
+			break;
+		if (enabled)
+			enableInterrupts();
+	}
+
+	// The transfer address can only be changed while no transfer is in
+	// progress.
+	_setTransferMode(SPU_CTRL_XFER_NONE);
+	SPU_ADDR = offset / 8;
+	_setTransferMode(SPU_CTRL_XFER_DMA_WRITE);
+
+	DMA_MADR(DMA_SPU) = (uint32_t) data;
+	DMA_BCR (DMA_SPU) = (SPU_DMA_CHUNK_SIZE / 4) | (numChunks << 16);
+	DMA_CHCR(DMA_SPU) = 0
+		| DMA_CHCR_WRITE
+		| DMA_CHCR_MODE_SLICE
+		| DMA_CHCR_ENABLE;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+bool isSPUTransferBusy(void) {
+	if (DMA_CHCR(DMA_SPU) & DMA_CHCR_ENABLE)
+		return true;
+
+	return (SPU_STAT & SPU_STAT_BUSY) ? true : false;
+}
+
+void waitForSPUTransfer(void) {
+	// The SPU may still be busy writing the last chunk from its FIFO to RAM
+	// after the DMA transfer has completed.
+	while (isSPUTransferBusy())
+		__asm__ volatile("");
+}
+
+void setSPUInterrupt(bool enable, uint32_t offset) {
+	bool     enabled = disableInterrupts();
+	uint16_t ctrl    = SPU_CTRL & ~SPU_CTRL_IRQ_ENABLE;
+
+	// Clearing the enable bit also clears the SPU's IRQ flag. The address
+	// must be set while the interrupt is disabled, as changing it could
+	// otherwise trigger an immediate IRQ.
+	SPU_CTRL = ctrl;
+
+	if (enable) {
+		SPU_IRQ_ADDR = offset / 8;
+		SPU_CTRL     = ctrl | SPU_CTRL_IRQ_ENABLE;
+
+		IRQ_MASK |= 1 << IRQ_SPU;
+	}
+	if (enabled)
+		enableInterrupts();
+}
+
+bool acknowledgeSPUInterrupt(void) {
+	if (!acknowledgeInterrupt(IRQ_SPU))
+		return false;
+
+	SPU_CTRL &= ~SPU_CTRL_IRQ_ENABLE;
+	return true;
+}
+
+/* SPU RAM allocator */
+
+void initSPUHeap(
+	SPUHeap  *heap,
+	uint32_t start,
+	uint32_t end,
+	SPUBlock *blocks,
+	int      maxBlocks
+) {
+	heap->start     = start;
+	heap->end       = end;
+	heap->blocks    = blocks;
+	heap->numBlocks = 0;
+	heap->maxBlocks = maxBlocks;
+}
+
+uint32_t allocateSPURAM(SPUHeap *heap, size_t length) {
+	if (!length || (heap->numBlocks >= heap->maxBlocks))
+		return 0;
+
+	length = (length + SPU_DMA_CHUNK_SIZE - 1) & ~(SPU_DMA_CHUNK_SIZE - 1);
+
+	// Find the first gap between blocks (or between the last block and the
+	// end of the heap) large enough for the new block.
+	uint32_t offset = heap->start;
+	int      index;
+
+	for (index = 0; index < heap->numBlocks; index++) {
+		const SPUBlock *block = &(heap->blocks)[index];
+
+		if ((block->offset - offset) >= length)
+			break;
+
+		offset = block->offset + block->length;
+	}
+
+	if ((offset + length) > heap->end)
+		return 0;
+
+	SPUBlock *block = &(heap->blocks)[index];
+
+	memmove(
+		block + 1,
+		block,
+		(heap->numBlocks - index) * sizeof(SPUBlock)
+	);
+	heap->numBlocks++;
+
+	block->offset = offset;
+	block->length = length;
+	return offset;
+}
+
+bool freeSPURAM(SPUHeap *heap, uint32_t offset) {
+	for (int index = 0; index < heap->numBlocks; index++) {
+		SPUBlock *block = &(heap->blocks)[index];
+
+		if (block->offset != offset)
+			continue;
+
+		heap->numBlocks--;
+		memmove(
+			block,
+			block + 1,
+			(heap->numBlocks - index) * sizeof(SPUBlock)
+		);
+		return true;
+	}
+
+	return false;
+}
+
+size_t getSPUHeapLargestFree(const SPUHeap *heap) {
+	uint32_t offset  = heap->start;
+	size_t   largest = 0;
+
+	for (int index = 0; index < heap->numBlocks; index++) {
+		const SPUBlock *block = &(heap->blocks)[index];
+
+		if ((block->offset - offset) > largest)
+			largest = block->offset - offset;
+
+		offset = block->offset + block->length;
+	}
+
+	if ((heap->end - offset) > largest)
+		largest = heap->end - offset;
+
+	return largest;
+}
+
+uint32_t loadSPUSample(SPUHeap *heap, const void *data, size_t length) {
+	uint32_t offset = allocateSPURAM(heap, length);
+
+	if (offset)
+		uploadSPUData(offset, data, length);
+
+	return offset;
+}
+
+/* Voice allocator */
+
+static int _getVoiceChannel(int handle) {
+	// Handles are made up of the channel index in the lowest 5 bits and the
+	// value of the voice counter at the time the voice was started in the
+	// upper bits, so that handles to voices whose channel has since been
+	// reused can be detected.
+	if (handle < 0)
+		return -1;
+
+	int ch = handle & 31;
+
+	if (ch >= SPU_NUM_CHANNELS)
+		return -1;
+	if (!(_activeChannels & (1 << ch)))
+		return -1;
+	if (_channelCounters[ch] != (uint16_t) (handle >> 5))
+		return -1;
+
+	return ch;
+}
+
+static int _allocateChannel(int priority) {
+	// Prefer idle channels, then channels whose voice has been stopped and is
+	// fading out.
+	uint32_t busy = _activeChannels | _reservedChannels;
+	uint32_t mask = ~busy & ALL_CHANNELS_BITMASK;
+
+	if (!mask)
+		mask = _releasingChannels;
+
+	if (mask) {
+		int ch = 0;
+
+		for (; !(mask & 1); mask >>= 1)
+			ch++;
+
+		return ch;
+	}
+
+	// If all channels are busy, pick the oldest voice among those with the
+	// lowest priority. The counter wraps around, so the age of two voices is
+	// compared by checking the sign of the difference between their counters.
+	int best = -1;
+
+	for (int ch = 0; ch < SPU_NUM_CHANNELS; ch++) {
+		int channelPriority = _channelPriorities[ch];
+
+		if (_reservedChannels & (1 << ch))
+			continue;
+		if (channelPriority > priority)
+			continue;
+
+		if (best >= 0) {
+			int bestPriority = _channelPriorities[best];
+			int age          =
+				(int16_t) (_channelCounters[best] - _channelCounters[ch]);
+
+			if (channelPriority > bestPriority)
+				continue;
+			if ((channelPriority == bestPriority) && (age <= 0))
+				continue;
+		}
+
+		best = ch;
+	}
+
+	return best;
+}
+
+int playSPUSample(
+	uint32_t offset,
+	uint16_t pitch,
+	uint16_t volumeLeft,
+	uint16_t volumeRight,
+	int      priority
+) {
+	int ch = _allocateChannel(priority);
+
+	if (ch < 0)
+		return -1;
+
+	// The address register is only read by the SPU when the channel is keyed
+	// on, so it can be changed safely even if the channel is still playing the
+	// voice being replaced.
+	SPU_CH_VOL_L(ch) = volumeLeft;
+	SPU_CH_VOL_R(ch) = volumeRight;
+	SPU_CH_FREQ (ch) = pitch;
+	SPU_CH_ADDR (ch) = offset / 8;
+
+	uint32_t bit = 1 << ch;
+
+	_activeChannels    |= bit;
+	_releasingChannels &= ~bit;
+	_pendingKeyOn      |= bit;
+	_pendingKeyOff     &= ~bit;
+
+	_voiceCounter++;
+	_channelCounters  [ch] = _voiceCounter;
+	_channelPriorities[ch] = priority;
+
+	return (_voiceCounter << 5) | ch;
+}
+
+void stopSPUVoice(int handle) {
+	int ch = _getVoiceChannel(handle);
+
+	if (ch < 0)
+		return;
+
+	uint32_t bit = 1 << ch;
+
+	_releasingChannels |= bit;
+	_pendingKeyOn      &= ~bit;
+	_pendingKeyOff     |= bit;
+}
+
+void setSPUVoiceVolume(int handle, uint16_t volumeLeft, uint16_t volumeRight) {
+	int ch = _getVoiceChannel(handle);
+
+	if (ch < 0)
+		return;
+
+	SPU_CH_VOL_L(ch) = volumeLeft;
+	SPU_CH_VOL_R(ch) = volumeRight;
+}
+
+bool isSPUVoicePlaying(int handle) {
+	return (_getVoiceChannel(handle) >= 0);
+}
+
+uint32_t getSPUActiveChannels(void) {
+	return _activeChannels;
+}
+
+uint32_t reserveSPUChannels(int count) {
+	// Reserve the highest free channels, leaving the lower ones (which are
+	// preferred by the allocator) to sound effects.
+	uint32_t mask = 0;
+
+	for (int ch = SPU_NUM_CHANNELS - 1; (ch >= 0) && count; ch--) {
+		uint32_t bit = 1 << ch;
+
+		if ((_activeChannels | _reservedChannels) & bit)
+			continue;
+
+		mask |= bit;
+		count--;
+	}
+
+	if (count)
+		return 0;
+
+	_reservedChannels |= mask;
+	return mask;
+}
+
+void releaseSPUChannels(uint32_t mask) {
+	_reservedChannels &= ~mask;
+}
+
+void updateSPU(void) {
+	uint32_t started = _pendingKeyOn;
+
+	if (_pendingKeyOff) {
+		SPU_FLAG_OFF1  = _pendingKeyOff & 0xffff;
+		SPU_FLAG_OFF2  = _pendingKeyOff >> 16;
+		_pendingKeyOff = 0;
+	}
+	if (started) {
+		SPU_FLAG_ON1  = started & 0xffff;
+		SPU_FLAG_ON2  = started >> 16;
+		_pendingKeyOn = 0;
+	}
+
+	// A channel is done once its envelope has dropped to zero, either because
+	// it has been released or because the end of a non-looping sample has been
+	// reached (which sets the envelope to zero immediately). Channels that
+	// have just been keyed on are skipped, as their envelope may not have
+	// started rising yet.
+	uint32_t mask = _activeChannels & ~started;
+
+	for (int ch = 0; mask; ch++, mask >>= 1) {
+		if (!(mask & 1))
+			continue;
+		if (SPU_CH_ADSR_VOL(ch))
+			continue;
+
+		_activeChannels    &= ~(1 << ch);
+		_releasingChannels &= ~(1 << ch);
+	}
+}
+
+/* Reverb */
+
+typedef struct {
+	uint16_t size; // In 8-byte units
+	uint16_t registers[32];
+} ReverbPreset;
+
+// Parameters for each preset, in the same order as the SPU_REVERB_DAPF1 to
+// SPU_REVERB_VRIN registers.
+static const ReverbPreset _reverbPresets[] = {
+	{
+		// SPU_REVERB_PRESET_OFF
+		.size      = 0,
+		.registers = { 0 }
+	}, {
+		// SPU_REVERB_PRESET_ROOM
+		.size      = 0x26c0 / 8,
+		.registers = {
+			0x007d, 0x005b, 0x6d80, 0x54b8, 0xbed0, 0x0000, 0x0000, 0xba80,
+			0x5800, 0x5300, 0x04d6, 0x0333, 0x03f0, 0x0227, 0x0374, 0x01ef,
+			0x0334, 0x01b5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+			0x0000, 0x0000, 0x01b4, 0x0136, 0x00b8, 0x005c, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_STUDIO_SMALL
+		.size      = 0x1f40 / 8,
+		.registers = {
+			0x0033, 0x0025, 0x70f0, 0x4fa8, 0xbce0, 0x4410, 0xc0f0, 0x9c00,
+			0x5280, 0x4ec0, 0x03e4, 0x031b, 0x03a4, 0x02af, 0x0372, 0x0266,
+			0x031c, 0x025d, 0x025c, 0x018e, 0x022f, 0x0135, 0x01d2, 0x00b7,
+			0x018f, 0x00b5, 0x00b4, 0x0080, 0x004c, 0x0026, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_STUDIO_MEDIUM
+		.size      = 0x4840 / 8,
+		.registers = {
+			0x00b1, 0x007f, 0x70f0, 0x4fa8, 0xbce0, 0x4510, 0xbef0, 0xb4c0,
+			0x5280, 0x4ec0, 0x0904, 0x076b, 0x0824, 0x065f, 0x07a2, 0x0616,
+			0x076c, 0x05ed, 0x05ec, 0x042e, 0x050f, 0x0305, 0x0462, 0x02b7,
+			0x042f, 0x0265, 0x0264, 0x01b2, 0x0100, 0x0080, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_STUDIO_LARGE
+		.size      = 0x6fe0 / 8,
+		.registers = {
+			0x00e3, 0x00a9, 0x6f60, 0x4fa8, 0xbce0, 0x4510, 0xbef0, 0xa680,
+			0x5680, 0x52c0, 0x0dfb, 0x0b58, 0x0d09, 0x0a3c, 0x0bd9, 0x0973,
+			0x0b59, 0x08da, 0x08d9, 0x05e9, 0x07ec, 0x04b0, 0x06ef, 0x03d2,
+			0x05ea, 0x031d, 0x031c, 0x0238, 0x0154, 0x00aa, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_HALL
+		.size      = 0xade0 / 8,
+		.registers = {
+			0x01a5, 0x0139, 0x6000, 0x5000, 0x4c00, 0xb800, 0xbc00, 0xc000,
+			0x6000, 0x5c00, 0x15ba, 0x11bb, 0x14c2, 0x10bd, 0x11bc, 0x0dc1,
+			0x11c0, 0x0dc3, 0x0dc0, 0x09c1, 0x0bc4, 0x07c1, 0x0a00, 0x06cd,
+			0x09c2, 0x05c1, 0x05c0, 0x041a, 0x0274, 0x013a, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_SPACE_ECHO
+		.size      = 0xf6c0 / 8,
+		.registers = {
+			0x033d, 0x0231, 0x7e00, 0x5000, 0xb400, 0xb000, 0x4c00, 0xb000,
+			0x6000, 0x5400, 0x1ed6, 0x1a31, 0x1d14, 0x183b, 0x1bc3, 0x16b2,
+			0x1a32, 0x15ef, 0x15ee, 0x1055, 0x1334, 0x0f2d, 0x11f6, 0x0c5d,
+			0x1056, 0x0ae1, 0x0ae0, 0x07a2, 0x0464, 0x0232, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_ECHO
+		.size      = 0x18040 / 8,
+		.registers = {
+			0x0001, 0x0001, 0x7fff, 0x7fff, 0x0000, 0x0000, 0x0000, 0x8100,
+			0x0000, 0x0000, 0x1fff, 0x0fff, 0x1005, 0x0005, 0x0000, 0x0000,
+			0x1005, 0x0005, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+			0x0000, 0x0000, 0x1004, 0x1002, 0x0004, 0x0002, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_DELAY
+		.size      = 0x18040 / 8,
+		.registers = {
+			0x0001, 0x0001, 0x7fff, 0x7fff, 0x0000, 0x0000, 0x0000, 0x0000,
+			0x0000, 0x0000, 0x1fff, 0x0fff, 0x1005, 0x0005, 0x0000, 0x0000,
+			0x1005, 0x0005, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+			0x0000, 0x0000, 0x1004, 0x1002, 0x0004, 0x0002, 0x8000, 0x8000
+		}
+	}, {
+		// SPU_REVERB_PRESET_HALF_ECHO
+		.size      = 0x3c00 / 8,
+		.registers = {
+			0x0017, 0x0013, 0x70f0, 0x4fa8, 0xbce0, 0x4510, 0xbef0, 0x8500,
+			0x5f80, 0x54c0, 0x0371, 0x02af, 0x02e5, 0x01df, 0x02b0, 0x01d7,
+			0x0358, 0x026a, 0x01d6, 0x011e, 0x012d, 0x00b1, 0x011f, 0x0059,
+			0x01a0, 0x00e3, 0x0058, 0x0040, 0x0028, 0x0014, 0x8000, 0x8000
+		}
+	}
+};
+
+size_t getSPUReverbSize(SPUReverbPreset preset) {
+	if (preset == SPU_REVERB_PRESET_OFF)
+		return 0;
+
+	return _reverbPresets[preset].size * 8;
+}
+
+void setSPUReverb(
+	SPUReverbPreset preset,
+	uint16_t        volumeLeft,
+	uint16_t        volumeRight
+) {
+	const ReverbPreset *params = &_reverbPresets[preset];
+
+	// The reverb unit keeps writing to its work area for as long as it is
+	// enabled, so it must be stopped before the area is moved or cleared.
+	bool enabled = disableInterrupts();
+
+	_setControl(SPU_CTRL & ~SPU_CTRL_REVERB);
+
+	if (enabled)
+		enableInterrupts();
+
+	SPU_REVERB_VOL_L = 0;
+	SPU_REVERB_VOL_R = 0;
+
+	if (preset == SPU_REVERB_PRESET_OFF) {
+		SPU_REVERB_ADDR = 0xfffe;
+		return;
+	}
+
+	// Some work area sizes are not a multiple of the DMA chunk size, in which
+	// case the last transfer wraps around to the beginning of SPU RAM. This is
+	// harmless as the capture buffers there are constantly overwritten anyway.
+	uint32_t start = SPU_RAM_SIZE - params->size * 8;
+
+	for (uint32_t offset = start; offset < SPU_RAM_SIZE;) {
+		size_t length = SPU_RAM_SIZE - offset;
+
+		if (length > sizeof(_zeroBuffer))
+			length = sizeof(_zeroBuffer);
+
+		uploadSPUData(offset, _zeroBuffer, length);
+		offset += length;
+	}
+
+	waitForSPUTransfer();
+
+	volatile uint16_t *reg = &SPU_REVERB_DAPF1;
+
+	for (int i = 0; i < 32; i++)
+		*(reg++) = params->registers[i];
+
+	SPU_REVERB_ADDR  = start / 8;
+	SPU_REVERB_VOL_L = volumeLeft;
+	SPU_REVERB_VOL_R = volumeRight;
+
+	enabled = disableInterrupts();
+
+	_setControl(SPU_CTRL | SPU_CTRL_REVERB);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void setSPUReverbChannels(uint32_t mask) {
+	SPU_FLAG_REVERB1 = mask & 0xffff;
+	SPU_FLAG_REVERB2 = mask >> 16;
+}
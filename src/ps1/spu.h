@@ -0,0 +1,322 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPU_RAM_SIZE     0x80000
+#define SPU_NUM_CHANNELS 24
+
+// Sound data is transferred to SPU RAM in 64-byte chunks, so all transfers are
+// rounded up to a multiple of this value. ADPCM samples are made up of 16-byte
+// blocks of 28 samples each.
+#define SPU_DMA_CHUNK_SIZE   64
+#define SPU_ADPCM_BLOCK_SIZE 16
+
+// The first 4 KB of SPU RAM are used by the SPU to capture the CD audio and
+// voice 1/3 outputs, and the block after them is filled with silence by
+// initSPU() so that idle channels can be pointed at it. Samples should thus be
+// placed after SPU_HEAP_START.
+#define SPU_DUMMY_BLOCK_ADDR 0x1000
+#define SPU_HEAP_START       0x1040
+
+#define SPU_MAX_VOLUME 0x3fff
+
+// Converts a sample rate in Hz into the pitch value expected by the SPU
+// (0x1000 = 44100 Hz). Rates above 176400 Hz cannot be represented.
+#define spu_pitch(sampleRate) ((((sampleRate) << 12) + 22050) / 44100)
+
+typedef enum {
+	SPU_REVERB_PRESET_OFF           = 0,
+	SPU_REVERB_PRESET_ROOM          = 1,
+	SPU_REVERB_PRESET_STUDIO_SMALL  = 2,
+	SPU_REVERB_PRESET_STUDIO_MEDIUM = 3,
+	SPU_REVERB_PRESET_STUDIO_LARGE  = 4,
+	SPU_REVERB_PRESET_HALL          = 5,
+	SPU_REVERB_PRESET_SPACE_ECHO    = 6,
+	SPU_REVERB_PRESET_ECHO          = 7,
+	SPU_REVERB_PRESET_DELAY         = 8,
+	SPU_REVERB_PRESET_HALF_ECHO     = 9
+} SPUReverbPreset;
+
+typedef struct {
+	uint32_t offset, length; // In bytes
+} SPUBlock;
+
+typedef struct {
+	// Region of SPU RAM managed by the heap, and array of blocks (provided by
+	// the caller) used to keep track of allocations. The blocks are kept
+	// sorted by their offset.
+	uint32_t start, end;
+	SPUBlock *blocks;
+	int      numBlocks, maxBlocks;
+} SPUHeap;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Initialization and DMA transfers */
+
+/**
+ * @brief Resets the SPU, stops all channels, enables the SPU DMA channel and
+ * sets the master volume and CD audio input volume to the maximum, so that
+ * CD-DA and XA-ADPCM audio played by the drive can be heard. The default
+ * envelope (instant attack and release, maximum sustain level) is set for all
+ * channels.
+ */
+void initSPU(void);
+
+/**
+ * @brief Starts transferring the given data to SPU RAM in the background using
+ * DMA. The offset must be a multiple of 8 bytes and the data 4-byte aligned.
+ * The length is rounded up to a multiple of SPU_DMA_CHUNK_SIZE, so up to 63
+ * bytes past the end of the data may be read and written to SPU RAM (the SPU
+ * heap rounds up allocations accordingly). Any previous transfer is waited for
+ * before starting the new one.
+ *
+ * @param offset Destination address in SPU RAM, in bytes
+ * @param data
+ * @param length
+ */
+void uploadSPUData(uint32_t offset, const void *data, size_t length);
+
+/**
+ * @brief Returns whether the transfer started by uploadSPUData() is still
+ * running.
+ */
+bool isSPUTransferBusy(void);
+
+/**
+ * @brief Waits for the transfer started by uploadSPUData() to complete.
+ */
+void waitForSPUTransfer(void);
+
+/**
+ * @brief Sets the SPU RAM address that raises an interrupt (IRQ_SPU) when
+ * accessed, and enables or disables the interrupt. The SPU checks the address
+ * against every access to its RAM, including reads by channels and the reverb
+ * unit as well as DMA transfers, and disables the interrupt after raising it;
+ * it must thus be re-enabled by calling this function again once acknowledged
+ * using acknowledgeSPUInterrupt().
+ *
+ * @param enable
+ * @param offset Address in SPU RAM, in bytes (must be a multiple of 8)
+ */
+void setSPUInterrupt(bool enable, uint32_t offset);
+
+/**
+ * @brief Checks for and acknowledges the interrupt set up by setSPUInterrupt().
+ * Meant to be called from an interrupt handler.
+ *
+ * @return True if the interrupt was pending
+ */
+bool acknowledgeSPUInterrupt(void);
+
+/* SPU RAM allocator */
+
+/**
+ * @brief Initializes a heap managing the given region of SPU RAM (usually from
+ * SPU_HEAP_START to SPU_RAM_SIZE, or to the start of the reverb work area if
+ * reverb is used). The block array limits the number of allocations that can
+ * exist at the same time.
+ *
+ * @param heap
+ * @param start
+ * @param end
+ * @param blocks
+ * @param maxBlocks
+ */
+void initSPUHeap(
+	SPUHeap  *heap,
+	uint32_t start,
+	uint32_t end,
+	SPUBlock *blocks,
+	int      maxBlocks
+);
+
+/**
+ * @brief Allocates a region of SPU RAM of at least the given length, rounded up
+ * to a multiple of SPU_DMA_CHUNK_SIZE. The first free region large enough is
+ * used.
+ *
+ * @param heap
+ * @param length
+ * @return Offset of the region in bytes, or 0 if there is not enough space or
+ * the block array is full
+ */
+uint32_t allocateSPURAM(SPUHeap *heap, size_t length);
+
+/**
+ * @brief Frees a region previously returned by allocateSPURAM(). Any channel
+ * still playing a sample from it must be stopped first.
+ *
+ * @param heap
+ * @param offset
+ * @return False if no region starts at the given offset
+ */
+bool freeSPURAM(SPUHeap *heap, uint32_t offset);
+
+/**
+ * @brief Returns the length of the largest free region in the heap.
+ *
+ * @param heap
+ */
+size_t getSPUHeapLargestFree(const SPUHeap *heap);
+
+/**
+ * @brief Allocates space for an ADPCM sample and starts uploading it.
+ *
+ * @param heap
+ * @param data
+ * @param length
+ * @return Offset of the sample in SPU RAM, or 0 if it could not be allocated
+ */
+uint32_t loadSPUSample(SPUHeap *heap, const void *data, size_t length);
+
+/* Voice allocator */
+
+/**
+ * @brief Starts playing the ADPCM sample at the given SPU RAM offset on a free
+ * channel. If all channels are busy, the one playing the oldest sound with the
+ * lowest priority is reused, as long as its priority is not higher than the
+ * new sound's; otherwise the sound is not played. Only the channel's volume,
+ * pitch and address registers are written immediately, while the channel is
+ * actually started by the next call to updateSPU().
+ *
+ * Must not be called from an interrupt handler, nor while updateSPU() may be
+ * running.
+ *
+ * @param offset Address of the sample in SPU RAM, in bytes
+ * @param pitch Playback rate (see spu_pitch())
+ * @param volumeLeft 0 to SPU_MAX_VOLUME
+ * @param volumeRight 0 to SPU_MAX_VOLUME
+ * @param priority Arbitrary value, higher priorities steal lower ones
+ * @return A handle to the voice, or -1 if no channel could be allocated
+ */
+int playSPUSample(
+	uint32_t offset,
+	uint16_t pitch,
+	uint16_t volumeLeft,
+	uint16_t volumeRight,
+	int      priority
+);
+
+/**
+ * @brief Releases the voice with the given handle (which is required to stop
+ * looping samples). Does nothing if the voice has already ended or its channel
+ * has been reused for another sound in the meantime.
+ *
+ * @param handle
+ */
+void stopSPUVoice(int handle);
+
+/**
+ * @brief Changes the volume of a playing voice. Does nothing if the voice has
+ * already ended or its channel has been reused.
+ *
+ * @param handle
+ * @param volumeLeft
+ * @param volumeRight
+ */
+void setSPUVoiceVolume(int handle, uint16_t volumeLeft, uint16_t volumeRight);
+
+/**
+ * @brief Returns whether the voice with the given handle is still playing.
+ *
+ * @param handle
+ */
+bool isSPUVoicePlaying(int handle);
+
+/**
+ * @brief Returns a bitmask of all channels currently allocated to a voice (bit
+ * N set = channel N busy).
+ */
+uint32_t getSPUActiveChannels(void);
+
+/**
+ * @brief Removes the given number of idle channels from the pool used by the
+ * voice allocator, so that they can be controlled directly (e.g. by the
+ * sequence player). Reserved channels must be keyed on and off by writing to
+ * the SPU_FLAG_ON* and SPU_FLAG_OFF* registers manually.
+ *
+ * @param count
+ * @return A bitmask of the reserved channels, or 0 if not enough channels are
+ * idle
+ */
+uint32_t reserveSPUChannels(int count);
+
+/**
+ * @brief Returns channels previously reserved by reserveSPUChannels() to the
+ * voice allocator. The channels should be stopped beforehand.
+ *
+ * @param mask
+ */
+void releaseSPUChannels(uint32_t mask);
+
+/**
+ * @brief Starts and stops all channels requested since the last call in one go,
+ * then frees channels whose sample has ended. Should be called once per frame,
+ * e.g. after waiting for vertical blank.
+ */
+void updateSPU(void);
+
+/* Reverb */
+
+/**
+ * @brief Returns the size of the work area required by the given reverb preset
+ * in bytes. The work area is always placed at the end of SPU RAM, so any heap
+ * should end at SPU_RAM_SIZE minus the size required by the largest preset
+ * that is going to be used.
+ *
+ * @param preset
+ */
+size_t getSPUReverbSize(SPUReverbPreset preset);
+
+/**
+ * @brief Disables reverb, clears the work area used by the given preset (to
+ * prevent leftover data from previous presets or samples from being heard),
+ * loads the preset's parameters and enables reverb again with the given output
+ * volume. Only channels enabled using setSPUReverbChannels() are fed into the
+ * reverb unit. Passing SPU_REVERB_PRESET_OFF disables reverb altogether.
+ *
+ * As clearing the work area takes a few milliseconds, this function should not
+ * be called from an interrupt handler.
+ *
+ * @param preset
+ * @param volumeLeft 0 to 0x7fff
+ * @param volumeRight 0 to 0x7fff
+ */
+void setSPUReverb(
+	SPUReverbPreset preset,
+	uint16_t        volumeLeft,
+	uint16_t        volumeRight
+);
+
+/**
+ * @brief Sets which channels are fed into the reverb unit (bit N set = channel
+ * N has reverb applied).
+ *
+ * @param mask
+ */
+void setSPUReverbChannels(uint32_t mask);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,340 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Samples played by the SPU must be stored in its own 512 KB of RAM, which is
+ * too small to hold more than a minute or so of mono audio. Longer tracks can
+ * be played by treating a small region of SPU RAM as a ring buffer, split into
+ * two halves: the first block of the first half is flagged as the loop start
+ * and the last block of the second half as the loop end, so that the channel
+ * keeps cycling through both halves, and each half is refilled with new data
+ * while the channel is playing the other one.
+ *
+ * The SPU can raise an interrupt whenever a given address in its RAM is
+ * accessed. Pointing it at the beginning of the half the channel is about to
+ * enter thus provides a notification once the previous half has been fully
+ * played and can be overwritten. DMA transfers also count as accesses, so the
+ * interrupt address cannot be moved to the beginning of the half being
+ * refilled until the transfer has completed; the SPU interrupt is thus only
+ * re-enabled by the DMA completion interrupt. The loop flags of each chunk are
+ * rewritten in main RAM before it is uploaded, allowing any ADPCM data to be
+ * streamed regardless of how it was encoded.
+ *
+ * Chunks are queued in a ring buffer in main RAM, which may be filled from any
+ * source at the game's own pace: copied from a larger buffer, read from the
+ * CD-ROM or even generated on the fly. If no chunk is available when a half
+ * needs to be refilled, a silent block with the end flag set is uploaded in
+ * its place, which mutes the channel once reached rather than letting it play
+ * the stale data left in SPU RAM.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ps1/registers.h"
+#include "ps1/spu.h"
+#include "ps1/spustream.h"
+#include "ps1/system.h"
+
+#define DICR_CONFIG_BITMASK \
+	(DMA_DICR_CH_MODE_BITMASK | DMA_DICR_CH_ENABLE_BITMASK | DMA_DICR_IRQ_ENABLE)
+
+// Loop flags, stored in the second byte of each ADPCM block.
+#define FLAG_END        (1 << 0)
+#define FLAG_REPEAT     (1 << 1)
+#define FLAG_LOOP_START (1 << 2)
+
+// Instant attack, maximum sustain level and instant release.
+#define STREAM_ADSR1 0x00ff
+#define STREAM_ADSR2 0x0000
+
+// Single silent ADPCM block with only the end flag set, padded to the size of
+// a DMA chunk. When reached, it mutes the channel and makes it jump back to
+// the beginning of the buffer.
+static const uint32_t _stopBlock[SPU_DMA_CHUNK_SIZE / 4] = { 0x0100 };
+
+/* Interrupt helpers */
+
+static void _setDMAInterrupt(bool enable) {
+	bool     enabled = disableInterrupts();
+	uint32_t dicr    = DMA_DICR & DICR_CONFIG_BITMASK;
+
+	if (enable)
+		dicr |= DMA_DICR_CH_ENABLE(DMA_SPU) | DMA_DICR_IRQ_ENABLE;
+	else
+		dicr &= ~DMA_DICR_CH_ENABLE(DMA_SPU);
+
+	DMA_DICR = dicr;
+
+	if (enable) {
+		IRQ_STAT  = ~(1 << IRQ_DMA);
+		IRQ_MASK |= 1 << IRQ_DMA;
+	}
+	if (enabled)
+		enableInterrupts();
+}
+
+static bool _acknowledgeDMAInterrupt(void) {
+	if (!(DMA_DICR & DMA_DICR_CH_STAT(DMA_SPU)))
+		return false;
+
+	acknowledgeInterrupt(IRQ_DMA);
+	DMA_DICR = (DMA_DICR & DICR_CONFIG_BITMASK) | DMA_DICR_CH_STAT(DMA_SPU);
+	return true;
+}
+
+/* Chunk management */
+
+static uint8_t *_getChunk(const SPUStream *stream, uint32_t index) {
+	return &(stream->buffer)[(index % stream->numChunks) * stream->chunkLength];
+}
+
+static uint32_t _getHalfOffset(const SPUStream *stream, int half) {
+	return stream->spuOffset + half * stream->chunkLength;
+}
+
+static void _uploadChunk(SPUStream *stream, uint8_t *chunk, int half) {
+	size_t length = stream->chunkLength;
+
+	// Clear the flags of all blocks, then make the first half's first block
+	// the loop start and the second half's last block the loop end.
+	for (size_t i = 1; i < length; i += SPU_ADPCM_BLOCK_SIZE)
+		chunk[i] = 0;
+
+	if (half)
+		chunk[length - SPU_ADPCM_BLOCK_SIZE + 1] = FLAG_END | FLAG_REPEAT;
+	else
+		chunk[1]                                 = FLAG_LOOP_START;
+
+	uploadSPUData(_getHalfOffset(stream, half), chunk, stream->chunkLength);
+	stream->stats.chunks++;
+}
+
+bool initSPUStream(
+	SPUStream *stream,
+	SPUHeap   *heap,
+	uint8_t   *buffer,
+	int       numChunks,
+	size_t    chunkLength
+) {
+	uint32_t offset = allocateSPURAM(heap, chunkLength * 2);
+
+	if (!offset)
+		return false;
+
+	uint32_t mask = reserveSPUChannels(1);
+
+	if (!mask) {
+		freeSPURAM(heap, offset);
+		return false;
+	}
+
+	int ch = 0;
+
+	for (; !(mask & 1); mask >>= 1)
+		ch++;
+
+	stream->buffer      = buffer;
+	stream->numChunks   = numChunks;
+	stream->chunkLength = chunkLength;
+	stream->spuOffset   = offset;
+	stream->channel     = ch;
+
+	stream->status          = SPUSTREAM_STOPPED;
+	stream->stats.chunks    = 0;
+	stream->stats.underruns = 0;
+
+	stream->readCount      = 0;
+	stream->writeCount     = 0;
+	stream->uploading      = false;
+	stream->uploadingChunk = false;
+	stream->nextHalf       = 0;
+	return true;
+}
+
+void freeSPUStream(SPUStream *stream, SPUHeap *heap) {
+	stopSPUStream(stream);
+
+	while (stream->uploading)
+		__asm__ volatile("");
+
+	freeSPURAM(heap, stream->spuOffset);
+	releaseSPUChannels(1 << stream->channel);
+}
+
+uint8_t *getSPUStreamFreeChunk(const SPUStream *stream) {
+	if (getSPUStreamBufferedChunks(stream) >= stream->numChunks)
+		return 0;
+
+	return _getChunk(stream, stream->writeCount);
+}
+
+void commitSPUStreamChunk(SPUStream *stream) {
+	stream->writeCount++;
+}
+
+int getSPUStreamBufferedChunks(const SPUStream *stream) {
+	return stream->writeCount - stream->readCount;
+}
+
+/* Playback control */
+
+bool startSPUStream(
+	SPUStream *stream,
+	uint16_t  pitch,
+	uint16_t  volumeLeft,
+	uint16_t  volumeRight
+) {
+	// Wait for the DMA interrupt to release the chunk being uploaded if the
+	// stream has just been stopped.
+	while (stream->uploading)
+		__asm__ volatile("");
+
+	if (getSPUStreamBufferedChunks(stream) < 2)
+		return false;
+
+	// The handler does not touch the read counter while the stream is not
+	// playing, so it can be updated safely.
+	_uploadChunk(stream, _getChunk(stream, stream->readCount + 0), 0);
+	_uploadChunk(stream, _getChunk(stream, stream->readCount + 1), 1);
+	waitForSPUTransfer();
+
+	stream->readCount += 2;
+	stream->nextHalf   = 0;
+	stream->status     = SPUSTREAM_PLAYING;
+
+	int      ch  = stream->channel;
+	uint32_t bit = 1 << ch;
+
+	SPU_CH_VOL_L(ch) = volumeLeft;
+	SPU_CH_VOL_R(ch) = volumeRight;
+	SPU_CH_FREQ (ch) = pitch;
+	SPU_CH_ADDR (ch) = stream->spuOffset / 8;
+	SPU_CH_ADSR1(ch) = STREAM_ADSR1;
+	SPU_CH_ADSR2(ch) = STREAM_ADSR2;
+
+	// Enable the interrupts before keying on the channel, so that the end of
+	// the first half cannot be missed.
+	_setDMAInterrupt(true);
+	setSPUInterrupt(true, _getHalfOffset(stream, 1));
+
+	SPU_FLAG_ON1 = bit & 0xffff;
+	SPU_FLAG_ON2 = bit >> 16;
+	return true;
+}
+
+void stopSPUStream(SPUStream *stream) {
+	bool     enabled = disableInterrupts();
+	uint32_t bit     = 1 << stream->channel;
+
+	stream->status = SPUSTREAM_STOPPED;
+	setSPUInterrupt(false, 0);
+
+	SPU_FLAG_OFF1 = bit & 0xffff;
+	SPU_FLAG_OFF2 = bit >> 16;
+
+	if (!stream->uploading)
+		_setDMAInterrupt(false);
+	if (enabled)
+		enableInterrupts();
+}
+
+void setSPUStreamVolume(
+	SPUStream *stream,
+	uint16_t  volumeLeft,
+	uint16_t  volumeRight
+) {
+	SPU_CH_VOL_L(stream->channel) = volumeLeft;
+	SPU_CH_VOL_R(stream->channel) = volumeRight;
+}
+
+bool isSPUStreamPlaying(const SPUStream *stream) {
+	return (stream->status == SPUSTREAM_PLAYING)
+		|| (stream->status == SPUSTREAM_ENDING);
+}
+
+/* Interrupt handler */
+
+static void _handleHalfEntered(SPUStream *stream) {
+	// If the channel has just reached the silent block uploaded when the
+	// buffer ran empty, it is now muted and nothing else is left to do.
+	if (stream->status == SPUSTREAM_ENDING) {
+		stream->status = SPUSTREAM_STALLED;
+		_setDMAInterrupt(false);
+		return;
+	}
+	if (stream->status != SPUSTREAM_PLAYING)
+		return;
+
+	int half = stream->nextHalf;
+
+	if (stream->readCount != stream->writeCount) {
+		_uploadChunk(stream, _getChunk(stream, stream->readCount), half);
+		stream->uploadingChunk = true;
+	} else {
+		uploadSPUData(
+			_getHalfOffset(stream, half),
+			_stopBlock,
+			sizeof(_stopBlock)
+		);
+		stream->uploadingChunk = false;
+		stream->status         = SPUSTREAM_ENDING;
+		stream->stats.underruns++;
+	}
+
+	stream->uploading = true;
+}
+
+static void _handleUploadDone(SPUStream *stream) {
+	// The DMA interrupt is also raised by other transfers, including the one
+	// the stream's upload may have had to wait for. The upload is complete
+	// only once the channel is no longer busy.
+	if (!stream->uploading)
+		return;
+	if (DMA_CHCR(DMA_SPU) & DMA_CHCR_ENABLE)
+		return;
+
+	stream->uploading = false;
+
+	if (stream->uploadingChunk)
+		stream->readCount++;
+
+	if (!isSPUStreamPlaying(stream)) {
+		_setDMAInterrupt(false);
+		return;
+	}
+
+	// Wait for the channel to enter the half that has just been refilled,
+	// then refill the other one.
+	setSPUInterrupt(true, _getHalfOffset(stream, stream->nextHalf));
+	stream->nextHalf ^= 1;
+}
+
+bool handleSPUStreamInterrupt(SPUStream *stream) {
+	bool handled = false;
+
+	if (acknowledgeSPUInterrupt()) {
+		_handleHalfEntered(stream);
+		handled = true;
+	}
+	if (_acknowledgeDMAInterrupt()) {
+		_handleUploadDone(stream);
+		handled = true;
+	}
+
+	return handled;
+}
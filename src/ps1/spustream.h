@@ -0,0 +1,184 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ps1/spu.h"
+
+typedef enum {
+	SPUSTREAM_STOPPED = 0,
+	SPUSTREAM_PLAYING = 1,
+	SPUSTREAM_ENDING  = 2, // Buffer ran empty, last chunk still playing
+	SPUSTREAM_STALLED = 3  // Channel stopped after running out of data
+} SPUStreamStatus;
+
+typedef struct {
+	uint32_t chunks;    // Chunks uploaded to SPU RAM
+	uint32_t underruns; // Times the buffer was empty when a chunk was needed
+} SPUStreamStats;
+
+typedef struct {
+	// Ring buffer provided by the caller, region of SPU RAM (two chunks long)
+	// the stream is played from and channel reserved for it.
+	uint8_t  *buffer;
+	int      numChunks;
+	size_t   chunkLength;
+	uint32_t spuOffset;
+	int      channel;
+
+	// Current state of the stream and counters updated by the interrupt
+	// handler.
+	volatile uint8_t status;
+	SPUStreamStats   stats;
+
+	// Internal state. As with XA streams, the read and write counters are
+	// only ever incremented by the interrupt handler and the producer
+	// respectively.
+	volatile uint32_t readCount, writeCount;
+	volatile bool     uploading;
+	bool              uploadingChunk;
+	uint8_t           nextHalf;
+} SPUStream;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a stream, allocating space for two chunks in SPU RAM from
+ * the given heap and reserving a channel to play them on. The ring buffer must
+ * be 4-byte aligned and numChunks * chunkLength bytes long; chunkLength must
+ * be a multiple of SPU_DMA_CHUNK_SIZE (a multiple of 2048 bytes is required to
+ * read chunks directly from the CD-ROM). At least 3 chunks are recommended, as
+ * one is always being uploaded.
+ *
+ * @param stream
+ * @param heap
+ * @param buffer
+ * @param numChunks
+ * @param chunkLength
+ * @return False if SPU RAM could not be allocated or no channel is idle
+ */
+bool initSPUStream(
+	SPUStream *stream,
+	SPUHeap   *heap,
+	uint8_t   *buffer,
+	int       numChunks,
+	size_t    chunkLength
+);
+
+/**
+ * @brief Frees the SPU RAM and channel used by a stream, stopping it first if
+ * needed.
+ *
+ * @param stream
+ * @param heap
+ */
+void freeSPUStream(SPUStream *stream, SPUHeap *heap);
+
+/**
+ * @brief Returns a pointer to the next free chunk in the ring buffer, or a null
+ * pointer if the buffer is full. The chunk shall be filled with chunkLength
+ * bytes of SPU-ADPCM data (whose loop flags are ignored) by copying it from
+ * main RAM, generating it or reading it from the CD-ROM, then passed to the
+ * stream by calling commitSPUStreamChunk().
+ *
+ * @param stream
+ * @return Pointer to chunk or 0
+ */
+uint8_t *getSPUStreamFreeChunk(const SPUStream *stream);
+
+/**
+ * @brief Adds the chunk returned by getSPUStreamFreeChunk() to the stream.
+ * Chunks are played in the order they are committed. Can be called from an
+ * interrupt handler (e.g. a CD-ROM request's completion callback).
+ *
+ * @param stream
+ */
+void commitSPUStreamChunk(SPUStream *stream);
+
+/**
+ * @brief Returns the number of chunks currently waiting in the ring buffer.
+ */
+int getSPUStreamBufferedChunks(const SPUStream *stream);
+
+/**
+ * @brief Starts playing the stream, uploading the first two chunks in the
+ * buffer to SPU RAM and keying on the stream's channel. The SPU and DMA
+ * interrupts are then used to refill SPU RAM with the following chunks; the
+ * interrupt handler must call handleSPUStreamInterrupt(). If the buffer runs
+ * empty, the stream plays the data left in SPU RAM and goes into the
+ * SPUSTREAM_STALLED state, from which it can be restarted by calling this
+ * function again once more chunks are available.
+ *
+ * Only one stream can be played at a time, as the SPU has a single interrupt
+ * address.
+ *
+ * @param stream
+ * @param pitch Playback rate (see spu_pitch())
+ * @param volumeLeft 0 to SPU_MAX_VOLUME
+ * @param volumeRight 0 to SPU_MAX_VOLUME
+ * @return False if less than two chunks are buffered, true otherwise
+ */
+bool startSPUStream(
+	SPUStream *stream,
+	uint16_t  pitch,
+	uint16_t  volumeLeft,
+	uint16_t  volumeRight
+);
+
+/**
+ * @brief Stops the stream's channel immediately. Chunks left in the buffer are
+ * kept and played once the stream is restarted.
+ *
+ * @param stream
+ */
+void stopSPUStream(SPUStream *stream);
+
+/**
+ * @brief Changes the volume of the stream's channel.
+ *
+ * @param stream
+ * @param volumeLeft
+ * @param volumeRight
+ */
+void setSPUStreamVolume(
+	SPUStream *stream,
+	uint16_t  volumeLeft,
+	uint16_t  volumeRight
+);
+
+/**
+ * @brief Handles the SPU and DMA interrupts raised while a stream is playing.
+ * Meant to be called from the interrupt handler for each stream.
+ *
+ * @param stream
+ * @return True if any interrupt was handled
+ */
+bool handleSPUStreamInterrupt(SPUStream *stream);
+
+/**
+ * @brief Returns whether the stream's channel is currently playing.
+ */
+bool isSPUStreamPlaying(const SPUStream *stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,310 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Playing back full motion video involves moving each frame through several
+ * stages: its sectors have to be read from the disc, the bitstream has to be
+ * decoded by the CPU into run-length codes, those have to be fed to the MDEC
+ * and the resulting pixels have to be read back into RAM and finally uploaded
+ * to VRAM. Running these one after another would leave most of the hardware
+ * idle most of the time, so this player keeps them all running at once on
+ * different pieces of data:
+ *
+ * - the drive reads the sectors of the next frames into the XA stream's ring
+ *   buffer in the background;
+ * - the CPU decodes the bitstream of frame N+1 into one of two MDEC buffers;
+ * - meanwhile the MDEC decodes frame N from the other buffer, with its input
+ *   fed by DMA;
+ * - frame N's output is read back one vertical slice (a column of 16x16
+ *   macroblocks) at a time into two alternating slice buffers, each slice
+ *   being uploaded to VRAM while the MDEC is busy decoding the next one.
+ *
+ * The output side is entirely driven by the DMA interrupt raised whenever a
+ * slice has been received, leaving the main loop only responsible for feeding
+ * sectors to the bitstream decoder. Decoded frames are placed in two VRAM
+ * buffers in turn so that the one being displayed is never overwritten.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ps1/mdec.h"
+#include "ps1/mdecbs.h"
+#include "ps1/registers.h"
+#include "ps1/strplayer.h"
+#include "ps1/system.h"
+#include "ps1/xastream.h"
+
+typedef enum {
+	BUFFER_FREE  = 0,
+	BUFFER_READY = 1, // Decoded and waiting for the MDEC to become idle
+	BUFFER_BUSY  = 2  // Being fed to the MDEC
+} BufferState;
+
+static inline uint16_t _getTime(void) {
+	return TIMER_VALUE(1);
+}
+
+static inline int _getSliceLength(int height) {
+	return MDEC_MACROBLOCK_SIZE_16BPP * (height / 16);
+}
+
+/* MDEC pipeline */
+
+static void _startMDEC(STRPlayer *player) {
+	int index = player->currentMDECBuffer;
+
+	// Must be called with interrupts disabled (or from the interrupt handler)
+	// as it can be invoked from both the main loop and the DMA interrupt.
+	if (player->mdecActive || (player->mdecState[index] != BUFFER_READY))
+		return;
+
+	player->mdecActive       = true;
+	player->mdecState[index] = BUFFER_BUSY;
+	player->slice            = 0;
+	player->numSlices        = player->mdecWidth[index] / 16;
+	player->mdecStart        = _getTime();
+	player->uploadTime       = 0;
+
+	feedMDEC(
+		player->mdecBuffers[index],
+		player->mdecLength[index],
+		MDEC_CMD_FORMAT_16BPP
+	);
+	receiveMDEC(
+		player->sliceBuffers[0],
+		_getSliceLength(player->mdecHeight[index])
+	);
+}
+
+bool handleSTRPlayerInterrupt(STRPlayer *player) {
+	if (!acknowledgeMDECInterrupt())
+		return false;
+	if (!player->mdecActive)
+		return true;
+
+	int      index  = player->currentMDECBuffer;
+	int      slice  = player->slice++;
+	int      height = player->mdecHeight[index];
+	int      vram   = player->vramBuffer;
+	uint16_t start  = _getTime();
+
+	// Start uploading the slice that has just been received before reusing
+	// the other slice buffer, whose upload is guaranteed to have completed
+	// once the callback has started the new one.
+	player->upload(
+		player->sliceBuffers[slice % 2],
+		player->bufferX[vram] + slice * 16,
+		player->bufferY[vram],
+		16,
+		height
+	);
+
+	player->uploadTime += _getTime() - start;
+
+	if (player->slice < player->numSlices) {
+		receiveMDEC(
+			player->sliceBuffers[player->slice % 2],
+			_getSliceLength(height)
+		);
+		return true;
+	}
+
+	// The whole frame has been decoded, so the buffer can be handed back to
+	// the bitstream decoder and the next frame (if already decoded) fed to
+	// the MDEC.
+	uint16_t now = _getTime();
+
+	player->stats.mdecTime   = now - player->mdecStart;
+	player->stats.uploadTime = player->uploadTime;
+	player->stats.interval   = now - player->lastFrameEnd;
+	player->stats.frames++;
+
+	player->lastFrameEnd      = now;
+	player->displayBuffer     = vram;
+	player->vramBuffer        = vram ^ 1;
+	player->mdecState[index]  = BUFFER_FREE;
+	player->currentMDECBuffer = index ^ 1;
+	player->mdecActive        = false;
+
+	_startMDEC(player);
+	return true;
+}
+
+/* Frame assembly and decoding */
+
+static bool _decodeFrame(STRPlayer *player) {
+	int index = player->nextMDECBuffer;
+
+	// If both MDEC buffers are in use the frame is kept around, and no more
+	// sectors are processed until one of them becomes free.
+	if (player->mdecState[index] != BUFFER_FREE)
+		return false;
+
+	int      width  = (player->frameWidth  + 15) / 16;
+	int      height = (player->frameHeight + 15) / 16;
+	uint16_t start  = _getTime();
+
+	int length = decodeMDECBitstream(
+		player->mdecBuffers[index],
+		player->mdecBufferLength,
+		player->frameBuffer,
+		player->frameLength,
+		width * height
+	);
+
+	player->stats.decodeTime = _getTime() - start;
+	player->chunksReceived   = 0;
+	player->numChunks        = 0;
+
+	if (!length) {
+		player->stats.errors++;
+		return true;
+	}
+
+	player->mdecWidth[index]  = width  * 16;
+	player->mdecHeight[index] = height * 16;
+	player->mdecLength[index] = length;
+	player->mdecState[index]  = BUFFER_READY;
+	player->nextMDECBuffer    = index ^ 1;
+
+	bool enabled = disableInterrupts();
+
+	_startMDEC(player);
+
+	if (enabled)
+		enableInterrupts();
+
+	return true;
+}
+
+static void _processSector(STRPlayer *player, const uint8_t *sector) {
+	const STRSectorHeader *header = (const STRSectorHeader *) sector;
+
+	if (
+		(header->magic != STR_SECTOR_MAGIC) ||
+		(header->type != STR_SECTOR_TYPE)
+	)
+		return;
+
+	// Sectors belonging to a new frame discard whatever was left of the
+	// previous one, which can only happen if some of its sectors were lost.
+	if (header->frame != player->currentFrame) {
+		if (player->chunksReceived)
+			player->stats.dropped++;
+
+		player->currentFrame   = header->frame;
+		player->numChunks      = header->numChunks;
+		player->chunksReceived = 0;
+		player->frameLength    = header->frameLength;
+		player->frameWidth     = header->width;
+		player->frameHeight    = header->height;
+		player->readStart      = _getTime();
+
+		if (player->frameLength > (player->numChunks * STR_CHUNK_SIZE))
+			player->frameLength = player->numChunks * STR_CHUNK_SIZE;
+	}
+
+	int offset = header->chunk * STR_CHUNK_SIZE;
+
+	if (
+		(header->chunk >= player->numChunks) ||
+		((offset + STR_CHUNK_SIZE) > player->frameBufferLength)
+	)
+		return;
+
+	memcpy(
+		&player->frameBuffer[offset],
+		&sector[STR_HEADER_SIZE],
+		STR_CHUNK_SIZE
+	);
+
+	if (++player->chunksReceived == player->numChunks)
+		player->stats.readTime = _getTime() - player->readStart;
+}
+
+/* Public API */
+
+void initSTRPlayer(STRPlayer *player, uint8_t *sectorBuffer, int numSlots) {
+	initXAStream(&player->stream, sectorBuffer, numSlots);
+
+	player->displayBuffer     = -1;
+	player->currentFrame      = 0;
+	player->numChunks         = 0;
+	player->chunksReceived    = 0;
+	player->mdecState[0]      = BUFFER_FREE;
+	player->mdecState[1]      = BUFFER_FREE;
+	player->mdecActive        = false;
+	player->nextMDECBuffer    = 0;
+	player->currentMDECBuffer = 0;
+	player->vramBuffer        = 0;
+
+	player->stats.frames     = 0;
+	player->stats.dropped    = 0;
+	player->stats.errors     = 0;
+	player->stats.readTime   = 0;
+	player->stats.decodeTime = 0;
+	player->stats.mdecTime   = 0;
+	player->stats.uploadTime = 0;
+	player->stats.interval   = 0;
+
+	// Configure timer 1 to count horizontal blanking periods, in order to
+	// measure the time taken by each stage.
+	TIMER_CTRL(1) = TIMER_CTRL_EXT_CLOCK;
+
+	setMDECInterrupt(true);
+}
+
+void startSTRPlayer(STRPlayer *player) {
+	player->currentFrame   = 0;
+	player->numChunks      = 0;
+	player->chunksReceived = 0;
+	player->lastFrameEnd   = _getTime();
+
+	startXAStream(&player->stream);
+}
+
+void stopSTRPlayer(STRPlayer *player) {
+	stopXAStream(&player->stream);
+}
+
+void updateSTRPlayer(STRPlayer *player) {
+	for (;;) {
+		if (
+			player->numChunks &&
+			(player->chunksReceived == player->numChunks)
+		) {
+			if (!_decodeFrame(player))
+				break;
+		}
+
+		const uint8_t *sector = getXAStreamSector(&player->stream);
+
+		if (!sector)
+			break;
+
+		_processSector(player, sector);
+		releaseXAStreamSector(&player->stream);
+	}
+}
+
+bool isSTRPlayerActive(const STRPlayer *player) {
+	return
+		isXAStreamActive(&player->stream) ||
+		player->mdecActive ||
+		(player->mdecState[0] != BUFFER_FREE) ||
+		(player->mdecState[1] != BUFFER_FREE);
+}
@@ -0,0 +1,174 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/mdecbs.h"
+#include "ps1/xastream.h"
+
+#define STR_SECTOR_MAGIC 0x0160
+#define STR_SECTOR_TYPE  0x8001
+#define STR_HEADER_SIZE  0x20
+#define STR_CHUNK_SIZE   (XASTREAM_SECTOR_SIZE - STR_HEADER_SIZE)
+
+// Each video sector begins with this header, followed by a chunk of the
+// compressed frame. The bitstream header of the frame is copied into all of
+// its sectors.
+typedef struct __attribute__((packed)) {
+	uint16_t     magic;       // Always STR_SECTOR_MAGIC
+	uint16_t     type;        // Always STR_SECTOR_TYPE
+	uint16_t     chunk;       // Index of this sector within the frame
+	uint16_t     numChunks;   // Number of sectors making up the frame
+	uint32_t     frame;       // Frame number, starting from 1
+	uint32_t     frameLength; // Length of the compressed frame in bytes
+	uint16_t     width, height;
+	MDECBSHeader bsHeader;
+	uint32_t     _reserved;
+} STRSectorHeader;
+
+typedef void (*STRUploadCallback)(
+	const void *data,
+	int        x,
+	int        y,
+	int        width,
+	int        height
+);
+
+typedef struct {
+	uint32_t frames;  // Frames decoded and uploaded to VRAM
+	uint32_t dropped; // Frames lost due to missing sectors or all buffers full
+	uint32_t errors;  // Frames whose bitstream could not be decoded
+
+	// Time spent in each stage for the last frame, measured in horizontal
+	// blanking periods (roughly 64 microseconds each). The read time is the
+	// time between the first and last sector of the frame being processed,
+	// the upload time is the total time spent in the upload callback and the
+	// interval is the time between the last two frames being completed.
+	uint16_t readTime, decodeTime, mdecTime, uploadTime, interval;
+} STRPlayerStats;
+
+typedef struct {
+	// These fields must be filled in before calling initSTRPlayer(). The
+	// frame buffer is used to reassemble compressed frames from sectors and
+	// must be 4-byte aligned and large enough to hold the largest frame in the
+	// video. The MDEC buffers hold decoded run-length codes and must be large
+	// enough for the largest frame once decoded (usually about 3-4 times its
+	// compressed length), while the slice buffers must each hold a column of
+	// 16x16 macroblocks (MDEC_MACROBLOCK_SIZE_16BPP * height / 16 words).
+	uint8_t  *frameBuffer;
+	int      frameBufferLength;
+	uint32_t *mdecBuffers[2];
+	int      mdecBufferLength;
+	uint32_t *sliceBuffers[2];
+
+	// Decoded frames are uploaded to the two given VRAM locations in turn,
+	// one vertical slice at a time, by calling the upload callback from the
+	// interrupt handler. The callback must start uploading the slice and may
+	// return before the upload has completed, but must wait for any previous
+	// upload to finish first (as sendVRAMData() in the examples does).
+	uint16_t          bufferX[2], bufferY[2];
+	STRUploadCallback upload;
+
+	// The stream's location, file and channel numbers must be filled in
+	// before starting playback. Video sectors are expected to be on the
+	// stream's data channel.
+	XAStream stream;
+
+	// Index of the VRAM buffer holding the last completed frame (-1 if none
+	// has been completed yet), which should be displayed at the next vertical
+	// blank.
+	volatile int8_t displayBuffer;
+	STRPlayerStats  stats;
+
+	// Internal state.
+	uint32_t          currentFrame, numChunks, chunksReceived, frameLength;
+	uint16_t          frameWidth, frameHeight, readStart, lastFrameEnd;
+	volatile uint8_t  mdecState[2];
+	uint16_t          mdecWidth[2], mdecHeight[2];
+	int               mdecLength[2];
+	volatile bool     mdecActive;
+	uint8_t           nextMDECBuffer, currentMDECBuffer, vramBuffer;
+	int               slice, numSlices;
+	uint16_t          mdecStart, uploadTime;
+} STRPlayer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes the player using the buffers set in its fields and sets
+ * up the MDEC interrupt and timer 1 (which is used to measure the time taken
+ * by each stage). initCDROM(), initMDEC() and initMDECBitstream() must have
+ * been called prior to this. The DMA interrupt must be enabled and
+ * handleSTRPlayerInterrupt() called from the interrupt handler.
+ *
+ * @param player
+ * @param sectorBuffer Ring buffer for the XA stream (see initXAStream())
+ * @param numSlots
+ */
+void initSTRPlayer(STRPlayer *player, uint8_t *sectorBuffer, int numSlots);
+
+/**
+ * @brief Starts playing back the video stream described by the player's
+ * stream fields. Frames are paced by the rate at which the drive delivers
+ * them, so updateSTRPlayer() must be called frequently (at least once per
+ * frame) to keep up.
+ *
+ * @param player
+ */
+void startSTRPlayer(STRPlayer *player);
+
+/**
+ * @brief Stops reading the stream. Any frame currently being decoded by the
+ * MDEC is still completed and uploaded.
+ *
+ * @param player
+ */
+void stopSTRPlayer(STRPlayer *player);
+
+/**
+ * @brief Processes all sectors received so far, decoding the bitstream of any
+ * completed frame into run-length codes and handing it over to the MDEC. Must
+ * be called from the main loop, as decoding takes a significant amount of CPU
+ * time. Reading, decoding, MDEC transfers and VRAM uploads are all performed
+ * in parallel, each working on a different frame or slice.
+ *
+ * @param player
+ */
+void updateSTRPlayer(STRPlayer *player);
+
+/**
+ * @brief Handles the MDEC output interrupt, uploading the slice that has just
+ * been decoded and starting the next transfer. Must be called from the
+ * interrupt handler whenever a DMA interrupt occurs.
+ *
+ * @param player
+ * @return True if the interrupt was handled
+ */
+bool handleSTRPlayerInterrupt(STRPlayer *player);
+
+/**
+ * @brief Returns whether the player is still reading the stream or decoding
+ * frames.
+ */
+bool isSTRPlayerActive(const STRPlayer *player);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,258 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include "ps1/cop0.h"
+#include "ps1/registers.h"
+#include "ps1/system.h"
+
+#define EXCEPTION_VECTOR ((uint32_t *) 0x80000080)
+#define VECTOR_LENGTH    4
+#define NUM_IRQ_CHANNELS 11
+
+typedef struct {
+	InterruptHandler func;
+	void             *arg;
+	uint32_t         flags;
+} IRQHandlerEntry;
+
+typedef struct {
+	uint32_t data[32], control[32];
+} GTEContext;
+
+extern const uint32_t _exceptionVector[];
+extern volatile int   _exceptionDepth;
+
+void _saveGTEContext(GTEContext *context);
+void _restoreGTEContext(const GTEContext *context);
+
+static InterruptHandler _interruptHandler    = 0;
+static void             *_interruptHandlerArg = 0;
+
+static IRQHandlerEntry _irqHandlers[NUM_IRQ_CHANNELS];
+static uint32_t        _irqHandlerMask = 0;
+static uint32_t        _irqNestedMask  = 0;
+
+// The timer register to sample is read directly by the assembly handler.
+volatile uint16_t     *_interruptTimer = 0;
+static InterruptStats _interruptStats;
+
+static void _dispatchIRQs(void) {
+	// Only IRQs that were pending when the handler was entered are dispatched.
+	// If another one is raised in the meantime (or a handler fails to
+	// acknowledge its IRQ), the CPU will take a new exception as soon as the
+	// handler returns.
+	uint32_t pending = IRQ_STAT & IRQ_MASK & _irqHandlerMask;
+
+	if (!pending)
+		return;
+
+	GTEContext gteContext;
+	bool       gteSaved = false;
+
+	for (int irq = 0; pending; irq++, pending >>= 1) {
+		if (!(pending & 1))
+			continue;
+
+		const IRQHandlerEntry *entry = &_irqHandlers[irq];
+
+		// If the GTE is not enabled, the interrupted code can't have been
+		// using it and there is nothing to save.
+		if (
+			(entry->flags & IRQ_HANDLER_USES_GTE) && !gteSaved &&
+			(cop0_getReg(COP0_STATUS) & COP0_STATUS_CU2)
+		) {
+			_saveGTEContext(&gteContext);
+			gteSaved = true;
+		}
+
+		if (entry->flags & IRQ_HANDLER_NESTED) {
+			// Mask the IRQ while the handler is running to prevent it from
+			// being reentered, then let any other IRQ preempt it. Nested
+			// exceptions save their own copy of the registers and EPC, so
+			// interrupts only have to be disabled again before returning.
+			// The IRQ is only unmasked afterwards if the handler did not
+			// mask it itself in the meantime using maskIRQ().
+			uint32_t bit = 1 << irq;
+
+			IRQ_MASK       &= ~bit;
+			_irqNestedMask |= bit;
+			enableInterrupts();
+			entry->func(entry->arg);
+			disableInterrupts();
+
+			if (_irqNestedMask & bit) {
+				IRQ_MASK       |= bit;
+				_irqNestedMask &= ~bit;
+			}
+		} else {
+			entry->func(entry->arg);
+		}
+	}
+
+	if (gteSaved)
+		_restoreGTEContext(&gteContext);
+}
+
+// This function is called by the assembly handler in exception.s, and returns
+// the address execution shall resume from. The entry time is the value of the
+// timer selected using setInterruptTimer(), sampled as soon as the handler was
+// entered.
+uint32_t _handleException(uint32_t cause, uint32_t epc, uint16_t entryTime) {
+	// Any exception other than an interrupt is the result of a bug (or of a
+	// syscall, which is not used), so just hang to make it easier to inspect
+	// the CPU's state in a debugger.
+	if ((cause & COP0_CAUSE_EXC_BITMASK) != COP0_CAUSE_EXC_INT) {
+		for (;;)
+			__asm__ volatile("");
+	}
+
+	// Due to a hardware bug, if an interrupt occurs while the CPU is about to
+	// execute a GTE command the command will be executed anyway, and EPC will
+	// still point to it. Skip the instruction in such cases to prevent it from
+	// being run twice. GTE commands are encoded as COP2 instructions with bit
+	// 25 set.
+	if (!(cause & COP0_CAUSE_BD)) {
+		uint32_t instruction = *((const uint32_t *) epc);
+
+		if ((instruction >> 25) == 0x25)
+			epc += 4;
+	}
+
+	InterruptStats    *stats = &_interruptStats;
+	volatile uint16_t *timer = _interruptTimer;
+	uint16_t          time;
+
+	stats->count++;
+
+	if (_exceptionDepth > stats->maxDepth)
+		stats->maxDepth = _exceptionDepth;
+
+	if (timer) {
+		time = *timer - entryTime;
+
+		stats->lastEntryTime = time;
+		if (time > stats->maxEntryTime)
+			stats->maxEntryTime = time;
+	}
+
+	if (_interruptHandler)
+		_interruptHandler(_interruptHandlerArg);
+
+	_dispatchIRQs();
+
+	// This does not include the time spent restoring registers, which is
+	// constant and only takes a few dozen cycles.
+	if (timer) {
+		time = *timer - entryTime;
+
+		stats->lastTotalTime = time;
+		if (time > stats->maxTotalTime)
+			stats->maxTotalTime = time;
+	}
+
+	return epc;
+}
+
+void installExceptionHandler(void) {
+	disableInterrupts();
+
+	IRQ_MASK = 0;
+	IRQ_STAT = 0;
+
+	// Overwrite the BIOS's own vector with ours, then flush the instruction
+	// cache to ensure the CPU is not going to run any stale copy of the old
+	// one. Clearing the BEV bit makes the CPU use the vector in RAM rather than
+	// the one in ROM (the BIOS clears it during boot anyway) and unmasking
+	// interrupt line 2 lets the IRQ controller's signal through.
+	for (int i = 0; i < VECTOR_LENGTH; i++)
+		EXCEPTION_VECTOR[i] = _exceptionVector[i];
+
+	flushCache();
+
+	uint32_t status = cop0_getReg(COP0_STATUS);
+
+	status &= ~(COP0_STATUS_BEV | COP0_STATUS_Im0 | COP0_STATUS_Im1);
+	status |= COP0_STATUS_Im2;
+	cop0_setReg(COP0_STATUS, status);
+}
+
+void setInterruptHandler(InterruptHandler func, void *arg) {
+	bool enabled = disableInterrupts();
+
+	_interruptHandler    = func;
+	_interruptHandlerArg = arg;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void setIRQHandler(
+	IRQChannel       irq,
+	InterruptHandler func,
+	void             *arg,
+	uint32_t         flags
+) {
+	bool            enabled = disableInterrupts();
+	IRQHandlerEntry *entry  = &_irqHandlers[irq];
+
+	entry->func  = func;
+	entry->arg   = arg;
+	entry->flags = flags;
+
+	if (func)
+		_irqHandlerMask |= 1 << irq;
+	else
+		_irqHandlerMask &= ~(1 << irq);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void maskIRQ(IRQChannel irq) {
+	bool enabled = disableInterrupts();
+
+	IRQ_MASK       &= ~(1 << irq);
+	_irqNestedMask &= ~(1 << irq);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void setInterruptTimer(int timer) {
+	bool enabled = disableInterrupts();
+
+	_interruptTimer = (timer >= 0) ? &TIMER_VALUE(timer) : 0;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void getInterruptStats(InterruptStats *output, bool reset) {
+	bool enabled = disableInterrupts();
+
+	*output = _interruptStats;
+
+	if (reset) {
+		_interruptStats.count        = 0;
+		_interruptStats.maxEntryTime = 0;
+		_interruptStats.maxTotalTime = 0;
+		_interruptStats.maxDepth     = 0;
+	}
+
+	if (enabled)
+		enableInterrupts();
+}
@@ -16,10 +16,147 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cop0.h"
+#include "ps1/registers.h"
+
+typedef void (*InterruptHandler)(void *arg);
+
+typedef enum {
+	IRQ_HANDLER_NESTED   = 1 << 0, // Run with interrupts enabled
+	IRQ_HANDLER_USES_GTE = 1 << 1  // Save and restore GTE registers
+} IRQHandlerFlag;
+
+typedef struct {
+	// Number of exceptions handled. All times are in ticks of the timer
+	// selected using setInterruptTimer(): entry times are measured from the
+	// exception being taken to the first handler being called, while total
+	// times also include the handlers themselves.
+	uint32_t count;
+	uint16_t lastEntryTime, maxEntryTime;
+	uint16_t lastTotalTime, maxTotalTime;
+	uint8_t  maxDepth;
+} InterruptStats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Enables interrupts globally (by setting the COP0 IEc bit). Interrupts
+ * from each source must additionally be unmasked through IRQ_MASK.
+ */
+static inline void enableInterrupts(void) {
+	cop0_setReg(COP0_STATUS, cop0_getReg(COP0_STATUS) | COP0_STATUS_IEc);
+}
+
+/**
+ * @brief Disables interrupts globally.
+ *
+ * @return True if interrupts were previously enabled, false otherwise
+ */
+static inline bool disableInterrupts(void) {
+	uint32_t status = cop0_getReg(COP0_STATUS);
+
+	cop0_setReg(COP0_STATUS, status & ~COP0_STATUS_IEc);
+	return (status & COP0_STATUS_IEc) ? true : false;
+}
+
+/**
+ * @brief Checks whether the given IRQ is pending and acknowledges it if so.
+ * Meant to be called from an interrupt handler once for each source it is
+ * interested in.
+ *
+ * @param irq
+ * @return True if the IRQ was pending, false otherwise
+ */
+static inline bool acknowledgeInterrupt(IRQChannel irq) {
+	if (IRQ_STAT & (1 << irq)) {
+		IRQ_STAT = ~(1 << irq);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Replaces the BIOS exception handler with a minimal one that calls the
+ * functions registered using setInterruptHandler() and setIRQHandler() whenever
+ * an interrupt occurs. All interrupt sources are masked and interrupts are left
+ * disabled; call enableInterrupts() after setting a handler and unmasking the
+ * desired IRQs.
+ */
+void installExceptionHandler(void);
+
+/**
+ * @brief Sets the function to be called by the exception handler whenever an
+ * interrupt occurs. The handler runs with interrupts disabled on a dedicated
+ * stack, and is responsible for acknowledging all IRQs it handles (using
+ * acknowledgeInterrupt()).
+ *
+ * @param func
+ * @param arg Optional argument passed to the handler
+ */
+void setInterruptHandler(InterruptHandler func, void *arg);
+
+/**
+ * @brief Sets the function to be called by the exception handler whenever the
+ * given IRQ is pending and unmasked. Handlers registered this way are called
+ * after the one set using setInterruptHandler() (if any), in IRQ channel order,
+ * and are responsible for acknowledging the IRQ as usual.
+ *
+ * If IRQ_HANDLER_NESTED is set, the handler runs with interrupts enabled so
+ * that other IRQs can preempt it; its own IRQ is masked until it returns (use
+ * maskIRQ() to keep it masked afterwards). If
+ * IRQ_HANDLER_USES_GTE is set, all GTE registers are saved before the handler
+ * is called and restored once all handlers have returned, so the handler is
+ * free to use the GTE even if the interrupted code was in the middle of a
+ * calculation. GTE registers are otherwise left untouched, as saving them is
+ * relatively expensive.
+ *
+ * @param irq
+ * @param func Handler to call, or a null pointer to remove the current one
+ * @param arg Optional argument passed to the handler
+ * @param flags Combination of IRQHandlerFlag values
+ */
+void setIRQHandler(
+	IRQChannel       irq,
+	InterruptHandler func,
+	void             *arg,
+	uint32_t         flags
+);
+
+/**
+ * @brief Masks the given IRQ. This is equivalent to clearing its bit in
+ * IRQ_MASK, but must be used instead if the IRQ may be masked from within its
+ * own handler while registered with IRQ_HANDLER_NESTED; clearing the bit
+ * directly would have no effect, as the IRQ is already masked while the handler
+ * is running and would be unmasked again once it returns.
+ *
+ * @param irq
+ */
+void maskIRQ(IRQChannel irq);
+
+/**
+ * @brief Selects the timer used to measure the exception handler's latency
+ * (see getInterruptStats()), or disables measurement if -1 is passed. The timer
+ * is only read, not configured, and should be counting up freely (i.e. not be
+ * set to reset at a target value) using any clock source.
+ *
+ * @param timer Timer index (0-2) or -1
+ */
+void setInterruptTimer(int timer);
+
+/**
+ * @brief Copies the latency statistics collected by the exception handler into
+ * the given structure, then optionally resets them.
+ *
+ * @param output
+ * @param reset
+ */
+void getInterruptStats(InterruptStats *output, bool reset);
+
 /**
  * @brief Clears the CPU's instruction cache. This function should be called
  * whenever any new executable code is loaded into main RAM.
@@ -0,0 +1,247 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * This is a minimal cooperative scheduler, allowing code that has to wait for
+ * hardware (such as a sequence of CD-ROM reads followed by processing of the
+ * loaded data) to be written as straight-line code rather than as a state
+ * machine polled by the main loop. Threads only ever switch when the running
+ * one yields or waits, so no locking is needed between them; interrupt
+ * handlers still run at any time and can wake up threads by raising events.
+ *
+ * Switching threads is done with setjmp() and longjmp(), which save and
+ * restore the registers preserved across function calls as well as the stack
+ * pointer and return address. All other registers are already assumed to be
+ * clobbered by the call to the scheduler, so nothing else has to be saved. A
+ * new thread is started by crafting a saved context whose stack pointer points
+ * to the top of its stack and whose return address points to an entry stub,
+ * which then calls the thread's function. Note that GTE registers are not
+ * saved, so threads must not yield halfway through a GTE calculation.
+ *
+ * The main thread (i.e. the code that called initThreads()) is treated like
+ * any other thread. Typically it will run the main loop and call
+ * waitThreadVSync() once per frame, letting other threads use the remaining
+ * time until the next vertical blank.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <string.h>
+#include "ps1/system.h"
+#include "ps1/thread.h"
+
+// Value stacks are filled with when a thread is created, used to measure how
+// much of each stack has been used. The MIPS calling convention requires a
+// 16-byte area at the top of the stack for the callee to spill its arguments
+// into.
+#define STACK_FILL       0xa5
+#define STACK_ARGS_SPACE 16
+
+static Thread  _mainThread;
+static Thread  *_threads;
+static int     _maxThreads, _currentIndex;
+static uint8_t *_stacks;
+static size_t  _stackSize;
+
+/* Scheduler */
+
+static Thread *_getThread(int index) {
+	// Index 0 is the main thread, followed by the threads in the pool.
+	return index ? &_threads[index - 1] : &_mainThread;
+}
+
+static bool _isThreadRunnable(Thread *thread) {
+	switch (thread->state) {
+		case THREAD_READY:
+			return true;
+
+		case THREAD_WAITING_CONDITION:
+			if (!thread->condition(thread->conditionArg))
+				return false;
+
+			thread->state = THREAD_READY;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static void _schedule(void) {
+	// Go through all threads in a round-robin fashion, starting from the one
+	// after the current thread and checking the current one last. If no
+	// thread is ready, keep looping until an interrupt handler or condition
+	// wakes one up.
+	int numThreads = _maxThreads + 1;
+	int index      = _currentIndex;
+
+	for (;;) {
+		index = (index + 1) % numThreads;
+
+		Thread *next = _getThread(index);
+
+		if (!_isThreadRunnable(next))
+			continue;
+		if (index == _currentIndex)
+			return;
+
+		Thread *current = _getThread(_currentIndex);
+
+		if (setjmp(&current->context))
+			return;
+
+		_currentIndex = index;
+		longjmp(&next->context, 1);
+	}
+}
+
+static void _threadEntry(void) {
+	Thread *thread = _getThread(_currentIndex);
+
+	thread->func(thread->arg);
+
+	// Free the thread, then switch to another one. As the thread is no longer
+	// runnable, the scheduler will never return here.
+	thread->state = THREAD_FREE;
+	_schedule();
+}
+
+/* Public API */
+
+void initThreads(
+	Thread  *threads,
+	int     maxThreads,
+	uint8_t *stacks,
+	size_t  stackSize
+) {
+	_threads      = threads;
+	_maxThreads   = maxThreads;
+	_currentIndex = 0;
+	_stacks       = stacks;
+	_stackSize    = stackSize;
+
+	_mainThread.func  = 0;
+	_mainThread.arg   = 0;
+	_mainThread.stack = 0;
+	_mainThread.state = THREAD_READY;
+
+	for (int i = 0; i < maxThreads; i++)
+		threads[i].state = THREAD_FREE;
+}
+
+Thread *createThread(ThreadFunction func, void *arg) {
+	for (int i = 0; i < _maxThreads; i++) {
+		Thread *thread = &_threads[i];
+
+		if (thread->state != THREAD_FREE)
+			continue;
+
+		uint8_t  *stack = &_stacks[i * _stackSize];
+		uint32_t gp;
+
+		__asm__ volatile("move %0, $gp\n" : "=r"(gp));
+		memset(stack, STACK_FILL, _stackSize);
+		memset(&thread->context, 0, sizeof(jmp_buf));
+
+		thread->context.ra = (uint32_t) &_threadEntry;
+		thread->context.gp = gp;
+		thread->context.sp =
+			(uint32_t) &stack[_stackSize - STACK_ARGS_SPACE];
+
+		thread->func  = func;
+		thread->arg   = arg;
+		thread->stack = stack;
+		thread->state = THREAD_READY;
+		return thread;
+	}
+
+	return 0;
+}
+
+Thread *getCurrentThread(void) {
+	return _getThread(_currentIndex);
+}
+
+void yieldThread(void) {
+	_schedule();
+}
+
+uint32_t waitThreadEvents(uint32_t mask) {
+	Thread *thread = _getThread(_currentIndex);
+
+	// The state must be updated with interrupts disabled, as the handler may
+	// otherwise raise an event after the mask has been set but before the
+	// thread is marked as waiting.
+	bool enabled = disableInterrupts();
+
+	thread->waitMask = mask;
+	thread->events   = 0;
+	thread->state    = THREAD_WAITING_EVENTS;
+
+	if (enabled)
+		enableInterrupts();
+
+	_schedule();
+	return thread->events;
+}
+
+void waitThreadCondition(ThreadCondition condition, void *arg) {
+	Thread *thread = _getThread(_currentIndex);
+
+	if (condition(arg))
+		return;
+
+	thread->condition    = condition;
+	thread->conditionArg = arg;
+	thread->state        = THREAD_WAITING_CONDITION;
+
+	_schedule();
+}
+
+void signalThreadEvents(uint32_t mask) {
+	for (int i = 0; i <= _maxThreads; i++) {
+		Thread *thread = _getThread(i);
+
+		if (thread->state != THREAD_WAITING_EVENTS)
+			continue;
+		if (!(thread->waitMask & mask))
+			continue;
+
+		thread->events = thread->waitMask & mask;
+		thread->state  = THREAD_READY;
+	}
+}
+
+bool isThreadRunning(const Thread *thread) {
+	return (thread->state != THREAD_FREE);
+}
+
+size_t getThreadStackUsage(const Thread *thread) {
+	if (!thread->stack)
+		return 0;
+
+	// Stacks grow downwards, so the lowest overwritten byte marks the deepest
+	// point reached.
+	size_t unused = 0;
+
+	while ((unused < _stackSize) && (thread->stack[unused] == STACK_FILL))
+		unused++;
+
+	return _stackSize - unused;
+}
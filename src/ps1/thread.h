@@ -0,0 +1,170 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+typedef enum {
+	THREAD_FREE              = 0,
+	THREAD_READY             = 1,
+	THREAD_WAITING_EVENTS    = 2,
+	THREAD_WAITING_CONDITION = 3
+} ThreadState;
+
+// Events are arbitrary bits raised by signalThreadEvents(), usually from an
+// interrupt handler. A few are predefined for common sources; the remaining
+// ones can be used freely.
+typedef enum {
+	THREAD_EVENT_VSYNC = 1 << 0,
+	THREAD_EVENT_CDROM = 1 << 1,
+	THREAD_EVENT_DMA   = 1 << 2,
+	THREAD_EVENT_SPU   = 1 << 3,
+	THREAD_EVENT_TIMER = 1 << 4,
+	THREAD_EVENT_USER  = 1 << 8
+} ThreadEvent;
+
+typedef void (*ThreadFunction)(void *arg);
+typedef bool (*ThreadCondition)(void *arg);
+
+typedef struct {
+	// Saved registers, valid while the thread is not running.
+	jmp_buf context;
+
+	// Entry point and argument, and stack allocated from the pool (a null
+	// pointer for the main thread, which uses the stack set up by crt0).
+	ThreadFunction func;
+	void           *arg;
+	uint8_t        *stack;
+
+	// Current state and wait parameters. The events a thread is waiting for
+	// may be received from an interrupt handler.
+	volatile uint8_t  state;
+	uint32_t          waitMask;
+	volatile uint32_t events;
+	ThreadCondition   condition;
+	void              *conditionArg;
+} Thread;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes the scheduler, turning the code calling this function
+ * into the main thread. The given array and stack pool are used to create up
+ * to maxThreads additional threads; the pool must be 8-byte aligned and
+ * maxThreads * stackSize bytes long, with stackSize being a multiple of 8.
+ *
+ * @param threads
+ * @param maxThreads
+ * @param stacks
+ * @param stackSize
+ */
+void initThreads(
+	Thread  *threads,
+	int     maxThreads,
+	uint8_t *stacks,
+	size_t  stackSize
+);
+
+/**
+ * @brief Creates a new thread running the given function, which starts
+ * running the next time the current thread yields or waits. The thread is
+ * freed once the function returns.
+ *
+ * @param func
+ * @param arg
+ * @return Pointer to the thread, or a null pointer if all threads are in use
+ */
+Thread *createThread(ThreadFunction func, void *arg);
+
+/**
+ * @brief Returns the thread currently running.
+ */
+Thread *getCurrentThread(void);
+
+/**
+ * @brief Lets other threads that are ready run, returning once all of them have
+ * had a chance to run (or immediately if no other thread is ready).
+ */
+void yieldThread(void);
+
+/**
+ * @brief Suspends the current thread until any of the given events is raised by
+ * signalThreadEvents(). Only events raised after this function is called are
+ * taken into account, so state that may have changed beforehand (such as the
+ * completion of a CD-ROM read) should be waited for using
+ * waitThreadCondition() instead.
+ *
+ * @param mask
+ * @return The events that resumed the thread
+ */
+uint32_t waitThreadEvents(uint32_t mask);
+
+/**
+ * @brief Suspends the current thread until the given function returns true.
+ * The function is called by the scheduler each time it looks for a thread to
+ * run, and should thus only check a flag or register (e.g. whether a transfer
+ * has completed).
+ *
+ * @param condition
+ * @param arg
+ */
+void waitThreadCondition(ThreadCondition condition, void *arg);
+
+/**
+ * @brief Resumes all threads waiting for any of the given events. Can be
+ * called from an interrupt handler.
+ *
+ * @param mask
+ */
+void signalThreadEvents(uint32_t mask);
+
+/**
+ * @brief Returns whether the given thread is still running (i.e. has not yet
+ * returned from its function).
+ *
+ * @param thread
+ */
+bool isThreadRunning(const Thread *thread);
+
+/**
+ * @brief Returns the maximum amount of stack space used by the given thread so
+ * far in bytes, determined by checking how much of the pattern the stack was
+ * filled with upon creation has been overwritten. Always returns 0 for the
+ * main thread.
+ *
+ * @param thread
+ */
+size_t getThreadStackUsage(const Thread *thread);
+
+/**
+ * @brief Suspends the current thread until the next vertical blank, letting
+ * other threads run in the meantime. The interrupt handler must call
+ * signalThreadEvents(THREAD_EVENT_VSYNC) upon receiving IRQ_VSYNC.
+ */
+static inline void waitThreadVSync(void) {
+	waitThreadEvents(THREAD_EVENT_VSYNC);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,315 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The CD-ROM controller contains a hardware XA-ADPCM decoder, which can play
+ * back compressed audio sectors as they are read without any involvement from
+ * the CPU. Each sector's XA subheader carries a file and channel number, and
+ * the drive can be told (using the setfilter command) to only play back the
+ * audio sectors that match a given pair. This allows multiple audio channels
+ * to be interleaved in a single file: 37800 Hz stereo audio only takes up one
+ * sector out of every eight at double speed, so up to seven other channels,
+ * of either audio or data, can be stored in between.
+ *
+ * Audio sectors are consumed by the decoder and never raise an interrupt, but
+ * all other sectors are still delivered to the CPU. This module keeps the
+ * drive reading through an interleaved stream, lets the decoder play one of
+ * its audio channels and picks the sectors belonging to a data channel out of
+ * the rest, placing them in a ring buffer for the game to process at its own
+ * pace. The drive is put in 2340-byte sector mode so that the subheader of
+ * each sector can be inspected; only the 2048 bytes of actual data are then
+ * transferred, directly into the buffer.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+#include "ps1/system.h"
+#include "ps1/xastream.h"
+
+typedef enum {
+	STEP_IDLE      = 0,
+	STEP_SETMODE   = 1,
+	STEP_SETFILTER = 2,
+	STEP_DEMUTE    = 3,
+	STEP_READ      = 4, // Seeking to the beginning of the stream
+	STEP_STREAMING = 5,
+	STEP_PAUSE     = 6,
+	STEP_RESTORE   = 7  // Switching the drive back to 2048-byte sectors
+} StreamStep;
+
+// In 2340-byte mode each sector begins with its location (as an MSF value),
+// the mode byte and two copies of the XA subheader, followed by the data.
+typedef struct __attribute__((packed)) {
+	CDROMGetlocLResult location;
+	CDROMXAHeader      headerCopy;
+} SectorHeader;
+
+#define STREAM_MODE  (CDROM_MODE_SPEED_2X | CDROM_MODE_XA_FILTER \
+	| CDROM_MODE_XA_ADPCM | CDROM_MODE_SIZE_2340)
+#define DEFAULT_MODE (CDROM_MODE_SPEED_2X | CDROM_MODE_SIZE_2048)
+
+static void _requestCallback(CDROMRequest *request);
+
+/* Command sequencing */
+
+static void _sendCommand(
+	XAStream   *stream,
+	StreamStep step,
+	uint8_t    command,
+	int        paramLength
+) {
+	CDROMRequest *request = &stream->request;
+
+	stream->step = step;
+
+	request->command     = command;
+	request->paramLength = paramLength;
+	request->getBuffer   = 0;
+	request->callback    = &_requestCallback;
+	request->arg         = stream;
+	queueCDROMRequest(request);
+}
+
+static void _startReading(XAStream *stream) {
+	CDROMRequest *request = &stream->request;
+
+	// A read with a count of zero leaves the drive running once it has begun
+	// reading, with sectors being passed to the sector callback.
+	request->lba   = stream->lba;
+	request->count = 0;
+	_sendCommand(stream, STEP_READ, CDROM_CMD_READ_S, 0);
+}
+
+static void _stop(XAStream *stream, XAStreamStatus endStatus) {
+	setCDROMSectorCallback(0, 0);
+
+	stream->status    = XASTREAM_STOPPING;
+	stream->endStatus = endStatus;
+	_sendCommand(stream, STEP_PAUSE, CDROM_CMD_PAUSE, 0);
+}
+
+static void _requestCallback(CDROMRequest *request) {
+	XAStream *stream = (XAStream *) request->arg;
+
+	if (request->status != CDROM_OK) {
+		setCDROMSectorCallback(0, 0);
+
+		stream->step   = STEP_IDLE;
+		stream->status = XASTREAM_ERROR;
+		return;
+	}
+
+	// A stop requested while the drive was being set up (or was seeking back
+	// to the beginning of the stream) takes effect once the current command
+	// has completed.
+	if (stream->stopRequested && (stream->step < STEP_PAUSE)) {
+		_stop(stream, XASTREAM_STOPPED);
+		return;
+	}
+
+	switch (stream->step) {
+		case STEP_SETMODE:
+			request->params[0] = stream->file;
+			request->params[1] = stream->audioChannel;
+			_sendCommand(stream, STEP_SETFILTER, CDROM_CMD_SETFILTER, 2);
+			break;
+
+		case STEP_SETFILTER:
+			_sendCommand(stream, STEP_DEMUTE, CDROM_CMD_DEMUTE, 0);
+			break;
+
+		case STEP_DEMUTE:
+			_startReading(stream);
+			break;
+
+		case STEP_READ:
+			stream->step   = STEP_STREAMING;
+			stream->status = XASTREAM_PLAYING;
+			break;
+
+		case STEP_PAUSE:
+			request->params[0] = DEFAULT_MODE;
+			_sendCommand(stream, STEP_RESTORE, CDROM_CMD_SETMODE, 1);
+			break;
+
+		case STEP_RESTORE:
+			stream->step   = STEP_IDLE;
+			stream->status = stream->endStatus;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* Sector handling */
+
+static void _sectorCallback(void *arg) {
+	XAStream *stream = (XAStream *) arg;
+
+	// Sectors may still trickle in from the previous location while seeking
+	// back to the beginning of the stream.
+	if (stream->step != STEP_STREAMING)
+		return;
+
+	SectorHeader header __attribute__((aligned(4)));
+
+	readCDROMSectorData(&header, sizeof(header));
+
+	const CDROMXAHeader *xa = &header.location.header;
+
+	uint32_t lba = cdrom_convertMSFToLBA(&header.location.absoluteMSF);
+	uint32_t end = stream->lba + stream->length;
+
+	if ((lba < stream->lba) || (lba >= end))
+		return;
+
+	if (
+		(xa->file == stream->file) &&
+		(xa->channel == stream->dataChannel) &&
+		(xa->submode & CDROM_XA_SM_TYPE_DATA)
+	) {
+		uint32_t count = stream->writeCount;
+
+		if ((count - stream->readCount) >= stream->numSlots) {
+			stream->stats.dropped++;
+		} else {
+			readCDROMSectorData(
+				&stream->buffer[
+					(count % stream->numSlots) * XASTREAM_SECTOR_SIZE
+				],
+				XASTREAM_SECTOR_SIZE
+			);
+
+			stream->writeCount = count + 1;
+			stream->stats.dataSectors++;
+		}
+	} else {
+		stream->stats.skipped++;
+	}
+
+	// As audio sectors never raise an interrupt, the end of the stream can
+	// only be detected by looking at the location of other sectors. Streams
+	// should thus end with a non-audio sector.
+	if ((lba + 1) < end)
+		return;
+
+	if (stream->loop) {
+		stream->stats.loops++;
+		_startReading(stream);
+	} else {
+		_stop(stream, XASTREAM_FINISHED);
+	}
+}
+
+/* Public API */
+
+void initXAStream(XAStream *stream, uint8_t *buffer, int numSlots) {
+	stream->buffer        = buffer;
+	stream->numSlots      = numSlots;
+	stream->status        = XASTREAM_STOPPED;
+	stream->readCount     = 0;
+	stream->writeCount    = 0;
+	stream->step          = STEP_IDLE;
+	stream->stopRequested = false;
+
+	stream->stats.dataSectors = 0;
+	stream->stats.skipped     = 0;
+	stream->stats.dropped     = 0;
+	stream->stats.loops       = 0;
+
+	// Mark the filter request as not in use.
+	stream->filterRequest.status = CDROM_OK;
+}
+
+void startXAStream(XAStream *stream) {
+	bool enabled = disableInterrupts();
+
+	stream->status        = XASTREAM_STARTING;
+	stream->readCount     = 0;
+	stream->writeCount    = 0;
+	stream->stopRequested = false;
+
+	setCDROMSectorCallback(&_sectorCallback, stream);
+
+	stream->request.params[0] = STREAM_MODE;
+	_sendCommand(stream, STEP_SETMODE, CDROM_CMD_SETMODE, 1);
+
+	if (enabled)
+		enableInterrupts();
+}
+
+void stopXAStream(XAStream *stream) {
+	bool enabled = disableInterrupts();
+
+	if (stream->step == STEP_STREAMING)
+		_stop(stream, XASTREAM_STOPPED);
+	else if (stream->step != STEP_IDLE)
+		stream->stopRequested = true;
+
+	if (enabled)
+		enableInterrupts();
+}
+
+bool setXAStreamChannel(XAStream *stream, uint8_t channel) {
+	CDROMRequest *request = &stream->filterRequest;
+	bool         enabled  = disableInterrupts();
+	bool         changed  = false;
+
+	if (
+		(stream->step == STEP_STREAMING) &&
+		(request->status != CDROM_PENDING)
+	) {
+		stream->audioChannel = channel;
+
+		request->command     = CDROM_CMD_SETFILTER;
+		request->paramLength = 2;
+		request->params[0]   = stream->file;
+		request->params[1]   = channel;
+		request->getBuffer   = 0;
+		request->callback    = 0;
+		queueCDROMRequest(request);
+
+		changed = true;
+	}
+
+	if (enabled)
+		enableInterrupts();
+
+	return changed;
+}
+
+const uint8_t *getXAStreamSector(const XAStream *stream) {
+	uint32_t count = stream->readCount;
+
+	if (count == stream->writeCount)
+		return 0;
+
+	return &stream->buffer[(count % stream->numSlots) * XASTREAM_SECTOR_SIZE];
+}
+
+void releaseXAStreamSector(XAStream *stream) {
+	if (stream->readCount != stream->writeCount)
+		stream->readCount++;
+}
+
+bool isXAStreamActive(const XAStream *stream) {
+	return
+		(stream->status == XASTREAM_STARTING) ||
+		(stream->status == XASTREAM_PLAYING) ||
+		(stream->status == XASTREAM_STOPPING);
+}
@@ -0,0 +1,146 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ps1/cdrom.h"
+
+#define XASTREAM_SECTOR_SIZE 2048
+#define XASTREAM_NO_CHANNEL  0xff
+
+typedef enum {
+	XASTREAM_STOPPED  = 0,
+	XASTREAM_STARTING = 1, // Drive being configured or seeking to the stream
+	XASTREAM_PLAYING  = 2,
+	XASTREAM_STOPPING = 3, // Drive being paused and switched back to 2048 mode
+	XASTREAM_FINISHED = 4, // End of stream reached with looping disabled
+	XASTREAM_ERROR    = 5  // CD-ROM request failed (no disc, read error)
+} XAStreamStatus;
+
+typedef struct {
+	uint32_t dataSectors; // Data sectors placed in the buffer
+	uint32_t skipped;     // Sectors belonging to other channels or files
+	uint32_t dropped;     // Data sectors lost due to the buffer being full
+	uint32_t loops;       // Times the stream has restarted from the beginning
+} XAStreamStats;
+
+typedef struct {
+	// These fields must be filled in before starting the stream. The location
+	// and length are in sectors. XA-ADPCM sectors whose file and channel
+	// numbers match the given ones are played back by the drive, while data
+	// sectors on the data channel are placed in the buffer; setting the data
+	// channel to XASTREAM_NO_CHANNEL disables data delivery altogether.
+	uint32_t lba, length;
+	uint8_t  file, audioChannel, dataChannel;
+	bool     loop;
+
+	// Ring buffer provided by the caller.
+	uint8_t *buffer;
+	int     numSlots;
+
+	// Current state of the stream and counters updated by the interrupt
+	// handler.
+	volatile uint8_t status;
+	XAStreamStats    stats;
+
+	// Internal state. The read and write counters are only ever incremented
+	// by the consumer and interrupt handler respectively, so that neither has
+	// to disable interrupts to update them.
+	volatile uint32_t readCount, writeCount;
+	CDROMRequest      request, filterRequest;
+	uint8_t           step, endStatus;
+	bool              stopRequested;
+} XAStream;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a stream using the given buffer, which must be 4-byte
+ * aligned and numSlots * XASTREAM_SECTOR_SIZE bytes long. initCDROM() must
+ * have been called prior to this. XA-ADPCM audio is mixed into the SPU's CD
+ * audio input, which must be enabled and given a non-zero volume separately
+ * (initSPU() does so).
+ *
+ * @param stream
+ * @param buffer
+ * @param numSlots
+ */
+void initXAStream(XAStream *stream, uint8_t *buffer, int numSlots);
+
+/**
+ * @brief Starts playing back the stream described by the stream's fields. The
+ * drive is switched to double speed, raw 2340-byte sectors and XA-ADPCM
+ * playback, then left reading for as long as the stream is playing; the drive
+ * cannot be used for anything else in the meantime. Once the last sector is
+ * reached the stream either restarts or stops on its own, depending on the
+ * loop field. Must not be called while the stream is active.
+ *
+ * @param stream
+ */
+void startXAStream(XAStream *stream);
+
+/**
+ * @brief Stops the stream, pausing the drive and switching it back to
+ * 2048-byte sectors so that other drivers can use it again. The stream's
+ * status goes to XASTREAM_STOPPED once done. Any data sectors left in the
+ * buffer can still be retrieved afterwards.
+ *
+ * @param stream
+ */
+void stopXAStream(XAStream *stream);
+
+/**
+ * @brief Switches playback to another audio channel of the stream without
+ * interrupting data delivery, e.g. to change music track or crossfade between
+ * variations of the same one. Takes effect from the next sector onwards.
+ *
+ * @param stream
+ * @param channel
+ * @return False if the stream is not playing or a previous change is still
+ * pending, true otherwise
+ */
+bool setXAStreamChannel(XAStream *stream, uint8_t channel);
+
+/**
+ * @brief Returns a pointer to the oldest data sector in the buffer (2048
+ * bytes) or a null pointer if the buffer is empty. The sector remains valid
+ * until releaseXAStreamSector() is called.
+ *
+ * @param stream
+ * @return Pointer to sector data or 0
+ */
+const uint8_t *getXAStreamSector(const XAStream *stream);
+
+/**
+ * @brief Removes the oldest data sector from the buffer, freeing its slot for
+ * the interrupt handler to reuse.
+ *
+ * @param stream
+ */
+void releaseXAStreamSector(XAStream *stream);
+
+/**
+ * @brief Returns whether the stream is starting, playing or stopping.
+ */
+bool isXAStreamActive(const XAStream *stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""MDEC bitstream test data generator
+
+A simple script to regenerate the test data used by mdecbsTest. Each test case
+consists of a frame compressed by tools/convertVideo.py (.bin) and the run-length
+codes the decoder is expected to output for it (.rlc), which are computed
+directly from the quantized coefficients rather than by decoding the frame. The
+images are generated procedurally from a fixed seed, so running this script
+again produces identical files unless the encoder's output changes.
+
+The number of macroblocks and maximum output length of each case must match the
+values passed to addMDECBSTest() in CMakeLists.txt. Requires NumPy.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+import sys
+from pathlib import Path
+from struct  import Struct
+
+import numpy
+from numpy import ndarray
+
+sys.path.insert(0, str(Path(__file__).parent.parent / "tools"))
+
+from convertVideo import \
+	encodeFrame, encodeFrameWithBudget, quantizeBlocks, toBlocks, \
+	transformBlocks
+
+## Reference decoder
+
+MDEC_END_OF_BLOCK: int = 0xfe00
+MDEC_CHUNK_SIZE:   int = 32
+
+def getReferenceCodes(
+	dc:         ndarray,
+	ac:         ndarray,
+	quantScale: int,
+	version:    int
+) -> bytes:
+	codes: list[int] = []
+
+	for block in range(dc.shape[0]):
+		# Version 3 DC coefficients are stored in units of 4.
+		value: int = int(dc[block]) * (4 if (version == 3) else 1)
+		codes.append((quantScale << 10) | (value & 0x3ff))
+
+		previous: int = 0
+
+		for position in numpy.flatnonzero(ac[block]):
+			run:   int = int(position) - previous
+			level: int = int(ac[block, position])
+
+			codes.append((run << 10) | (level & 0x3ff))
+			previous = int(position) + 1
+
+		codes.append(MDEC_END_OF_BLOCK)
+
+	# The decoder pads its output to a multiple of the DMA chunk size.
+	codes += [ MDEC_END_OF_BLOCK ] * (-len(codes) % (MDEC_CHUNK_SIZE * 2))
+
+	return Struct(f"< {len(codes)}H").pack(*codes)
+
+## Test images
+
+def makeGradient(width: int, height: int) -> ndarray:
+	y, x = numpy.mgrid[0:height, 0:width]
+
+	image: ndarray = numpy.zeros(( height, width, 3 ), "f")
+	image[:, :, 0] = x * 255 / width
+	image[:, :, 1] = y * 255 / height
+	image[:, :, 2] = \
+		((x - width / 2) ** 2 + (y - height / 2) ** 2 < (height / 3) ** 2) * 255
+
+	return image.astype("B")
+
+def makeNoise(width: int, height: int, seed: int) -> ndarray:
+	return numpy.random.default_rng(seed).integers(
+		0,
+		256,
+		( height, width, 3 ),
+		"B"
+	)
+
+## Main
+
+def main():
+	outputDir: Path = Path(__file__).parent / "data"
+	outputDir.mkdir(exist_ok = True)
+
+	def _save(name: str, frame: bytes, reference: bytes):
+		with open(outputDir / f"{name}.bin", "wb") as file:
+			file.write(frame)
+		with open(outputDir / f"{name}.rlc", "wb") as file:
+			file.write(reference)
+
+	def _encode(
+		image:      ndarray,
+		quantScale: int,
+		version:    int
+	) -> tuple[bytes, bytes]:
+		dc, ac = quantizeBlocks(
+			transformBlocks(toBlocks(image)),
+			quantScale,
+			version
+		)
+		frame: bytes = encodeFrame(dc, ac, quantScale, version)
+
+		return frame, getReferenceCodes(dc, ac, quantScale, version)
+
+	gradient: ndarray = makeGradient(48, 32)
+	noise:    ndarray = makeNoise(32, 32, 1)
+
+	# Regular frames, noise frames (which use long and escape codes
+	# extensively) and a frame truncated halfway through, which the decoder
+	# must reject.
+	_save("gradient_v3", *_encode(gradient, 8, 3))
+	_save("gradient_v2", *_encode(gradient, 8, 2))
+	_save("noise_v3",    *_encode(noise,    1, 3))
+	_save("noise_v2",    *_encode(noise,    1, 2))
+
+	frame, _ = _encode(gradient, 8, 3)
+	_save("truncated_v3", frame[0:len(frame) // 2], b"")
+
+	# A frame encoded with the smallest quantization scale that fits a
+	# 1024-word buffer, which must then be decodable into a buffer of that
+	# size.
+	coeffs:     ndarray = transformBlocks(toBlocks(makeNoise(64, 64, 2)))
+	quantScale: int     = encodeFrameWithBudget(coeffs, 1 << 20, 1024, 3)[1]
+	dc, ac              = quantizeBlocks(coeffs, quantScale, 3)
+
+	_save(
+		"budget_v3",
+		encodeFrame(dc, ac, quantScale, 3),
+		getReferenceCodes(dc, ac, quantScale, 3)
+	)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,121 @@
+/*
+ * ps1-bare-metal - (C) 2023-2025 spicyjpeg
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * This program is built for and run on the host rather than the PS1. It decodes
+ * a frame generated by tools/convertVideo.py using the bitstream decoder in
+ * ps1/mdecbs.c and compares the resulting run-length codes against a reference
+ * file, generated alongside the frame by tests/generateMDECBSData.py directly
+ * from the encoder's quantized coefficients. An empty reference file means the
+ * decoder is expected to reject the frame.
+ *
+ * Usage: mdecbsTest <frame> <reference> <macroblocks> <max length in words>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ps1/mdecbs.h"
+
+#define MAX_FILE_LENGTH (1 << 20)
+
+static uint32_t input [MAX_FILE_LENGTH / 4];
+static uint32_t output[MAX_FILE_LENGTH / 4];
+static uint32_t expected[MAX_FILE_LENGTH / 4];
+
+static int loadFile(const char *path, uint32_t *buffer) {
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stderr, "unable to open %s\n", path);
+		return -1;
+	}
+
+	int length = fread(buffer, 1, MAX_FILE_LENGTH, file);
+
+	fclose(file);
+	return length;
+}
+
+int main(int argc, const char **argv) {
+	if (argc != 5) {
+		fprintf(
+			stderr,
+			"usage: %s <frame> <reference> <macroblocks> <max length>\n",
+			argv[0]
+		);
+		return 2;
+	}
+
+	int inputLength    = loadFile(argv[1], input);
+	int expectedLength = loadFile(argv[2], expected);
+	int numMacroblocks = atoi(argv[3]);
+	int maxLength      = atoi(argv[4]);
+
+	if ((inputLength < 0) || (expectedLength < 0))
+		return 2;
+	if (maxLength > (MAX_FILE_LENGTH / 4)) {
+		fprintf(stderr, "maximum length too large\n");
+		return 2;
+	}
+
+	initMDECBitstream(0);
+
+	// Fill the output buffer with a known pattern beforehand, so that any
+	// write past the given maximum length can be detected.
+	for (int i = 0; i < (MAX_FILE_LENGTH / 4); i++)
+		output[i] = 0xdeadbeef;
+
+	int length = decodeMDECBitstream(
+		output,
+		maxLength,
+		input,
+		inputLength,
+		numMacroblocks
+	);
+
+	for (int i = maxLength; i < (MAX_FILE_LENGTH / 4); i++) {
+		if (output[i] != 0xdeadbeef) {
+			printf("FAIL: decoder wrote past the end of the buffer\n");
+			return 1;
+		}
+	}
+
+	if (length != (expectedLength / 4)) {
+		printf(
+			"FAIL: decoded %d words, expected %d\n",
+			length,
+			expectedLength / 4
+		);
+		return 1;
+	}
+
+	for (int i = 0; i < length; i++) {
+		if (output[i] != expected[i]) {
+			printf(
+				"FAIL: mismatch at word %d: got %08x, expected %08x\n",
+				i,
+				output[i],
+				expected[i]
+			);
+			return 1;
+		}
+	}
+
+	printf("OK: %d words\n", length);
+	return 0;
+}
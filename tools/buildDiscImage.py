@@ -0,0 +1,828 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 disc image builder
+
+A simple script to build bootable ISO9660 disc images from a JSON manifest
+listing the executable to boot and any additional files. A SYSTEM.CNF file is
+generated automatically. Files can be laid out on the disc in the order they
+were accessed in a recorded trace (a list of paths, one per line), so that data
+loaded together is stored contiguously and can be read without seeking. The
+image can be written either as a raw BIN/CUE pair (with valid EDC/ECC data) or
+as a plain .iso file, and optionally parsed back after being built to verify
+it. Requires no external dependencies.
+
+The manifest is a JSON object with the following keys:
+
+- "volumeID" (optional): volume name, up to 32 characters;
+- "executable": path to the .psexe file to boot;
+- "executableName" (optional): name of the executable on the disc, "PSX.EXE"
+  by default;
+- "stackTop", "tcb", "event" (optional): values for the respective SYSTEM.CNF
+  fields;
+- "systemArea" (optional): path to a file to place in the first 16 sectors of
+  the disc (such as license data);
+- "accessTrace" (optional): path to a trace file, overridden by -t;
+- "files": list of { "name": "DIR/FILE.EXT", "source": "path" } objects.
+  Setting the optional "xa" key to true in an entry marks its source as a raw
+  XA file made up of 2336-byte sectors (subheader and data), such as the
+  streams generated by interleaveXA.py; its sectors are then written to the
+  disc as-is, as either Form 1 or Form 2 sectors depending on their subheader.
+
+Source paths are relative to the directory containing the manifest, or to any
+of the directories passed using -I.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+import json
+from argparse        import ArgumentParser, FileType, Namespace
+from collections.abc import Generator
+from dataclasses     import dataclass, field
+from pathlib         import Path
+from struct          import Struct
+from sys             import stderr
+
+## Utilities
+
+def encodeBCD(value: int) -> int:
+	return value + (value // 10) * 6
+
+def toBothEndian32(value: int) -> bytes:
+	return value.to_bytes(4, "little") + value.to_bytes(4, "big")
+
+def toBothEndian16(value: int) -> bytes:
+	return value.to_bytes(2, "little") + value.to_bytes(2, "big")
+
+def padString(value: str, length: int) -> bytes:
+	return value.upper().encode("ascii")[0:length].ljust(length, b" ")
+
+def alignToSector(data: bytes) -> bytes:
+	length: int = max(len(data) + SECTOR_SIZE - 1, SECTOR_SIZE)
+
+	return data.ljust(length - (length % SECTOR_SIZE), b"\0")
+
+## EDC/ECC calculation
+
+# Raw Mode 2 Form 1 sectors carry a 32-bit EDC (a CRC) and two sets of
+# Reed-Solomon parity bytes (P and Q) for error correction. Without them most
+# emulators and drives will reject the sectors as unreadable.
+EDC_TABLE:   list[int] = []
+ECC_F_TABLE: list[int] = []
+ECC_B_TABLE: list[int] = [ 0 ] * 256
+
+for i in range(256):
+	edc: int = i
+
+	for j in range(8):
+		edc = (edc >> 1) ^ (0xd8018001 if (edc & 1) else 0)
+
+	EDC_TABLE.append(edc)
+
+	j: int = ((i << 1) ^ (0x11d if (i & 0x80) else 0)) & 0xff
+	ECC_F_TABLE.append(j)
+	ECC_B_TABLE[i ^ j] = i
+
+def calculateEDC(data: bytes | bytearray) -> int:
+	edc: int = 0
+
+	for byte in data:
+		edc = (edc >> 8) ^ EDC_TABLE[(edc ^ byte) & 0xff]
+
+	return edc
+
+def calculateECCBlock(
+	sector:     bytearray,
+	majorCount: int,
+	minorCount: int,
+	majorMult:  int,
+	minorInc:   int,
+	offset:     int
+):
+	size: int = majorCount * minorCount
+
+	for major in range(majorCount):
+		index: int = (major >> 1) * majorMult + (major & 1)
+		eccA:  int = 0
+		eccB:  int = 0
+
+		for minor in range(minorCount):
+			value: int = sector[12 + index]
+			index     += minorInc
+
+			if index >= size:
+				index -= size
+
+			eccA ^= value
+			eccB ^= value
+			eccA  = ECC_F_TABLE[eccA]
+
+		eccA = ECC_B_TABLE[ECC_F_TABLE[eccA] ^ eccB]
+
+		sector[offset + major]              = eccA
+		sector[offset + major + majorCount] = eccA ^ eccB
+
+## Raw sector encoding
+
+SECTOR_SIZE:     int   = 2048
+RAW_SECTOR_SIZE: int   = 2352
+SYNC_PATTERN:    bytes = b"\x00" + (b"\xff" * 10) + b"\x00"
+
+XA_SECTOR_SIZE:    int = 2336
+XA_FORM2_DATA_SIZE: int = 2324
+
+SUBMODE_DATA:  int = 0x08
+SUBMODE_EOR:   int = 0x01
+SUBMODE_FORM2: int = 0x20
+SUBMODE_EOF:   int = 0x80
+SUBMODE_LAST:  int = SUBMODE_DATA | SUBMODE_EOR | SUBMODE_EOF
+
+def makeSubheader(submode: int) -> bytes:
+	return bytes(( 0, 0, submode, 0 ) * 2)
+
+def encodeRawSector(lba: int, data: bytes, subheader: bytes) -> bytearray:
+	sector: bytearray = bytearray(RAW_SECTOR_SIZE)
+	lba              += 150
+
+	sector[0:12]  = SYNC_PATTERN
+	sector[16:24] = subheader
+
+	# Form 2 sectors (used for XA-ADPCM audio) trade error correction for a
+	# larger payload and only have an EDC, which may be left blank.
+	if subheader[2] & SUBMODE_FORM2:
+		sector[24:2348] = data[0:XA_FORM2_DATA_SIZE]
+
+		edc: int = calculateEDC(sector[16:2348])
+		sector[2348:2352] = edc.to_bytes(4, "little")
+	else:
+		sector[24:24 + SECTOR_SIZE] = data[0:SECTOR_SIZE]
+
+		edc: int = calculateEDC(sector[16:2072])
+		sector[2072:2076] = edc.to_bytes(4, "little")
+
+		# The header is excluded from the ECC calculation in Mode 2 sectors,
+		# so it is only filled in afterwards.
+		calculateECCBlock(sector, 86, 24,  2, 86, 2076)
+		calculateECCBlock(sector, 52, 43, 86, 88, 2248)
+
+	sector[12:16] = bytes((
+		encodeBCD(lba // (75 * 60)),
+		encodeBCD((lba // 75) % 60),
+		encodeBCD(lba % 75),
+		2
+	))
+
+	return sector
+
+## ISO9660 structures
+
+SYSTEM_AREA_SECTORS: int = 16
+PVD_LBA:             int = 16
+MAX_NAME_LENGTH:     int = 12 # 8.3 format
+MAX_DEPTH:           int = 8
+VALID_NAME_CHARS:    str = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_."
+
+DIR_RECORD_STRUCT:    Struct = Struct("< 2B 8s 8s 7s 3B 4s B")
+PATH_RECORD_L_STRUCT: Struct = Struct("< 2B I H")
+PATH_RECORD_M_STRUCT: Struct = Struct("> 2B I H")
+
+DIR_FLAG_DIRECTORY: int = 1 << 1
+
+@dataclass
+class DiscFile:
+	name: str
+	data: bytes
+	xa:   bool = False
+	lba:  int  = 0
+
+	def getSectorCount(self) -> int:
+		if self.xa:
+			return len(self.data) // XA_SECTOR_SIZE
+
+		return max((len(self.data) + SECTOR_SIZE - 1) // SECTOR_SIZE, 1)
+
+	def getLength(self) -> int:
+		# By convention the length of XA files is given as if all of their
+		# sectors were 2048 bytes long.
+		if self.xa:
+			return self.getSectorCount() * SECTOR_SIZE
+
+		return len(self.data)
+
+@dataclass
+class DiscDirectory:
+	name:     str
+	parent:   "DiscDirectory | None" = None
+	children: dict[str, "DiscDirectory"] = field(default_factory = dict)
+	files:    dict[str, DiscFile]        = field(default_factory = dict)
+	lba:      int = 0
+	length:   int = 0
+	index:    int = 0
+
+def makeDirRecord(name: bytes, lba: int, length: int, flags: int) -> bytes:
+	# Records must be an even number of bytes long.
+	recordLength: int = DIR_RECORD_STRUCT.size + len(name)
+	recordLength     += recordLength % 2
+
+	return DIR_RECORD_STRUCT.pack(
+		recordLength,
+		0,
+		toBothEndian32(lba),
+		toBothEndian32(length),
+		bytes(7),
+		flags,
+		0,
+		0,
+		toBothEndian16(1),
+		len(name)
+	) + name.ljust(recordLength - DIR_RECORD_STRUCT.size, b"\0")
+
+def makePathRecord(
+	name:        bytes,
+	lba:         int,
+	parentIndex: int,
+	bigEndian:   bool
+) -> bytes:
+	_struct: Struct = \
+		PATH_RECORD_M_STRUCT if bigEndian else PATH_RECORD_L_STRUCT
+	padding: bytes  = b"\0" * (len(name) % 2)
+
+	return _struct.pack(len(name), 0, lba, parentIndex) + name + padding
+
+class DiscImage:
+	def __init__(self, volumeID: str):
+		self.volumeID: str           = volumeID
+		self.root:     DiscDirectory = DiscDirectory("")
+		self.order:    list[DiscFile] = []
+
+	def addFile(self, path: str, data: bytes, xa: bool = False):
+		components: list[str] = [
+			part.upper() for part in path.replace("\\", "/").split("/")
+			if part
+		]
+
+		if not components:
+			raise RuntimeError(f"invalid file path: {path}")
+		if len(components) > MAX_DEPTH:
+			raise RuntimeError(f"path is nested too deeply: {path}")
+
+		for part in components:
+			if (len(part) > MAX_NAME_LENGTH) or \
+				(part.strip(VALID_NAME_CHARS) != ""):
+				raise RuntimeError(f"invalid name in path: {path}")
+
+		directory: DiscDirectory = self.root
+
+		for part in components[:-1]:
+			if part not in directory.children:
+				directory.children[part] = DiscDirectory(part, directory)
+
+			directory = directory.children[part]
+
+		name: str = components[-1]
+
+		if (name in directory.files) or (name in directory.children):
+			raise RuntimeError(f"duplicate file path: {path}")
+
+		if xa and ((not data) or (len(data) % XA_SECTOR_SIZE)):
+			raise RuntimeError(f"XA file has an invalid length: {path}")
+
+		entry: DiscFile = DiscFile("/".join(components), data, xa)
+
+		directory.files[name] = entry
+		self.order.append(entry)
+
+	def findFile(self, path: str) -> DiscFile | None:
+		path = "/".join(
+			part.upper().split(";")[0]
+			for part in path.replace("\\", "/").split("/") if part
+		)
+
+		for entry in self.order:
+			if entry.name == path:
+				return entry
+
+		return None
+
+	def applyTrace(self, trace: list[str]):
+		# Move all files that appear in the trace to the beginning of the disc
+		# in the order they were first accessed, keeping the original order of
+		# all other files.
+		traced: list[DiscFile] = []
+
+		for path in trace:
+			entry: DiscFile | None = self.findFile(path)
+
+			if entry is None:
+				print(
+					f"warning: traced file not on disc: {path}",
+					file = stderr
+				)
+			elif entry not in traced:
+				traced.append(entry)
+
+		self.order = traced + [
+			entry for entry in self.order if entry not in traced
+		]
+
+	def _getDirectories(self) -> list[DiscDirectory]:
+		# The path table must list directories sorted by depth first, then by
+		# parent directory and finally by name.
+		directories: list[DiscDirectory] = [ self.root ]
+
+		for directory in directories:
+			directories.extend(
+				directory.children[name]
+				for name in sorted(directory.children.keys())
+			)
+
+		for index, directory in enumerate(directories):
+			directory.index = index + 1
+
+		return directories
+
+	def _buildDirectory(self, directory: DiscDirectory) -> bytes:
+		records: list[bytes] = [
+			makeDirRecord(
+				b"\0",
+				directory.lba,
+				directory.length,
+				DIR_FLAG_DIRECTORY
+			),
+			makeDirRecord(
+				b"\1",
+				(directory.parent or directory).lba,
+				(directory.parent or directory).length,
+				DIR_FLAG_DIRECTORY
+			)
+		]
+
+		entries: list[tuple[str, bytes]] = []
+
+		for name, child in directory.children.items():
+			entries.append(( name, makeDirRecord(
+				name.encode("ascii"),
+				child.lba,
+				child.length,
+				DIR_FLAG_DIRECTORY
+			) ))
+		for name, entry in directory.files.items():
+			entries.append(( name, makeDirRecord(
+				f"{name};1".encode("ascii"),
+				entry.lba,
+				entry.getLength(),
+				0
+			) ))
+
+		entries.sort(key = lambda item: item[0])
+		records.extend(record for _, record in entries)
+
+		# Records may not cross sector boundaries, so the current sector must
+		# be padded if the next record does not fit.
+		data: bytearray = bytearray()
+
+		for record in records:
+			remaining: int = SECTOR_SIZE - (len(data) % SECTOR_SIZE)
+
+			if len(record) > remaining:
+				data.extend(b"\0" * remaining)
+
+			data.extend(record)
+
+		return alignToSector(bytes(data))
+
+	def _getDirectorySize(self, directory: DiscDirectory) -> int:
+		return len(self._buildDirectory(directory))
+
+	def hasXAFiles(self) -> bool:
+		return any(entry.xa for entry in self.order)
+
+	def build(self, systemArea: bytes = b"") -> list[tuple[int, bytes, bytes]]:
+		directories: list[DiscDirectory] = self._getDirectories()
+
+		pathTableSize: int = sum(
+			PATH_RECORD_L_STRUCT.size
+				+ len(directory.name or "\0")
+				+ (len(directory.name or "\0") % 2)
+			for directory in directories
+		)
+		pathTableSectors: int = \
+			(pathTableSize + SECTOR_SIZE - 1) // SECTOR_SIZE
+
+		# Allocate sectors for the path tables, directories and files in that
+		# order. Directory sizes do not depend on the LBAs of their contents,
+		# so they can be calculated beforehand.
+		lba: int = PVD_LBA + 2
+
+		pathTableLBA: int = lba
+		lba              += pathTableSectors * 2
+
+		for directory in directories:
+			directory.length = self._getDirectorySize(directory)
+			directory.lba    = lba
+			lba             += directory.length // SECTOR_SIZE
+
+		for entry in self.order:
+			entry.lba = lba
+			lba      += entry.getSectorCount()
+
+		totalSectors: int = lba
+
+		# Generate all sectors, returning a list of (LBA, data, subheader)
+		# tuples.
+		sectors: list[tuple[int, bytes, bytes]] = []
+
+		def addData(lba: int, data: bytes):
+			data       = alignToSector(data)
+			count: int = len(data) // SECTOR_SIZE
+
+			for i in range(count):
+				sectors.append((
+					lba + i,
+					data[i * SECTOR_SIZE:(i + 1) * SECTOR_SIZE],
+					makeSubheader(
+						SUBMODE_LAST if (i == (count - 1)) else SUBMODE_DATA
+					)
+				))
+
+		def addXAData(lba: int, data: bytes):
+			for i in range(0, len(data), XA_SECTOR_SIZE):
+				sector: bytes = data[i:i + XA_SECTOR_SIZE]
+
+				sectors.append((
+					lba + i // XA_SECTOR_SIZE,
+					sector[8:],
+					sector[0:8]
+				))
+
+		addData(0, systemArea[0:SYSTEM_AREA_SECTORS * SECTOR_SIZE].ljust(
+			SYSTEM_AREA_SECTORS * SECTOR_SIZE, b"\0"
+		))
+
+		pathTableL: bytes = b"".join(
+			makePathRecord(
+				directory.name.encode("ascii") or b"\0",
+				directory.lba,
+				directory.parent.index if directory.parent else 1,
+				False
+			) for directory in directories
+		)
+		pathTableM: bytes = b"".join(
+			makePathRecord(
+				directory.name.encode("ascii") or b"\0",
+				directory.lba,
+				directory.parent.index if directory.parent else 1,
+				True
+			) for directory in directories
+		)
+
+		addData(PVD_LBA, self._buildPVD(
+			totalSectors,
+			pathTableSize,
+			pathTableLBA,
+			pathTableLBA + pathTableSectors
+		))
+		addData(PVD_LBA + 1, b"\xffCD001\x01")
+		addData(pathTableLBA, pathTableL)
+		addData(pathTableLBA + pathTableSectors, pathTableM)
+
+		for directory in directories:
+			addData(directory.lba, self._buildDirectory(directory))
+		for entry in self.order:
+			if entry.xa:
+				addXAData(entry.lba, entry.data)
+			else:
+				addData(entry.lba, entry.data)
+
+		sectors.sort(key = lambda item: item[0])
+		return sectors
+
+	def _buildPVD(
+		self,
+		totalSectors:  int,
+		pathTableSize: int,
+		pathTableLBA:  int,
+		pathTableMLBA: int
+	) -> bytes:
+		pvd: bytearray = bytearray(SECTOR_SIZE)
+		noDate: bytes  = b"0" * 16 + b"\0"
+
+		pvd[0:7]     = b"\x01CD001\x01"
+		pvd[8:40]    = padString("PLAYSTATION", 32)
+		pvd[40:72]   = padString(self.volumeID, 32)
+		pvd[80:88]   = toBothEndian32(totalSectors)
+		pvd[120:124] = toBothEndian16(1)
+		pvd[124:128] = toBothEndian16(1)
+		pvd[128:132] = toBothEndian16(SECTOR_SIZE)
+		pvd[132:140] = toBothEndian32(pathTableSize)
+		pvd[140:144] = pathTableLBA.to_bytes(4, "little")
+		pvd[148:152] = pathTableMLBA.to_bytes(4, "big")
+		pvd[156:190] = makeDirRecord(
+			b"\0",
+			self.root.lba,
+			self.root.length,
+			DIR_FLAG_DIRECTORY
+		)
+		pvd[190:318] = padString("", 128)
+		pvd[318:446] = padString("", 128)
+		pvd[446:574] = padString("", 128)
+		pvd[574:702] = padString("PLAYSTATION", 128)
+		pvd[702:813] = padString("", 111)
+		pvd[813:881] = noDate * 4
+		pvd[881]     = 1
+
+		# The XA signature is expected by some drives and emulators to be
+		# present in the application use area.
+		pvd[1024:1032] = b"CD-XA001"
+
+		return bytes(pvd)
+
+## Image verification
+
+def readSector(image: bytes, lba: int, raw: bool) -> bytes:
+	if not raw:
+		return image[lba * SECTOR_SIZE:(lba + 1) * SECTOR_SIZE]
+
+	sector: bytes = image[lba * RAW_SECTOR_SIZE:(lba + 1) * RAW_SECTOR_SIZE]
+
+	if sector[0:12] != SYNC_PATTERN:
+		raise RuntimeError(f"sector {lba} has no sync pattern")
+	if calculateEDC(sector[16:2072]) != \
+		int.from_bytes(sector[2072:2076], "little"):
+		raise RuntimeError(f"sector {lba} has an invalid EDC")
+
+	return sector[24:24 + SECTOR_SIZE]
+
+def verifyXAFile(image: bytes, lba: int, entry: DiscFile) -> bool:
+	# Only compare the subheader and payload of each sector, as the EDC and
+	# ECC fields are filled in while building the image.
+	for i in range(entry.getSectorCount()):
+		offset:   int   = (lba + i) * RAW_SECTOR_SIZE
+		sector:   bytes = image[offset:offset + RAW_SECTOR_SIZE]
+		expected: bytes = \
+			entry.data[i * XA_SECTOR_SIZE:(i + 1) * XA_SECTOR_SIZE]
+
+		length: int = \
+			XA_FORM2_DATA_SIZE if (expected[2] & SUBMODE_FORM2) else SECTOR_SIZE
+
+		if sector[16:24 + length] != expected[0:8 + length]:
+			return False
+
+	return True
+
+def walkImage(
+	image: bytes,
+	raw:   bool
+) -> Generator[tuple[str, int, int], None, None]:
+	pvd: bytes = readSector(image, PVD_LBA, raw)
+
+	if pvd[0:6] != b"\x01CD001":
+		raise RuntimeError("primary volume descriptor not found")
+
+	pending: list[tuple[str, bytes]] = [ ( "", pvd[156:190] ) ]
+
+	# Walk the directory tree the same way the ISO9660 library does, yielding
+	# the path, LBA and length of each file found.
+	while pending:
+		path, record = pending.pop()
+		lba:    int  = int.from_bytes(record[2:6], "little")
+		length: int  = int.from_bytes(record[10:14], "little")
+
+		data: bytes = b"".join(
+			readSector(image, lba + i, raw)
+			for i in range(length // SECTOR_SIZE)
+		)
+
+		offset: int = 0
+
+		while offset < len(data):
+			recordLength: int = data[offset]
+
+			if not recordLength:
+				offset += SECTOR_SIZE - (offset % SECTOR_SIZE)
+				continue
+
+			entry: bytes = data[offset:offset + recordLength]
+			offset      += recordLength
+			name:  bytes = entry[33:33 + entry[32]]
+
+			if name in ( b"\0", b"\1" ):
+				continue
+
+			childPath: str = f"{path}/{name.decode('ascii').split(';')[0]}"
+
+			if entry[25] & DIR_FLAG_DIRECTORY:
+				pending.append(( childPath, entry ))
+				continue
+
+			yield (
+				childPath,
+				int.from_bytes(entry[2:6], "little"),
+				int.from_bytes(entry[10:14], "little")
+			)
+
+def verifyImage(image: bytes, raw: bool, disc: DiscImage) -> int:
+	found: int = 0
+
+	# Check that every file's contents match what was placed on the disc.
+	for path, lba, length in walkImage(image, raw):
+		sectors:  int             = (length + SECTOR_SIZE - 1) // SECTOR_SIZE
+		expected: DiscFile | None = disc.findFile(path)
+
+		if expected is None:
+			raise RuntimeError(f"unexpected file {path} in image")
+
+		if expected.xa:
+			valid: bool = (length == expected.getLength()) \
+				and verifyXAFile(image, lba, expected)
+		else:
+			valid: bool = expected.data == b"".join(
+				readSector(image, lba + i, raw)
+				for i in range(sectors)
+			)[0:length]
+
+		if not valid:
+			raise RuntimeError(f"contents of {path} do not match")
+
+		found += 1
+
+	if found != len(disc.order):
+		raise RuntimeError(
+			f"expected {len(disc.order)} files, found {found} in image"
+		)
+
+	return found
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Builds a bootable PlayStation 1 disc image from a JSON manifest, "
+			"optionally laying out files according to an access trace.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Image options")
+	group.add_argument(
+		"-t", "--trace",
+		type    = Path,
+		help    = \
+			"Lay out files in the order they appear in the given trace file "
+			"(one path per line)",
+		metavar = "file"
+	)
+	group.add_argument(
+		"-I", "--search-path",
+		type    = Path,
+		action  = "append",
+		default = [],
+		help    = "Add a directory to search for source files in",
+		metavar = "dir"
+	)
+	group.add_argument(
+		"-i", "--iso",
+		action = "store_true",
+		help   = \
+			"Output a plain .iso file with 2048-byte sectors rather than a "
+			"BIN/CUE pair"
+	)
+	group.add_argument(
+		"-v", "--verify",
+		action = "store_true",
+		help   = "Parse the image back after building it to verify it"
+	)
+	group.add_argument(
+		"-d", "--depfile",
+		type    = FileType("wt"),
+		help    = "Write a Makefile-style list of dependencies to given path",
+		metavar = "file"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"manifest",
+		type = Path,
+		help = "Path to JSON manifest"
+	)
+	group.add_argument(
+		"output",
+		type = Path,
+		help = \
+			"Path to .bin file to generate (the .cue file is saved alongside "
+			"it), or .iso file if -i is passed"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	searchPaths:  list[Path] = [ args.manifest.parent, *args.search_path ]
+	dependencies: list[Path] = [ args.manifest ]
+
+	def readSource(path: str) -> bytes:
+		for directory in searchPaths:
+			fullPath: Path = directory / path
+
+			if fullPath.exists():
+				dependencies.append(fullPath)
+
+				with open(fullPath, "rb") as file:
+					return file.read()
+
+		raise RuntimeError(f"unable to find source file: {path}")
+
+	try:
+		with open(args.manifest, "rt") as file:
+			manifest: dict = json.load(file)
+
+		disc:    DiscImage = DiscImage(manifest.get("volumeID", "PSX"))
+		exeName: str       = manifest.get("executableName", "PSX.EXE")
+
+		disc.addFile("SYSTEM.CNF", (
+			f"BOOT = cdrom:\\{exeName};1\r\n"
+			f"TCB = {manifest.get('tcb', 4)}\r\n"
+			f"EVENT = {manifest.get('event', 10)}\r\n"
+			f"STACK = {manifest.get('stackTop', '801FFFF0')}\r\n"
+		).encode("ascii"))
+		disc.addFile(exeName, readSource(manifest["executable"]))
+
+		for entry in manifest.get("files", []):
+			disc.addFile(
+				entry["name"],
+				readSource(entry["source"]),
+				entry.get("xa", False)
+			)
+
+		if args.iso and disc.hasXAFiles():
+			raise RuntimeError("XA files cannot be stored in .iso images")
+
+		tracePath: Path | None = args.trace
+
+		if (tracePath is None) and ("accessTrace" in manifest):
+			tracePath = args.manifest.parent / manifest["accessTrace"]
+		if tracePath is not None:
+			dependencies.append(tracePath)
+
+			with open(tracePath, "rt") as file:
+				trace: list[str] = [
+					line.strip() for line in file
+					if line.strip() and not line.startswith("#")
+				]
+
+			# The BIOS always loads SYSTEM.CNF and the executable first.
+			disc.applyTrace([ "SYSTEM.CNF", exeName, *trace ])
+
+		systemArea: bytes = \
+			readSource(manifest["systemArea"]) \
+			if ("systemArea" in manifest) else b""
+		sectors: list[tuple[int, bytes, bytes]] = disc.build(systemArea)
+	except KeyError as err:
+		parser.error(f"missing key in manifest: {err.args[0]}")
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	with open(args.output, "wb") as file:
+		for lba, data, subheader in sectors:
+			if args.iso:
+				file.write(data)
+			else:
+				file.write(encodeRawSector(lba, data, subheader))
+
+	if not args.iso:
+		with open(args.output.with_suffix(".cue"), "wt") as file:
+			file.write(
+				f"FILE \"{args.output.name}\" BINARY\n"
+				"  TRACK 01 MODE2/2352\n"
+				"    INDEX 01 00:00:00\n"
+			)
+
+	if args.depfile:
+		with args.depfile as file:
+			file.write(f"{args.output}: " + " ".join(
+				str(path).replace(" ", "\\ ") for path in dependencies
+			) + "\n")
+
+	if args.verify:
+		with open(args.output, "rb") as file:
+			image: bytes = file.read()
+
+		try:
+			count: int = verifyImage(image, not args.iso, disc)
+		except RuntimeError as err:
+			parser.error(f"verification failed: {err.args[0]}")
+
+		print(f"verified {count} files ({len(sectors)} sectors)")
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,320 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 instrument bank builder
+
+A simple script to build instrument banks for the sequence player library from
+a JSON manifest and a set of samples, already encoded in the SPU's ADPCM format
+(e.g. using convertAudio.py). The loop flags of each sample can optionally be
+rewritten according to the manifest, so that looping instruments can be built
+from any properly trimmed sample. Samples used by more than one instrument are
+only stored once. Requires no external dependencies.
+
+The manifest is a JSON object with an "instruments" key, containing a list of
+objects with the following keys:
+
+- "sample": path to the ADPCM sample data;
+- "sampleRate": sample rate the sample was encoded at;
+- "rootNote" (optional): MIDI note at which the sample plays back at its
+  original pitch, 60 (middle C) by default;
+- "programs" (optional): list of MIDI program numbers (0-127) to map to the
+  instrument;
+- "drums" (optional): list of notes on the drum channel to map to the
+  instrument;
+- "loop" (optional): whether the sample shall be looped; if omitted, the loop
+  flags already present in the sample data (such as the ones set by
+  convertAudio.py) are left as-is;
+- "loopStart" (optional): index of the sample to start the loop at if "loop"
+  is set, rounded down to the beginning of an ADPCM block, 0 by default;
+- "volume" (optional): instrument volume (0-127), 127 by default;
+- "attack", "decay", "release" (optional): envelope times in milliseconds, 0
+  by default;
+- "sustain" (optional): envelope sustain level (0-127), 127 by default.
+
+Sample paths are relative to the directory containing the manifest, or to any
+of the directories passed using -I.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+import json
+from argparse    import ArgumentParser, FileType, Namespace
+from dataclasses import dataclass
+from pathlib     import Path
+from struct      import Struct
+
+## Sample processing
+
+BLOCK_SIZE:        int = 16
+SAMPLES_PER_BLOCK: int = 28
+
+FLAG_END:        int = 1 << 0
+FLAG_REPEAT:     int = 1 << 1
+FLAG_LOOP_START: int = 1 << 2
+FLAG_BITMASK:    int = FLAG_END | FLAG_REPEAT | FLAG_LOOP_START
+
+def setLoopFlags(data: bytes, loop: bool, loopStart: int = 0) -> bytes:
+	if (not data) or (len(data) % BLOCK_SIZE):
+		raise RuntimeError("sample length is not a multiple of block size")
+
+	output:    bytearray = bytearray(data)
+	numBlocks: int       = len(data) // BLOCK_SIZE
+	loopBlock: int       = loopStart // SAMPLES_PER_BLOCK
+
+	if loopBlock >= numBlocks:
+		raise RuntimeError("loop start is past the end of the sample")
+
+	# The SPU jumps to the last block flagged as a loop start whenever it
+	# reaches a block with the end flag set. If the repeat flag is cleared, the
+	# channel's ADSR envelope is also muted, which is used to stop one-shot
+	# samples.
+	for offset in range(0, len(output), BLOCK_SIZE):
+		output[offset + 1] &= ~FLAG_BITMASK & 0xff
+
+	if loop:
+		output[loopBlock * BLOCK_SIZE + 1] |= FLAG_LOOP_START
+		output[-BLOCK_SIZE + 1]            |= FLAG_END | FLAG_REPEAT
+	else:
+		output[-BLOCK_SIZE + 1]            |= FLAG_END
+
+	return bytes(output)
+
+def getBasePitch(sampleRate: int) -> int:
+	pitch: int = round(sampleRate * 0x1000 / 44100)
+
+	if not (0 < pitch <= 0x3fff):
+		raise RuntimeError(f"invalid sample rate: {sampleRate}")
+
+	return pitch
+
+## Bank generation
+
+BANK_HEADER_STRUCT: Struct = Struct("< I 2H 2I 128s 128s")
+INSTRUMENT_STRUCT:  Struct = Struct("< I H 2B 3H 2B")
+BANK_MAGIC:         int    = 0x4b4e4250
+NO_INSTRUMENT:      int    = 0xff
+
+@dataclass
+class Instrument:
+	offset:    int
+	basePitch: int
+	rootNote:  int
+	volume:    int
+	attack:    int
+	decay:     int
+	release:   int
+	sustain:   int
+
+	def serialize(self) -> bytes:
+		return INSTRUMENT_STRUCT.pack(
+			self.offset,
+			self.basePitch,
+			self.rootNote,
+			self.volume,
+			self.attack,
+			self.decay,
+			self.release,
+			self.sustain,
+			0
+		)
+
+class SoundBank:
+	def __init__(self):
+		self.instruments: list[Instrument]      = []
+		self.programMap:  bytearray             = \
+			bytearray([ NO_INSTRUMENT ] * 128)
+		self.drumMap:     bytearray             = \
+			bytearray([ NO_INSTRUMENT ] * 128)
+		self.sampleData:  bytearray             = bytearray()
+		self.samples:     dict[bytes, int]      = {}
+
+	def addSample(self, data: bytes) -> int:
+		# Deduplicate samples (after their loop flags have been set).
+		if data in self.samples:
+			return self.samples[data]
+
+		offset: int = len(self.sampleData)
+
+		self.samples[data] = offset
+		self.sampleData   += data
+
+		return offset
+
+	def addInstrument(
+		self,
+		instrument: Instrument,
+		programs:   list[int],
+		drums:      list[int]
+	):
+		index: int = len(self.instruments)
+
+		if index >= NO_INSTRUMENT:
+			raise RuntimeError("too many instruments in bank")
+
+		for value, mapping in (
+			*(( program, self.programMap ) for program in programs),
+			*(( note,    self.drumMap    ) for note    in drums)
+		):
+			if not (0 <= value <= 127):
+				raise RuntimeError(f"invalid program or note number: {value}")
+			if mapping[value] != NO_INSTRUMENT:
+				raise RuntimeError(f"program or note {value} mapped twice")
+
+			mapping[value] = index
+
+		self.instruments.append(instrument)
+
+	def serialize(self) -> bytes:
+		table: bytes = b"".join(
+			instrument.serialize() for instrument in self.instruments
+		)
+		dataOffset: int = BANK_HEADER_STRUCT.size + len(table)
+
+		# Sample data is uploaded to SPU RAM through DMA and must thus be
+		# 4-byte aligned. The length is padded to a multiple of the transfer
+		# size with silent blocks.
+		dataOffset += (4 - dataOffset % 4) % 4
+		padding:  int = (64 - len(self.sampleData) % 64) % 64
+
+		header: bytes = BANK_HEADER_STRUCT.pack(
+			BANK_MAGIC,
+			len(self.instruments),
+			0,
+			dataOffset,
+			len(self.sampleData) + padding,
+			bytes(self.programMap),
+			bytes(self.drumMap)
+		)
+
+		return (header + table).ljust(dataOffset, b"\0") \
+			+ self.sampleData + bytes(padding)
+
+def clamp(value: int, minValue: int, maxValue: int, name: str) -> int:
+	if not (minValue <= value <= maxValue):
+		raise RuntimeError(
+			f"{name} must be in {minValue}-{maxValue} range, got {value}"
+		)
+
+	return value
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Builds an instrument bank for the PS1 sequence player from a JSON "
+			"manifest and a set of SPU ADPCM samples.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Bank options")
+	group.add_argument(
+		"-I", "--search-path",
+		type    = Path,
+		action  = "append",
+		default = [],
+		help    = "Add a directory to search for samples in",
+		metavar = "dir"
+	)
+	group.add_argument(
+		"-d", "--depfile",
+		type    = FileType("wt"),
+		help    = "Write a Makefile-style list of dependencies to given path",
+		metavar = "file"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"manifest",
+		type = Path,
+		help = "Path to JSON manifest"
+	)
+	group.add_argument(
+		"output",
+		type = Path,
+		help = "Path to bank file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	searchPaths:  list[Path] = [ args.manifest.parent, *args.search_path ]
+	dependencies: list[Path] = [ args.manifest ]
+
+	def readSource(path: str) -> bytes:
+		for directory in searchPaths:
+			fullPath: Path = directory / path
+
+			if fullPath.exists():
+				dependencies.append(fullPath)
+
+				with open(fullPath, "rb") as file:
+					return file.read()
+
+		raise RuntimeError(f"unable to find sample file: {path}")
+
+	try:
+		with open(args.manifest, "rt") as file:
+			manifest: dict = json.load(file)
+
+		bank: SoundBank = SoundBank()
+
+		for entry in manifest["instruments"]:
+			sample: bytes = readSource(entry["sample"])
+
+			if "loop" in entry:
+				sample = setLoopFlags(
+					sample,
+					entry["loop"],
+					entry.get("loopStart", 0)
+				)
+
+			bank.addInstrument(
+				Instrument(
+					bank.addSample(sample),
+					getBasePitch(entry["sampleRate"]),
+					clamp(entry.get("rootNote", 60),   0,  127, "root note"),
+					clamp(entry.get("volume",  127),   0,  127, "volume"),
+					clamp(entry.get("attack",    0),   0, 0xffff, "attack"),
+					clamp(entry.get("decay",     0),   0, 0xffff, "decay"),
+					clamp(entry.get("release",   0),   0, 0xffff, "release"),
+					clamp(entry.get("sustain", 127),   0,  127, "sustain")
+				),
+				entry.get("programs", []),
+				entry.get("drums",    [])
+			)
+	except KeyError as err:
+		parser.error(f"missing key in manifest: {err.args[0]}")
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	data: bytes = bank.serialize()
+
+	print(
+		f"{args.manifest.name}: {len(bank.instruments)} instruments, "
+		f"{len(bank.samples)} samples, {len(bank.sampleData)} bytes of "
+		"sample data"
+	)
+
+	with open(args.output, "wb") as file:
+		file.write(data)
+
+	if args.depfile:
+		with args.depfile as file:
+			file.write(f"{args.output}: " + " ".join(
+				str(path).replace(" ", "\\ ") for path in dependencies
+			) + "\n")
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,544 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 SPU-ADPCM audio encoder
+
+A simple script to convert uncompressed WAV files into the ADPCM format used by
+the SPU for samples in SPU RAM, as an alternative to psxavenc's "-t spu" output
+type. The input is mixed down to mono and resampled to the given rate using a
+windowed sinc filter. Requires NumPy to be installed.
+
+SPU-ADPCM data is made up of 16-byte blocks, each holding 28 4-bit samples, a
+shift amount and one of five prediction filters, which compute each sample from
+the two preceding ones. The best filter and shift for each block are picked by
+trying all 65 combinations on all blocks at once, assuming the preceding
+samples were decoded perfectly; each block is then encoded again using the
+actually decoded samples, falling back to a larger step size if any sample
+would otherwise clip. The signal-to-noise ratio and peak error of the encoded
+data are printed once done.
+
+Looping samples are supported, with the loop points either passed on the
+command line or read from the WAV file's "smpl" chunk. As the loop start must
+fall on a block boundary, silence is added before the sample if needed to align
+it, and short loops whose length is not a multiple of 28 samples are repeated
+until it is. The block at the loop start always uses the filter that does not
+depend on previous samples, so that it decodes identically whether it is
+reached from the preceding block or by looping back. A silent block is also
+added at the beginning of each sample (as done in .VAG files) to ensure
+decoding starts from a known state.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+import wave
+from argparse import ArgumentParser, FileType, Namespace
+from math     import gcd
+from struct   import Struct
+
+import numpy
+from numpy import ndarray
+
+## WAV file parsing
+
+CHUNK_STRUCT:     Struct = Struct("< 4s I")
+SMPL_STRUCT:      Struct = Struct("< 9I")
+SMPL_LOOP_STRUCT: Struct = Struct("< 6I")
+
+def readLoopPoints(data: bytes) -> tuple[int, int] | None:
+	# The wave module ignores any chunk other than "fmt " and "data", so the
+	# "smpl" chunk (if any) has to be found manually.
+	offset: int = 12
+
+	while (offset + CHUNK_STRUCT.size) <= len(data):
+		name, length = CHUNK_STRUCT.unpack_from(data, offset)
+		offset      += CHUNK_STRUCT.size
+
+		if name == b"smpl":
+			numLoops: int = SMPL_STRUCT.unpack_from(data, offset)[7]
+
+			if not numLoops:
+				return None
+
+			_, _, start, end, _, _ = SMPL_LOOP_STRUCT.unpack_from(
+				data,
+				offset + SMPL_STRUCT.size
+			)
+
+			# The loop end is inclusive.
+			return start, end + 1
+
+		offset += length + (length % 2)
+
+	return None
+
+def readWAVFile(path: str) -> tuple[ndarray, int, tuple[int, int] | None]:
+	with open(path, "rb") as file:
+		data: bytes = file.read()
+
+	try:
+		with wave.open(path, "rb") as file:
+			numChannels: int   = file.getnchannels()
+			width:       int   = file.getsampwidth()
+			sampleRate:  int   = file.getframerate()
+			frames:      bytes = file.readframes(file.getnframes())
+	except (wave.Error, EOFError) as err:
+		raise RuntimeError(f"unsupported WAV file: {err}")
+
+	if width == 1:
+		samples: ndarray = \
+			(numpy.frombuffer(frames, "u1").astype("f8") - 128) * 256
+	elif width == 3:
+		raw: ndarray = numpy.frombuffer(frames, "u1").reshape(( -1, 3 ))
+		samples      = (
+			raw[:, 1].astype("i4") | (raw[:, 2].astype("i1").astype("i4") << 8)
+		).astype("f8")
+	else:
+		samples = numpy.frombuffer(frames, f"<i{width}").astype("f8") \
+			/ (1 << (8 * width - 16))
+
+	# Mix all channels down to mono.
+	samples = samples.reshape(( -1, numChannels )).mean(1)
+
+	return samples, sampleRate, readLoopPoints(data)
+
+## Resampling
+
+FILTER_TAPS:   int = 32
+CHUNK_LENGTH:  int = 0x4000
+
+def resample(samples: ndarray, inputRate: int, outputRate: int) -> ndarray:
+	if inputRate == outputRate:
+		return samples
+
+	# Use a Blackman-windowed sinc filter, whose cutoff is lowered when
+	# downsampling in order to avoid aliasing.
+	ratio:  float   = inputRate / outputRate
+	cutoff: float   = min(1.0, 1 / ratio)
+	length: int     = int(len(samples) / ratio)
+	padded: ndarray = numpy.pad(samples, FILTER_TAPS)
+	output: ndarray = numpy.empty(length)
+
+	offsets: ndarray = numpy.arange(-FILTER_TAPS + 1, FILTER_TAPS + 1)
+
+	for start in range(0, length, CHUNK_LENGTH):
+		positions: ndarray = \
+			numpy.arange(start, min(start + CHUNK_LENGTH, length)) * ratio
+		indices:   ndarray = \
+			numpy.floor(positions).astype("i8")[:, None] + offsets
+		distances: ndarray = indices - positions[:, None]
+
+		weights: ndarray = numpy.sinc(distances * cutoff) * cutoff \
+			* numpy.blackman(2 * FILTER_TAPS + 2)[1:-1]
+		output[start:start + len(positions)] = \
+			(padded[indices + FILTER_TAPS] * weights).sum(1)
+
+	return output
+
+## Loop point handling
+
+SAMPLES_PER_BLOCK: int = 28
+MAX_UNROLLED_LOOP: int = 0x4000
+
+def prepareSamples(
+	samples:   ndarray,
+	loopStart: int | None,
+	loopEnd:   int | None
+) -> tuple[ndarray, int | None]:
+	if loopStart is None:
+		padding: int = -len(samples) % SAMPLES_PER_BLOCK
+		samples      = numpy.pad(samples, ( SAMPLES_PER_BLOCK, padding ))
+
+		return samples, None
+
+	loopEnd = min(loopEnd or len(samples), len(samples))
+
+	if not (0 <= loopStart < loopEnd):
+		raise RuntimeError("invalid loop points")
+
+	# Anything past the end of the loop would never be played back.
+	intro:  ndarray = samples[:loopStart]
+	loop:   ndarray = samples[loopStart:loopEnd]
+	repeat: int     = SAMPLES_PER_BLOCK // gcd(len(loop), SAMPLES_PER_BLOCK)
+
+	# Make the loop length a multiple of the block size, either by repeating
+	# the loop or (if that would make it too long) by trimming it.
+	if (len(loop) * repeat) <= MAX_UNROLLED_LOOP:
+		loop = numpy.tile(loop, repeat)
+	else:
+		loop = loop[:len(loop) - (len(loop) % SAMPLES_PER_BLOCK)]
+
+	# Add the leading silent block, plus enough silence to align the loop
+	# start to a block boundary.
+	padding: int = SAMPLES_PER_BLOCK + (-len(intro) % SAMPLES_PER_BLOCK)
+	intro        = numpy.pad(intro, ( padding, 0 ))
+
+	return numpy.concatenate(( intro, loop )), len(intro)
+
+## ADPCM encoding
+
+BLOCK_SIZE: int = 16
+
+SEGMENT_LENGTH: int = 256
+
+FLAG_END:        int = 1 << 0
+FLAG_REPEAT:     int = 1 << 1
+FLAG_LOOP_START: int = 1 << 2
+
+# Prediction filter coefficients (in 1/64 units) applied to the previous and
+# second previous samples respectively.
+FILTERS: tuple[tuple[int, int], ...] = (
+	(   0,   0 ),
+	(  60,   0 ),
+	( 115, -52 ),
+	(  98, -55 ),
+	( 122, -60 )
+)
+
+NUM_SHIFTS:   int = 13
+SEARCH_CHUNK: int = 0x800
+
+def _getCandidates() -> tuple[ndarray, ndarray, ndarray, ndarray]:
+	filters: ndarray = numpy.repeat(numpy.arange(len(FILTERS)), NUM_SHIFTS)
+	shifts:  ndarray = numpy.tile(numpy.arange(NUM_SHIFTS), len(FILTERS))
+	coeffs:  ndarray = numpy.array(FILTERS, "i8")[filters]
+
+	return filters, shifts, coeffs[:, 0], coeffs[:, 1]
+
+CANDIDATES: tuple[ndarray, ndarray, ndarray, ndarray] = _getCandidates()
+
+def searchParameters(blocks: ndarray, forceRaw: ndarray) -> ndarray:
+	# Try all filter and shift combinations on every block at once, using the
+	# original input samples as history. The inner loop runs once per sample
+	# within a block, operating on arrays of (blocks, candidates) values.
+	_, shifts, coeff1, coeff2 = CANDIDATES
+
+	steps:   ndarray = (1 << (12 - shifts)).astype("i8")
+	history: ndarray = numpy.concatenate((
+		numpy.zeros(( 2, )),
+		blocks.reshape(-1)
+	))
+	best:    ndarray = numpy.empty(len(blocks), "i8")
+
+	for start in range(0, len(blocks), SEARCH_CHUNK):
+		chunk:  ndarray = blocks[start:start + SEARCH_CHUNK].astype("i8")
+		offset: int     = start * SAMPLES_PER_BLOCK
+		last:   ndarray = numpy.arange(len(chunk)) * SAMPLES_PER_BLOCK + offset
+
+		prev1:  ndarray = numpy.repeat(
+			history[last + 1].astype("i8")[:, None], len(steps), 1
+		)
+		prev2:  ndarray = numpy.repeat(
+			history[last + 0].astype("i8")[:, None], len(steps), 1
+		)
+		errors: ndarray = numpy.zeros(( len(chunk), len(steps) ), "i8")
+
+		for i in range(SAMPLES_PER_BLOCK):
+			target:    ndarray = chunk[:, i, None]
+			predicted: ndarray = (prev1 * coeff1 + prev2 * coeff2 + 32) >> 6
+			values:    ndarray = numpy.clip(
+				(target - predicted + (steps >> 1)) // steps, -8, 7
+			)
+			decoded:   ndarray = numpy.clip(
+				predicted + values * steps, -0x8000, 0x7fff
+			)
+
+			errors      += (target - decoded) ** 2
+			prev2, prev1 = prev1, decoded
+
+		# Only consider the first filter for blocks that must not depend on
+		# previous samples.
+		errors[forceRaw[start:start + SEARCH_CHUNK], NUM_SHIFTS:] = \
+			numpy.iinfo("i8").max
+		best[start:start + len(chunk)] = errors.argmin(1)
+
+	return best
+
+def encodeBlocks(
+	blocks:  ndarray,
+	filters: ndarray,
+	shifts:  ndarray,
+	prev1:   ndarray,
+	prev2:   ndarray
+) -> tuple[ndarray, ndarray, ndarray, ndarray]:
+	# Encode any number of blocks at once, each one using its own filter,
+	# shift and history. As in searchParameters(), the loop runs once per
+	# sample within a block.
+	coeffs: ndarray = numpy.array(FILTERS, "i8")[filters]
+	steps:  ndarray = (1 << (12 - shifts)).astype("i8")
+
+	values:  ndarray = numpy.empty(blocks.shape, "i8")
+	decoded: ndarray = numpy.empty(blocks.shape, "i8")
+	errors:  ndarray = numpy.zeros(len(blocks), "i8")
+	clipped: ndarray = numpy.zeros(len(blocks), "?")
+
+	for i in range(SAMPLES_PER_BLOCK):
+		target:    ndarray = blocks[:, i]
+		predicted: ndarray = \
+			(prev1 * coeffs[:, 0] + prev2 * coeffs[:, 1] + 32) >> 6
+		value:     ndarray = (target - predicted + (steps >> 1)) // steps
+
+		clipped      |= (value < -8) | (value > 7)
+		value         = numpy.clip(value, -8, 7)
+		values [:, i] = value
+		decoded[:, i] = \
+			numpy.clip(predicted + value * steps, -0x8000, 0x7fff)
+
+		errors      += (target - decoded[:, i]) ** 2
+		prev2, prev1 = prev1, decoded[:, i]
+
+	return values, decoded, errors, clipped
+
+def encodeADPCM(
+	samples:   ndarray,
+	loopStart: int | None
+) -> tuple[bytes, ndarray]:
+	samples = numpy.clip(numpy.rint(samples), -0x8000, 0x7fff).astype("i8")
+
+	blocks:    ndarray = samples.reshape(( -1, SAMPLES_PER_BLOCK ))
+	numBlocks: int     = len(blocks)
+	loopBlock: int     = -1 if (loopStart is None) else \
+		(loopStart // SAMPLES_PER_BLOCK)
+
+	forceRaw: ndarray = numpy.zeros(numBlocks, "?")
+
+	if loopBlock >= 0:
+		forceRaw[loopBlock] = True
+
+	best:    ndarray = searchParameters(blocks, forceRaw)
+	filters: ndarray = CANDIDATES[0][best]
+	shifts:  ndarray = CANDIDATES[1][best]
+
+	values:  ndarray = numpy.zeros(blocks.shape, "i8")
+	decoded: ndarray = numpy.zeros(blocks.shape, "i8")
+	chosen:  ndarray = shifts.copy()
+	prev1:   ndarray = numpy.zeros(numBlocks, "i8")
+	prev2:   ndarray = numpy.zeros(numBlocks, "i8")
+
+	def _encode(indices: ndarray):
+		# Encode each block again using the actual decoded history. If the
+		# error caused by the history differing from the original samples
+		# makes any value clip, try a larger step size as well and keep
+		# whichever is better.
+		blockValues, blockDecoded, errors, clipped = encodeBlocks(
+			blocks [indices],
+			filters[indices],
+			shifts [indices],
+			prev1  [indices],
+			prev2  [indices]
+		)
+		blockShifts: ndarray = shifts[indices]
+		retry:       ndarray = numpy.flatnonzero(clipped & (blockShifts > 0))
+
+		if len(retry):
+			otherValues, otherDecoded, otherErrors, _ = encodeBlocks(
+				blocks [indices[retry]],
+				filters[indices[retry]],
+				shifts [indices[retry]] - 1,
+				prev1  [indices[retry]],
+				prev2  [indices[retry]]
+			)
+			better: ndarray = otherErrors < errors[retry]
+			retry           = retry[better]
+
+			blockValues [retry] = otherValues [better]
+			blockDecoded[retry] = otherDecoded[better]
+			blockShifts [retry] -= 1
+
+		values [indices] = blockValues
+		decoded[indices] = blockDecoded
+		chosen [indices] = blockShifts
+
+	def _update(indices: ndarray) -> ndarray:
+		# Pass the last two decoded samples of each block on to the next one
+		# and return the indices of the blocks whose history has changed.
+		indices          = indices[indices < (numBlocks - 1)]
+		last1:   ndarray = decoded[indices, -1]
+		last2:   ndarray = decoded[indices, -2]
+		changed: ndarray = \
+			(last1 != prev1[indices + 1]) | (last2 != prev2[indices + 1])
+
+		indices        = indices[changed] + 1
+		prev1[indices] = last1[changed]
+		prev2[indices] = last2[changed]
+
+		return indices
+
+	# As each block's history depends on the previous one, the blocks must be
+	# encoded in order. To avoid going through them one at a time, the blocks
+	# are split into segments which are encoded in parallel, initially using
+	# the original samples as history for the first block of each segment.
+	# Whenever a block's decoded output then turns out not to match the
+	# history the next block was encoded with, the latter is encoded again;
+	# this is repeated until no history changes, yielding the same result as
+	# encoding all blocks in order.
+	starts: ndarray = numpy.arange(0, numBlocks, SEGMENT_LENGTH)
+
+	prev1[starts[1:]] = blocks[starts[1:] - 1, -1]
+	prev2[starts[1:]] = blocks[starts[1:] - 1, -2]
+
+	for offset in range(SEGMENT_LENGTH):
+		indices: ndarray = starts + offset
+		indices          = indices[indices < numBlocks]
+
+		_encode(indices)
+
+		if offset < (SEGMENT_LENGTH - 1):
+			_update(indices)
+
+	pending: ndarray = _update(starts[1:] - 1)
+
+	while len(pending):
+		_encode(pending)
+		pending = _update(pending)
+
+	flags: ndarray = numpy.zeros(numBlocks, "B")
+
+	if loopBlock >= 0:
+		flags[loopBlock] |= FLAG_LOOP_START
+		flags[-1]        |= FLAG_REPEAT
+
+	flags[-1] |= FLAG_END
+
+	output: ndarray = numpy.empty(( numBlocks, BLOCK_SIZE ), "B")
+	output[:, 0]    = (filters << 4) | chosen
+	output[:, 1]    = flags
+	output[:, 2:]   = (values[:, 0::2] & 15) | ((values[:, 1::2] & 15) << 4)
+
+	return output.tobytes(), decoded.reshape(-1)
+
+def getQuality(original: ndarray, decoded: ndarray) -> tuple[float, int]:
+	original = numpy.clip(numpy.rint(original), -0x8000, 0x7fff)
+	noise:   ndarray = original - decoded
+
+	signalPower: float = float((original ** 2).sum())
+	noisePower:  float = float((noise    ** 2).sum())
+
+	if not noisePower:
+		return float("inf"), 0
+	if not signalPower:
+		return 0.0, int(abs(noise).max())
+
+	return \
+		10 * numpy.log10(signalPower / noisePower), int(abs(noise).max())
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Converts a WAV file into SPU-ADPCM sample data, optionally "
+			"resampling it and setting loop points.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Conversion options")
+	group.add_argument(
+		"-r", "--rate",
+		type    = int,
+		help    = \
+			"Resample the input to the given sample rate (same as the input "
+			"by default)",
+		metavar = "value"
+	)
+	group.add_argument(
+		"-l", "--loop",
+		action = "store_true",
+		help   = \
+			"Loop the sample, using the WAV file's loop points if any or the "
+			"whole sample otherwise"
+	)
+	group.add_argument(
+		"-n", "--no-loop",
+		action = "store_true",
+		help   = "Ignore any loop points in the WAV file"
+	)
+	group.add_argument(
+		"-s", "--loop-start",
+		type    = int,
+		help    = "Set loop start to the given input sample index (implies -l)",
+		metavar = "index"
+	)
+	group.add_argument(
+		"-e", "--loop-end",
+		type    = int,
+		help    = "Set loop end to the given input sample index (implies -l)",
+		metavar = "index"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"input",
+		type = str,
+		help = "Path to WAV file to convert"
+	)
+	group.add_argument(
+		"output",
+		type = FileType("wb"),
+		help = "Path to raw SPU-ADPCM file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	try:
+		samples, inputRate, loopPoints = readWAVFile(args.input)
+	except (OSError, RuntimeError) as err:
+		parser.error(str(err))
+
+	outputRate: int = args.rate or inputRate
+
+	if not (0 < outputRate <= 0x3fff * 44100 // 0x1000):
+		parser.error("invalid output sample rate")
+
+	if args.no_loop:
+		loopPoints = None
+	if (loopPoints is None) and \
+		(args.loop or (args.loop_start is not None) or args.loop_end):
+		loopPoints = 0, len(samples)
+	if loopPoints is not None:
+		loopPoints = (
+			loopPoints[0] if (args.loop_start is None) else args.loop_start,
+			loopPoints[1] if (args.loop_end   is None) else args.loop_end
+		)
+
+	samples = resample(samples, inputRate, outputRate)
+
+	loopStart: int | None = None
+	loopEnd:   int | None = None
+
+	if loopPoints is not None:
+		loopStart = round(loopPoints[0] * outputRate / inputRate)
+		loopEnd   = round(loopPoints[1] * outputRate / inputRate)
+
+	try:
+		samples, loopStart = prepareSamples(samples, loopStart, loopEnd)
+	except RuntimeError as err:
+		parser.error(str(err))
+
+	data, decoded  = encodeADPCM(samples, loopStart)
+	snr, peakError = getQuality(samples, decoded)
+
+	loopInfo: str = "" if (loopStart is None) else \
+		f", loop at {loopStart}"
+
+	print(
+		f"{args.input}: {len(samples)} samples at {outputRate} Hz{loopInfo}, "
+		f"{len(data)} bytes, SNR {snr:.1f} dB, peak error {peakError}"
+	)
+
+	with args.output as file:
+		file.write(data)
+
+if __name__ == "__main__":
+	main()
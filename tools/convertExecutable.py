@@ -7,9 +7,15 @@ A very simple script to convert ELF files compiled for the PS1 to the executable
 format used by the BIOS, with support for setting initial $sp/$gp values and
 customizing the region string (used by some emulators to determine whether they
 should start in PAL or NTSC mode by default). Requires no external dependencies.
+
+Executables can optionally be compressed using a simple LZ77 variant, in which
+case a small decompression stub is appended to the compressed data and set as
+the entry point. The stub decompresses the program in place to its original
+address, flushes the instruction cache and then jumps to the original entry
+point, with the same arguments and return address it was started with.
 """
 
-__version__ = "0.1.2"
+__version__ = "0.2.0"
 __author__  = "spicyjpeg"
 
 from argparse        import ArgumentParser, FileType, Namespace
@@ -43,6 +49,8 @@ def parseStructsFromFile(
 ELF_HEADER_STRUCT:  Struct = Struct("< 4s 4B 8x 2H 5I 6H")
 ELF_HEADER_MAGIC:   bytes  = b"\x7fELF"
 PROG_HEADER_STRUCT: Struct = Struct("< 8I")
+SEC_HEADER_STRUCT:  Struct = Struct("< 10I")
+SYMBOL_STRUCT:      Struct = Struct("< 3I 2B H")
 
 class ELFType(IntEnum):
 	RELOCATABLE = 1
@@ -64,6 +72,12 @@ class ProgHeaderType(IntEnum):
 	INTERPRETER = 3
 	NOTE        = 4
 
+class SecHeaderType(IntEnum):
+	NULL     = 0
+	PROGBITS = 1
+	SYMTAB   = 2
+	STRTAB   = 3
+
 class ProgHeaderFlag(IntFlag):
 	EXECUTE = 1 << 0
 	WRITE   = 1 << 1
@@ -71,9 +85,10 @@ class ProgHeaderFlag(IntFlag):
 
 @dataclass
 class Segment:
-	address: int
-	data:    bytes
-	flags:   ProgHeaderFlag
+	address:    int
+	data:       bytes
+	flags:      ProgHeaderFlag
+	fileLength: int
 
 	def isReadOnly(self) -> bool:
 		return not \
@@ -149,9 +164,53 @@ class ELF:
 			else:
 				data = data[0:length]
 
-			self.segments.append(Segment(address, data, flags))
+			self.segments.append(
+				Segment(address, data, flags, min(fileLength, length))
+			)
+
+		# Parse the symbol table, if any. Only the names and values of symbols
+		# are retained.
+		self.symbols: dict[str, int] = {}
 
-		#file.close()
+		if not secHeaderOffset or secHeaderSize != SEC_HEADER_STRUCT.size:
+			return
+
+		file.seek(secHeaderOffset)
+		sections: list[tuple] = list(
+			parseStructsFromFile(file, SEC_HEADER_STRUCT, secHeaderCount)
+		)
+
+		for (
+			_,
+			secType,
+			_,
+			_,
+			fileOffset,
+			length,
+			link,
+			_,
+			_,
+			entrySize
+		) in sections:
+			if (
+				secType   != SecHeaderType.SYMTAB or
+				entrySize != SYMBOL_STRUCT.size
+			):
+				continue
+
+			file.seek(sections[link][4])
+			names: bytes = file.read(sections[link][5])
+
+			file.seek(fileOffset)
+
+			for nameOffset, value, _, _, _, _ in parseStructsFromFile(
+				file, SYMBOL_STRUCT, length // SYMBOL_STRUCT.size
+			):
+				end:  int = names.find(b"\0", nameOffset)
+				name: str = names[nameOffset:end].decode("ascii", "replace")
+
+				if name:
+					self.symbols[name] = value
 
 	def flatten(self, stripReadOnly: bool = False) -> tuple[int, bytearray]:
 		# Find the lower and upper boundaries of the segments' address space.
@@ -174,6 +233,346 @@ class ELF:
 
 		return startAddress, data
 
+	def getInitializedLength(self, stripReadOnly: bool = False) -> int:
+		# Return the length of the flattened data, excluding any uninitialized
+		# (.bss) area at the end which the program will clear on its own.
+		startAddress: int = min(
+			seg.address for seg in self.segments
+		)
+
+		return max(
+			(seg.address + seg.fileLength - startAddress)
+			for seg in self.segments
+			if not (stripReadOnly and seg.isReadOnly())
+		)
+
+## LZ compressor
+
+# The compressed stream is made up of groups of up to 8 tokens, each preceded by
+# a byte whose bits (starting from the least significant one) specify whether
+# the respective token is a literal byte (0) or a back-reference (1). Each
+# back-reference is a 16-bit little-endian value, whose bottom 12 bits are the
+# distance to the data to copy minus 1 and whose top 4 bits are the length of
+# the copy minus 3. This format is less efficient than LZ4 but only requires
+# byte loads and stores, shifts and masks, which makes for a very short
+# decompressor that runs well on the R3000 despite the lack of a data cache.
+LZ_MIN_LENGTH:     int = 3
+LZ_MAX_LENGTH:     int = LZ_MIN_LENGTH + 15
+LZ_WINDOW_SIZE:    int = 4096
+LZ_MAX_CANDIDATES: int = 64
+
+@dataclass
+class CompressionStats:
+	literals:      int = 0
+	matches:       int = 0
+	matchedBytes:  int = 0
+	controlBytes:  int = 0
+	inPlaceMargin: int = 0
+
+def compressLZ(data: bytes) -> tuple[bytes, CompressionStats]:
+	output:     bytearray              = bytearray()
+	stats:      CompressionStats       = CompressionStats()
+	candidates: dict[bytes, list[int]] = {}
+
+	controlOffset: int = 0
+	controlBit:    int = 8
+	offset:        int = 0
+
+	def addPositions(start: int, end: int):
+		for position in range(start, min(end, len(data) - LZ_MIN_LENGTH + 1)):
+			key: bytes = data[position:position + LZ_MIN_LENGTH]
+			candidates.setdefault(key, []).append(position)
+
+	while offset < len(data):
+		if controlBit == 8:
+			controlOffset = len(output)
+			controlBit    = 0
+			stats.controlBytes += 1
+
+			output.append(0)
+
+		# Find the longest match among the most recent occurrences of the next
+		# few bytes within the window.
+		maxLength:  int = min(LZ_MAX_LENGTH, len(data) - offset)
+		bestLength: int = 0
+		bestOffset: int = 0
+
+		if maxLength >= LZ_MIN_LENGTH:
+			key: bytes = data[offset:offset + LZ_MIN_LENGTH]
+
+			for position in reversed(
+				candidates.get(key, [])[-LZ_MAX_CANDIDATES:]
+			):
+				if (offset - position) > LZ_WINDOW_SIZE:
+					break
+
+				length: int = LZ_MIN_LENGTH
+
+				while (
+					length < maxLength and
+					data[position + length] == data[offset + length]
+				):
+					length += 1
+
+				if length > bestLength:
+					bestLength = length
+					bestOffset = offset - position
+
+					if length == maxLength:
+						break
+
+		if bestLength >= LZ_MIN_LENGTH:
+			token: int = \
+				(bestOffset - 1) | ((bestLength - LZ_MIN_LENGTH) << 12)
+
+			output[controlOffset] |= 1 << controlBit
+			output.extend(token.to_bytes(2, "little"))
+			stats.matches      += 1
+			stats.matchedBytes += bestLength
+		else:
+			bestLength = 1
+
+			output.append(data[offset])
+			stats.literals += 1
+
+		addPositions(offset, offset + bestLength)
+		offset     += bestLength
+		controlBit += 1
+
+		# As decompression is done in place, the compressed data must be placed
+		# far enough past the beginning of the output buffer that the
+		# decompressor never overwrites any data it has yet to read. Keep track
+		# of the largest distance needed.
+		stats.inPlaceMargin = \
+			max(stats.inPlaceMargin, offset - len(output))
+
+	return bytes(output), stats
+
+# Rough cycle counts for each step of the decompressor, measured by summing up
+# instruction counts and main RAM access times. Used to give an estimate of the
+# time required to decompress an executable.
+CYCLES_PER_CONTROL_BYTE: int = 12
+CYCLES_PER_LITERAL:      int = 20
+CYCLES_PER_MATCH:        int = 22
+CYCLES_PER_MATCHED_BYTE: int = 12
+F_CPU:                   int = 33868800
+
+def estimateDecompressionTime(stats: CompressionStats) -> float:
+	cycles: int = 0 \
+		+ stats.controlBytes * CYCLES_PER_CONTROL_BYTE \
+		+ stats.literals     * CYCLES_PER_LITERAL \
+		+ stats.matches      * CYCLES_PER_MATCH \
+		+ stats.matchedBytes * CYCLES_PER_MATCHED_BYTE
+
+	return cycles / F_CPU
+
+## Decompression stub
+
+R_ZERO: int =  0
+R_A0:   int =  4
+R_A1:   int =  5
+R_T0:   int =  8
+R_T1:   int =  9
+R_T2:   int = 10
+R_T3:   int = 11
+R_T4:   int = 12
+R_T5:   int = 13
+R_T6:   int = 14
+R_T7:   int = 15
+R_RA:   int = 31
+
+class StubAssembler:
+	# A tiny assembler for the handful of MIPS instructions used by the stub.
+	# All instructions are emitted as-is, so delay slots must be filled
+	# manually.
+	def __init__(self, address: int):
+		self.address: int               = address
+		self.code:    list[int | tuple] = []
+		self.labels:  dict[str, int]    = {}
+
+	def label(self, name: str):
+		self.labels[name] = len(self.code)
+
+	def _iType(self, op: int, rs: int, rt: int, imm: int):
+		self.code.append((op << 26) | (rs << 21) | (rt << 16) | (imm & 0xffff))
+
+	def _rType(self, funct: int, rs: int, rt: int, rd: int, shamt: int = 0):
+		self.code.append(
+			(rs << 21) | (rt << 16) | (rd << 11) | (shamt << 6) | funct
+		)
+
+	def nop(self):
+		self.code.append(0)
+	def sll(self, rd: int, rt: int, shift: int):
+		self._rType(0x00, 0, rt, rd, shift)
+	def srl(self, rd: int, rt: int, shift: int):
+		self._rType(0x02, 0, rt, rd, shift)
+	def jr(self, rs: int):
+		self._rType(0x08, rs, 0, 0)
+	def jalr(self, rs: int):
+		self._rType(0x09, rs, 0, R_RA)
+	def subu(self, rd: int, rs: int, rt: int):
+		self._rType(0x23, rs, rt, rd)
+	def or_(self, rd: int, rs: int, rt: int):
+		self._rType(0x25, rs, rt, rd)
+
+	def addiu(self, rt: int, rs: int, value: int):
+		self._iType(0x09, rs, rt, value)
+	def andi(self, rt: int, rs: int, value: int):
+		self._iType(0x0c, rs, rt, value)
+	def ori(self, rt: int, rs: int, value: int):
+		self._iType(0x0d, rs, rt, value)
+	def lui(self, rt: int, value: int):
+		self._iType(0x0f, 0, rt, value)
+	def lbu(self, rt: int, offset: int, rs: int):
+		self._iType(0x24, rs, rt, offset)
+	def lw(self, rt: int, offset: int, rs: int):
+		self._iType(0x23, rs, rt, offset)
+	def sb(self, rt: int, offset: int, rs: int):
+		self._iType(0x28, rs, rt, offset)
+	def sw(self, rt: int, offset: int, rs: int):
+		self._iType(0x2b, rs, rt, offset)
+
+	def li(self, rt: int, value: int):
+		self.lui(rt, value >> 16)
+		self.ori(rt, rt, value & 0xffff)
+
+	def jal(self, target: int):
+		self.code.append((0x03 << 26) | ((target >> 2) & 0x3ffffff))
+
+	def beq(self, rs: int, rt: int, label: str):
+		self.code.append(( 0x04, rs, rt, label ))
+	def bne(self, rs: int, rt: int, label: str):
+		self.code.append(( 0x05, rs, rt, label ))
+
+	def word(self, value: int):
+		self.code.append(value)
+
+	def getLabelAddress(self, name: str) -> int:
+		return self.address + self.labels[name] * 4
+
+	def assemble(self) -> bytes:
+		output: bytearray = bytearray()
+
+		for index, item in enumerate(self.code):
+			if isinstance(item, tuple):
+				op, rs, rt, label = item
+				offset: int       = self.labels[label] - (index + 1)
+
+				item = \
+					(op << 26) | (rs << 21) | (rt << 16) | (offset & 0xffff)
+
+			output.extend(item.to_bytes(4, "little"))
+
+		return bytes(output)
+
+def generateStub(
+	address:     int,
+	source:      int,
+	destination: int,
+	length:      int,
+	entryPoint:  int,
+	flushCache:  int | None
+) -> bytes:
+	stub: StubAssembler = StubAssembler(address)
+
+	# Assemble the stub twice, as the address of the save area is only known
+	# after the first pass.
+	for _ in range(2):
+		saveArea: int = \
+			stub.getLabelAddress("saveArea") if stub.labels else address
+
+		stub.code   = []
+		stub.labels = {}
+
+		# Save the arguments and return address the stub was called with, so
+		# that they can be passed on to the actual entry point.
+		stub.li   (R_T7, saveArea)
+		stub.sw   (R_A0, 0, R_T7)
+		stub.sw   (R_A1, 4, R_T7)
+		stub.sw   (R_RA, 8, R_T7)
+		stub.li   (R_T0, source)
+		stub.li   (R_T1, destination)
+		stub.li   (R_T2, destination + length)
+		stub.addiu(R_T3, R_ZERO, 1)
+
+		# $t3 holds the current control byte, with a marker bit above it that
+		# is shifted down along with the flags. Once only the marker is left,
+		# a new control byte is fetched.
+		stub.label("loop")
+		stub.beq  (R_T1, R_T2, "done")
+		stub.srl  (R_T4, R_T3, 1)
+		stub.bne  (R_T4, R_ZERO, "haveFlags")
+		stub.nop  ()
+		stub.lbu  (R_T3, 0, R_T0)
+		stub.addiu(R_T0, R_T0, 1)
+		stub.ori  (R_T3, R_T3, 0x100)
+
+		stub.label("haveFlags")
+		stub.andi (R_T4, R_T3, 1)
+		stub.srl  (R_T3, R_T3, 1)
+		stub.bne  (R_T4, R_ZERO, "match")
+		stub.lbu  (R_T5, 0, R_T0)
+
+		# Literal byte
+		stub.addiu(R_T0, R_T0, 1)
+		stub.sb   (R_T5, 0, R_T1)
+		stub.beq  (R_ZERO, R_ZERO, "loop")
+		stub.addiu(R_T1, R_T1, 1)
+
+		# Back-reference
+		stub.label("match")
+		stub.lbu  (R_T6, 1, R_T0)
+		stub.addiu(R_T0, R_T0, 2)
+		stub.sll  (R_T6, R_T6, 8)
+		stub.or_  (R_T5, R_T5, R_T6)
+		stub.andi (R_T6, R_T5, 0xfff)
+		stub.addiu(R_T6, R_T6, 1)
+		stub.srl  (R_T5, R_T5, 12)
+		stub.addiu(R_T5, R_T5, LZ_MIN_LENGTH)
+		stub.subu (R_T6, R_T1, R_T6)
+
+		stub.label("copy")
+		stub.lbu  (R_T4, 0, R_T6)
+		stub.addiu(R_T6, R_T6, 1)
+		stub.addiu(R_T5, R_T5, -1)
+		stub.sb   (R_T4, 0, R_T1)
+		stub.bne  (R_T5, R_ZERO, "copy")
+		stub.addiu(R_T1, R_T1, 1)
+		stub.beq  (R_ZERO, R_ZERO, "loop")
+		stub.nop  ()
+
+		# Flush the instruction cache using the program's own flushCache()
+		# function if present, or the much slower BIOS FlushCache() (A0h
+		# function 44h) otherwise.
+		stub.label("done")
+
+		if flushCache is not None:
+			stub.jal  (flushCache)
+			stub.nop  ()
+		else:
+			stub.addiu(R_T2, R_ZERO, 0xa0)
+			stub.jalr (R_T2)
+			stub.addiu(R_T1, R_ZERO, 0x44)
+
+		stub.li   (R_T7, saveArea)
+		stub.lw   (R_A0, 0, R_T7)
+		stub.lw   (R_A1, 4, R_T7)
+		stub.lw   (R_RA, 8, R_T7)
+		stub.li   (R_T0, entryPoint)
+		stub.jr   (R_T0)
+		stub.nop  ()
+
+		stub.label("saveArea")
+		stub.word (0)
+		stub.word (0)
+		stub.word (0)
+
+	return stub.assemble()
+
+def alignValue(value: int, alignment: int) -> int:
+	return value + (alignment - value % alignment) % alignment
+
 ## Main
 
 EXE_HEADER_STRUCT: Struct = Struct("< 8s 8x 4I 16x 2I 20x 1972s")
@@ -216,6 +615,13 @@ def createParser() -> ArgumentParser:
 		help    = "Add an initial value for the global pointer to the header",
 		metavar = "value"
 	)
+	group.add_argument(
+		"-c", "--compress",
+		action = "store_true",
+		help   = \
+			"Compress the executable and add a stub to decompress it at "
+			"runtime"
+	)
 	group.add_argument(
 		"-S", "--strip-read-only",
 		action = "store_true",
@@ -256,14 +662,64 @@ def main():
 		parser.error("ELF file must contain at least one segment")
 
 	startAddress, data = elf.flatten(args.strip_read_only)
+	entryPoint:   int  = elf.entryPoint
+	loadAddress:  int  = startAddress
+
+	if args.compress:
+		# The .bss section does not need to be stored, as it is cleared by the
+		# program's startup code.
+		length: int = alignValue(
+			elf.getInitializedLength(args.strip_read_only), 4
+		)
+
+		compressed, stats = \
+			compressLZ(bytes(data[0:length]).ljust(length, b"\0"))
+
+		# Place the compressed data as close to the end of the decompressed
+		# program as allowed by the margin required for in-place
+		# decompression, followed by the stub.
+		offset:      int = alignValue(
+			max(stats.inPlaceMargin, length - len(compressed)), 4
+		)
+		stubStart:   int = alignValue(len(compressed), 4)
+		stubAddress: int = startAddress + offset + stubStart
+
+		output: bytearray = bytearray(compressed.ljust(stubStart, b"\0"))
+		output.extend(generateStub(
+			stubAddress,
+			startAddress + offset,
+			startAddress,
+			length,
+			elf.entryPoint,
+			elf.symbols.get("flushCache", None)
+		))
+
+		if len(output) < len(data):
+			print(
+				f"{args.input.name}: compressed {len(data)} bytes to "
+				f"{len(output)} ({100 - len(output) * 100 // len(data)}% "
+				f"smaller), about "
+				f"{estimateDecompressionTime(stats) * 1000:.1f} ms to "
+				"decompress"
+			)
+
+			loadAddress = startAddress + offset
+			entryPoint  = stubAddress
+			data        = output
+		else:
+			print(
+				f"{args.input.name}: compression would not reduce size, "
+				"leaving executable uncompressed"
+			)
+
 	alignToMultiple(data, EXE_ALIGNMENT)
 
 	region: bytes = args.region_str.strip().encode("ascii")
 	header: bytes = EXE_HEADER_STRUCT.pack(
 		EXE_HEADER_MAGIC, # Magic
-		elf.entryPoint,   # Entry point
+		entryPoint,       # Entry point
 		args.set_gp,      # Initial global pointer
-		startAddress,     # Data load address
+		loadAddress,      # Data load address
 		len(data),        # Data size
 		args.set_sp,      # Stack offset
 		0,                # Stack size
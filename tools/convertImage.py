@@ -5,10 +5,13 @@
 
 A simple script to convert image files into either raw 16bpp RGB data as
 expected by the PS1's GPU, or 4bpp or 8bpp indexed color data plus a separate
-16bpp color palette. Requires PIL/Pillow and NumPy to be installed.
+16bpp color palette. Photographic images can alternatively be compressed into a
+single MDEC bitstream frame (the same format used by video frames), which can be
+decoded by the MDEC directly into VRAM at load time. Requires PIL/Pillow and
+NumPy to be installed.
 """
 
-__version__ = "0.2.0"
+__version__ = "0.3.0"
 __author__  = "spicyjpeg"
 
 from argparse import ArgumentParser, FileType, Namespace
@@ -17,6 +20,9 @@ import numpy
 from numpy import ndarray
 from PIL   import Image
 
+from convertVideo import \
+	encodeFrame, quantizeBlocks, toBlocks, transformBlocks
+
 ## Input image handling
 
 # Pillow's built-in quantize() method will use different algorithms, some of
@@ -149,13 +155,37 @@ def convertIndexedImage(
 
 	return image, clut
 
+def convertMDECImage(
+	imageObj:   Image.Image,
+	quantScale: int,
+	version:    int = 3
+) -> bytes:
+	# The image is decoded by the MDEC one vertical strip of macroblocks at a
+	# time, so its dimensions must be multiples of 16 pixels (any alpha
+	# channel is discarded, as the MDEC cannot output transparent pixels).
+	if (imageObj.width % 16) or (imageObj.height % 16):
+		raise RuntimeError(
+			f"image dimensions ({imageObj.width}x{imageObj.height}) must be "
+			f"multiples of 16 pixels"
+		)
+
+	image:  ndarray = numpy.asarray(imageObj.convert("RGB"), "B")
+	coeffs: ndarray = transformBlocks(toBlocks(image))
+
+	return encodeFrame(
+		*quantizeBlocks(coeffs, quantScale, version),
+		quantScale,
+		version
+	)
+
 ## Main
 
 def createParser() -> ArgumentParser:
 	parser = ArgumentParser(
 		description = \
-			"Converts an image file into raw 16bpp image data, or 4bpp or 8bpp "
-			"indexed color data plus a 16bpp palette.",
+			"Converts an image file into raw 16bpp image data, 4bpp or 8bpp "
+			"indexed color data plus a 16bpp palette, or an MDEC-compressed "
+			"16bpp image.",
 		add_help    = False
 	)
 
@@ -184,6 +214,23 @@ def createParser() -> ArgumentParser:
 			"Set the semitransparency/blending flag on all pixels in the "
 			"output image (useful when using additive or subtractive blending)"
 	)
+	group.add_argument(
+		"-m", "--mdec",
+		action = "store_true",
+		help   = \
+			"Compress the image into an MDEC bitstream instead of generating "
+			"raw data (the color depth option is ignored, dimensions must be "
+			"multiples of 16)"
+	)
+	group.add_argument(
+		"-q", "--quant-scale",
+		type    = int,
+		default = 2,
+		help    = \
+			"Use specified quantization scale when compressing (1-63, higher "
+			"values result in smaller files but lower quality, default 2)",
+		metavar = "value"
+	)
 
 	group = parser.add_argument_group("File paths")
 	group.add_argument(
@@ -209,7 +256,24 @@ def main():
 	parser: ArgumentParser = createParser()
 	args:   Namespace      = parser.parse_args()
 
-	if args.bpp == 16:
+	if args.mdec:
+		if not (1 <= args.quant_scale <= 63):
+			parser.error("quantization scale must be in 1-63 range")
+
+		try:
+			imageData: bytes = convertMDECImage(args.input, args.quant_scale)
+		except RuntimeError as err:
+			parser.error(err.args[0])
+
+		# Report how much space was saved compared to the equivalent raw 16bpp
+		# image.
+		rawLength: int = args.input.width * args.input.height * 2
+
+		print(
+			f"{args.input.filename}: {rawLength} -> {len(imageData)} bytes "
+			f"({rawLength / len(imageData):.1f}:1)"
+		)
+	elif args.bpp == 16:
 		imageData: ndarray = numpy.asarray(args.input)
 		imageData          = to16bpp(imageData, args.force_stp)
 	else:
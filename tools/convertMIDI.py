@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 MIDI sequence converter
+
+A simple script to convert standard MIDI files (format 0 or 1) into the compact
+sequence format used by the sequence player library. All tracks are merged and
+tempo changes are resolved, so that each event is placed at a fixed tick rate
+independent of the song's tempo. Only note, program change, volume, panning
+and pitch bend events are kept; everything else is discarded. Requires no
+external dependencies.
+
+A loop point can be set by placing a marker named "loopStart" in the MIDI file
+(or by passing -l to loop the entire song), while a marker named "loopEnd" ends
+the song early. The number of notes played at the same time and the number of
+events in a single tick are printed once the file has been converted, in order
+to help pick the number of voices to reserve for the player.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+from argparse    import ArgumentParser, FileType, Namespace
+from dataclasses import dataclass
+from struct      import Struct
+
+## MIDI file parser
+
+@dataclass
+class MIDIEvent:
+	time:    int        # In MIDI ticks
+	status:  int
+	data:    bytes
+	meta:    int = -1   # Meta event type (if status is 0xff)
+	index:   int = 0    # Used to keep events in their original order
+
+class MIDIReader:
+	def __init__(self, data: bytes):
+		self.data:   bytes = data
+		self.offset: int   = 0
+
+	def read(self, length: int) -> bytes:
+		if (self.offset + length) > len(self.data):
+			raise RuntimeError("unexpected end of MIDI data")
+
+		value: bytes = self.data[self.offset:self.offset + length]
+		self.offset += length
+
+		return value
+
+	def readByte(self) -> int:
+		return self.read(1)[0]
+
+	def readVarInt(self) -> int:
+		value: int = 0
+
+		for _ in range(4):
+			byte:  int = self.readByte()
+			value      = (value << 7) | (byte & 0x7f)
+
+			if not (byte & 0x80):
+				return value
+
+		raise RuntimeError("invalid variable-length value")
+
+	def atEnd(self) -> bool:
+		return self.offset >= len(self.data)
+
+# Number of data bytes following each channel message type.
+MESSAGE_LENGTHS: dict[int, int] = {
+	0x80: 2, 0x90: 2, 0xa0: 2, 0xb0: 2, 0xc0: 1, 0xd0: 1, 0xe0: 2
+}
+
+def parseTrack(data: bytes) -> list[MIDIEvent]:
+	reader:  MIDIReader      = MIDIReader(data)
+	events:  list[MIDIEvent] = []
+	time:    int             = 0
+	running: int             = 0
+
+	while not reader.atEnd():
+		time   += reader.readVarInt()
+		status: int = reader.readByte()
+
+		if status == 0xff:
+			meta:   int   = reader.readByte()
+			length: int   = reader.readVarInt()
+			body:   bytes = reader.read(length)
+
+			events.append(MIDIEvent(time, status, body, meta))
+
+			if meta == 0x2f:
+				break
+		elif status in ( 0xf0, 0xf7 ):
+			reader.read(reader.readVarInt())
+		else:
+			# Handle running status, i.e. messages that reuse the status byte
+			# of the previous one.
+			if status & 0x80:
+				running = status
+				body    = reader.read(MESSAGE_LENGTHS[status & 0xf0])
+			elif running:
+				body    = bytes(( status, )) + \
+					reader.read(MESSAGE_LENGTHS[running & 0xf0] - 1)
+			else:
+				raise RuntimeError("data byte found without a status byte")
+
+			events.append(MIDIEvent(time, running, body))
+
+	return events
+
+HEADER_STRUCT: Struct = Struct("> 4s I 3H")
+CHUNK_STRUCT:  Struct = Struct("> 4s I")
+
+def parseMIDIFile(data: bytes) -> tuple[int, list[MIDIEvent]]:
+	magic, length, fileFormat, numTracks, division = \
+		HEADER_STRUCT.unpack_from(data, 0)
+
+	if (magic != b"MThd") or (length != 6):
+		raise RuntimeError("not a valid MIDI file")
+	if fileFormat > 1:
+		raise RuntimeError(f"unsupported MIDI file format {fileFormat}")
+	if division & 0x8000:
+		raise RuntimeError("SMPTE time division is not supported")
+
+	offset: int             = HEADER_STRUCT.size
+	events: list[MIDIEvent] = []
+
+	while (offset < len(data)) and numTracks:
+		magic, length = CHUNK_STRUCT.unpack_from(data, offset)
+		offset       += CHUNK_STRUCT.size
+
+		if magic == b"MTrk":
+			events    += parseTrack(data[offset:offset + length])
+			numTracks -= 1
+
+		offset += length
+
+	for index, event in enumerate(events):
+		event.index = index
+
+	# Merge all tracks, keeping events at the same time in the order they
+	# appear in the file.
+	events.sort(key = lambda event: ( event.time, event.index ))
+
+	return division, events
+
+## Sequence generation
+
+SEQ_HEADER_STRUCT: Struct = Struct("< I 2H I")
+SEQ_MAGIC:         int    = 0x51455350
+SEQ_NO_LOOP:       int    = 0xffffffff
+
+CMD_END:        int = 0x00
+CMD_NOTE_OFF:   int = 0x80
+CMD_NOTE_ON:    int = 0x90
+CMD_CONTROL:    int = 0xb0
+CMD_PROGRAM:    int = 0xc0
+CMD_PITCH_BEND: int = 0xe0
+CMD_LONG_WAIT:  int = 0xf0
+
+MAX_SHORT_WAIT: int = 0x7f
+MAX_LONG_WAIT:  int = 0xffff
+
+# Only volume and panning are supported by the player.
+SUPPORTED_CONTROLLERS: tuple[int, ...] = ( 7, 10 )
+
+# Pitch bends are converted from the MIDI 14-bit format into 1/16 semitone
+# units, assuming the default range of +/- 2 semitones.
+BEND_RANGE: int = 2 * 16
+
+@dataclass
+class SeqEvent:
+	tick:  int
+	order: int
+	data:  bytes
+
+def convertEvents(
+	division:  int,
+	events:    list[MIDIEvent],
+	tickRate:  int,
+	loop:      bool
+) -> tuple[list[SeqEvent], int | None, int]:
+	output:    list[SeqEvent] = []
+	loopTick:  int | None     = 0 if loop else None
+	endTick:   int            = 0
+
+	# Convert MIDI ticks into seconds (and then player ticks) by keeping track
+	# of tempo changes, which apply to all tracks.
+	tempo:        int   = 500000 # Microseconds per quarter note
+	lastTime:     int   = 0
+	lastSeconds:  float = 0.0
+
+	for event in events:
+		lastSeconds += \
+			(event.time - lastTime) * tempo / (division * 1000000)
+		lastTime     = event.time
+		tick: int    = round(lastSeconds * tickRate)
+		endTick      = max(endTick, tick)
+
+		if event.status == 0xff:
+			if event.meta == 0x51:
+				tempo = int.from_bytes(event.data, "big")
+			elif event.meta == 0x06:
+				marker: str = event.data.decode("ascii", "ignore").lower()
+
+				if marker == "loopstart":
+					loopTick = tick
+				elif marker == "loopend":
+					return output, loopTick, tick
+
+			continue
+
+		message: int = event.status & 0xf0
+		channel: int = event.status & 0x0f
+
+		# Note offs are always placed before any other event at the same
+		# tick, so that a note ending and the same note starting again at the
+		# same time does not result in the new note being cut off.
+		if (message == 0x90) and event.data[1]:
+			output.append(SeqEvent(
+				tick, 1, bytes(( CMD_NOTE_ON | channel, *event.data ))
+			))
+		elif message in ( 0x80, 0x90 ):
+			output.append(SeqEvent(
+				tick, 0, bytes(( CMD_NOTE_OFF | channel, event.data[0] ))
+			))
+		elif message == 0xb0:
+			if event.data[0] in SUPPORTED_CONTROLLERS:
+				output.append(SeqEvent(
+					tick, 1, bytes(( CMD_CONTROL | channel, *event.data ))
+				))
+		elif message == 0xc0:
+			output.append(SeqEvent(
+				tick, 1, bytes(( CMD_PROGRAM | channel, event.data[0] ))
+			))
+		elif message == 0xe0:
+			value: int = (event.data[0] | (event.data[1] << 7)) - 0x2000
+			bend:  int = max(-128, min(127, (value * BEND_RANGE) // 0x2000))
+
+			output.append(SeqEvent(
+				tick, 1, bytes(( CMD_PITCH_BEND | channel, bend & 0xff ))
+			))
+
+	return output, loopTick, endTick
+
+def encodeWait(ticks: int) -> bytes:
+	data: bytearray = bytearray()
+
+	while ticks > MAX_SHORT_WAIT:
+		chunk: int  = min(ticks, MAX_LONG_WAIT)
+		data       += bytes(( CMD_LONG_WAIT, )) + chunk.to_bytes(2, "little")
+		ticks      -= chunk
+
+	if ticks:
+		data.append(ticks)
+
+	return bytes(data)
+
+def encodeSequence(
+	events:   list[SeqEvent],
+	loopTick: int | None,
+	endTick:  int,
+	tickRate: int
+) -> bytes:
+	events = sorted(events, key = lambda event: ( event.tick, event.order ))
+
+	data:       bytearray = bytearray()
+	loopOffset: int       = SEQ_NO_LOOP
+	lastTick:   int       = 0
+
+	for event in events:
+		if (loopTick is not None) and (loopOffset == SEQ_NO_LOOP) and \
+			(event.tick >= loopTick):
+			data      += encodeWait(loopTick - lastTick)
+			lastTick   = loopTick
+			loopOffset = len(data)
+
+		data     += encodeWait(event.tick - lastTick)
+		data     += event.data
+		lastTick  = event.tick
+
+	if (loopTick is not None) and (loopOffset == SEQ_NO_LOOP):
+		data      += encodeWait(loopTick - lastTick)
+		lastTick   = loopTick
+		loopOffset = len(data)
+
+	# Wait until the end of the song (which may be later than the last note
+	# off) before ending or looping back.
+	data += encodeWait(max(endTick - lastTick, 0))
+	data.append(CMD_END)
+
+	if len(data) % 4:
+		data += bytes(4 - len(data) % 4)
+
+	return SEQ_HEADER_STRUCT.pack(SEQ_MAGIC, tickRate, 0, loopOffset) + data
+
+def getStatistics(events: list[SeqEvent]) -> tuple[int, int]:
+	# Calculate the maximum number of notes held at the same time (ignoring
+	# release times) and the maximum number of events in a single tick.
+	active:    set[tuple[int, int]] = set()
+	perTick:   dict[int, int]       = {}
+	maxActive: int                  = 0
+
+	for event in sorted(events, key = lambda event: ( event.tick, event.order )):
+		perTick[event.tick] = perTick.get(event.tick, 0) + 1
+		command: int        = event.data[0] & 0xf0
+		key:     tuple      = ( event.data[0] & 0x0f, event.data[1] )
+
+		if command == CMD_NOTE_ON:
+			active.add(key)
+			maxActive = max(maxActive, len(active))
+		elif command == CMD_NOTE_OFF:
+			active.discard(key)
+
+	return maxActive, max(perTick.values(), default = 0)
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Converts a standard MIDI file into a sequence for the PS1 "
+			"sequence player.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Conversion options")
+	group.add_argument(
+		"-r", "--tick-rate",
+		type    = int,
+		default = 120,
+		help    = \
+			"Use specified number of ticks per second (65-1000, default 120); "
+			"higher rates improve timing accuracy at the expense of CPU time",
+		metavar = "value"
+	)
+	group.add_argument(
+		"-l", "--loop",
+		action = "store_true",
+		help   = \
+			"Loop the entire song if no loopStart marker is present in the "
+			"MIDI file"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"input",
+		type = FileType("rb"),
+		help = "Path to MIDI file to convert"
+	)
+	group.add_argument(
+		"output",
+		type = FileType("wb"),
+		help = "Path to sequence file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	if not (65 <= args.tick_rate <= 1000):
+		parser.error("tick rate must be in 65-1000 range")
+
+	with args.input as file:
+		data: bytes = file.read()
+
+	try:
+		division, events          = parseMIDIFile(data)
+		seqEvents, loopTick, end  = \
+			convertEvents(division, events, args.tick_rate, args.loop)
+	except (RuntimeError, KeyError, IndexError) as err:
+		parser.error(f"failed to parse MIDI file: {err}")
+
+	sequence: bytes = encodeSequence(seqEvents, loopTick, end, args.tick_rate)
+	polyphony, maxEvents = getStatistics(seqEvents)
+
+	print(
+		f"{args.input.name}: {len(seqEvents)} events, "
+		f"{end / args.tick_rate:.1f} seconds, up to {polyphony} notes and "
+		f"{maxEvents} events per tick"
+	)
+
+	with args.output as file:
+		file.write(sequence)
+
+if __name__ == "__main__":
+	main()
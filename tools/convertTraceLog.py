@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Disc access trace generator
+
+A simple script to turn a log of the reads issued by the sector cache into an
+access trace for the disc image builder. When built in debug mode, the cache
+prints a line in the form of "cdcache: read <lba> <count>" to the serial port
+for each read queued while its trace flag is set; this script parses a capture
+of the serial output (any other lines are ignored), looks up which file on the
+disc each read belongs to and writes the paths of all files in the order they
+were first accessed.
+
+The disc image passed must be the exact one the log was captured from, as file
+locations change whenever the image is rebuilt with a different trace. Reads
+that do not fall within any file are reported and skipped.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+import re
+from argparse import ArgumentParser, FileType, Namespace
+from pathlib  import Path
+from sys      import stderr
+
+from buildDiscImage import SECTOR_SIZE, walkImage
+
+## Log parsing
+
+LOG_LINE_REGEX: re.Pattern = re.compile(r"cdcache: read (\d+) (\d+)")
+
+def parseLog(lines: list[str]) -> list[tuple[int, int]]:
+	reads: list[tuple[int, int]] = []
+
+	for line in lines:
+		match: re.Match | None = LOG_LINE_REGEX.search(line)
+
+		if match is not None:
+			reads.append(( int(match.group(1)), int(match.group(2)) ))
+
+	return reads
+
+def generateTrace(
+	files: list[tuple[str, int, int]],
+	reads: list[tuple[int, int]]
+) -> list[str]:
+	trace: list[str] = []
+
+	for lba, count in reads:
+		# A single read may span more than one file if the program loads
+		# several adjacent files at once.
+		found: bool = False
+
+		for path, fileLBA, length in files:
+			sectors: int = max((length + SECTOR_SIZE - 1) // SECTOR_SIZE, 1)
+
+			if (lba >= (fileLBA + sectors)) or ((lba + count) <= fileLBA):
+				continue
+
+			found = True
+
+			if path not in trace:
+				trace.append(path)
+
+		if not found:
+			print(
+				f"warning: read at LBA {lba} is not part of any file",
+				file = stderr
+			)
+
+	return trace
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Generates an access trace for the disc image builder from a "
+			"serial log of the reads issued by the sector cache.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Image options")
+	group.add_argument(
+		"-i", "--iso",
+		action = "store_true",
+		help   = \
+			"Treat the image as a plain .iso file with 2048-byte sectors "
+			"rather than a .bin file"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"image",
+		type = Path,
+		help = "Path to the disc image the log was captured from"
+	)
+	group.add_argument(
+		"log",
+		type = FileType("rt"),
+		help = "Path to serial log"
+	)
+	group.add_argument(
+		"output",
+		type = FileType("wt"),
+		help = "Path to trace file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	with open(args.image, "rb") as file:
+		image: bytes = file.read()
+	with args.log as file:
+		reads: list[tuple[int, int]] = parseLog(file.readlines())
+
+	if not reads:
+		parser.error("no cache reads found in log")
+
+	try:
+		files: list[tuple[str, int, int]] = list(
+			walkImage(image, not args.iso)
+		)
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	trace: list[str] = generateTrace(files, reads)
+
+	with args.output as file:
+		file.write(
+			f"# Generated by convertTraceLog.py from {len(reads)} reads.\n"
+		)
+
+		for path in trace:
+			file.write(f"{path.lstrip('/')}\n")
+
+if __name__ == "__main__":
+	main()
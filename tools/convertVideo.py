@@ -0,0 +1,712 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 video encoder
+
+A simple script to convert a sequence of frames (either one or more animated
+images or a list of still images) into a video stream that can be played back
+using the MDEC and the video player library. Each frame is compressed into the
+version 3 (or optionally version 2) MDEC bitstream format and split into
+2048-byte sectors, each prefixed with a header identifying the frame and chunk.
+Requires PIL/Pillow and NumPy to be installed.
+
+As the player displays each frame as soon as it has been read and decoded, the
+frame rate is set by the rate at which the drive delivers sectors: each frame
+is thus allotted a fixed number of sectors, and its quantization scale is
+picked so that the compressed frame fits in that budget. An XA-ADPCM audio
+track (as generated by psxavenc -t xa) can optionally be interleaved with the
+video. The output is a file made up of 2336-byte XA sectors, which can be placed
+on a disc by listing it in the disc image builder's manifest with the "xa" key
+set.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+from argparse import ArgumentParser, FileType, Namespace
+from pathlib  import Path
+from struct   import Struct
+from typing   import Iterable
+
+import numpy
+from numpy import ndarray
+from PIL   import Image, ImageSequence
+
+from interleaveXA import \
+	interleave, makeDataSector, makeNullSector, readAudioSectors
+
+## Color conversion and DCT
+
+def toBlocks(image: ndarray) -> ndarray:
+	# Pad the image to a multiple of 16 pixels by repeating its edges.
+	height, width, _ = image.shape
+
+	image = numpy.pad(
+		image.astype("f"),
+		( ( 0, -height % 16 ), ( 0, -width % 16 ), ( 0, 0 ) ),
+		"edge"
+	)
+
+	r: ndarray = image[:, :, 0]
+	g: ndarray = image[:, :, 1]
+	b: ndarray = image[:, :, 2]
+
+	y:  ndarray = 0.299   * r + 0.587   * g + 0.114   * b - 128.0
+	cb: ndarray = -0.1687 * r - 0.3313  * g + 0.5     * b
+	cr: ndarray = 0.5     * r - 0.4187  * g - 0.0813  * b
+
+	# Average each 2x2 group of chroma samples.
+	cb = (cb[0::2, 0::2] + cb[0::2, 1::2] + cb[1::2, 0::2] + cb[1::2, 1::2]) / 4
+	cr = (cr[0::2, 0::2] + cr[0::2, 1::2] + cr[1::2, 0::2] + cr[1::2, 1::2]) / 4
+
+	# Split the planes into 8x8 blocks and group them into macroblocks, stored
+	# in column-major order (so that the MDEC outputs one vertical strip of the
+	# frame at a time) and each made up of the Cr, Cb and four Y blocks.
+	rows:    int = y.shape[0] // 16
+	columns: int = y.shape[1] // 16
+
+	luma: ndarray = y.reshape(( rows, 2, 8, columns, 2, 8 ))
+	luma          = luma.transpose(( 3, 0, 1, 4, 2, 5 ))
+	luma          = luma.reshape(( columns * rows, 4, 8, 8 ))
+
+	def _toChromaBlocks(plane: ndarray) -> ndarray:
+		plane = plane.reshape(( rows, 8, columns, 8 )).transpose(( 2, 0, 1, 3 ))
+
+		return plane.reshape(( columns * rows, 1, 8, 8 ))
+
+	return numpy.concatenate((
+		_toChromaBlocks(cr),
+		_toChromaBlocks(cb),
+		luma
+	), 1)
+
+def _getDCTMatrix() -> ndarray:
+	u: ndarray = numpy.arange(8).reshape(( 8, 1 ))
+	x: ndarray = numpy.arange(8).reshape(( 1, 8 ))
+
+	matrix: ndarray = numpy.cos((2 * x + 1) * u * numpy.pi / 16) / 2
+	matrix[0, :]    = numpy.sqrt(1 / 8)
+
+	return matrix
+
+def _getZigzagOrder() -> ndarray:
+	indices: list[tuple[int, int]] = sorted(
+		(
+			( y, x ) for y in range(8) for x in range(8)
+		),
+		key = lambda pos: (
+			pos[0] + pos[1],
+			pos[0] if ((pos[0] + pos[1]) % 2) else pos[1]
+		)
+	)
+
+	return numpy.array([ y * 8 + x for y, x in indices ])
+
+DCT_MATRIX:   ndarray = _getDCTMatrix()
+ZIGZAG_ORDER: ndarray = _getZigzagOrder()
+
+def transformBlocks(blocks: ndarray) -> ndarray:
+	# Apply the DCT to all blocks and return their coefficients in zigzag
+	# order, as a (macroblocks * 6, 64) array.
+	coeffs: ndarray = numpy.einsum(
+		"ux,nbxy,vy->nbuv",
+		DCT_MATRIX,
+		blocks,
+		DCT_MATRIX
+	)
+
+	return coeffs.reshape(( -1, 64 ))[:, ZIGZAG_ORDER]
+
+## Quantization
+
+# MPEG-1 default intra quantization table in zigzag order, which must match the
+# one uploaded to the MDEC by initMDEC().
+QUANT_TABLE: ndarray = numpy.array((
+	 2, 16, 16, 19, 16, 19, 22, 22,
+	22, 22, 22, 22, 26, 24, 26, 27,
+	27, 27, 26, 26, 26, 26, 27, 27,
+	27, 29, 29, 29, 34, 34, 34, 29,
+	29, 29, 27, 27, 29, 29, 32, 32,
+	34, 34, 37, 38, 37, 35, 35, 34,
+	35, 38, 38, 40, 40, 40, 48, 48,
+	46, 46, 56, 56, 58, 69, 69, 83
+), "f")
+
+MAX_QUANT_SCALE: int = 63
+
+def quantizeBlocks(
+	coeffs:     ndarray,
+	quantScale: int,
+	version:    int
+) -> tuple[ndarray, ndarray]:
+	# The MDEC multiplies DC coefficients by the first entry of the table
+	# (regardless of the scale) and AC coefficients by the table entry times
+	# the scale divided by 8. Version 3 frames store DC coefficients in units
+	# of 4, i.e. as the average value of each block.
+	if version == 3:
+		dc: ndarray = numpy.clip(numpy.rint(coeffs[:, 0] / 8), -128, 127)
+	else:
+		dc: ndarray = numpy.clip(
+			numpy.rint(coeffs[:, 0] / QUANT_TABLE[0]),
+			-512,
+			511
+		)
+
+	ac: ndarray = numpy.clip(
+		numpy.rint(coeffs[:, 1:] * 8 / (QUANT_TABLE[1:] * quantScale)),
+		-511,
+		511
+	)
+
+	return dc.astype("i"), ac.astype("i")
+
+## Bitstream generation
+
+# MPEG-1 AC coefficient table (code length, code, run length, coefficient),
+# excluding the end of block and escape codes. Each code is followed by a sign
+# bit.
+AC_CODES: tuple[tuple[int, int, int, int], ...] = (
+	(  2, 0x0003,  0,  1 ), (  3, 0x0003,  1,  1 ), (  4, 0x0004,  0,  2 ),
+	(  4, 0x0005,  2,  1 ), (  5, 0x0005,  0,  3 ), (  5, 0x0006,  4,  1 ),
+	(  5, 0x0007,  3,  1 ), (  6, 0x0004,  7,  1 ), (  6, 0x0005,  6,  1 ),
+	(  6, 0x0006,  1,  2 ), (  6, 0x0007,  5,  1 ), (  7, 0x0004,  2,  2 ),
+	(  7, 0x0005,  9,  1 ), (  7, 0x0006,  0,  4 ), (  7, 0x0007,  8,  1 ),
+	(  8, 0x0020, 13,  1 ), (  8, 0x0021,  0,  6 ), (  8, 0x0022, 12,  1 ),
+	(  8, 0x0023, 11,  1 ), (  8, 0x0024,  3,  2 ), (  8, 0x0025,  1,  3 ),
+	(  8, 0x0026,  0,  5 ), (  8, 0x0027, 10,  1 ), ( 10, 0x0008, 16,  1 ),
+	( 10, 0x0009,  5,  2 ), ( 10, 0x000a,  0,  7 ), ( 10, 0x000b,  2,  3 ),
+	( 10, 0x000c,  1,  4 ), ( 10, 0x000d, 15,  1 ), ( 10, 0x000e, 14,  1 ),
+	( 10, 0x000f,  4,  2 ), ( 12, 0x0010,  0, 11 ), ( 12, 0x0011,  8,  2 ),
+	( 12, 0x0012,  4,  3 ), ( 12, 0x0013,  0, 10 ), ( 12, 0x0014,  2,  4 ),
+	( 12, 0x0015,  7,  2 ), ( 12, 0x0016, 21,  1 ), ( 12, 0x0017, 20,  1 ),
+	( 12, 0x0018,  0,  9 ), ( 12, 0x0019, 19,  1 ), ( 12, 0x001a, 18,  1 ),
+	( 12, 0x001b,  1,  5 ), ( 12, 0x001c,  3,  3 ), ( 12, 0x001d,  0,  8 ),
+	( 12, 0x001e,  6,  2 ), ( 12, 0x001f, 17,  1 ), ( 13, 0x0010, 10,  2 ),
+	( 13, 0x0011,  9,  2 ), ( 13, 0x0012,  5,  3 ), ( 13, 0x0013,  3,  4 ),
+	( 13, 0x0014,  2,  5 ), ( 13, 0x0015,  1,  7 ), ( 13, 0x0016,  1,  6 ),
+	( 13, 0x0017,  0, 15 ), ( 13, 0x0018,  0, 14 ), ( 13, 0x0019,  0, 13 ),
+	( 13, 0x001a,  0, 12 ), ( 13, 0x001b, 26,  1 ), ( 13, 0x001c, 25,  1 ),
+	( 13, 0x001d, 24,  1 ), ( 13, 0x001e, 23,  1 ), ( 13, 0x001f, 22,  1 ),
+	( 14, 0x0010,  0, 31 ), ( 14, 0x0011,  0, 30 ), ( 14, 0x0012,  0, 29 ),
+	( 14, 0x0013,  0, 28 ), ( 14, 0x0014,  0, 27 ), ( 14, 0x0015,  0, 26 ),
+	( 14, 0x0016,  0, 25 ), ( 14, 0x0017,  0, 24 ), ( 14, 0x0018,  0, 23 ),
+	( 14, 0x0019,  0, 22 ), ( 14, 0x001a,  0, 21 ), ( 14, 0x001b,  0, 20 ),
+	( 14, 0x001c,  0, 19 ), ( 14, 0x001d,  0, 18 ), ( 14, 0x001e,  0, 17 ),
+	( 14, 0x001f,  0, 16 ), ( 15, 0x0010,  0, 40 ), ( 15, 0x0011,  0, 39 ),
+	( 15, 0x0012,  0, 38 ), ( 15, 0x0013,  0, 37 ), ( 15, 0x0014,  0, 36 ),
+	( 15, 0x0015,  0, 35 ), ( 15, 0x0016,  0, 34 ), ( 15, 0x0017,  0, 33 ),
+	( 15, 0x0018,  0, 32 ), ( 15, 0x0019,  1, 14 ), ( 15, 0x001a,  1, 13 ),
+	( 15, 0x001b,  1, 12 ), ( 15, 0x001c,  1, 11 ), ( 15, 0x001d,  1, 10 ),
+	( 15, 0x001e,  1,  9 ), ( 15, 0x001f,  1,  8 ), ( 16, 0x0010,  1, 18 ),
+	( 16, 0x0011,  1, 17 ), ( 16, 0x0012,  1, 16 ), ( 16, 0x0013,  1, 15 ),
+	( 16, 0x0014,  6,  3 ), ( 16, 0x0015, 16,  2 ), ( 16, 0x0016, 15,  2 ),
+	( 16, 0x0017, 14,  2 ), ( 16, 0x0018, 13,  2 ), ( 16, 0x0019, 12,  2 ),
+	( 16, 0x001a, 11,  2 ), ( 16, 0x001b, 31,  1 ), ( 16, 0x001c, 30,  1 ),
+	( 16, 0x001d, 29,  1 ), ( 16, 0x001e, 28,  1 ), ( 16, 0x001f, 27,  1 ),
+)
+
+EOB_LENGTH:    int = 2
+EOB_CODE:      int = 0x2
+ESCAPE_LENGTH: int = 6 + 6 + 10
+ESCAPE_CODE:   int = 0x01
+
+LUMA_DC_CODES: tuple[tuple[int, int], ...] = (
+	( 3, 0x04 ), ( 2, 0x00 ), ( 2, 0x01 ), ( 3, 0x05 ), ( 3, 0x06 ),
+	( 4, 0x0e ), ( 5, 0x1e ), ( 6, 0x3e ), ( 7, 0x7e )
+)
+CHROMA_DC_CODES: tuple[tuple[int, int], ...] = (
+	( 2, 0x00 ), ( 2, 0x01 ), ( 2, 0x02 ), ( 3, 0x06 ), ( 4, 0x0e ),
+	( 5, 0x1e ), ( 6, 0x3e ), ( 7, 0x7e ), ( 8, 0xfe )
+)
+
+AC_CODE_MAP: dict[tuple[int, int], tuple[int, int]] = {
+	( run, level ): ( length, code )
+	for length, code, run, level in AC_CODES
+}
+
+def _getACLengthTable() -> ndarray:
+	# Precompute the length of the code (including the sign bit) for every
+	# combination of run length and coefficient, to allow for estimating the
+	# size of a frame without actually encoding it.
+	table: ndarray = numpy.full(( 64, 512 ), ESCAPE_LENGTH, "i")
+
+	for length, _, run, level in AC_CODES:
+		table[run, level] = length + 1
+
+	return table
+
+AC_LENGTH_TABLE: ndarray = _getACLengthTable()
+
+def _getDCLengthTable(codes: tuple[tuple[int, int], ...]) -> ndarray:
+	return numpy.array([
+		length + size for size, ( length, _ ) in enumerate(codes)
+	], "i")
+
+LUMA_DC_LENGTH_TABLE:   ndarray = _getDCLengthTable(LUMA_DC_CODES)
+CHROMA_DC_LENGTH_TABLE: ndarray = _getDCLengthTable(CHROMA_DC_CODES)
+
+def getDCDifferences(dc: ndarray) -> ndarray:
+	# Version 3 frames store the difference between the DC coefficient of each
+	# block and the one of the previous block of the same component, with all
+	# luma blocks sharing the same predictor.
+	blocks: ndarray = dc.reshape(( -1, 6 ))
+	diffs:  ndarray = numpy.empty_like(blocks)
+
+	for columns in ( [ 0 ], [ 1 ], [ 2, 3, 4, 5 ] ):
+		values: ndarray = blocks[:, columns].reshape(-1)
+		values          = numpy.diff(values, prepend = 0)
+
+		diffs[:, columns] = values.reshape(( -1, len(columns) ))
+
+	return diffs.reshape(-1)
+
+def getDCSizes(diffs: ndarray) -> ndarray:
+	magnitudes: ndarray = numpy.abs(diffs)
+
+	return numpy.sum([ (magnitudes >> bit) > 0 for bit in range(9) ], 0)
+
+def getRunLengths(ac: ndarray) -> tuple[ndarray, ndarray]:
+	# Return the number of zeroes preceding each non-zero AC coefficient, along
+	# with the coefficients themselves, in the order they are encoded.
+	nonZero:   ndarray = (ac != 0)
+	positions: ndarray = numpy.arange(1, 64)
+
+	previous: ndarray = numpy.where(nonZero, positions, 0)
+	previous          = numpy.maximum.accumulate(previous, 1)
+	previous          = numpy.c_[
+		numpy.zeros(( ac.shape[0], 1 ), "i"),
+		previous[:, :-1]
+	]
+
+	return (positions - previous - 1)[nonZero], ac[nonZero]
+
+class BitWriter:
+	def __init__(self):
+		self.data:   bytearray = bytearray()
+		self.buffer: int       = 0
+		self.length: int       = 0
+
+	def write(self, value: int, length: int):
+		self.buffer  = (self.buffer << length) | (value & ((1 << length) - 1))
+		self.length += length
+
+		# Flush the buffer 16 bits at a time, storing each 16-bit word in
+		# little endian format as expected by the decoder.
+		while self.length >= 16:
+			self.length -= 16
+			self.data   += \
+				((self.buffer >> self.length) & 0xffff).to_bytes(2, "little")
+			self.buffer &= (1 << self.length) - 1
+
+	def getData(self) -> bytes:
+		# Pad the bitstream with zeroes to a multiple of 32 bits.
+		self.write(0, -self.length % 16)
+
+		if len(self.data) % 4:
+			self.write(0, 16)
+
+		return bytes(self.data)
+
+## Frame encoding
+
+FRAME_HEADER_STRUCT:   Struct = Struct("< 4H")
+FRAME_MAGIC:           int    = 0x3800
+MDEC_CHUNK_SIZE:       int    = 32
+BLOCKS_PER_MACROBLOCK: int    = 6
+MAX_MACROBLOCK_LENGTH: int    = (1 + 63 + 1) * BLOCKS_PER_MACROBLOCK
+
+def getFrameSize(
+	dc:      ndarray,
+	ac:      ndarray,
+	version: int
+) -> tuple[int, int, int]:
+	# Calculate the length of the compressed frame in bytes, as well as the
+	# length of the data the decoder will generate from it in 32-bit words
+	# (one 16-bit code for the DC coefficient, one for each non-zero AC
+	# coefficient and an end of block code for each block).
+	runs, levels = getRunLengths(ac)
+	numBlocks    = dc.shape[0]
+
+	bits: int = int(AC_LENGTH_TABLE[runs, numpy.abs(levels)].sum()) \
+		+ EOB_LENGTH * numBlocks
+
+	if version == 3:
+		sizes:  ndarray = getDCSizes(getDCDifferences(dc)).reshape(( -1, 6 ))
+		bits           += int(CHROMA_DC_LENGTH_TABLE[sizes[:, 0:2]].sum())
+		bits           += int(LUMA_DC_LENGTH_TABLE[sizes[:, 2:6]].sum())
+	else:
+		bits += 10 * numBlocks
+
+	length:     int = FRAME_HEADER_STRUCT.size + (bits + 31) // 32 * 4
+	mdecLength: int = (numBlocks * 2 + len(runs) + 1) // 2
+	mdecLength      = -(-mdecLength // MDEC_CHUNK_SIZE) * MDEC_CHUNK_SIZE
+
+	# The decoder does not check for overflows while decoding a macroblock,
+	# and instead requires enough space for a worst case macroblock (all 63
+	# AC coefficients in each block) to be left in its output buffer before
+	# decoding each one. The buffer must thus be large enough to fit the last
+	# macroblock's starting offset plus that amount, which may be more than
+	# the actual length of the decoded data.
+	lastLength: int = BLOCKS_PER_MACROBLOCK * 2 \
+		+ int(numpy.count_nonzero(ac[-BLOCKS_PER_MACROBLOCK:]))
+	lastOffset: int = numBlocks * 2 + len(runs) - lastLength
+
+	bufferLength: int = max(
+		mdecLength,
+		(lastOffset + MAX_MACROBLOCK_LENGTH + 1) // 2
+	)
+
+	return length, mdecLength, bufferLength
+
+def encodeFrame(
+	dc:         ndarray,
+	ac:         ndarray,
+	quantScale: int,
+	version:    int
+) -> bytes:
+	writer: BitWriter = BitWriter()
+	diffs:  ndarray   = getDCDifferences(dc) if (version == 3) else dc
+
+	for block in range(dc.shape[0]):
+		dcValue: int = int(diffs[block])
+
+		if version == 3:
+			codes: tuple[tuple[int, int], ...] = \
+				CHROMA_DC_CODES if ((block % 6) < 2) else LUMA_DC_CODES
+
+			# Negative values are stored as the complement of their magnitude,
+			# so that their top bit is always cleared.
+			size:         int = abs(dcValue).bit_length()
+			length, code      = codes[size]
+
+			writer.write(code, length)
+
+			if size:
+				writer.write(
+					dcValue if (dcValue > 0) else (dcValue + (1 << size) - 1),
+					size
+				)
+		else:
+			writer.write(dcValue, 10)
+
+		previous: int = 0
+
+		for position in numpy.flatnonzero(ac[block]):
+			run:   int = int(position) - previous
+			level: int = int(ac[block, position])
+
+			previous = int(position) + 1
+
+			if ( run, abs(level) ) in AC_CODE_MAP:
+				length, code = AC_CODE_MAP[run, abs(level)]
+
+				writer.write(code, length)
+				writer.write(int(level < 0), 1)
+			else:
+				writer.write(ESCAPE_CODE, 6)
+				writer.write(run, 6)
+				writer.write(level, 10)
+
+		writer.write(EOB_CODE, EOB_LENGTH)
+
+	_, mdecLength, _ = getFrameSize(dc, ac, version)
+
+	return FRAME_HEADER_STRUCT.pack(
+		mdecLength,
+		FRAME_MAGIC,
+		quantScale,
+		version
+	) + writer.getData()
+
+def encodeFrameWithBudget(
+	coeffs:        ndarray,
+	maxLength:     int,
+	maxMDECLength: int,
+	version:       int
+) -> tuple[bytes, int]:
+	# Find the lowest quantization scale (i.e. the highest quality) at which
+	# the frame fits within the given budget. As the size of a frame can be
+	# calculated much faster than actually encoding it, and it decreases as
+	# the scale goes up, a binary search is performed over the scale using the
+	# calculated sizes and the frame is only encoded once.
+	def _fits(quantScale: int) -> bool:
+		length, _, bufferLength = getFrameSize(
+			*quantizeBlocks(coeffs, quantScale, version),
+			version
+		)
+
+		return (length <= maxLength) and (bufferLength <= maxMDECLength)
+
+	if not _fits(MAX_QUANT_SCALE):
+		raise RuntimeError(
+			"frame does not fit in the available sectors even at the lowest "
+			"quality, try lowering the frame rate or resolution"
+		)
+
+	low:  int = 1
+	high: int = MAX_QUANT_SCALE
+
+	while low < high:
+		middle: int = (low + high) // 2
+
+		if _fits(middle):
+			high = middle
+		else:
+			low = middle + 1
+
+	dc, ac = quantizeBlocks(coeffs, high, version)
+
+	return encodeFrame(dc, ac, high, version), high
+
+## Sector layout
+
+SECTOR_HEADER_STRUCT: Struct = Struct("< 4H 2I 2H 8s I")
+SECTOR_MAGIC:         int    = 0x0160
+SECTOR_TYPE:          int    = 0x8001
+CHUNK_SIZE:           int    = 2048 - SECTOR_HEADER_STRUCT.size
+
+# The drive reads 75 sectors per second at single speed.
+BASE_SECTOR_RATE: int = 75
+
+def getFrameBudgets(
+	numFrames:  int,
+	frameRate:  int,
+	sectorRate: int,
+	groupSize:  int,
+	numAudio:   int
+) -> list[int]:
+	# Each frame is allotted all data slots within the range of sectors read by
+	# the drive while the previous frame is being displayed. The audio channels
+	# take up the first slots of each group of sectors, as laid out by the
+	# interleaver.
+	budgets: list[int] = []
+
+	for frame in range(numFrames):
+		start: int = (frame       * sectorRate) // frameRate
+		end:   int = ((frame + 1) * sectorRate) // frameRate
+
+		budgets.append(sum(
+			(sector % groupSize) >= numAudio for sector in range(start, end)
+		))
+
+	return budgets
+
+def makeFrameSectors(
+	data:    bytes,
+	frame:   int,
+	width:   int,
+	height:  int,
+	budget:  int,
+	file:    int,
+	channel: int
+) -> list[bytes]:
+	numChunks: int = (len(data) + CHUNK_SIZE - 1) // CHUNK_SIZE
+
+	# Each chunk carries a copy of the frame's header. Any slots left unused
+	# by the frame are filled with null sectors, which the player ignores.
+	sectors: list[bytes] = [
+		makeDataSector(
+			file,
+			channel,
+			SECTOR_HEADER_STRUCT.pack(
+				SECTOR_MAGIC,
+				SECTOR_TYPE,
+				chunk,
+				numChunks,
+				frame,
+				len(data),
+				width,
+				height,
+				data[0:FRAME_HEADER_STRUCT.size],
+				0
+			) + data[chunk * CHUNK_SIZE:(chunk + 1) * CHUNK_SIZE],
+			False
+		) for chunk in range(numChunks)
+	]
+
+	while len(sectors) < budget:
+		sectors.append(makeNullSector(file))
+
+	return sectors
+
+## Main
+
+def loadFrames(paths: Iterable[Path]) -> Iterable[ndarray]:
+	for path in paths:
+		with Image.open(path) as image:
+			for frame in ImageSequence.Iterator(image):
+				yield numpy.asarray(frame.convert("RGB"))
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Converts a sequence of frames into a video stream of 2336-byte "
+			"XA sectors, optionally interleaved with XA-ADPCM audio.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Video options")
+	group.add_argument(
+		"-r", "--frame-rate",
+		type    = int,
+		default = 15,
+		help    = "Set the playback frame rate (default 15)",
+		metavar = "value"
+	)
+	group.add_argument(
+		"-S", "--speed",
+		type    = int,
+		choices = ( 1, 2 ),
+		default = 2,
+		help    = "Set the drive speed used for playback (default 2)",
+		metavar = "1|2"
+	)
+	group.add_argument(
+		"-v", "--bitstream-version",
+		type    = int,
+		choices = ( 2, 3 ),
+		default = 3,
+		help    = \
+			"Use specified bitstream version (2 for raw DC coefficients, "
+			"default 3 for delta coded DC coefficients)",
+		metavar = "2|3"
+	)
+	group.add_argument(
+		"-m", "--max-mdec-length",
+		type    = int,
+		default = 16384,
+		help    = \
+			"Ensure each frame can be decoded into a buffer of the given "
+			"number of 32-bit words, to match the size of the player's MDEC "
+			"buffers (default 16384)",
+		metavar = "words"
+	)
+
+	group = parser.add_argument_group("Stream options")
+	group.add_argument(
+		"-a", "--audio",
+		type    = Path,
+		help    = \
+			"Interleave the given XA-ADPCM audio file with the video on "
+			"channel 0",
+		metavar = "file"
+	)
+	group.add_argument(
+		"-n", "--interleave",
+		type    = int,
+		default = 8,
+		help    = \
+			"Place audio sectors once every N sectors (default 8, suitable "
+			"for 37800 Hz stereo audio at double speed)",
+		metavar = "N"
+	)
+	group.add_argument(
+		"-f", "--file-number",
+		type    = int,
+		default = 1,
+		help    = "Set the XA file number of all sectors (default 1)",
+		metavar = "value"
+	)
+	group.add_argument(
+		"-c", "--video-channel",
+		type    = int,
+		default = 1,
+		help    = "Set the channel number of video sectors (default 1)",
+		metavar = "value"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"input",
+		type  = Path,
+		nargs = "+",
+		help  = \
+			"Paths to input frames (either still or animated images, which "
+			"are concatenated in the order given)"
+	)
+	group.add_argument(
+		"output",
+		type = FileType("wb"),
+		help = "Path to stream file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	numAudio: int = 1 if args.audio else 0
+
+	if not (0 < args.interleave <= 32):
+		parser.error("interleave must be in 1-32 range")
+	if not (numAudio <= args.video_channel < 31):
+		parser.error("video channel must be in 1-30 range")
+
+	try:
+		audioChannels: list[list[bytes]] = [
+			readAudioSectors(args.audio, args.file_number, 0)
+		] if args.audio else []
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	frames:  list[ndarray] = list(loadFrames(args.input))
+	height, width, _       = frames[0].shape
+
+	if any(frame.shape != frames[0].shape for frame in frames):
+		parser.error("all frames must have the same size")
+
+	budgets: list[int] = getFrameBudgets(
+		len(frames),
+		args.frame_rate,
+		BASE_SECTOR_RATE * args.speed,
+		args.interleave,
+		numAudio
+	)
+
+	if not all(budgets):
+		parser.error("frame rate is too high for the given drive speed")
+
+	dataSectors: list[bytes] = []
+
+	for index, ( frame, budget ) in enumerate(zip(frames, budgets)):
+		try:
+			data, _ = encodeFrameWithBudget(
+				transformBlocks(toBlocks(frame)),
+				budget * CHUNK_SIZE,
+				args.max_mdec_length,
+				args.bitstream_version
+			)
+		except RuntimeError as err:
+			parser.error(f"frame {index}: {err.args[0]}")
+
+		dataSectors.extend(makeFrameSectors(
+			data,
+			index + 1,
+			width,
+			height,
+			budget,
+			args.file_number,
+			args.video_channel
+		))
+
+	sectors: list[bytes] = interleave(
+		audioChannels,
+		dataSectors,
+		args.interleave,
+		args.file_number
+	)
+
+	with args.output as file:
+		for sector in sectors:
+			file.write(sector)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,368 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""PlayStation 1 memory card image tool
+
+A simple script to create, inspect and modify raw (.mcd) memory card images,
+using the same directory and block chain layout as the BIOS and the memory card
+filesystem library (src/ps1/memcardfs.c). Files are replaced using the same
+algorithm as the library, so this tool can be used to test save file layouts on
+a PC before running them on hardware or in an emulator. Requires no external
+dependencies.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+from argparse    import ArgumentParser, FileType, Namespace
+from dataclasses import dataclass
+from enum        import IntEnum
+from pathlib     import Path
+from struct      import Struct
+
+## Memory card layout
+
+SECTOR_SIZE:       int = 128
+SECTORS_PER_BLOCK: int = 64
+BLOCK_SIZE:        int = SECTOR_SIZE * SECTORS_PER_BLOCK
+NUM_BLOCKS:        int = 15
+CARD_SIZE:         int = BLOCK_SIZE * (NUM_BLOCKS + 1)
+MAX_NAME_LENGTH:   int = 20
+
+HEADER_MAGIC:       bytes  = b"MC"
+DIR_ENTRY_STRUCT:   Struct = Struct("< 2I H 21s 96x")
+BROKEN_LIST_STRUCT: Struct = Struct("< I 4x H 117x")
+BROKEN_LIST_OFFSET: int    = 16
+BROKEN_LIST_LENGTH: int    = 20
+WRITE_TEST_SECTOR:  int    = 63
+NO_BLOCK:           int    = 0xffff
+
+class BlockState(IntEnum):
+	FREE           = 0xa0
+	FIRST          = 0x51
+	MIDDLE         = 0x52
+	LAST           = 0x53
+	DELETED_FIRST  = 0xa1
+	DELETED_MIDDLE = 0xa2
+	DELETED_LAST   = 0xa3
+
+def xorChecksum(data: bytes) -> int:
+	value: int = 0
+
+	for byte in data:
+		value ^= byte
+
+	return value
+
+def makeSector(data: bytes) -> bytes:
+	# All metadata sectors are protected by an XOR checksum of their first 127
+	# bytes, placed in the last byte.
+	data = data[0:SECTOR_SIZE - 1].ljust(SECTOR_SIZE - 1, b"\0")
+
+	return data + bytes([ xorChecksum(data) ])
+
+@dataclass
+class DirEntry:
+	state:     int
+	length:    int = 0
+	nextBlock: int = NO_BLOCK
+	name:      str = ""
+	valid:     bool = True
+
+	@staticmethod
+	def parse(data: bytes) -> "DirEntry":
+		state, length, nextBlock, name = \
+			DIR_ENTRY_STRUCT.unpack(data[0:DIR_ENTRY_STRUCT.size])
+
+		return DirEntry(
+			state,
+			length,
+			nextBlock,
+			name.split(b"\0", 1)[0].decode("ascii", "replace"),
+			xorChecksum(data[0:SECTOR_SIZE - 1]) == data[SECTOR_SIZE - 1]
+		)
+
+	def serialize(self) -> bytes:
+		return makeSector(DIR_ENTRY_STRUCT.pack(
+			self.state,
+			self.length,
+			self.nextBlock,
+			self.name.encode("ascii")
+		))
+
+	def isFree(self) -> bool:
+		return self.valid and \
+			(BlockState.FREE <= self.state <= BlockState.DELETED_LAST)
+
+class MemoryCard:
+	def __init__(self, data: bytes | None = None):
+		if data is None:
+			self.data: bytearray = self._format()
+		elif len(data) == CARD_SIZE:
+			self.data: bytearray = bytearray(data)
+		else:
+			raise RuntimeError(f"image must be exactly {CARD_SIZE} bytes long")
+
+		if self.data[0:2] != HEADER_MAGIC:
+			raise RuntimeError("image is not formatted")
+
+		self.entries: list[DirEntry] = [
+			DirEntry.parse(self.readSector(i + 1)) for i in range(NUM_BLOCKS)
+		]
+
+	def _format(self) -> bytearray:
+		data:   bytearray = bytearray(CARD_SIZE)
+		header: bytes     = makeSector(HEADER_MAGIC)
+
+		data[0:SECTOR_SIZE] = header
+
+		for i in range(NUM_BLOCKS):
+			offset: int = (i + 1) * SECTOR_SIZE
+			data[offset:offset + SECTOR_SIZE] = \
+				DirEntry(BlockState.FREE).serialize()
+
+		for i in range(BROKEN_LIST_LENGTH):
+			offset: int = (BROKEN_LIST_OFFSET + i) * SECTOR_SIZE
+			data[offset:offset + SECTOR_SIZE] = \
+				makeSector(BROKEN_LIST_STRUCT.pack(0xffffffff, NO_BLOCK))
+
+		offset: int = WRITE_TEST_SECTOR * SECTOR_SIZE
+		data[offset:offset + SECTOR_SIZE] = header
+
+		return data
+
+	def readSector(self, sector: int) -> bytes:
+		offset: int = sector * SECTOR_SIZE
+
+		return self.data[offset:offset + SECTOR_SIZE]
+
+	def _commitEntries(self):
+		for i, entry in enumerate(self.entries):
+			offset: int = (i + 1) * SECTOR_SIZE
+			self.data[offset:offset + SECTOR_SIZE] = entry.serialize()
+
+	def followChain(self, first: int) -> list[int]:
+		chain: list[int] = []
+		block: int       = first
+
+		for i in range(NUM_BLOCKS):
+			entry: DirEntry = self.entries[block]
+
+			if not entry.valid:
+				raise RuntimeError(f"entry {block} has an invalid checksum")
+			if entry.state not in (
+				( BlockState.FIRST, ) if not i else \
+				( BlockState.MIDDLE, BlockState.LAST )
+			):
+				raise RuntimeError(f"entry {block} is not part of a file")
+
+			chain.append(block)
+
+			if entry.state == BlockState.LAST:
+				return chain
+
+			block = entry.nextBlock
+
+			if block == NO_BLOCK:
+				if entry.state == BlockState.FIRST:
+					return chain
+
+				raise RuntimeError(f"chain ends early at entry {chain[-1]}")
+			if block >= NUM_BLOCKS:
+				raise RuntimeError(f"entry {chain[-1]} has invalid next block")
+
+		raise RuntimeError(f"chain starting at entry {first} loops")
+
+	def findFile(self, name: str) -> int | None:
+		for i, entry in enumerate(self.entries):
+			if not entry.valid or entry.state != BlockState.FIRST:
+				continue
+			if entry.name == name[0:MAX_NAME_LENGTH]:
+				return i
+
+		return None
+
+	def listFiles(self) -> list[tuple[str, int, list[int]]]:
+		return [
+			( entry.name, entry.length, self.followChain(i) )
+			for i, entry in enumerate(self.entries)
+			if entry.valid and entry.state == BlockState.FIRST
+		]
+
+	def getFreeBlocks(self) -> int:
+		return sum(entry.isFree() for entry in self.entries)
+
+	def readFile(self, name: str) -> bytes:
+		first: int | None = self.findFile(name)
+
+		if first is None:
+			raise RuntimeError(f"file not found: {name}")
+
+		data: bytearray = bytearray()
+
+		for block in self.followChain(first):
+			offset: int = (block + 1) * BLOCK_SIZE
+			data.extend(self.data[offset:offset + BLOCK_SIZE])
+
+		return bytes(data[0:self.entries[first].length])
+
+	def writeFile(self, name: str, data: bytes):
+		if len(name) > MAX_NAME_LENGTH:
+			raise RuntimeError(
+				f"file name must be {MAX_NAME_LENGTH} characters or less"
+			)
+
+		# Write the new contents to free blocks first, then link them in the
+		# directory and only delete the old copy last, just like the library.
+		numBlocks: int       = max((len(data) + BLOCK_SIZE - 1) // BLOCK_SIZE, 1)
+		chain:     list[int] = [
+			i for i, entry in enumerate(self.entries) if entry.isFree()
+		][0:numBlocks]
+		old:       int | None = self.findFile(name)
+
+		if len(chain) < numBlocks:
+			raise RuntimeError(
+				f"not enough free blocks ({numBlocks} required, "
+				f"{len(chain)} available)"
+			)
+
+		data = data.ljust(numBlocks * BLOCK_SIZE, b"\0")
+
+		for i, block in enumerate(chain):
+			offset: int = (block + 1) * BLOCK_SIZE
+			self.data[offset:offset + BLOCK_SIZE] = \
+				data[i * BLOCK_SIZE:(i + 1) * BLOCK_SIZE]
+
+		for i, block in enumerate(chain):
+			if not i:
+				state: BlockState = BlockState.FIRST
+			elif i == (numBlocks - 1):
+				state: BlockState = BlockState.LAST
+			else:
+				state: BlockState = BlockState.MIDDLE
+
+			self.entries[block] = DirEntry(
+				state,
+				0 if i else len(data),
+				chain[i + 1] if (i < (numBlocks - 1)) else NO_BLOCK,
+				"" if i else name
+			)
+
+		if old is not None:
+			self.deleteFile(old)
+
+		self._commitEntries()
+
+	def deleteFile(self, first: int):
+		for block in self.followChain(first):
+			entry: DirEntry = self.entries[block]
+			entry.state    += BlockState.DELETED_FIRST - BlockState.FIRST
+
+		self._commitEntries()
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Creates, inspects and modifies PlayStation 1 memory card images "
+			"(.mcd).",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Image options")
+	group.add_argument(
+		"-c", "--create",
+		action = "store_true",
+		help   = "Create a new, empty image (overwriting any existing one)"
+	)
+	group.add_argument(
+		"-a", "--add",
+		type    = Path,
+		nargs   = 2,
+		action  = "append",
+		default = [],
+		help    = "Add or replace a file using the contents of the given path",
+		metavar = ( "name", "path" )
+	)
+	group.add_argument(
+		"-x", "--extract",
+		type    = Path,
+		nargs   = 2,
+		action  = "append",
+		default = [],
+		help    = "Extract a file's contents to the given path",
+		metavar = ( "name", "path" )
+	)
+	group.add_argument(
+		"-d", "--delete",
+		type    = str,
+		action  = "append",
+		default = [],
+		help    = "Delete a file",
+		metavar = "name"
+	)
+	group.add_argument(
+		"-l", "--list",
+		action = "store_true",
+		help   = "List all files and free space after performing all changes"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"image",
+		type = Path,
+		help = "Path to memory card image to create or modify",
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	try:
+		if args.create:
+			card: MemoryCard = MemoryCard()
+		else:
+			with open(args.image, "rb") as file:
+				card: MemoryCard = MemoryCard(file.read())
+
+		for name in args.delete:
+			first: int | None = card.findFile(name)
+
+			if first is None:
+				raise RuntimeError(f"file not found: {name}")
+
+			card.deleteFile(first)
+
+		for name, path in args.add:
+			with open(path, "rb") as file:
+				card.writeFile(str(name), file.read())
+
+		for name, path in args.extract:
+			with open(path, "wb") as file:
+				file.write(card.readFile(str(name)))
+
+		if args.list:
+			for name, length, chain in card.listFiles():
+				blocks: str = ", ".join(str(block + 1) for block in chain)
+				print(f"{name:<20}  {length:6d} bytes  (blocks {blocks})")
+
+			print(f"{card.getFreeBlocks()} free blocks")
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	if args.create or args.add or args.delete:
+		with open(args.image, "wb") as file:
+			file.write(card.data)
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""CD-ROM XA stream interleaver
+
+A simple script to combine one or more XA-ADPCM audio files (as generated by
+psxavenc -t xa) and a data file into a single interleaved stream, suitable for
+playback using the XA streaming library. Each audio file is assigned its own
+channel and placed once every N sectors, while the data file is split into
+2048-byte sectors and placed in the remaining slots of each group on a separate
+channel. The output is a file made up of 2336-byte sectors (XA subheader and
+data), which can be placed on a disc by listing it in the disc image builder's
+manifest with the "xa" key set.
+
+The interleave must match the format of the audio files: at double speed it
+should be 8 for 37800 Hz stereo, 16 for 37800 Hz mono or 18900 Hz stereo and
+32 for 18900 Hz mono audio. All audio files must share the same format.
+"""
+
+__version__ = "0.1.0"
+__author__  = "spicyjpeg"
+
+from argparse import ArgumentParser, FileType, Namespace
+from pathlib  import Path
+
+## XA sector generation
+
+XA_SECTOR_SIZE: int = 2336
+SUBHEADER_SIZE: int = 8
+DATA_SIZE:      int = 2048
+MAX_CHANNELS:   int = 32
+NULL_CHANNEL:   int = MAX_CHANNELS - 1
+
+SUBMODE_EOR:   int = 1 << 0
+SUBMODE_AUDIO: int = 1 << 2
+SUBMODE_DATA:  int = 1 << 3
+SUBMODE_FORM2: int = 1 << 5
+SUBMODE_EOF:   int = 1 << 7
+
+def makeSubheader(
+	file:       int,
+	channel:    int,
+	submode:    int,
+	codingInfo: int
+) -> bytes:
+	return bytes(( file, channel, submode, codingInfo )) * 2
+
+def makeDataSector(file: int, channel: int, data: bytes, last: bool) -> bytes:
+	# The EDC and ECC fields following the data are left blank here and filled
+	# in by the disc image builder.
+	submode: int = SUBMODE_DATA
+
+	if last:
+		submode |= SUBMODE_EOR | SUBMODE_EOF
+
+	return makeSubheader(file, channel, submode, 0) \
+		+ data.ljust(XA_SECTOR_SIZE - SUBHEADER_SIZE, b"\0")
+
+def makeNullSector(file: int) -> bytes:
+	# Null sectors have neither the audio nor the data flag set, so they are
+	# delivered to the CPU (which allows the end of a stream to be detected)
+	# but ignored by both the XA-ADPCM decoder and the streaming library.
+	return makeSubheader(file, NULL_CHANNEL, SUBMODE_FORM2, 0) \
+		+ bytes(XA_SECTOR_SIZE - SUBHEADER_SIZE)
+
+def readAudioSectors(path: Path, file: int, channel: int) -> list[bytes]:
+	with open(path, "rb") as _file:
+		data: bytes = _file.read()
+
+	if (not data) or (len(data) % XA_SECTOR_SIZE):
+		raise RuntimeError(
+			f"{path} is not a valid XA file (expected 2336-byte sectors)"
+		)
+
+	sectors: list[bytes] = []
+
+	for offset in range(0, len(data), XA_SECTOR_SIZE):
+		sector: bytes = data[offset:offset + XA_SECTOR_SIZE]
+
+		if not (sector[2] & SUBMODE_AUDIO):
+			raise RuntimeError(f"{path} contains non-audio sectors")
+
+		# Replace the file and channel numbers in both copies of the
+		# subheader, keeping the submode and coding information.
+		sectors.append(
+			makeSubheader(file, channel, sector[2], sector[3])
+			+ sector[SUBHEADER_SIZE:]
+		)
+
+	return sectors
+
+def interleave(
+	audioChannels: list[list[bytes]],
+	dataSectors:   list[bytes],
+	groupSize:     int,
+	file:          int
+) -> list[bytes]:
+	dataSlots: int = groupSize - len(audioChannels)
+	numGroups: int = max(
+		max(( len(sectors) for sectors in audioChannels ), default = 0),
+		(len(dataSectors) + dataSlots - 1) // dataSlots if dataSlots else 0
+	)
+
+	output:    list[bytes] = []
+	dataIndex: int         = 0
+
+	for group in range(numGroups):
+		for slot in range(groupSize):
+			if slot < len(audioChannels):
+				sectors: list[bytes] = audioChannels[slot]
+
+				if group < len(sectors):
+					output.append(sectors[group])
+					continue
+			elif dataIndex < len(dataSectors):
+				output.append(dataSectors[dataIndex])
+				dataIndex += 1
+				continue
+
+			output.append(makeNullSector(file))
+
+	# Make sure the stream ends with a non-audio sector flagged as the end of
+	# the file.
+	if (not output) or (output[-1][2] & SUBMODE_AUDIO):
+		output.append(makeNullSector(file))
+
+	last: bytearray = bytearray(output[-1])
+	last[2]        |= SUBMODE_EOR | SUBMODE_EOF
+	last[6]        |= SUBMODE_EOR | SUBMODE_EOF
+	output[-1]      = bytes(last)
+
+	return output
+
+## Main
+
+def createParser() -> ArgumentParser:
+	parser = ArgumentParser(
+		description = \
+			"Interleaves one or more XA-ADPCM audio files and a data file "
+			"into a single stream of 2336-byte XA sectors.",
+		add_help    = False
+	)
+
+	group = parser.add_argument_group("Tool options")
+	group.add_argument(
+		"-h", "--help",
+		action = "help",
+		help   = "Show this help message and exit"
+	)
+
+	group = parser.add_argument_group("Stream options")
+	group.add_argument(
+		"-n", "--interleave",
+		type    = int,
+		default = 8,
+		help    = \
+			"Place each audio channel once every N sectors (default 8, "
+			"suitable for 37800 Hz stereo audio at double speed)",
+		metavar = "N"
+	)
+	group.add_argument(
+		"-f", "--file-number",
+		type    = int,
+		default = 1,
+		help    = "Set the XA file number of all sectors (default 1)",
+		metavar = "value"
+	)
+	group.add_argument(
+		"-a", "--audio",
+		type    = Path,
+		action  = "append",
+		default = [],
+		help    = \
+			"Add an XA-ADPCM audio file as the next audio channel, starting "
+			"from channel 0 (can be specified multiple times)",
+		metavar = "file"
+	)
+	group.add_argument(
+		"-D", "--data",
+		type    = FileType("rb"),
+		help    = "Place the contents of the given file on the data channel",
+		metavar = "file"
+	)
+	group.add_argument(
+		"-c", "--data-channel",
+		type    = int,
+		help    = \
+			"Set the data channel number (default is the channel following "
+			"the last audio channel)",
+		metavar = "value"
+	)
+
+	group = parser.add_argument_group("File paths")
+	group.add_argument(
+		"output",
+		type = FileType("wb"),
+		help = "Path to stream file to generate"
+	)
+
+	return parser
+
+def main():
+	parser: ArgumentParser = createParser()
+	args:   Namespace      = parser.parse_args()
+
+	numAudio:    int = len(args.audio)
+	dataChannel: int = \
+		numAudio if (args.data_channel is None) else args.data_channel
+
+	if not (0 < args.interleave <= MAX_CHANNELS):
+		parser.error(f"interleave must be in 1-{MAX_CHANNELS} range")
+	if numAudio > args.interleave:
+		parser.error("too many audio channels for the given interleave")
+	if args.data and (numAudio >= args.interleave):
+		parser.error("no room left for the data channel")
+	if not (0 <= dataChannel < NULL_CHANNEL):
+		parser.error(f"data channel must be in 0-{NULL_CHANNEL - 1} range")
+	if dataChannel < numAudio:
+		parser.error("data channel overlaps an audio channel")
+
+	try:
+		audioChannels: list[list[bytes]] = [
+			readAudioSectors(path, args.file_number, channel)
+			for channel, path in enumerate(args.audio)
+		]
+	except RuntimeError as err:
+		parser.error(err.args[0])
+
+	dataSectors: list[bytes] = []
+
+	if args.data:
+		with args.data as file:
+			data: bytes = file.read()
+
+		for offset in range(0, len(data), DATA_SIZE):
+			dataSectors.append(makeDataSector(
+				args.file_number,
+				dataChannel,
+				data[offset:offset + DATA_SIZE],
+				(offset + DATA_SIZE) >= len(data)
+			))
+
+	sectors: list[bytes] = interleave(
+		audioChannels,
+		dataSectors,
+		args.interleave,
+		args.file_number
+	)
+
+	with args.output as file:
+		for sector in sectors:
+			file.write(sector)
+
+if __name__ == "__main__":
+	main()